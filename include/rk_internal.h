@@ -31,7 +31,13 @@
 // C++ headers for SurfaceFlinger
 #ifdef __cplusplus
 #include <utils/RefBase.h>
+#include <binder/IBinder.h>
 #include <ui/DisplayId.h>
+#include <ui/DisplayState.h>
+
+namespace android {
+class DisplayEventReceiver;
+}
 #endif
 
 #ifdef __cplusplus
@@ -47,15 +53,136 @@ typedef struct {
     int width;           // 图像宽度（像素）
     int height;          // 图像高度（像素）
     int stride;          // 行步进（像素）
+    int height_stride;   // 垂直步进（行）
     int format;          // 像素格式
     void* vir_addr;      // mmap 后的虚拟地址
+    struct RkDmaBufPool* pool;  // 租借来源（NULL 表示独占）
+    bool sync_unsupported;      // fd 不支持 DMA_BUF_IOCTL_SYNC（如 memfd）
+    struct RkImportCache* import_cache;  // 导入缓存借出（NULL 表示非缓存）
+    uint64_t rga_handle;        // 已导入的 RGA 句柄（0 表示未导入）
+    void* mpp_buf;              // 已导入的 MppBuffer（NULL 表示未导入）
+    bool dma32;                 // 物理地址在 4G 以下（RGA2 只能访问 32 位地址）
 } RkDmaBuffer;
 
+// ============================================
+// DMA-BUF 分配器（DMA-HEAP / memfd）
+// ============================================
+typedef struct {
+    const char* name;
+    int (*alloc_fd)(size_t size);   // 返回 fd，失败返回 -1
+    bool dma32;                     // 分配的 buffer 都在 4G 以下
+} RkDmaAllocator;
+
+const RkDmaAllocator* rk_dmabuf_heap_allocator(void);
+const RkDmaAllocator* rk_dmabuf_dma32_allocator(void);  // system-dma32 heap，RGA2 可访问
+const RkDmaAllocator* rk_dmabuf_memfd_allocator(void);  // 纯 Linux 主机测试用
+// 优先 system-dma32 heap，其次 cma / system heap，都没有时 memfd
+const RkDmaAllocator* rk_dmabuf_default_allocator(void);
+
+// 像素格式布局（RkImageFormat 的 Raw 格式）
+int rk_format_bits_per_pixel(int format);           // 0 表示不支持
+size_t rk_format_frame_size(int format, int stride, int height_stride);
+size_t rk_format_packed_size(int format, int width, int height);   // 无步进填充的紧凑大小
+const char* rk_format_name(int format);
+
 // DMA-BUF 操作
 RkDmaBuffer* rk_dmabuf_alloc(int width, int height);
-void* rk_dmabuf_map(RkDmaBuffer* buf);
+RkDmaBuffer* rk_dmabuf_alloc_with(const RkDmaAllocator* allocator,
+                                  int width, int height, int format);
+// 按对齐要求分配（hor_align/ver_align 为像素/行，<= 1 表示紧凑）
+RkDmaBuffer* rk_dmabuf_alloc_aligned(const RkDmaAllocator* allocator,
+                                     int width, int height, int format,
+                                     int hor_align, int ver_align);
+void* rk_dmabuf_map(RkDmaBuffer* buf);    // 映射保持到 buffer 释放
 void rk_dmabuf_unmap(RkDmaBuffer* buf);
-void rk_dmabuf_free(RkDmaBuffer* buf);
+void rk_dmabuf_free(RkDmaBuffer* buf);   // 租借的 buffer 自动归还 pool / 导入缓存
+
+// CPU 访问区间（DMA_BUF_IOCTL_SYNC 包围，保证 cache 一致性）
+#define RK_DMABUF_CPU_READ   (1 << 0)
+#define RK_DMABUF_CPU_WRITE  (1 << 1)
+
+void* rk_dmabuf_begin_cpu_access(RkDmaBuffer* buf, int access, size_t offset, size_t len);
+void rk_dmabuf_end_cpu_access(RkDmaBuffer* buf, int access, size_t offset, size_t len);
+
+// 映射/同步计数（进程内累计）
+typedef struct {
+    uint64_t maps;
+    uint64_t unmaps;
+    uint64_t syncs;
+} RkDmaBufStats;
+
+void rk_dmabuf_get_stats(RkDmaBufStats* stats);
+
+// ============================================
+// DMA-BUF 缓冲池（按 width/height/format/stride 复用）
+// ============================================
+typedef struct RkDmaBufPool RkDmaBufPool;
+
+typedef struct {
+    uint64_t hits;              // 命中空闲 buffer
+    uint64_t misses;            // 需要新分配
+    uint64_t evictions;         // 超过上限被释放
+    size_t idle_bytes;          // 空闲 buffer 占用
+    size_t leased_bytes;        // 已租出 buffer 占用
+    size_t high_water_bytes;    // 峰值占用 (idle + leased)
+    int idle_count;
+    int leased_count;
+} RkDmaBufPoolStats;
+
+RkDmaBufPool* rk_dmabuf_pool_create(const RkDmaAllocator* allocator, size_t max_idle_bytes);
+void rk_dmabuf_pool_destroy(RkDmaBufPool* pool);
+RkDmaBuffer* rk_dmabuf_pool_acquire(RkDmaBufPool* pool, int width, int height, int format);
+RkDmaBuffer* rk_dmabuf_pool_acquire_aligned(RkDmaBufPool* pool, int width, int height, int format,
+                                            int hor_align, int ver_align);
+void rk_dmabuf_pool_release(RkDmaBufPool* pool, RkDmaBuffer* buf);
+void rk_dmabuf_pool_trim(RkDmaBufPool* pool, size_t max_idle_bytes);
+void rk_dmabuf_pool_get_stats(RkDmaBufPool* pool, RkDmaBufPoolStats* stats);
+
+// ============================================
+// 外部 buffer 导入缓存（按唯一 ID 复用 RGA/MPP 导入）
+// ============================================
+// SurfaceFlinger 在少量 GraphicBuffer 间轮转，缓存条目持有 buffer 引用，
+// 使 importbuffer_fd 句柄和 mpp_buffer_import 结果跨帧保持有效。
+typedef struct {
+    void* user;
+    // 导入失败返回非 0，对应句柄保持为空（使用方回退到按 fd 访问）
+    int (*import_rga)(void* user, const RkDmaBuffer* buf, uint64_t* handle);
+    void (*release_rga)(void* user, uint64_t handle);
+    int (*import_mpp)(void* user, const RkDmaBuffer* buf, void** mpp_buf);
+    void (*release_mpp)(void* user, void* mpp_buf);
+    // 释放 buffer 所有者引用（如 GraphicBuffer 强引用）
+    void (*release_owner)(void* user, void* owner);
+} RkImportOps;
+
+// 一帧待导入的外部 buffer
+typedef struct {
+    uint64_t id;        // 唯一 ID（GraphicBuffer::getId）
+    int fd;             // 借用的 fd，未命中时 dup
+    size_t size;
+    int width;
+    int height;
+    int stride;
+    int height_stride;
+    int format;
+    void* owner;        // 所有者引用，交给缓存管理
+} RkImportDesc;
+
+typedef struct RkImportCache RkImportCache;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    int entries;
+} RkImportCacheStats;
+
+RkImportCache* rk_import_cache_create(const RkImportOps* ops, int capacity);
+void rk_import_cache_destroy(RkImportCache* cache);
+RkScreenshotError rk_import_cache_acquire(RkImportCache* cache, const RkImportDesc* desc,
+                                          RkDmaBuffer** out);
+void rk_import_cache_release(RkImportCache* cache, RkDmaBuffer* buf);
+void rk_import_cache_clear(RkImportCache* cache);   // 释放所有未使用条目
+void rk_import_cache_get_stats(RkImportCache* cache, RkImportCacheStats* stats);
 
 // 时间工具
 uint64_t rk_get_time_us(void);
@@ -66,10 +193,31 @@ uint64_t rk_get_time_us(void);
 // ============================================
 // SurfaceFlinger 上下文 (C++ only)
 // ============================================
+
+// 单个显示器的缓存：仅在热插拔/模式变化/捕获失败时刷新，避免每帧两次 Binder 调用
+struct RkSfDisplay {
+    android::PhysicalDisplayId id;
+    bool internal;
+    android::sp<android::IBinder> token;
+    android::ui::DisplayState state;
+    float refresh_rate;
+    bool valid;                     // token/state 是否可用
+    bool removed;                   // 已拔出，最后一次捕获结束后释放
+    int busy;                       // 进行中的捕获数
+    RkImportCache* import_cache;    // 该显示器的 GraphicBuffer 导入缓存
+};
+
 struct RkSurfaceFlingerContext {
     bool initialized;
+    pthread_mutex_t lock;           // 保护显示器表；捕获本身不持锁，可并发
     uint64_t total_captures;
     uint64_t total_time_us;
+
+    RkSfDisplay* displays[RK_MAX_DISPLAYS * 2];    // 含已拔出但仍在捕获中的条目
+    int display_count;
+    bool displays_valid;            // 显示器列表是否需要重新枚举
+    android::DisplayEventReceiver* display_events;  // 热插拔/模式变化通知
+    uint64_t display_refreshes;
 };
 
 extern "C" {
@@ -77,10 +225,61 @@ extern "C" {
 struct RkSurfaceFlingerContext;
 #endif
 
-// SurfaceFlinger 捕获
+// 捕获请求：由合成器（或其他帧来源）直接输出缩放/裁剪后的图像
+typedef struct {
+    uint64_t display_id;    // 0 表示主屏
+    int width;              // 输出尺寸，0 表示与源区域相同
+    int height;
+    int crop_x;             // 源区域（显示坐标），crop_width/height 为 0 表示全屏
+    int crop_y;
+    int crop_width;
+    int crop_height;
+} RkCaptureRequest;
+
 RkScreenshotError rk_sf_init(struct RkSurfaceFlingerContext** ctx);
 void rk_sf_deinit(struct RkSurfaceFlingerContext* ctx);
-RkScreenshotError rk_sf_capture(struct RkSurfaceFlingerContext* ctx, RkDmaBuffer** out);
+RkScreenshotError rk_sf_get_displays(struct RkSurfaceFlingerContext* ctx,
+                                     RkDisplayInfo* displays, int max_count, int* count);
+RkScreenshotError rk_sf_get_display_size(struct RkSurfaceFlingerContext* ctx, uint64_t display_id,
+                                         int* width, int* height);
+// req 为 NULL 时捕获全分辨率
+RkScreenshotError rk_sf_capture(struct RkSurfaceFlingerContext* ctx,
+                                const RkCaptureRequest* req, RkDmaBuffer** out);
+
+// ============================================
+// 帧来源：SurfaceFlinger / 合成图案 / 原始帧回放
+// ============================================
+// 管线只经由此接口取帧，无 SurfaceFlinger 的主机上也可以跑 benchmark
+typedef struct RkFrameSource RkFrameSource;
+
+struct RkFrameSource {
+    const char* name;
+    void* priv;
+    RkScreenshotError (*get_displays)(RkFrameSource* src, RkDisplayInfo* displays,
+                                      int max_count, int* count);
+    RkScreenshotError (*get_display_size)(RkFrameSource* src, uint64_t display_id,
+                                          int* width, int* height);
+    // 输出一帧 RGBA（尺寸/裁剪语义同 rk_sf_capture），调用者 rk_dmabuf_free
+    RkScreenshotError (*capture)(RkFrameSource* src, const RkCaptureRequest* req,
+                                 RkDmaBuffer** out);
+    void (*destroy)(RkFrameSource* src);
+};
+
+typedef struct {
+    int width;                          // 虚拟显示器尺寸
+    int height;
+    int change_interval;                // 每 N 帧画面变化一次，0 表示静止画面
+    const RkDmaAllocator* allocator;    // NULL 表示 rk_dmabuf_default_allocator
+} RkSyntheticSourceConfig;
+
+RkFrameSource* rk_frame_source_create_sf(void);
+RkFrameSource* rk_frame_source_create_synthetic(const RkSyntheticSourceConfig* cfg);
+// 文件为紧凑排列的 RGBA8888 帧（width * height * 4 字节/帧），播放到末尾后循环
+RkFrameSource* rk_frame_source_create_replay(const char* path, int width, int height,
+                                             const RkDmaAllocator* allocator);
+// "sf" | "synthetic[:WxH[:N]]" | "replay:FILE:WxH"，无效时返回 NULL
+RkFrameSource* rk_frame_source_create_from_spec(const char* spec);
+void rk_frame_source_destroy(RkFrameSource* src);
 
 #ifdef __cplusplus
 }
@@ -95,15 +294,217 @@ extern "C" {
 
 typedef struct {
     bool initialized;
-    pthread_mutex_t lock;
+    pthread_mutex_t lock;       // 仅保护统计，作业本身不持锁
     uint64_t total_ops;
     uint64_t total_time_us;
+    uint64_t async_ops;         // 异步提交数（耗时不计入 total_time_us）
+    uint32_t core_mask;         // 探测到的核心，bit = RkRgaCore；0 表示未知
+    char version[64];           // querystring(RGA_VERSION) 首行
 } RkRgaProcessor;
 
+// RK3588：两个 RGA3 核 + 一个 RGA2 核，AUTO 交给驱动选择
+typedef enum {
+    RK_RGA_CORE_AUTO = -1,
+    RK_RGA_CORE_RGA3_0 = 0,
+    RK_RGA_CORE_RGA3_1,
+    RK_RGA_CORE_RGA2,
+    RK_RGA_CORE_COUNT
+} RkRgaCore;
+
 RkScreenshotError rk_rga_init(RkRgaProcessor* proc);
 void rk_rga_deinit(RkRgaProcessor* proc);
 RkScreenshotError rk_rga_process(RkRgaProcessor* proc, RkDmaBuffer* src, RkDmaBuffer* dst, int rotation);
 
+// 单次作业：裁剪 -> 缩放 -> 旋转 -> 镜像，结果充满 dst 的输出区域
+// dst 为 RGB888/BGR888/NV12/I420 时同时完成颜色转换（YUV 为 JFIF 全范围 BT.601）
+typedef struct {
+    int crop_x;                 // 源区域，crop_width/height 为 0 表示整幅源图
+    int crop_y;
+    int crop_width;
+    int crop_height;
+    int rotation;               // 顺时针 0, 90, 180, 270
+    bool flip_horizontal;       // 输出图像左右镜像
+    bool flip_vertical;         // 输出图像上下镜像
+    int dst_x;                  // 输出区域，dst_width/height 为 0 表示整幅 dst（分块用）
+    int dst_y;                  // YUV 输出时 dst_x/dst_y 须为偶数
+    int dst_width;
+    int dst_height;
+} RkRgaJob;
+
+RkScreenshotError rk_rga_process_job(RkRgaProcessor* proc, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                     const RkRgaJob* job);
+
+// 作业可输出的格式：RGBA/RGBX、RGB888、BGR888、YUV420SP、YUV420P
+bool rk_rga_output_format_supported(int format);
+
+// 校验作业参数（裁剪区域在源图内、旋转角度合法、源 RGBA、目标格式可输出）
+RkScreenshotError rk_rga_job_check(const RkDmaBuffer* src, const RkDmaBuffer* dst,
+                                   const RkRgaJob* job);
+
+// CPU 参考实现（最近邻采样），语义同 rk_rga_process_job，用于主机校验与性能对比
+RkScreenshotError rk_cpu_process_job(RkDmaBuffer* src, RkDmaBuffer* dst, const RkRgaJob* job);
+
+// 线程池：按行条带并行，调用线程参与执行
+typedef struct RkThreadPool RkThreadPool;
+
+RkThreadPool* rk_thread_pool_create(int threads);   // threads <= 0 取在线 CPU 数
+void rk_thread_pool_destroy(RkThreadPool* pool);
+int rk_thread_pool_size(const RkThreadPool* pool);  // 含调用线程
+// 执行 fn(arg, 0..count-1) 全部完成后返回；多个调用者串行使用同一线程池
+void rk_thread_pool_run(RkThreadPool* pool, int count, void (*fn)(void* arg, int index),
+                        void* arg);
+
+// CPU 处理后端：SIMD 缩放 + 旋转镜像（NEON / SSE2，其余标量）
+typedef enum {
+    RK_CPU_FILTER_AUTO = 0,     // 两个方向都缩小 >= 2 倍用盒式，否则双线性
+    RK_CPU_FILTER_NEAREST,      // 同 rk_cpu_process_job
+    RK_CPU_FILTER_BILINEAR,
+    RK_CPU_FILTER_BOX,          // 区域平均，适合大比例缩小
+} RkCpuFilter;
+
+// 先缩放到旋转前尺寸，再旋转/镜像/转换格式；pool 为 NULL 时单线程
+RkScreenshotError rk_cpu_process_job_ex(RkDmaBuffer* src, RkDmaBuffer* dst, const RkRgaJob* job,
+                                        RkCpuFilter filter, RkThreadPool* pool);
+
+// 异步提交（IM_ASYNC）：立即返回，*release_fence 为作业完成时触发的 sync_file
+// acquire_fence >= 0 时 RGA 等其触发后才开始（所有权不转移）
+// core 指定执行核心（RkRgaCore），RK_RGA_CORE_AUTO 由驱动选择
+RkScreenshotError rk_rga_submit_job(RkRgaProcessor* proc, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                    const RkRgaJob* job, int core,
+                                    int acquire_fence, int* release_fence);
+
+// 批量提交：同一源的多个作业（各自输出 dsts[i]）作为一个 RGA job 提交，全部完成时触发一个 fence
+#define RK_RGA_BATCH_MAX 8
+
+RkScreenshotError rk_rga_submit_batch(RkRgaProcessor* proc, RkDmaBuffer* src,
+                                      RkDmaBuffer* const* dsts, const RkRgaJob* jobs, int count,
+                                      int core, int acquire_fence, int* release_fence);
+
+// 完成句柄：可 poll 的 fd（RGA sync_file / 模拟执行器的 pipe），触发后可读；
+// 以错误触发（sync_file status < 0、pipe 无数据挂断）时返回 RKSS_ERROR_RGA_FAILED
+// timeout_ms < 0 无限等待；fence < 0 视为已完成
+RkScreenshotError rk_fence_wait(int fence, int timeout_ms);
+void rk_fence_close(int fence);
+
+// RGA 作业执行器：硬件异步提交，或在 CPU 上模拟 RGA 延迟（主机测试调度逻辑）
+typedef struct RkRgaExecutor RkRgaExecutor;
+
+struct RkRgaExecutor {
+    const char* name;
+    void* priv;
+    // 提交后立即返回；src/dst 须保持到 *release_fence 触发，调用者 rk_fence_close
+    RkScreenshotError (*submit)(RkRgaExecutor* exec, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                const RkRgaJob* job, int acquire_fence, int* release_fence);
+    // 批量：count <= RK_RGA_BATCH_MAX，语义同 rk_rga_submit_batch
+    RkScreenshotError (*submit_batch)(RkRgaExecutor* exec, RkDmaBuffer* src,
+                                      RkDmaBuffer* const* dsts, const RkRgaJob* jobs, int count,
+                                      int acquire_fence, int* release_fence);
+    void (*destroy)(RkRgaExecutor* exec);
+};
+
+RkRgaExecutor* rk_rga_executor_create_hw(RkRgaProcessor* proc, int core);
+// 单队列串行执行，每个作业至少 latency_us；队列满 queue_depth 时 submit 阻塞
+RkRgaExecutor* rk_rga_executor_create_emulated(int latency_us, int queue_depth);
+// CPU 后端：在提交线程上同步完成（线程池分条带），release fence 恒为 -1
+RkRgaExecutor* rk_rga_executor_create_cpu(int threads, RkCpuFilter filter);
+// 小作业（RGA 启动开销占主导）走 cpu，其余走 rga，rga 失败时退回 cpu；接管两个执行器
+RkRgaExecutor* rk_rga_executor_create_hybrid(RkRgaExecutor* rga, RkRgaExecutor* cpu);
+void rk_rga_executor_destroy(RkRgaExecutor* exec);   // 等待已提交作业完成
+
+// 多核调度：按核心能力过滤，再选预计完成最早的核心（在途估计耗时 + 本作业估计耗时）
+// 小作业启动开销低的 RGA2 占优，大图缩放吞吐高的 RGA3 占优；I420 输出只有 RGA2
+// RGA2 只能访问 32 位物理地址：源与目标都来自 dma32 分配器时才会选它
+typedef struct {
+    int src_width;              // 源区域（裁剪后）
+    int src_height;
+    int dst_width;
+    int dst_height;
+    int dst_format;
+    int rotation;
+    bool high_mem;              // 有 buffer 可能在 4G 以上，RGA2 无法访问
+} RkRgaJobDesc;
+
+void rk_rga_job_describe(const RkDmaBuffer* src, const RkDmaBuffer* dst, const RkRgaJob* job,
+                         RkRgaJobDesc* desc);
+bool rk_rga_core_supports(int core, const RkRgaJobDesc* desc);
+// 源区域与输出都很小时 CPU 比一次 RGA 提交更快
+bool rk_cpu_job_is_tiny(const RkRgaJobDesc* desc);
+uint32_t rk_rga_core_cost_us(int core, const RkRgaJobDesc* desc);
+// 单次作业的尺寸上限（像素，宽高相同）
+void rk_rga_core_max_size(int core, int* max_src, int* max_dst);
+// 纯策略函数：core_mask 为可用核心，返回 RkRgaCore，无可用核心返回 -1
+int rk_rga_sched_pick(const RkRgaJobDesc* desc, const uint64_t pending_us[RK_RGA_CORE_COUNT],
+                      uint32_t core_mask);
+// 批量作业整体放在同一核心：须支持全部作业，成本为各作业之和
+int rk_rga_sched_pick_batch(const RkRgaJobDesc* descs, int count,
+                            const uint64_t pending_us[RK_RGA_CORE_COUNT], uint32_t core_mask);
+
+typedef struct {
+    uint64_t jobs;
+    uint64_t busy_us;           // 实测占用（完成时间 - max(提交, 上一作业完成)）
+    uint64_t pending_us;        // 在途作业估计耗时
+    int queued;                 // 在途作业数
+    int max_queued;
+} RkRgaCoreStats;
+
+// cores[i] 为 NULL 表示该核不可用，调度器接管其所有权；
+// 设备上每核一个 hw 执行器，主机上用不同延迟的模拟执行器代替
+RkRgaExecutor* rk_rga_executor_create_scheduler(RkRgaExecutor* cores[RK_RGA_CORE_COUNT]);
+// 利用率 = busy_us / elapsed_us
+RkScreenshotError rk_rga_scheduler_get_stats(RkRgaExecutor* sched,
+                                             RkRgaCoreStats stats[RK_RGA_CORE_COUNT],
+                                             uint64_t* elapsed_us);
+
+// 分块：源或输出超出核心单次尺寸上限（8K 源、RGA2 4096 输出等）时，把缩放后的图像切成网格，
+// 每块是一个完整作业（源区域裁剪 + dst 内输出区域），块边界尽量对齐缩放比例使接缝与单次处理一致
+#define RK_RGA_TILE_MAX 16
+
+// core_mask 中某个核心可单次完成时返回 1（tiles[0] = *job）；
+// 否则返回块数（所有块都可由同一类核心完成），无法切分（缩放比例/格式超限）返回 0
+int rk_rga_job_split(const RkDmaBuffer* src, const RkDmaBuffer* dst, const RkRgaJob* job,
+                     uint32_t core_mask, RkRgaJob tiles[RK_RGA_TILE_MAX]);
+
+typedef struct {
+    uint64_t jobs;              // 提交的作业
+    uint64_t tiled_jobs;        // 其中被分块的作业
+    uint64_t tiles;             // 已完成计时的块
+    uint64_t tile_us_total;     // 块耗时（提交 -> fence 触发）之和
+    uint32_t tile_us_max;
+} RkRgaTileStats;
+
+// 分块执行器：超限作业逐块提交给 inner（多核调度器会把块分到不同核心），
+// 各块 fence 合并为一个；无法合并（模拟执行器的 pipe）时同步等待，release fence 为 -1
+// core_mask 为 0 时按 RGA2 的上限切分；接管 inner
+RkRgaExecutor* rk_rga_executor_create_tiled(RkRgaExecutor* inner, uint32_t core_mask);
+RkScreenshotError rk_rga_tiled_get_stats(RkRgaExecutor* tiled, RkRgaTileStats* stats);
+
+// 长期导入（importbuffer_fd），返回 0 表示失败
+uint64_t rk_rga_import(const RkDmaBuffer* buf);
+void rk_rga_release_import(uint64_t handle);
+
+// ============================================
+// 水印叠加（编码前在输出 DMA-BUF 上混合）
+// ============================================
+
+// RGA SRC_OVER 同步混合：fg（预乘 RGBA）左上 width x height 叠到 dst 的 (x, y)
+RkScreenshotError rk_rga_blend(RkRgaProcessor* proc, RkDmaBuffer* fg, RkDmaBuffer* dst,
+                               int x, int y, int width, int height);
+
+// 引用计数，跨帧复用；rga 已初始化时水印转为预乘 RGBA DMA-BUF 并导入 RGA
+// alpha 为整体透明度，并入逐像素 alpha；x/y 为输出图像坐标（>= 0），超出输出的部分裁掉
+typedef struct RkOverlay RkOverlay;
+
+RkOverlay* rk_overlay_create(const uint8_t* rgba, int width, int height, int x, int y,
+                             uint8_t alpha, RkRgaProcessor* rga);
+RkOverlay* rk_overlay_ref(RkOverlay* ov);
+void rk_overlay_unref(RkOverlay* ov);
+// RGBA 输出优先 RGA 混合，其余格式或 RGA 失败时 CPU 混合
+RkScreenshotError rk_overlay_apply(RkOverlay* ov, RkRgaProcessor* rga, RkDmaBuffer* dst);
+// CPU 混合（NEON / SSE2）：DMA-BUF，或 rk_format_packed_size 紧凑布局的内存
+RkScreenshotError rk_overlay_blend_cpu(RkOverlay* ov, RkDmaBuffer* dst);
+RkScreenshotError rk_overlay_blend_packed(RkOverlay* ov, uint8_t* data, int format,
+                                          int width, int height);
+
 #ifdef __cplusplus
 }
 #endif
@@ -118,18 +519,305 @@ RkScreenshotError rk_rga_process(RkRgaProcessor* proc, RkDmaBuffer* src, RkDmaBu
 extern "C" {
 #endif
 
+// 编码器生效配置（MPP_ENC_SET_CFG 的 prep:* 与 jpeg:quant），相同时跳过重新配置
+typedef struct {
+    int width;
+    int height;
+    int hor_stride;             // 字节
+    int ver_stride;             // 行
+    int format;                 // MppFrameFormat
+    int quant;                  // 1-10
+} RkMppEncParams;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t reconfigs;         // 配置变化，重新 SET_CFG
+    uint64_t reuses;            // 沿用上一帧配置
+    uint64_t resets;            // 编码出错后 reset
+    uint64_t overflows;         // 输出 buffer 估小，按最大容量重编
+} RkMppEncStats;
+
+// 输出 packet 容量估计：按观测到的 JPEG 字节/像素，变大立即跟上，变小缓慢回落
+typedef struct {
+    double bytes_per_px;
+} RkMppPacketSizer;
+
+// 编码结果：data 位于 buffer 内（MPP 为 buffer group 中的 MppBuffer），用完调用 release(buffer)
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    void* buffer;
+    void (*release)(void* buffer);
+} RkMppPacket;
+
 typedef struct {
     MppCtx ctx;
     MppApi* api;
     MppEncCfg cfg;
-    MppBufferGroup buf_grp;
+    MppBufferGroup buf_grp;     // 输出 packet 池
+    pthread_mutex_t lock;       // 单编码上下文，同步截图与异步任务线程串行使用
     bool initialized;
+    bool configured;            // active 已下发给编码器
+    RkMppEncParams active;
+    RkMppEncStats stats;
+    RkMppPacketSizer sizer;
 } RkMppEncoder;
 
+// MPP 输入要求：水平/垂直步进 16 对齐
+#define RK_MPP_ALIGN 16
+
 RkScreenshotError rk_mpp_init(RkMppEncoder* enc);
+bool rk_mpp_can_import(const RkDmaBuffer* buf);   // 满足零拷贝导入条件
+// 编码 src 所需的配置；质量按 MPP 的 1-10 档量化，同档的 quality 共用配置
+RkScreenshotError rk_mpp_enc_params(const RkDmaBuffer* src, int quality, RkMppEncParams* params);
+void rk_mpp_get_stats(RkMppEncoder* enc, RkMppEncStats* stats);
+
+void rk_mpp_packet_sizer_init(RkMppPacketSizer* sizer);
+// 按估计分配的容量（64KB 对齐），不超过 rk_mpp_packet_capacity_max
+size_t rk_mpp_packet_capacity(const RkMppPacketSizer* sizer, int width, int height);
+size_t rk_mpp_packet_capacity_max(int width, int height);
+void rk_mpp_packet_sizer_update(RkMppPacketSizer* sizer, size_t bytes, int width, int height);
+// 归还 RkMppPacket.buffer；编码器 deinit 之后调用也安全
+void rk_mpp_packet_release(void* buffer);
+
+// 长期导入（mpp_buffer_import），返回 NULL 表示失败或不满足零拷贝条件
+void* rk_mpp_import(const RkDmaBuffer* buf);
+void rk_mpp_release_import(void* mpp_buf);
 void rk_mpp_deinit(RkMppEncoder* enc);
-RkScreenshotError rk_mpp_encode_jpeg(RkMppEncoder* enc, RkDmaBuffer* src, 
-                                     uint8_t** out_data, size_t* out_size, int quality);
+RkScreenshotError rk_mpp_encode_jpeg(RkMppEncoder* enc, RkDmaBuffer* src,
+                                     RkMppPacket* out, int quality);
+// 只编码 [y, y + height) 行（y 为偶数），输出该区域的独立 JPEG；条带行区间拷贝到 MPP buffer
+RkScreenshotError rk_mpp_encode_jpeg_rows(RkMppEncoder* enc, RkDmaBuffer* src, int y, int height,
+                                          RkMppPacket* out, int quality);
+
+// ============================================
+// JPEG 编码器池
+// ============================================
+// 软件基线 JPEG（4:2:0、IJG 质量、标准 Huffman 表），输入 RGBA8888 / RGBX8888 / NV12；
+// 结果 malloc 分配
+RkScreenshotError rk_jpeg_sw_encode(RkDmaBuffer* src, int quality, uint8_t** out, size_t* size);
+// 只编码 [y, y + height) 行（y 为偶数）
+RkScreenshotError rk_jpeg_sw_encode_rows(RkDmaBuffer* src, int y, int height, int quality,
+                                         uint8_t** out, size_t* size);
+
+// 单个编码上下文：MPP 硬件，或 CPU 替身（主机上测试池的并发与争用）
+typedef struct RkJpegEncoder RkJpegEncoder;
+
+struct RkJpegEncoder {
+    const char* name;
+    void* priv;
+    // 编码 [y, y + height) 行；同一上下文同时只有一个调用者（由池保证）
+    RkScreenshotError (*encode)(RkJpegEncoder* enc, RkDmaBuffer* src, int y, int height,
+                                int quality, RkMppPacket* out);
+    void (*destroy)(RkJpegEncoder* enc);
+};
+
+RkJpegEncoder* rk_jpeg_encoder_create_mpp(void);
+// 软件编码；latency_us > 0 时补足到该耗时，模拟硬件核心
+RkJpegEncoder* rk_jpeg_encoder_create_sw(int latency_us);
+void rk_jpeg_encoder_destroy(RkJpegEncoder* enc);
+
+// 多个上下文供并发线程借用：优先取上次编码同配置的空闲上下文（沿用其配置与输出 buffer），
+// 全忙时等待；RK3588 的 JPEG 编码器有多个核心，MPP 把不同上下文分到不同核心
+#define RK_JPEG_POOL_MAX 8
+
+typedef struct RkJpegPool RkJpegPool;
+
+typedef struct {
+    const char* name;
+    uint64_t frames;
+    uint64_t failures;
+    uint64_t busy_us;           // 利用率 = busy_us / elapsed_us
+    uint64_t affinity_hits;     // 借到时配置与上一帧相同
+} RkJpegEncoderStats;
+
+typedef struct {
+    uint64_t encodes;
+    uint64_t waits;             // 全部上下文都忙
+    uint64_t wait_us;
+    uint64_t elapsed_us;        // 自创建起
+} RkJpegPoolStats;
+
+// 接管 encoders（count <= RK_JPEG_POOL_MAX），失败时由调用者销毁
+RkJpegPool* rk_jpeg_pool_create(RkJpegEncoder* const* encoders, int count);
+void rk_jpeg_pool_destroy(RkJpegPool* pool);
+int rk_jpeg_pool_size(const RkJpegPool* pool);
+RkScreenshotError rk_jpeg_pool_encode(RkJpegPool* pool, RkDmaBuffer* src, int quality,
+                                      RkMppPacket* out);
+RkScreenshotError rk_jpeg_pool_encode_rows(RkJpegPool* pool, RkDmaBuffer* src, int y, int height,
+                                           int quality, RkMppPacket* out);
+// encoders 至少 rk_jpeg_pool_size 项，可为 NULL
+void rk_jpeg_pool_get_stats(RkJpegPool* pool, RkJpegEncoderStats* encoders,
+                            RkJpegPoolStats* stats);
+
+// 条带并行编码：各条带独立编码后用 restart interval 拼成一个基线 JPEG
+#define RK_JPEG_STRIPS_MAX 8
+
+// 条带高度（16 行对齐）；strips < 2 时为整帧高度
+int rk_jpeg_strip_rows(int height, int strips);
+// 实际条带数：requested 为 RkScreenshotConfig.jpeg_strips，AUTO 时大帧取 contexts；1 表示单次编码
+int rk_jpeg_strip_count(int width, int height, int requested, int contexts);
+// strips[i] 为第 i 个条带的完整 JPEG（相同的表，除最后一条外等高且为整数个 MCU 行）；
+// 结果 malloc 分配
+RkScreenshotError rk_jpeg_stitch_strips(const RkMppPacket* strips, int count, int width,
+                                        int height, uint8_t** out, size_t* size);
+// 条带分给 threads 并发从池中借上下文编码；条带数不足 2 或 threads 为 NULL 时单次编码
+// threads 不能是调用者正在执行的线程池
+RkScreenshotError rk_jpeg_pool_encode_strips(RkJpegPool* pool, RkThreadPool* threads,
+                                             RkDmaBuffer* src, int quality, int strips,
+                                             RkMppPacket* out);
+
+// ============================================
+// JPEG 目标大小：质量 -> 大小模型
+// ============================================
+// 质量按 MPP 的 10 档（10, 20 .. 100）选择；每个分辨率一条曲线：
+// 字节 = 像素 * 先验曲线[档] * 内容系数 * 档位修正，内容系数与修正由最近的编码结果 EWMA 更新
+#define RK_JPEG_RATE_LEVELS  10
+#define RK_JPEG_RATE_ENTRIES 8
+
+typedef struct {
+    int width;
+    int height;
+    uint64_t last_used;
+    uint64_t samples;
+    double scale;                           // 内容系数（实测 / 先验）
+    double level_adj[RK_JPEG_RATE_LEVELS];  // 各档相对先验曲线的修正
+} RkJpegRateEntry;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t first_hits;        // 首次编码即在预算内
+    uint64_t reencodes;
+    uint64_t misses;            // 重编码后仍超出
+    double fill_sum;            // 最终大小 / 预算 之和（平均利用率）
+} RkJpegRateStats;
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t clock;             // LRU 计数
+    RkJpegRateEntry entries[RK_JPEG_RATE_ENTRIES];
+    RkJpegRateStats stats;
+} RkJpegRateModel;
+
+void rk_jpeg_rate_init(RkJpegRateModel* model);
+void rk_jpeg_rate_deinit(RkJpegRateModel* model);
+// 预计不超过 max_bytes 的最高质量（不高于 max_quality）；都放不下时为最低档
+int rk_jpeg_rate_pick(RkJpegRateModel* model, int width, int height, size_t max_bytes,
+                      int max_quality);
+void rk_jpeg_rate_update(RkJpegRateModel* model, int width, int height, int quality,
+                         size_t bytes);
+// 按质量编码一次，结果由调用者释放
+typedef RkScreenshotError (*RkJpegEncodeFn)(void* user, int quality, RkMppPacket* out);
+// 选质量编码；超出预算时更新模型后降档重编码一次。仍超出时返回较小的结果（size > max_bytes）
+RkScreenshotError rk_jpeg_encode_target(RkJpegRateModel* model, int width, int height,
+                                        size_t max_bytes, int max_quality, RkJpegEncodeFn encode,
+                                        void* user, RkMppPacket* out, int* quality);
+void rk_jpeg_rate_get_stats(RkJpegRateModel* model, RkJpegRateStats* stats);
+
+// ============================================
+// 视频录制：捕获 -> RGA (NV12) -> MPP AVC/HEVC -> Annex-B / MP4
+// ============================================
+typedef struct {
+    int codec;                  // RK_FORMAT_H264 / RK_FORMAT_H265
+    int width;                  // 偶数
+    int height;
+    int fps;
+    int gop;                    // 关键帧间隔（帧）
+    int bitrate;                // bps
+} RkVideoEncParams;
+
+// 单个视频编码上下文：MPP 硬件，或 CPU 替身（输出结构合法、内容不可解码的码流，主机上测管线与封装）
+typedef struct RkVideoEncoder RkVideoEncoder;
+
+struct RkVideoEncoder {
+    const char* name;
+    void* priv;
+    // 编码一帧 NV12（16 对齐），out 为一个 Annex-B 访问单元，IDR 之前带参数集
+    RkScreenshotError (*encode)(RkVideoEncoder* enc, RkDmaBuffer* src, bool force_idr,
+                                RkMppPacket* out);
+    void (*destroy)(RkVideoEncoder* enc);
+};
+
+RkVideoEncoder* rk_video_encoder_create_mpp(const RkVideoEncParams* params);
+// latency_us > 0 时补足到该耗时；每帧大小按码率分配，IDR 为 P 帧的 4 倍
+RkVideoEncoder* rk_video_encoder_create_stub(const RkVideoEncParams* params, int latency_us);
+void rk_video_encoder_destroy(RkVideoEncoder* enc);
+// 未指定码率时按分辨率估算
+int rk_video_default_bitrate(int codec, int width, int height, int fps);
+
+// 封装：.mp4 写 MP4（mdat 在前，moov 在关闭时写入），其余写 Annex-B 裸流
+typedef struct RkVideoMuxer RkVideoMuxer;
+
+RkVideoMuxer* rk_video_muxer_open(const char* path, int codec, int width, int height);
+// au 为一个 Annex-B 访问单元，pts_us 递增
+RkScreenshotError rk_video_muxer_write(RkVideoMuxer* mux, const uint8_t* au, size_t size,
+                                       int64_t pts_us);
+// end_us 为最后一帧的结束时刻；写入索引并释放 mux
+RkScreenshotError rk_video_muxer_close(RkVideoMuxer* mux, int64_t end_us);
+// Annex-B 访问单元是否为关键帧（H.264 IDR / HEVC IRAP）
+bool rk_video_au_is_keyframe(int codec, const uint8_t* au, size_t size);
+
+// 录制线程：按帧率节拍取帧 -> 画面未变则跳过 -> 编码 -> 封装
+typedef struct {
+    void* user;
+    // 取一帧编码器输入（NV12，尺寸同编码参数，16 对齐），调用者 rk_dmabuf_free
+    RkScreenshotError (*acquire)(void* user, RkDmaBuffer** out);
+} RkRecorderSource;
+
+typedef struct {
+    uint64_t ticks;             // 经过的帧节拍
+    uint64_t frames;            // 编码并写入的帧
+    uint64_t keyframes;
+    uint64_t static_skips;      // 画面未变，未编码
+    uint64_t late_ticks;        // 上一帧处理超时错过的节拍
+    uint64_t failures;          // 取帧/编码/写入失败
+    uint64_t bytes;
+    uint64_t encode_us;
+    uint64_t elapsed_us;
+} RkRecorderStats;
+
+typedef struct RkRecorder RkRecorder;
+
+// 接管 enc 与 mux；启动失败时一并释放
+RkRecorder* rk_recorder_start(const RkVideoEncParams* params, const RkRecorderSource* source,
+                              RkVideoEncoder* enc, RkVideoMuxer* mux);
+void rk_recorder_get_stats(RkRecorder* rec, RkRecorderStats* stats);
+// 停止线程并完成文件；返回封装关闭结果
+RkScreenshotError rk_recorder_stop(RkRecorder* rec, RkRecorderStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+// ============================================
+// 缩放成本模型（SurfaceFlinger vs RGA）
+// ============================================
+// t = setup + per_mpx * 百万像素，per_mpx 由实测耗时 EWMA 更新
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    pthread_mutex_t lock;
+    double sf_setup_us;         // SF 捕获固定开销
+    double sf_per_mpx_us;       // SF 原尺寸合成，每百万输出像素
+    double sf_scaled_per_mpx_us; // SF 缩放/裁剪合成（带滤波），每百万输出像素
+    double rga_setup_us;        // RGA 单次作业固定开销
+    double rga_per_mpx_us;      // RGA 每百万像素（源 + 目标）
+    uint64_t sf_samples;
+    uint64_t rga_samples;
+} RkScalerModel;
+
+void rk_scaler_model_init(RkScalerModel* model);
+void rk_scaler_model_deinit(RkScalerModel* model);
+// 估算两条路径总耗时并选择；post_rga 为 SF 路径仍需 RGA 后处理（如重新对齐）
+RkScaler rk_scaler_model_choose(RkScalerModel* model,
+                                int src_width, int src_height,
+                                int out_width, int out_height, bool post_rga);
+void rk_scaler_model_update_sf(RkScalerModel* model, int out_width, int out_height,
+                               bool scaled, uint64_t us);
+void rk_scaler_model_update_rga(RkScalerModel* model, int src_width, int src_height,
+                                int dst_width, int dst_height, uint64_t us);
 
 #ifdef __cplusplus
 }
@@ -144,9 +832,14 @@ extern "C" {
 
 typedef struct {
     bool initialized;
-    struct RkSurfaceFlingerContext* sf_ctx;
+    RkFrameSource* source;    // 帧来源（默认 SurfaceFlinger）
     RkRgaProcessor rga;
-    RkMppEncoder mpp;
+    RkRgaExecutor* rga_exec;  // 作业提交（RGA 异步 + fence / CPU / 混合，见 RK_SCREENSHOT_PROCESSOR）
+    RkJpegPool* jpeg;         // MPP 编码上下文池
+    RkThreadPool* encode_threads; // 批量输出 / JPEG 条带并行编码，线程数同编码上下文数
+    RkDmaBufPool* pool;       // RGA 输出 buffer 复用
+    RkScalerModel scaler_model;
+    RkJpegRateModel jpeg_rate;  // 目标大小模式的质量 -> 大小模型
 } RkScreenshotContext;
 
 #ifdef __cplusplus
@@ -53,6 +53,7 @@ typedef enum {
     RKSS_ERROR_UNSUPPORTED = -12,
     RKSS_ERROR_TIMEOUT = -13,
     RKSS_ERROR_DEVICE_BUSY = -14,
+    RKSS_ERROR_CANCELLED = -15,
 } RkScreenshotError;
 
 // ============================================
@@ -77,6 +78,15 @@ typedef enum {
     RK_FORMAT_VP9 = 24,
 } RkImageFormat;
 
+// ============================================
+// 缩放/裁剪执行单元
+// ============================================
+typedef enum {
+    RK_SCALER_AUTO = 0,             // 配置：成本模型选择；结果：未缩放/裁剪
+    RK_SCALER_RGA = 1,              // 全分辨率捕获 + RGA 缩放
+    RK_SCALER_SURFACEFLINGER = 2,   // SurfaceFlinger 合成时直接输出目标尺寸
+} RkScaler;
+
 // ============================================
 // 截图配置
 // ============================================
@@ -85,7 +95,8 @@ typedef struct {
     int32_t width;
     int32_t height;
     
-    // 输出格式
+    // 输出格式：JPEG 或 Raw (RGBA8888/RGBX8888/RGB888/BGR888/YUV420SP/YUV420P)
+    // Raw YUV/RGB 由 RGA 颜色转换产出（YUV 为全范围 BT.601），结果紧凑排列
     RkImageFormat format;
     
     // 质量参数 (0-100, 仅用于压缩格式)
@@ -116,15 +127,66 @@ typedef struct {
     // 超时时间 (毫秒)
     int32_t timeout_ms;
     
-    // 保留字段
-    uint32_t reserved[8];
+    // 缩放/裁剪执行单元 (RK_SCALER_AUTO 由成本模型选择)
+    RkScaler scaler;
+    
+    // JPEG 编码器输入格式：RK_FORMAT_RGBA8888 (默认) 或 RK_FORMAT_YUV420SP
+    // NV12 由 RGA 在缩放时顺带转换，编码器读带宽约为 RGBA 的 3/8
+    RkImageFormat encode_input;
+    
+    // 目标显示器 (rk_screenshot_get_displays 返回的 ID，0 表示主屏)，拆成两个 32 位存放：
+    // uint64_t 会把结构体对齐从 4 提高到 8。用 rk_screenshot_config_set_display() 读写
+    uint32_t display_id_lo;
+    uint32_t display_id_hi;
+    
+    // JPEG 条带并行编码：0/1 单次编码（默认），N 切成 N 个水平条带在多个编码上下文上并发编码，
+    // 以 restart marker 拼成一个基线 JPEG（体积略增，大帧延迟显著降低）；
+    // RK_JPEG_STRIPS_AUTO 在 1440p 及以上按编码上下文数切分
+    int32_t jpeg_strips;
+    
+    // JPEG 目标大小（字节，0 表示按 quality 编码）：由质量 -> 大小模型选择不超过 quality 的最高档，
+    // 超出时降档重编码一次；仍超出时返回较小的一次，调用者按 result->size 判断
+    uint32_t jpeg_max_bytes;
+    
+    // 保留字段（录制等专用参数放独立结构体，见 RkRecordingParams）
+    uint32_t reserved[2];
 } RkScreenshotConfig;
 
+// 新字段只能占用 reserved，结构体大小与对齐是 ABI 的一部分（64 位）
+static_assert(sizeof(RkScreenshotConfig) == 88, "RkScreenshotConfig ABI size changed");
+static_assert(alignof(RkScreenshotConfig) == 4, "RkScreenshotConfig ABI alignment changed");
+
+static inline uint64_t rk_screenshot_config_display(const RkScreenshotConfig* cfg) {
+    return (uint64_t)cfg->display_id_hi << 32 | cfg->display_id_lo;
+}
+
+static inline void rk_screenshot_config_set_display(RkScreenshotConfig* cfg, uint64_t display_id) {
+    cfg->display_id_lo = (uint32_t)display_id;
+    cfg->display_id_hi = (uint32_t)(display_id >> 32);
+}
+
+#define RK_JPEG_STRIPS_AUTO (-1)
+
+// ============================================
+// 录制参数（rk_screenshot_start_recording_ex）
+// ============================================
+typedef struct {
+    // 0 表示默认：30 fps、2 秒 GOP、按分辨率估算码率
+    uint16_t fps;
+    uint16_t gop;               // 关键帧间隔（帧）
+    uint32_t bitrate;           // bps
+    
+    // 保留字段
+    uint32_t reserved[6];
+} RkRecordingParams;
+
+static_assert(sizeof(RkRecordingParams) == 32, "RkRecordingParams ABI size changed");
+
 // ============================================
 // 截图结果
 // ============================================
 typedef struct {
-    // 图像数据
+    // 图像数据（JPEG 时直接指向编码器输出 buffer，只能经 rk_screenshot_free_result 释放）
     uint8_t* data;
     size_t size;
     
@@ -150,10 +212,81 @@ typedef struct {
     // 总耗时（微秒）
     int64_t total_time_us;      
     
+    // 实际使用的缩放/裁剪执行单元
+    RkScaler scaler;
+    
+    // 实际使用的 JPEG 质量（目标大小模式下由模型选择）
+    int32_t quality;
+    
+    // 来源显示器（data 指针已使结构体 8 字节对齐，uint64_t 不改变对齐）
+    uint64_t display_id;
+    
     // 保留字段
-    uint32_t reserved[8];
+    uint32_t reserved[4];
 } RkScreenshotResult;
 
+static_assert(sizeof(RkScreenshotResult) == 104, "RkScreenshotResult ABI size changed");
+static_assert(alignof(RkScreenshotResult) == 8, "RkScreenshotResult ABI alignment changed");
+
+// ============================================
+// DMA-BUF 截图结果（零拷贝，仅 Raw 格式）
+// ============================================
+typedef struct {
+    // DMA-BUF fd（库持有，release 后失效；需长期持有请 dup）
+    int fd;
+    size_t size;
+    
+    // 实际尺寸与行步进（像素）
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    
+    // 格式
+    RkImageFormat format;
+    
+    // 垂直步进（行）；YUV 色度平面从 stride * height_stride 字节处开始
+    int32_t height_stride;
+    
+    // CPU 映射 (仅 RK_CAPTURE_FLAG_MAP 时有效，否则为 NULL)
+    void* data;
+    
+    // 时间戳 / 耗时 (微秒)
+    int64_t timestamp_us;
+    int64_t capture_time_us;
+    int64_t process_time_us;
+    int64_t total_time_us;
+    
+    // 实际使用的缩放/裁剪执行单元
+    RkScaler scaler;
+    
+    // 保留字段
+    uint32_t reserved[6];
+} RkScreenshotDmaBuf;
+
+// rk_screenshot_capture_dmabuf 标志
+#define RK_CAPTURE_FLAG_MAP  (1u << 0)   // 同时提供 CPU 只读映射
+
+// ============================================
+// 显示器信息
+// ============================================
+typedef struct {
+    uint64_t id;                // 物理显示器 ID，用于 RkScreenshotConfig.display_id
+    int32_t width;              // 逻辑尺寸（截图默认输出尺寸）
+    int32_t height;
+    int32_t rotation;           // 0, 90, 180, 270
+    float refresh_rate;
+    bool internal;              // 主屏（display_id = 0 时使用）
+    
+    // 保留字段
+    uint32_t reserved[4];
+} RkDisplayInfo;
+
+// 同时捕获的最大显示器数量
+#define RK_MAX_DISPLAYS 4
+
+// 单次捕获扇出的最大输出数量
+#define RK_MAX_BATCH_OUTPUTS 8
+
 // ============================================
 // 硬件能力信息
 // ============================================
@@ -236,6 +369,15 @@ RK_API RkScreenshotError rk_screenshot_init();
  */
 RK_API RkScreenshotError rk_screenshot_init_ex(const RkScreenshotConfig* config);
 
+/**
+ * 选择帧来源（须在 rk_screenshot_init 之前调用）
+ * @param spec "sf"（默认，SurfaceFlinger）
+ *             "synthetic[:WxH[:N]]" 合成图案，每 N 帧变化一次（0 为静止画面）
+ *             "replay:FILE:WxH" 循环回放紧凑排列的 RGBA8888 原始帧
+ *             NULL 时使用环境变量 RK_SCREENSHOT_SOURCE
+ */
+RK_API RkScreenshotError rk_screenshot_set_frame_source(const char* spec);
+
 /**
  * 反初始化截图引擎
  */
@@ -262,12 +404,43 @@ RK_API RkScreenshotError rk_screenshot_capture(
     RkScreenshotResult** result
 );
 
+/**
+ * 枚举已连接的显示器
+ * @param displays 输出数组
+ * @param max_count 数组容量
+ * @param count 实际显示器数量（可能大于 max_count）
+ */
+RK_API RkScreenshotError rk_screenshot_get_displays(
+    RkDisplayInfo* displays,
+    int max_count,
+    int* count
+);
+
+/**
+ * 多屏截图：同时向所有显示器发起捕获，结果共用同一时间戳
+ * 各显示器沿用 config 的其余参数，config 中的显示器 ID 被忽略
+ * @param config 截图配置
+ * @param display_ids 显示器 ID 列表（最多 RK_MAX_DISPLAYS 个）
+ * @param count 显示器数量
+ * @param results 输出数组（count 项），逐个调用 rk_screenshot_free_result 释放
+ * @return RKSS_SUCCESS 成功；任一显示器失败时返回其错误码且不输出结果
+ */
+RK_API RkScreenshotError rk_screenshot_capture_multi(
+    const RkScreenshotConfig* config,
+    const uint64_t* display_ids,
+    int count,
+    RkScreenshotResult** results
+);
+
 /**
  * 截图 (异步模式)
+ * 当前线程完成屏幕捕获并提交 RGA 作业后即返回，RGA 完成后由任务线程编码并回调；
+ * 调用者可立即发起下一次捕获，与上一帧的 RGA/编码重叠
  * @param config 截图配置
- * @param callback 完成回调
+ * @param callback 完成回调（任务线程，按提交顺序）；result 归回调所有，需 rk_screenshot_free_result，
+ *                 失败时为 NULL，错误码由 rk_screenshot_wait 返回
  * @param user_data 用户数据
- * @return 任务 ID (>= 0) 或错误码 (< 0)
+ * @return 任务 ID (> 0) 或错误码 (< 0)；进行中任务已满时返回 RKSS_ERROR_DEVICE_BUSY
  */
 RK_API int rk_screenshot_capture_async(
     const RkScreenshotConfig* config,
@@ -276,20 +449,41 @@ RK_API int rk_screenshot_capture_async(
 );
 
 /**
- * 取消异步任务
+ * 取消异步任务（仅限尚未开始编码的任务，不再回调）
+ * @return 已开始编码时返回 RKSS_ERROR_DEVICE_BUSY
  */
 RK_API RkScreenshotError rk_screenshot_cancel(int task_id);
 
 /**
- * 等待异步任务完成
+ * 等待异步任务完成（含回调返回），timeout_ms < 0 无限等待
+ * @return 任务结果；已取消为 RKSS_ERROR_CANCELLED，任务 ID 过期为 RKSS_ERROR_INVALID_PARAM
  */
 RK_API RkScreenshotError rk_screenshot_wait(int task_id, int timeout_ms);
 
 /**
- * 释放截图结果
+ * 释放截图结果（含 data；JPEG 数据归还编码器 buffer 池，不能单独 free）
  */
 RK_API void rk_screenshot_free_result(RkScreenshotResult* result);
 
+/**
+ * 截图 (零拷贝 DMA-BUF 模式，仅 Raw 格式；YUV 平面布局见 stride/height_stride)
+ * 结果直接引用库内 DMA-BUF，可导入 GPU/编码器，无 CPU 拷贝
+ * @param config 截图配置
+ * @param flags RK_CAPTURE_FLAG_*
+ * @param result 输出结果，调用者需要调用 rk_screenshot_release_dmabuf 归还
+ * @return RKSS_SUCCESS 成功，其他为错误码
+ */
+RK_API RkScreenshotError rk_screenshot_capture_dmabuf(
+    const RkScreenshotConfig* config,
+    uint32_t flags,
+    RkScreenshotDmaBuf** result
+);
+
+/**
+ * 归还 DMA-BUF 截图结果
+ */
+RK_API void rk_screenshot_release_dmabuf(RkScreenshotDmaBuf* result);
+
 /**
  * 保存截图到文件
  * @param result 截图结果
@@ -324,15 +518,18 @@ RK_API const char* rk_screenshot_error_string(RkScreenshotError error);
 // ============================================
 
 /**
- * 添加水印
+ * 添加水印（事后叠加到已取回的原始数据，CPU SIMD 混合）
+ * @deprecated 改用 rk_screenshot_set_watermark：在编码前叠加（RGBA 输出由 RGA 混合），JPEG 也适用。
+ * 本函数只支持 Raw 结果（RGBA/RGBX/RGB888/BGR888/NV12/I420），JPEG 结果返回 RKSS_ERROR_UNSUPPORTED
  * @param result 原图
- * @param watermark_data 水印图像数据 (RGBA)
+ * @param watermark_data 水印图像数据 (RGBA，非预乘，wm_width * wm_height * 4 字节)
  * @param wm_width 水印宽度
  * @param wm_height 水印高度
- * @param x 水印 x 坐标
- * @param y 水印 y 坐标
- * @param alpha 透明度 (0-255)
+ * @param x 水印 x 坐标（>= 0，超出图像部分裁掉）
+ * @param y 水印 y 坐标（>= 0）
+ * @param alpha 透明度 (0-255)，与水印逐像素 alpha 相乘
  */
+[[deprecated("use rk_screenshot_set_watermark")]]
 RK_API RkScreenshotError rk_screenshot_add_watermark(
     RkScreenshotResult* result,
     const uint8_t* watermark_data,
@@ -344,11 +541,30 @@ RK_API RkScreenshotError rk_screenshot_add_watermark(
 );
 
 /**
- * 批量截图
- * @param configs 配置数组
- * @param count 数量
- * @param results 输出结果数组
- * @return RKSS_SUCCESS 成功，其他为错误码
+ * 设置常驻水印：之后所有截图（同步/异步/批量/DMA-BUF）在编码前叠加到输出 DMA-BUF
+ * 水印数据拷贝后转为预乘 RGBA DMA-BUF 并导入 RGA，跨帧复用；
+ * RGBA 输出由 RGA alpha 混合，其余格式由 CPU SIMD 混合
+ * 坐标与参数含义同 rk_screenshot_add_watermark，按最终输出图像（缩放/旋转后）定位
+ * @param watermark_data 为 NULL 时清除水印
+ * @return RKSS_SUCCESS 成功；未初始化返回 RKSS_ERROR_NOT_INITIALIZED（deinit 时清除）
+ */
+RK_API RkScreenshotError rk_screenshot_set_watermark(
+    const uint8_t* watermark_data,
+    int32_t wm_width,
+    int32_t wm_height,
+    int32_t x,
+    int32_t y,
+    uint8_t alpha
+);
+
+/**
+ * 批量截图：一次全分辨率捕获扇出多个输出（如原图 JPEG + 720p 预览 + 缩略图）
+ * 所有裁剪/缩放合并为一次 RGA 批量作业，随后依次编码；结果共用同一时间戳与捕获耗时
+ * @param configs 每个输出的配置（尺寸、裁剪、格式、质量等），显示器 ID 必须相同；
+ *                scaler 被忽略（总是 RGA）
+ * @param count 输出数量（1 ~ RK_MAX_BATCH_OUTPUTS）
+ * @param results 输出 count 项结果数组，调用 rk_screenshot_free_batch 释放
+ * @return RKSS_SUCCESS 成功；任一输出失败时返回其错误码且不输出结果
  */
 RK_API RkScreenshotError rk_screenshot_capture_batch(
     const RkScreenshotConfig* configs,
@@ -357,9 +573,14 @@ RK_API RkScreenshotError rk_screenshot_capture_batch(
 );
 
 /**
- * 开始视频流录制
- * @param config 配置
- * @param filepath 输出文件路径
+ * 释放批量截图结果（含数组本身）
+ */
+RK_API void rk_screenshot_free_batch(RkScreenshotResult** results, int count);
+
+/**
+ * 开始视频流录制（默认录制参数），等同 rk_screenshot_start_recording_ex(config, NULL, filepath)
+ * @param config 配置（format 选择 H.264 / H.265，裁剪/旋转/缩放同截图）
+ * @param filepath 输出文件路径：.mp4 写 MP4，其余写 Annex-B 裸流
  * @return 录制 ID (>= 0) 或错误码 (< 0)
  */
 RK_API int rk_screenshot_start_recording(
@@ -368,7 +589,18 @@ RK_API int rk_screenshot_start_recording(
 );
 
 /**
- * 停止视频流录制
+ * 开始视频流录制：专用线程按 params->fps 捕获 -> RGA 转 NV12 -> MPP AVC/HEVC 编码
+ * 画面静止时不编码（每个 GOP 仍至少一个关键帧）
+ * @param params 录制参数，NULL 或字段为 0 时取默认
+ */
+RK_API int rk_screenshot_start_recording_ex(
+    const RkScreenshotConfig* config,
+    const RkRecordingParams* params,
+    const char* filepath
+);
+
+/**
+ * 停止视频流录制并完成文件（MP4 写入索引）
  */
 RK_API RkScreenshotError rk_screenshot_stop_recording(int recording_id);
 
@@ -471,7 +703,9 @@ public:
     
     /**
      * 添加水印
+     * @deprecated 见 rk_screenshot_add_watermark
      */
+    [[deprecated("use rk_screenshot_set_watermark")]]
     RkScreenshotError addWatermark(
         RkScreenshotResult* result,
         const std::vector<uint8_t>& watermark,
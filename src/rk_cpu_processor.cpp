@@ -0,0 +1,768 @@
+/**
+ * RK3588 CPU Processor - RGA 作业的 CPU 实现
+ *
+ * 与 rk_rga_process_job 几何语义一致：裁剪 -> 缩放 -> 顺时针旋转 -> 输出镜像
+ * 输出 RGBA / RGB888 / BGR888 / NV12 / I420；YUV 按 JFIF 全范围 BT.601 转换，色度取 2x2 平均
+ *
+ * rk_cpu_process_job：最近邻参考实现（单线程），主机校验用
+ * rk_cpu_process_job_ex：先按双线性/盒式缩放到旋转前尺寸，再 1:1 旋转/镜像/转换，
+ *                        两趟均按行条带分给线程池；核心循环有 NEON（arm64）与 SSE2（x86）实现
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#undef LOG_TAG
+#define LOG_TAG "RK_CPU"
+
+static bool is_rgba(int format) {
+    return format == RK_FORMAT_RGBA8888 || format == RK_FORMAT_RGBX8888;
+}
+
+bool rk_rga_output_format_supported(int format) {
+    switch (format) {
+        case RK_FORMAT_RGBA8888:
+        case RK_FORMAT_RGBX8888:
+        case RK_FORMAT_RGB888:
+        case RK_FORMAT_BGR888:
+        case RK_FORMAT_YUV420SP:
+        case RK_FORMAT_YUV420P:
+            return true;
+        default:
+            return false;
+    }
+}
+
+RkScreenshotError rk_rga_job_check(const RkDmaBuffer* src, const RkDmaBuffer* dst,
+                                   const RkRgaJob* job) {
+    if (!src || !dst || !job) return RKSS_ERROR_INVALID_PARAM;
+    if (!is_rgba(src->format)) return RKSS_ERROR_UNSUPPORTED;
+    if (!rk_rga_output_format_supported(dst->format)) return RKSS_ERROR_UNSUPPORTED;
+
+    if (job->rotation != 0 && job->rotation != 90 &&
+        job->rotation != 180 && job->rotation != 270) {
+        ALOGE("❌ Invalid rotation %d", job->rotation);
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+    if (job->crop_width < 0 || job->crop_height < 0) return RKSS_ERROR_INVALID_PARAM;
+    if (job->crop_width > 0 && job->crop_height > 0 &&
+        (job->crop_x < 0 || job->crop_y < 0 ||
+         job->crop_x + job->crop_width > src->width ||
+         job->crop_y + job->crop_height > src->height)) {
+        ALOGE("❌ Crop %d,%d %dx%d outside %dx%d source", job->crop_x, job->crop_y,
+              job->crop_width, job->crop_height, src->width, src->height);
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+    if (job->dst_width < 0 || job->dst_height < 0) return RKSS_ERROR_INVALID_PARAM;
+    if (job->dst_width > 0 && job->dst_height > 0) {
+        bool yuv = (dst->format == RK_FORMAT_YUV420SP || dst->format == RK_FORMAT_YUV420P);
+        if (job->dst_x < 0 || job->dst_y < 0 ||
+            job->dst_x + job->dst_width > dst->width ||
+            job->dst_y + job->dst_height > dst->height ||
+            (yuv && ((job->dst_x | job->dst_y) & 1))) {
+            ALOGE("❌ Output rect %d,%d %dx%d outside %dx%d %s", job->dst_x, job->dst_y,
+                  job->dst_width, job->dst_height, dst->width, dst->height,
+                  rk_format_name(dst->format));
+            return RKSS_ERROR_INVALID_PARAM;
+        }
+    }
+    return RKSS_SUCCESS;
+}
+
+// 源区域 (cx, cy, cw, ch) -> W x H 输出的坐标映射表
+// 0/180 度：列表给出源 x，行表给出源 y；90/270 度互换（列表给出源 y，行表给出源 x）
+// 源区域与旋转前尺寸相同时映射为 1:1（只有旋转/镜像）
+static void build_maps(int cx, int cy, int cw, int ch, int W, int H, const RkRgaJob* job,
+                       std::vector<int>* col_map, std::vector<int>* row_map) {
+    bool transpose = (job->rotation == 90 || job->rotation == 270);
+    // 缩放后、旋转前的尺寸
+    int sw = transpose ? H : W;
+    int sh = transpose ? W : H;
+
+    col_map->resize(W);
+    row_map->resize(H);
+
+    for (int x = 0; x < W; x++) {
+        int xo = job->flip_horizontal ? W - 1 - x : x;
+        int sx = 0, sy = 0;
+        switch (job->rotation) {
+            case 0:   sx = xo; break;
+            case 180: sx = W - 1 - xo; break;
+            case 90:  sy = sh - 1 - xo; break;
+            case 270: sy = xo; break;
+        }
+        (*col_map)[x] = transpose ? cy + (int)(((int64_t)sy * 2 + 1) * ch / (2 * sh))
+                                  : cx + (int)(((int64_t)sx * 2 + 1) * cw / (2 * sw));
+    }
+    for (int y = 0; y < H; y++) {
+        int yo = job->flip_vertical ? H - 1 - y : y;
+        int sx = 0, sy = 0;
+        switch (job->rotation) {
+            case 0:   sy = yo; break;
+            case 180: sy = H - 1 - yo; break;
+            case 90:  sx = yo; break;
+            case 270: sx = sw - 1 - yo; break;
+        }
+        (*row_map)[y] = transpose ? cx + (int)(((int64_t)sx * 2 + 1) * cw / (2 * sw))
+                                  : cy + (int)(((int64_t)sy * 2 + 1) * ch / (2 * sh));
+    }
+}
+
+// 按映射表采样输出第 y 行 RGBA
+static void sample_row(const uint32_t* in, int src_stride, bool transpose,
+                       const std::vector<int>& col_map, int src_line, int width, uint32_t* row) {
+    if (transpose) {
+        // 输出行对应源图的一列
+        const uint32_t* col = in + src_line;
+        for (int x = 0; x < width; x++) {
+            row[x] = col[(size_t)col_map[x] * src_stride];
+        }
+    } else {
+        const uint32_t* src_row = in + (size_t)src_line * src_stride;
+        for (int x = 0; x < width; x++) {
+            row[x] = src_row[col_map[x]];
+        }
+    }
+}
+
+// RGBA 字节序 R, G, B, A（小端 uint32 低字节为 R）
+static inline int px_r(uint32_t p) { return p & 0xff; }
+static inline int px_g(uint32_t p) { return (p >> 8) & 0xff; }
+static inline int px_b(uint32_t p) { return (p >> 16) & 0xff; }
+
+static inline uint8_t clamp_u8(int v) {
+    return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+// 一行 RGBA -> Y（JFIF：Y = 0.299R + 0.587G + 0.114B）
+static void rgba_to_luma(const uint32_t* row, int width, uint8_t* y) {
+    int x = 0;
+#if defined(__ARM_NEON)
+    for (; x + 8 <= width; x += 8) {
+        uint8x8x4_t px = vld4_u8((const uint8_t*)(row + x));
+        uint16x8_t acc = vmull_u8(px.val[0], vdup_n_u8(77));
+        acc = vmlal_u8(acc, px.val[1], vdup_n_u8(150));
+        acc = vmlal_u8(acc, px.val[2], vdup_n_u8(29));
+        vst1_u8(y + x, vrshrn_n_u16(acc, 8));
+    }
+#endif
+    for (; x < width; x++) {
+        uint32_t p = row[x];
+        y[x] = (uint8_t)((77 * px_r(p) + 150 * px_g(p) + 29 * px_b(p) + 128) >> 8);
+    }
+}
+
+// 两行 RGBA -> 两行 Y 与一行色度（2x2 平均）
+// NV12：u/v 指向同一行交错 UV，step = 2；I420：u/v 为独立平面，step = 1
+static void rgba_to_yuv420(const uint32_t* row0, const uint32_t* row1, int width,
+                           uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v, int step) {
+    rgba_to_luma(row0, width, y0);
+    if (y1) rgba_to_luma(row1, width, y1);
+    for (int x = 0; x < width; x += 2) {
+        int x1 = x + 1 < width ? x + 1 : x;
+        uint32_t p[4] = {row0[x], row0[x1], row1[x], row1[x1]};
+        int r = 0, g = 0, b = 0;
+        for (int i = 0; i < 4; i++) {
+            r += px_r(p[i]);
+            g += px_g(p[i]);
+            b += px_b(p[i]);
+        }
+        // 4 像素求和，系数 / 256 后再 / 4
+        int c = x / 2 * step;
+        u[c] = clamp_u8(((-43 * r - 85 * g + 128 * b + 512) >> 10) + 128);
+        v[c] = clamp_u8(((128 * r - 107 * g - 21 * b + 512) >> 10) + 128);
+    }
+}
+
+// 一行 RGBA -> 24 位 RGB/BGR（丢弃 alpha）
+static void rgba_to_rgb24(const uint32_t* row, int width, uint8_t* out, bool bgr) {
+    int x = 0;
+#if defined(__ARM_NEON)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t px = vld4q_u8((const uint8_t*)(row + x));
+        uint8x16x3_t rgb;
+        rgb.val[0] = bgr ? px.val[2] : px.val[0];
+        rgb.val[1] = px.val[1];
+        rgb.val[2] = bgr ? px.val[0] : px.val[2];
+        vst3q_u8(out + x * 3, rgb);
+    }
+#endif
+    for (; x < width; x++) {
+        uint32_t p = row[x];
+        out[x * 3 + 0] = (uint8_t)(bgr ? px_b(p) : px_r(p));
+        out[x * 3 + 1] = (uint8_t)px_g(p);
+        out[x * 3 + 2] = (uint8_t)(bgr ? px_r(p) : px_b(p));
+    }
+}
+
+// ============================================
+// 第二趟：按映射表采样并输出 [y0, y1) 行
+// ============================================
+
+typedef struct {
+    const uint32_t* in;         // 采样源：原图，或第一趟的缩放中间图
+    int in_stride;              // 像素
+    bool transpose;
+    const int* col_map;
+    const int* row_map;
+    bool identity;              // 1:1 映射（只旋转/镜像），RGBA 输出可整行/分块搬运
+    int width;                  // 输出区域
+    int height;
+    int format;
+    int stride;                 // dst->stride（像素）
+    uint8_t* out;               // 输出区域首行（YUV 为 Y 平面）
+    uint8_t* u_plane;           // YUV：输出区域首行色度，NV12 时 v_plane = u_plane + 1
+    uint8_t* v_plane;
+    int c_stride;
+} EmitCtx;
+
+// 4 个像素倒序
+static void reverse_copy(uint32_t* out, const uint32_t* in, int width) {
+    int x = 0;
+#if defined(__ARM_NEON)
+    for (; x + 4 <= width; x += 4) {
+        uint32x4_t v = vrev64q_u32(vld1q_u32(in + width - 4 - x));
+        vst1q_u32(out + x, vcombine_u32(vget_high_u32(v), vget_low_u32(v)));
+    }
+#elif defined(__SSE2__)
+    for (; x + 4 <= width; x += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + width - 4 - x));
+        _mm_storeu_si128((__m128i*)(out + x), _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+#endif
+    for (; x < width; x++) {
+        out[x] = in[width - 1 - x];
+    }
+}
+
+// 90/270 度：输出 4x4 块 = 源中 4 行 x 4 列转置
+// 源行由列表给出（随 x 单调），源列由行表给出（随 y 单调 +-1）
+static void transpose_block(const EmitCtx* c, int x0, int y0) {
+    const int* rows = c->col_map + x0;
+    const int* cols = c->row_map + y0;
+    int cmin = cols[0] < cols[3] ? cols[0] : cols[3];
+    uint32_t* out = (uint32_t*)c->out;
+    int out_stride = c->stride;
+
+#if defined(__ARM_NEON) || defined(__SSE2__)
+    const uint32_t* src[4];
+    for (int i = 0; i < 4; i++) src[i] = c->in + (size_t)rows[i] * c->in_stride + cmin;
+#if defined(__ARM_NEON)
+    uint32x4x2_t t01 = vtrnq_u32(vld1q_u32(src[0]), vld1q_u32(src[1]));
+    uint32x4x2_t t23 = vtrnq_u32(vld1q_u32(src[2]), vld1q_u32(src[3]));
+    uint32x4_t t[4] = {
+        vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])),
+        vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])),
+        vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])),
+        vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])),
+    };
+    for (int k = 0; k < 4; k++) {
+        vst1q_u32(out + (size_t)(y0 + k) * out_stride + x0, t[cols[k] - cmin]);
+    }
+#else
+    __m128i l0 = _mm_loadu_si128((const __m128i*)src[0]);
+    __m128i l1 = _mm_loadu_si128((const __m128i*)src[1]);
+    __m128i l2 = _mm_loadu_si128((const __m128i*)src[2]);
+    __m128i l3 = _mm_loadu_si128((const __m128i*)src[3]);
+    __m128i a = _mm_unpacklo_epi32(l0, l1);
+    __m128i b = _mm_unpacklo_epi32(l2, l3);
+    __m128i d = _mm_unpackhi_epi32(l0, l1);
+    __m128i e = _mm_unpackhi_epi32(l2, l3);
+    __m128i t[4] = {
+        _mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b),
+        _mm_unpacklo_epi64(d, e), _mm_unpackhi_epi64(d, e),
+    };
+    for (int k = 0; k < 4; k++) {
+        _mm_storeu_si128((__m128i*)(out + (size_t)(y0 + k) * out_stride + x0), t[cols[k] - cmin]);
+    }
+#endif
+#else
+    for (int k = 0; k < 4; k++) {
+        uint32_t* row = out + (size_t)(y0 + k) * out_stride + x0;
+        for (int i = 0; i < 4; i++) row[i] = c->in[(size_t)rows[i] * c->in_stride + cols[k]];
+    }
+#endif
+}
+
+// RGBA 输出的 1:1 旋转/镜像
+static void orient_rgba_rows(const EmitCtx* c, int y0, int y1) {
+    int W = c->width;
+    uint32_t* out = (uint32_t*)c->out;
+
+    if (!c->transpose) {
+        bool reversed = W > 1 && c->col_map[W - 1] < c->col_map[0];
+        for (int y = y0; y < y1; y++) {
+            const uint32_t* src_row = c->in + (size_t)c->row_map[y] * c->in_stride;
+            uint32_t* row = out + (size_t)y * c->stride;
+            if (reversed) {
+                reverse_copy(row, src_row + c->col_map[W - 1], W);
+            } else {
+                memcpy(row, src_row + c->col_map[0], (size_t)W * 4);
+            }
+        }
+        return;
+    }
+
+    int y = y0;
+    for (; y + 4 <= y1; y += 4) {
+        int x = 0;
+        for (; x + 4 <= W; x += 4) transpose_block(c, x, y);
+        for (int k = 0; k < 4; k++) {
+            uint32_t* row = out + (size_t)(y + k) * c->stride;
+            for (int xx = x; xx < W; xx++) {
+                row[xx] = c->in[(size_t)c->col_map[xx] * c->in_stride + c->row_map[y + k]];
+            }
+        }
+    }
+    for (; y < y1; y++) {
+        uint32_t* row = out + (size_t)y * c->stride;
+        for (int x = 0; x < W; x++) {
+            row[x] = c->in[(size_t)c->col_map[x] * c->in_stride + c->row_map[y]];
+        }
+    }
+}
+
+// y0 为偶数（YUV 两行一组）
+static void emit_rows(const EmitCtx* c, int y0, int y1) {
+    int width = c->width;
+    std::vector<int> col_map(c->col_map, c->col_map + width);
+
+    if (is_rgba(c->format)) {
+        if (c->identity) {
+            orient_rgba_rows(c, y0, y1);
+            return;
+        }
+        for (int y = y0; y < y1; y++) {
+            uint32_t* row = (uint32_t*)c->out + (size_t)y * c->stride;
+            sample_row(c->in, c->in_stride, c->transpose, col_map, c->row_map[y], width, row);
+        }
+    } else if (c->format == RK_FORMAT_RGB888 || c->format == RK_FORMAT_BGR888) {
+        std::vector<uint32_t> row(width);
+        bool bgr = (c->format == RK_FORMAT_BGR888);
+        for (int y = y0; y < y1; y++) {
+            sample_row(c->in, c->in_stride, c->transpose, col_map, c->row_map[y], width,
+                       row.data());
+            rgba_to_rgb24(row.data(), width, c->out + (size_t)y * c->stride * 3, bgr);
+        }
+    } else {
+        // YUV420：每次处理两行，两行 Y + 一行色度
+        std::vector<uint32_t> rows((size_t)width * 2);
+        uint32_t* row0 = rows.data();
+        uint32_t* row1 = row0 + width;
+        bool nv12 = (c->format == RK_FORMAT_YUV420SP);
+        uint8_t* out = c->out;
+        for (int y = y0; y < y1; y += 2) {
+            bool pair = y + 1 < c->height;
+            sample_row(c->in, c->in_stride, c->transpose, col_map, c->row_map[y], width, row0);
+            if (pair) {
+                sample_row(c->in, c->in_stride, c->transpose, col_map, c->row_map[y + 1],
+                           width, row1);
+            }
+            size_t c_off = (size_t)(y / 2) * c->c_stride;
+            rgba_to_yuv420(row0, pair ? row1 : row0, width,
+                           out + (size_t)y * c->stride,
+                           pair ? out + (size_t)(y + 1) * c->stride : NULL,
+                           c->u_plane + c_off, c->v_plane + c_off, nv12 ? 2 : 1);
+        }
+    }
+}
+
+// ============================================
+// 第一趟：源区域缩放到旋转前尺寸（RGBA）
+// ============================================
+
+// 两行按 f/128 混合（f 为第二行权重）
+static void blend_rows(const uint8_t* a, const uint8_t* b, int bytes, int f, uint8_t* out) {
+    int g = 128 - f;
+    int i = 0;
+#if defined(__ARM_NEON)
+    uint8x8_t wa = vdup_n_u8((uint8_t)g);
+    uint8x8_t wb = vdup_n_u8((uint8_t)f);
+    for (; i + 16 <= bytes; i += 16) {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), wa), vget_low_u8(vb), wb);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), wa), vget_high_u8(vb), wb);
+        vst1q_u8(out + i, vcombine_u8(vrshrn_n_u16(lo, 7), vrshrn_n_u16(hi, 7)));
+    }
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i wa = _mm_set1_epi16((short)g);
+    __m128i wb = _mm_set1_epi16((short)f);
+    __m128i round = _mm_set1_epi16(64);
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 7);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 7);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < bytes; i++) {
+        out[i] = (uint8_t)((a[i] * g + b[i] * f + 64) >> 7);
+    }
+}
+
+// 一行水平双线性：输出 u 取 row[x0[u]] 与 row[x0[u] + 1] 按 f[u]/128 混合
+// 表保证 x0 + 1 在源区域内（宽度为 1 时由调用者走标量复制）
+static void hscale_bilinear(const uint32_t* row, const int* x0, const uint8_t* f, int width,
+                            uint32_t* out) {
+#if defined(__ARM_NEON)
+    for (int u = 0; u < width; u++) {
+        uint64_t wf = f[u], wg = 128 - f[u];
+        uint8x8_t w = vcreate_u8(wg * 0x01010101ull | (wf * 0x01010101ull) << 32);
+        uint16x8_t m = vmull_u8(vld1_u8((const uint8_t*)(row + x0[u])), w);
+        uint16x4_t sum = vadd_u16(vget_low_u16(m), vget_high_u16(m));
+        uint8x8_t px = vrshrn_n_u16(vcombine_u16(sum, sum), 7);
+        out[u] = vget_lane_u32(vreinterpret_u32_u8(px), 0);
+    }
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i round = _mm_set1_epi16(64);
+    for (int u = 0; u < width; u++) {
+        short wf = f[u], wg = (short)(128 - f[u]);
+        __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row + x0[u])), zero);
+        __m128i m = _mm_mullo_epi16(px, _mm_set_epi16(wf, wf, wf, wf, wg, wg, wg, wg));
+        m = _mm_add_epi16(m, _mm_srli_si128(m, 8));
+        m = _mm_srli_epi16(_mm_add_epi16(m, round), 7);
+        out[u] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(m, m));
+    }
+#else
+    for (int u = 0; u < width; u++) {
+        const uint8_t* a = (const uint8_t*)(row + x0[u]);
+        int wf = f[u], wg = 128 - wf;
+        uint8_t* o = (uint8_t*)(out + u);
+        for (int k = 0; k < 4; k++) o[k] = (uint8_t)((a[k] * wg + a[k + 4] * wf + 64) >> 7);
+    }
+#endif
+}
+
+// 像素中心对齐的双线性坐标：输出 u -> 源 (u + 0.5) * src / dst - 0.5
+// x0 取 [0, src - 2]，保证可读 x0 + 1；src == 1 时 x0 = 0, f = 0
+static void bilinear_table(int src, int dst, std::vector<int>* x0, std::vector<uint8_t>* f) {
+    x0->resize(dst);
+    f->resize(dst);
+    int64_t den = 2 * (int64_t)dst;
+    for (int u = 0; u < dst; u++) {
+        int64_t num = (2 * (int64_t)u + 1) * src - dst;
+        int x = 0, frac = 0;
+        if (num > 0) {
+            x = (int)(num / den);
+            frac = (int)((num % den) * 128 / den);
+        }
+        if (x >= src - 1) {
+            x = src > 1 ? src - 2 : 0;
+            frac = src > 1 ? 128 : 0;
+        }
+        (*x0)[u] = x;
+        (*f)[u] = (uint8_t)frac;
+    }
+}
+
+// 盒式区间：输出 u 覆盖源 [start[u], start[u + 1])，至少一个像素
+static void box_table(int src, int dst, std::vector<int>* start) {
+    start->resize(dst + 1);
+    for (int u = 0; u <= dst; u++) {
+        (*start)[u] = (int)((int64_t)u * src / dst);
+    }
+    for (int u = 0; u < dst; u++) {
+        if ((*start)[u + 1] <= (*start)[u]) (*start)[u + 1] = (*start)[u] + 1;
+    }
+}
+
+// 按字节累加一行到 16 位累加器（最多 257 行不溢出）
+static void accumulate_u16(uint16_t* acc, const uint8_t* row, int bytes) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= bytes; i += 16) {
+        uint8x16_t v = vld1q_u8(row + i);
+        vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vget_low_u8(v)));
+        vst1q_u16(acc + i + 8, vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(v)));
+    }
+#elif defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i* a = (__m128i*)(acc + i);
+        _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a), _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128(a + 1, _mm_add_epi16(_mm_loadu_si128(a + 1),
+                                              _mm_unpackhi_epi8(v, zero)));
+    }
+#endif
+    for (; i < bytes; i++) {
+        acc[i] += row[i];
+    }
+}
+
+typedef struct {
+    const uint32_t* in;         // 源区域左上角
+    int in_stride;
+    int cw, ch;                 // 源区域
+    int sw, sh;                 // 缩放后（旋转前）
+    RkCpuFilter filter;         // BILINEAR / BOX
+    uint32_t* out;
+    int out_stride;
+    std::vector<int> x0, y0;            // 双线性
+    std::vector<uint8_t> fx, fy;
+    std::vector<int> xs, ys;            // 盒式
+} ScaleCtx;
+
+static void scale_rows_bilinear(const ScaleCtx* c, int v0, int v1) {
+    std::vector<uint32_t> tmp(c->cw);
+    for (int v = v0; v < v1; v++) {
+        const uint32_t* r0 = c->in + (size_t)c->y0[v] * c->in_stride;
+        const uint32_t* row = r0;
+        if (c->fy[v] != 0) {
+            blend_rows((const uint8_t*)r0, (const uint8_t*)(r0 + c->in_stride), c->cw * 4,
+                       c->fy[v], (uint8_t*)tmp.data());
+            row = tmp.data();
+        }
+        uint32_t* out = c->out + (size_t)v * c->out_stride;
+        if (c->cw > 1) {
+            hscale_bilinear(row, c->x0.data(), c->fx.data(), c->sw, out);
+        } else {
+            for (int u = 0; u < c->sw; u++) out[u] = row[0];
+        }
+    }
+}
+
+static void scale_rows_box(const ScaleCtx* c, int v0, int v1) {
+    int bytes = c->cw * 4;
+    std::vector<uint16_t> acc16(bytes);
+    std::vector<uint32_t> acc32;
+    for (int v = v0; v < v1; v++) {
+        int ys = c->ys[v], n = c->ys[v + 1] - ys;
+        bool wide = n > 257;
+        if (wide) {
+            acc32.assign(bytes, 0);
+        } else {
+            memset(acc16.data(), 0, bytes * sizeof(uint16_t));
+        }
+        for (int y = ys; y < ys + n; y++) {
+            const uint8_t* row = (const uint8_t*)(c->in + (size_t)y * c->in_stride);
+            if (wide) {
+                for (int i = 0; i < bytes; i++) acc32[i] += row[i];
+            } else {
+                accumulate_u16(acc16.data(), row, bytes);
+            }
+        }
+
+        uint8_t* out = (uint8_t*)(c->out + (size_t)v * c->out_stride);
+        for (int u = 0; u < c->sw; u++) {
+            int xs = c->xs[u], xe = c->xs[u + 1];
+            uint32_t area = (uint32_t)n * (xe - xs);
+            uint64_t inv = ((1ull << 24) + area / 2) / area;
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int x = xs; x < xe; x++) {
+                for (int k = 0; k < 4; k++) {
+                    sum[k] += wide ? acc32[x * 4 + k] : acc16[x * 4 + k];
+                }
+            }
+            for (int k = 0; k < 4; k++) {
+                uint64_t q = (sum[k] * inv + (1u << 23)) >> 24;
+                out[u * 4 + k] = (uint8_t)(q > 255 ? 255 : q);
+            }
+        }
+    }
+}
+
+// ============================================
+// 行条带并行
+// ============================================
+
+typedef struct {
+    void (*fn)(const void* ctx, int y0, int y1);
+    const void* ctx;
+    int rows;
+    int stripe;
+} StripeJob;
+
+static void run_stripe(void* arg, int index) {
+    const StripeJob* job = (const StripeJob*)arg;
+    int y0 = index * job->stripe;
+    int y1 = y0 + job->stripe < job->rows ? y0 + job->stripe : job->rows;
+    job->fn(job->ctx, y0, y1);
+}
+
+// 每个线程约两个条带（负载不均时可互相补位），条带行数按 align 对齐且不少于 16 行
+static void parallel_rows(RkThreadPool* pool, int rows, int align,
+                          void (*fn)(const void* ctx, int y0, int y1), const void* ctx) {
+    int tasks = rk_thread_pool_size(pool) * 2;
+    int stripe = (rows + tasks - 1) / tasks;
+    if (stripe < 16) stripe = 16;
+    stripe = (stripe + align - 1) / align * align;
+
+    StripeJob job = {fn, ctx, rows, stripe};
+    rk_thread_pool_run(pool, (rows + stripe - 1) / stripe, run_stripe, &job);
+}
+
+static void emit_stripe(const void* ctx, int y0, int y1) {
+    emit_rows((const EmitCtx*)ctx, y0, y1);
+}
+
+static void scale_stripe(const void* ctx, int v0, int v1) {
+    const ScaleCtx* c = (const ScaleCtx*)ctx;
+    if (c->filter == RK_CPU_FILTER_BOX) {
+        scale_rows_box(c, v0, v1);
+    } else {
+        scale_rows_bilinear(c, v0, v1);
+    }
+}
+
+// ============================================
+// 作业入口
+// ============================================
+
+bool rk_cpu_job_is_tiny(const RkRgaJobDesc* desc) {
+    // 约 0.2 ms 的 CPU 工作量，低于一次 RGA 提交 + 等待的固定开销
+    uint64_t src_px = (uint64_t)desc->src_width * desc->src_height;
+    uint64_t dst_px = (uint64_t)desc->dst_width * desc->dst_height;
+    return dst_px <= 32 * 1024 && src_px <= 128 * 1024;
+}
+
+RkScreenshotError rk_cpu_process_job(RkDmaBuffer* src, RkDmaBuffer* dst, const RkRgaJob* job) {
+    return rk_cpu_process_job_ex(src, dst, job, RK_CPU_FILTER_NEAREST, NULL);
+}
+
+RkScreenshotError rk_cpu_process_job_ex(RkDmaBuffer* src, RkDmaBuffer* dst, const RkRgaJob* job,
+                                        RkCpuFilter filter, RkThreadPool* pool) {
+    RkScreenshotError err = rk_rga_job_check(src, dst, job);
+    if (err != RKSS_SUCCESS) return err;
+
+    uint64_t t0 = rk_get_time_us();
+
+    int cx = 0, cy = 0, cw = src->width, ch = src->height;
+    if (job->crop_width > 0 && job->crop_height > 0) {
+        cx = job->crop_x;
+        cy = job->crop_y;
+        cw = job->crop_width;
+        ch = job->crop_height;
+    }
+    int rx = 0, ry = 0, rw = dst->width, rh = dst->height;     // 输出区域
+    if (job->dst_width > 0 && job->dst_height > 0) {
+        rx = job->dst_x;
+        ry = job->dst_y;
+        rw = job->dst_width;
+        rh = job->dst_height;
+    }
+    bool transpose = (job->rotation == 90 || job->rotation == 270);
+    int sw = transpose ? rh : rw;       // 缩放后、旋转前
+    int sh = transpose ? rw : rh;
+    bool scaled = (cw != sw || ch != sh);
+
+    if (filter == RK_CPU_FILTER_AUTO) {
+        filter = (cw >= 2 * sw && ch >= 2 * sh) ? RK_CPU_FILTER_BOX : RK_CPU_FILTER_BILINEAR;
+    }
+    if (!scaled) filter = RK_CPU_FILTER_NEAREST;    // 1:1，只有旋转/镜像
+
+    size_t src_len = (size_t)src->stride * src->height * 4;
+    size_t dst_len = dst->size;
+    const uint32_t* in = (const uint32_t*)rk_dmabuf_begin_cpu_access(src, RK_DMABUF_CPU_READ,
+                                                                     0, src_len);
+    uint8_t* out = (uint8_t*)rk_dmabuf_begin_cpu_access(dst, RK_DMABUF_CPU_WRITE, 0, dst_len);
+    if (!in || !out) {
+        if (in) rk_dmabuf_end_cpu_access(src, RK_DMABUF_CPU_READ, 0, src_len);
+        if (out) rk_dmabuf_end_cpu_access(dst, RK_DMABUF_CPU_WRITE, 0, dst_len);
+        return RKSS_ERROR_NO_MEMORY;
+    }
+
+    std::vector<int> col_map, row_map;
+    EmitCtx emit;
+    memset(&emit, 0, sizeof(emit));
+    emit.transpose = transpose;
+    emit.width = rw;
+    emit.height = rh;
+    emit.format = dst->format;
+    emit.stride = dst->stride;
+    if (is_rgba(dst->format)) {
+        emit.out = out + ((size_t)ry * dst->stride + rx) * 4;
+    } else if (dst->format == RK_FORMAT_RGB888 || dst->format == RK_FORMAT_BGR888) {
+        emit.out = out + ((size_t)ry * dst->stride + rx) * 3;
+    } else {
+        uint8_t* chroma = out + (size_t)dst->stride * dst->height_stride;
+        emit.out = out + (size_t)ry * dst->stride + rx;
+        if (dst->format == RK_FORMAT_YUV420SP) {
+            emit.c_stride = dst->stride;
+            emit.u_plane = chroma + (size_t)(ry / 2) * emit.c_stride + rx;
+            emit.v_plane = emit.u_plane + 1;
+        } else {
+            emit.c_stride = dst->stride / 2;
+            size_t off = (size_t)(ry / 2) * emit.c_stride + rx / 2;
+            emit.u_plane = chroma + off;
+            emit.v_plane = chroma + (size_t)emit.c_stride * (dst->height_stride / 2) + off;
+        }
+    }
+
+    bool oriented = job->rotation != 0 || job->flip_horizontal || job->flip_vertical;
+    std::vector<uint32_t> scaled_buf;
+    bool done = false;
+
+    if (filter == RK_CPU_FILTER_NEAREST) {
+        // 单趟：裁剪 + 缩放 + 旋转 + 镜像由映射表一次完成
+        build_maps(cx, cy, cw, ch, rw, rh, job, &col_map, &row_map);
+        emit.in = in;
+        emit.in_stride = src->stride;
+        emit.identity = !scaled;
+    } else {
+        ScaleCtx sc;
+        sc.in = in + (size_t)cy * src->stride + cx;
+        sc.in_stride = src->stride;
+        sc.cw = cw;
+        sc.ch = ch;
+        sc.sw = sw;
+        sc.sh = sh;
+        sc.filter = filter;
+        if (filter == RK_CPU_FILTER_BOX) {
+            box_table(cw, sw, &sc.xs);
+            box_table(ch, sh, &sc.ys);
+        } else {
+            bilinear_table(cw, sw, &sc.x0, &sc.fx);
+            bilinear_table(ch, sh, &sc.y0, &sc.fy);
+        }
+
+        // 无旋转镜像的 RGBA 输出直接写入 dst，否则写中间图再做第二趟
+        if (!oriented && is_rgba(dst->format)) {
+            sc.out = (uint32_t*)emit.out;
+            sc.out_stride = dst->stride;
+            done = true;
+        } else {
+            scaled_buf.resize((size_t)sw * sh);
+            sc.out = scaled_buf.data();
+            sc.out_stride = sw;
+        }
+        parallel_rows(pool, sh, 1, scale_stripe, &sc);
+
+        build_maps(0, 0, sw, sh, rw, rh, job, &col_map, &row_map);
+        emit.in = scaled_buf.data();
+        emit.in_stride = sw;
+        emit.identity = true;
+    }
+
+    if (!done) {
+        emit.col_map = col_map.data();
+        emit.row_map = row_map.data();
+        // 4 行对齐：YUV 两行一组，RGBA 转置按 4x4 分块
+        parallel_rows(pool, rh, 4, emit_stripe, &emit);
+    }
+
+    rk_dmabuf_end_cpu_access(dst, RK_DMABUF_CPU_WRITE, 0, dst_len);
+    rk_dmabuf_end_cpu_access(src, RK_DMABUF_CPU_READ, 0, src_len);
+
+    ALOGD("CPU job: %dx%d -> %dx%d %s (rot %d%s%s, filter %d, %d threads) in %.2f ms",
+          cw, ch, rw, rh, rk_format_name(dst->format),
+          job->rotation, job->flip_horizontal ? ", flip H" : "",
+          job->flip_vertical ? ", flip V" : "", filter, rk_thread_pool_size(pool),
+          (rk_get_time_us() - t0) / 1000.0);
+    return RKSS_SUCCESS;
+}
@@ -12,9 +12,23 @@
 #include <errno.h>
 #include <cstring>
 #include <cstdlib>
+#include <atomic>
+#include <new>
+#include <vector>
 
-// Linux DMA-HEAP
+// Linux DMA-HEAP / DMA-BUF
 #include <linux/dma-heap.h>
+#include <linux/dma-buf.h>
+
+// Rockchip BSP 内核扩展：按区间同步，避免整块 cache flush
+#ifndef DMA_BUF_IOCTL_SYNC_PARTIAL
+struct dma_buf_sync_partial {
+    __u64 flags;
+    __u32 offset;
+    __u32 len;
+};
+#define DMA_BUF_IOCTL_SYNC_PARTIAL _IOW(DMA_BUF_BASE, 2, struct dma_buf_sync_partial)
+#endif
 
 #undef LOG_TAG
 #define LOG_TAG "RK_DMABUF"
@@ -22,8 +36,15 @@
 // DMA-HEAP 设备路径
 #define DMA_HEAP_PATH "/dev/dma_heap/system"
 #define DMA_HEAP_CMA_PATH "/dev/dma_heap/cma"
+#define DMA_HEAP_DMA32_PATH "/dev/dma_heap/system-dma32"
 
 static int g_heap_fd = -1;
+static int g_dma32_heap_fd = -1;
+
+static std::atomic<uint64_t> g_map_count(0);
+static std::atomic<uint64_t> g_unmap_count(0);
+static std::atomic<uint64_t> g_sync_count(0);
+static std::atomic<bool> g_partial_sync_supported(true);
 
 static int open_dma_heap() {
     if (g_heap_fd >= 0) return g_heap_fd;
@@ -46,39 +67,189 @@ static int open_dma_heap() {
     return -1;
 }
 
-RkDmaBuffer* rk_dmabuf_alloc(int width, int height) {
-    int heap_fd = open_dma_heap();
-    if (heap_fd < 0) return nullptr;
+static int heap_ioctl_alloc(int heap_fd, size_t size) {
 
-    size_t size = (size_t)width * height * 4;  // RGBA8888
-    
     struct dma_heap_allocation_data alloc = {};
     alloc.len = size;
     alloc.fd_flags = O_RDWR | O_CLOEXEC;
 
     if (ioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &alloc) < 0) {
         ALOGE("❌ DMA-HEAP alloc failed: %s (size=%zu)", strerror(errno), size);
+        return -1;
+    }
+    return alloc.fd;
+}
+
+static int heap_alloc_fd(size_t size) {
+    int heap_fd = open_dma_heap();
+    if (heap_fd < 0) return -1;
+    return heap_ioctl_alloc(heap_fd, size);
+}
+
+// cma 区域不保证在 4G 以下，只有 system-dma32 heap 能给 RGA2 用
+static int dma32_alloc_fd(size_t size) {
+    if (g_dma32_heap_fd < 0) {
+        g_dma32_heap_fd = open(DMA_HEAP_DMA32_PATH, O_RDWR);
+        if (g_dma32_heap_fd < 0) {
+            ALOGE("❌ Failed to open DMA-HEAP: %s: %s", DMA_HEAP_DMA32_PATH, strerror(errno));
+            return -1;
+        }
+        ALOGD("Using DMA-HEAP: %s", DMA_HEAP_DMA32_PATH);
+    }
+    return heap_ioctl_alloc(g_dma32_heap_fd, size);
+}
+
+// memfd 没有 IOMMU 语义，只用于在普通 Linux 主机上测试/benchmark pool
+static int memfd_alloc_fd(size_t size) {
+    int fd = memfd_create("rk_dmabuf", MFD_CLOEXEC);
+    if (fd < 0) {
+        ALOGE("❌ memfd_create failed: %s", strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)size) < 0) {
+        ALOGE("❌ memfd ftruncate failed: %s (size=%zu)", strerror(errno), size);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static const RkDmaAllocator g_heap_allocator = { "dma-heap", heap_alloc_fd, false };
+static const RkDmaAllocator g_dma32_allocator = { "dma-heap-dma32", dma32_alloc_fd, true };
+// memfd 只在主机上模拟，没有物理地址限制
+static const RkDmaAllocator g_memfd_allocator = { "memfd", memfd_alloc_fd, true };
+
+const RkDmaAllocator* rk_dmabuf_heap_allocator() {
+    return &g_heap_allocator;
+}
+
+const RkDmaAllocator* rk_dmabuf_dma32_allocator() {
+    return &g_dma32_allocator;
+}
+
+const RkDmaAllocator* rk_dmabuf_memfd_allocator() {
+    return &g_memfd_allocator;
+}
+
+const RkDmaAllocator* rk_dmabuf_default_allocator() {
+    if (access(DMA_HEAP_DMA32_PATH, R_OK | W_OK) == 0) {
+        return &g_dma32_allocator;
+    }
+    if (access(DMA_HEAP_CMA_PATH, R_OK | W_OK) == 0 || access(DMA_HEAP_PATH, R_OK | W_OK) == 0) {
+        return &g_heap_allocator;
+    }
+    ALOGW("⚠️ No DMA-HEAP, using memfd buffers (host build, no hardware import)");
+    return &g_memfd_allocator;
+}
+
+int rk_format_bits_per_pixel(int format) {
+    switch (format) {
+        case RK_FORMAT_RGBA8888:
+        case RK_FORMAT_RGBX8888:
+            return 32;
+        case RK_FORMAT_RGB888:
+        case RK_FORMAT_BGR888:
+            return 24;
+        case RK_FORMAT_YUV420SP:
+        case RK_FORMAT_YUV420P:
+            return 12;
+        default:
+            return 0;
+    }
+}
+
+size_t rk_format_frame_size(int format, int stride, int height_stride) {
+    return (size_t)stride * height_stride * rk_format_bits_per_pixel(format) / 8;
+}
+
+size_t rk_format_packed_size(int format, int width, int height) {
+    switch (format) {
+        case RK_FORMAT_YUV420SP:
+        case RK_FORMAT_YUV420P: {
+            // 色度平面 2x2 采样，奇数尺寸向上取整
+            size_t cw = (size_t)(width + 1) / 2, ch = (size_t)(height + 1) / 2;
+            return (size_t)width * height + cw * ch * 2;
+        }
+        default:
+            return (size_t)width * height * rk_format_bits_per_pixel(format) / 8;
+    }
+}
+
+const char* rk_format_name(int format) {
+    switch (format) {
+        case RK_FORMAT_RGBA8888: return "RGBA8888";
+        case RK_FORMAT_RGBX8888: return "RGBX8888";
+        case RK_FORMAT_RGB888: return "RGB888";
+        case RK_FORMAT_BGR888: return "BGR888";
+        case RK_FORMAT_YUV420SP: return "NV12";
+        case RK_FORMAT_YUV420P: return "I420";
+        case RK_FORMAT_JPEG: return "JPEG";
+        default: return "unknown";
+    }
+}
+
+static int align_up(int value, int align) {
+    if (align <= 1) return value;
+    return (value + align - 1) / align * align;
+}
+
+// 计算步进：YUV420 色度平面按 2x2 采样，步进至少偶数
+static void buffer_layout(int width, int height, int format, int hor_align, int ver_align,
+                          int* stride, int* height_stride) {
+    bool yuv = (format == RK_FORMAT_YUV420SP || format == RK_FORMAT_YUV420P);
+    *stride = align_up(width, yuv && hor_align < 2 ? 2 : hor_align);
+    *height_stride = align_up(height, yuv && ver_align < 2 ? 2 : ver_align);
+}
+
+RkDmaBuffer* rk_dmabuf_alloc_aligned(const RkDmaAllocator* allocator,
+                                     int width, int height, int format,
+                                     int hor_align, int ver_align) {
+    if (!allocator || width <= 0 || height <= 0) return nullptr;
+
+    if (rk_format_bits_per_pixel(format) == 0) {
+        ALOGE("❌ Unsupported DMA-BUF format: %d", format);
         return nullptr;
     }
 
+    int stride, height_stride;
+    buffer_layout(width, height, format, hor_align, ver_align, &stride, &height_stride);
+
+    size_t size = rk_format_frame_size(format, stride, height_stride);
+    int fd = allocator->alloc_fd(size);
+    if (fd < 0) return nullptr;
+
     RkDmaBuffer* buf = (RkDmaBuffer*)calloc(1, sizeof(RkDmaBuffer));
     if (!buf) {
-        close(alloc.fd);
+        close(fd);
         return nullptr;
     }
 
-    buf->fd = alloc.fd;
+    buf->fd = fd;
     buf->size = size;
     buf->width = width;
     buf->height = height;
-    buf->stride = width;
-    buf->format = RK_FORMAT_RGBA8888;
+    buf->stride = stride;
+    buf->height_stride = height_stride;
+    buf->format = format;
     buf->vir_addr = nullptr;
+    buf->pool = nullptr;
+    buf->sync_unsupported = false;
+    buf->dma32 = allocator->dma32;
 
-    ALOGD("✅ Allocated DMA-BUF: fd=%d, %dx%d, %zu bytes", buf->fd, width, height, size);
+    ALOGD("✅ Allocated DMA-BUF (%s): fd=%d, %dx%d (stride %dx%d), %zu bytes",
+          allocator->name, buf->fd, width, height, stride, height_stride, size);
     return buf;
 }
 
+RkDmaBuffer* rk_dmabuf_alloc_with(const RkDmaAllocator* allocator,
+                                  int width, int height, int format) {
+    return rk_dmabuf_alloc_aligned(allocator, width, height, format, 1, 1);
+}
+
+RkDmaBuffer* rk_dmabuf_alloc(int width, int height) {
+    return rk_dmabuf_alloc_with(&g_heap_allocator, width, height, RK_FORMAT_RGBA8888);
+}
+
 void* rk_dmabuf_map(RkDmaBuffer* buf) {
     if (!buf) return nullptr;
     if (buf->vir_addr) return buf->vir_addr;  // 已映射
@@ -91,6 +262,7 @@ void* rk_dmabuf_map(RkDmaBuffer* buf) {
     }
 
     buf->vir_addr = addr;
+    g_map_count++;
     ALOGD("Mapped: fd=%d -> %p", buf->fd, addr);
     return addr;
 }
@@ -100,12 +272,92 @@ void rk_dmabuf_unmap(RkDmaBuffer* buf) {
     
     munmap(buf->vir_addr, buf->size);
     buf->vir_addr = nullptr;
+    g_unmap_count++;
     ALOGD("Unmapped: fd=%d", buf->fd);
 }
 
+static void dmabuf_sync(RkDmaBuffer* buf, uint64_t flags, size_t offset, size_t len) {
+    if (buf->sync_unsupported) return;
+
+    // 区间同步（整块时直接走标准 ioctl）
+    bool partial_failed = false;
+    if (g_partial_sync_supported && (offset > 0 || len < buf->size)) {
+        struct dma_buf_sync_partial partial = {};
+        partial.flags = flags;
+        partial.offset = (__u32)offset;
+        partial.len = (__u32)len;
+        if (ioctl(buf->fd, DMA_BUF_IOCTL_SYNC_PARTIAL, &partial) == 0) {
+            g_sync_count++;
+            return;
+        }
+        partial_failed = (errno == ENOTTY || errno == EINVAL);
+    }
+
+    struct dma_buf_sync sync = {};
+    sync.flags = flags;
+    if (ioctl(buf->fd, DMA_BUF_IOCTL_SYNC, &sync) == 0) {
+        if (partial_failed) {
+            // 标准 ioctl 可用而区间版本不可用：内核没有 BSP 扩展
+            ALOGD("Partial DMA-BUF sync unsupported, using full sync");
+            g_partial_sync_supported = false;
+        }
+        g_sync_count++;
+        return;
+    }
+
+    if (errno == ENOTTY || errno == EINVAL) {
+        // 非 DMA-BUF fd（memfd），无需 cache 维护
+        buf->sync_unsupported = true;
+    } else {
+        ALOGW("⚠️ DMA_BUF_IOCTL_SYNC failed: fd=%d, %s", buf->fd, strerror(errno));
+    }
+}
+
+static uint64_t access_to_sync_flags(int access) {
+    uint64_t flags = 0;
+    if (access & RK_DMABUF_CPU_READ) flags |= DMA_BUF_SYNC_READ;
+    if (access & RK_DMABUF_CPU_WRITE) flags |= DMA_BUF_SYNC_WRITE;
+    return flags;
+}
+
+void* rk_dmabuf_begin_cpu_access(RkDmaBuffer* buf, int access, size_t offset, size_t len) {
+    if (!buf || offset >= buf->size) return nullptr;
+    if (len == 0 || len > buf->size - offset) len = buf->size - offset;
+
+    void* addr = rk_dmabuf_map(buf);
+    if (!addr) return nullptr;
+
+    dmabuf_sync(buf, DMA_BUF_SYNC_START | access_to_sync_flags(access), offset, len);
+    return addr;
+}
+
+void rk_dmabuf_end_cpu_access(RkDmaBuffer* buf, int access, size_t offset, size_t len) {
+    if (!buf || !buf->vir_addr || offset >= buf->size) return;
+    if (len == 0 || len > buf->size - offset) len = buf->size - offset;
+
+    dmabuf_sync(buf, DMA_BUF_SYNC_END | access_to_sync_flags(access), offset, len);
+}
+
+void rk_dmabuf_get_stats(RkDmaBufStats* stats) {
+    if (!stats) return;
+    stats->maps = g_map_count;
+    stats->unmaps = g_unmap_count;
+    stats->syncs = g_sync_count;
+}
+
 void rk_dmabuf_free(RkDmaBuffer* buf) {
     if (!buf) return;
 
+    if (buf->pool) {
+        rk_dmabuf_pool_release(buf->pool, buf);
+        return;
+    }
+
+    if (buf->import_cache) {
+        rk_import_cache_release(buf->import_cache, buf);
+        return;
+    }
+
     if (buf->vir_addr) {
         rk_dmabuf_unmap(buf);
     }
@@ -118,6 +370,187 @@ void rk_dmabuf_free(RkDmaBuffer* buf) {
     ALOGD("Freed DMA-BUF");
 }
 
+// ============================================
+// DMA-BUF 缓冲池
+// ============================================
+// 每帧 DMA_HEAP_IOCTL_ALLOC 需要一次 ioctl + 新 fd + CMA 清零，
+// pool 按 width/height/format/stride 复用已分配的 buffer。
+// 空闲列表按释放时间排序（尾部最新），超过上限时从头部淘汰。
+
+struct RkDmaBufPool {
+    const RkDmaAllocator* allocator;
+    pthread_mutex_t lock;
+    size_t max_idle_bytes;
+    std::vector<RkDmaBuffer*> idle;
+    bool closing;               // destroy 时仍有租出的 buffer
+    RkDmaBufPoolStats stats;
+};
+
+static void pool_free_buffer(RkDmaBuffer* buf) {
+    buf->pool = nullptr;
+    rk_dmabuf_free(buf);
+}
+
+// 调用者持有 pool->lock
+static void pool_trim_locked(RkDmaBufPool* pool, size_t max_idle_bytes) {
+    size_t n = 0;
+    while (n < pool->idle.size() && pool->stats.idle_bytes > max_idle_bytes) {
+        RkDmaBuffer* victim = pool->idle[n++];
+        pool->stats.idle_bytes -= victim->size;
+        pool->stats.idle_count--;
+        pool->stats.evictions++;
+        pool_free_buffer(victim);
+    }
+    pool->idle.erase(pool->idle.begin(), pool->idle.begin() + n);
+}
+
+static void pool_update_high_water(RkDmaBufPool* pool) {
+    size_t total = pool->stats.idle_bytes + pool->stats.leased_bytes;
+    if (total > pool->stats.high_water_bytes) {
+        pool->stats.high_water_bytes = total;
+    }
+}
+
+static void pool_log_stats(const RkDmaBufPool* pool) {
+    ALOGI("DMA-BUF pool (%s): %lu hits, %lu misses, %lu evictions, high-water %zu KB",
+          pool->allocator->name, pool->stats.hits, pool->stats.misses,
+          pool->stats.evictions, pool->stats.high_water_bytes / 1024);
+}
+
+static void pool_free(RkDmaBufPool* pool) {
+    pthread_mutex_destroy(&pool->lock);
+    delete pool;
+}
+
+RkDmaBufPool* rk_dmabuf_pool_create(const RkDmaAllocator* allocator, size_t max_idle_bytes) {
+    if (!allocator) return nullptr;
+
+    RkDmaBufPool* pool = new (std::nothrow) RkDmaBufPool();
+    if (!pool) return nullptr;
+
+    pool->allocator = allocator;
+    pool->max_idle_bytes = max_idle_bytes;
+    pool->closing = false;
+    memset(&pool->stats, 0, sizeof(pool->stats));
+    pthread_mutex_init(&pool->lock, NULL);
+
+    ALOGD("DMA-BUF pool created (%s, cap %zu KB)", allocator->name, max_idle_bytes / 1024);
+    return pool;
+}
+
+void rk_dmabuf_pool_destroy(RkDmaBufPool* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool_log_stats(pool);
+    pool_trim_locked(pool, 0);
+    bool leased = pool->stats.leased_count > 0;
+    if (leased) {
+        // 最后一个 buffer 归还时再释放 pool
+        ALOGW("⚠️ DMA-BUF pool destroyed with %d leased buffers", pool->stats.leased_count);
+        pool->closing = true;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!leased) pool_free(pool);
+}
+
+RkDmaBuffer* rk_dmabuf_pool_acquire(RkDmaBufPool* pool, int width, int height, int format) {
+    return rk_dmabuf_pool_acquire_aligned(pool, width, height, format, 1, 1);
+}
+
+RkDmaBuffer* rk_dmabuf_pool_acquire_aligned(RkDmaBufPool* pool, int width, int height, int format,
+                                            int hor_align, int ver_align) {
+    if (!pool) return nullptr;
+
+    int stride, height_stride;
+    buffer_layout(width, height, format, hor_align, ver_align, &stride, &height_stride);
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->closing) {   // destroy 在锁内置位
+        pthread_mutex_unlock(&pool->lock);
+        return nullptr;
+    }
+    for (size_t i = pool->idle.size(); i-- > 0;) {
+        RkDmaBuffer* buf = pool->idle[i];
+        if (buf->width == width && buf->height == height && buf->format == format &&
+            buf->stride == stride && buf->height_stride == height_stride) {
+            pool->idle.erase(pool->idle.begin() + i);
+            pool->stats.idle_bytes -= buf->size;
+            pool->stats.idle_count--;
+            pool->stats.leased_bytes += buf->size;
+            pool->stats.leased_count++;
+            pool->stats.hits++;
+            pthread_mutex_unlock(&pool->lock);
+
+            buf->pool = pool;
+            return buf;
+        }
+    }
+    pool->stats.misses++;
+    pthread_mutex_unlock(&pool->lock);
+
+    // 分配不持锁，避免 ioctl 阻塞其他租借
+    RkDmaBuffer* buf = rk_dmabuf_alloc_aligned(pool->allocator, width, height, format,
+                                               hor_align, ver_align);
+    if (!buf) return nullptr;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.leased_bytes += buf->size;
+    pool->stats.leased_count++;
+    pool_update_high_water(pool);
+    pthread_mutex_unlock(&pool->lock);
+
+    buf->pool = pool;
+    return buf;
+}
+
+void rk_dmabuf_pool_release(RkDmaBufPool* pool, RkDmaBuffer* buf) {
+    if (!pool || !buf) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.leased_bytes -= buf->size;
+    pool->stats.leased_count--;
+
+    if (pool->closing) {
+        bool last = pool->stats.leased_count == 0;
+        pthread_mutex_unlock(&pool->lock);
+        pool_free_buffer(buf);
+        if (last) pool_free(pool);
+        return;
+    }
+
+    if (buf->size > pool->max_idle_bytes) {
+        pool->stats.evictions++;
+        pthread_mutex_unlock(&pool->lock);
+        pool_free_buffer(buf);
+        return;
+    }
+
+    buf->pool = nullptr;
+    pool->idle.push_back(buf);
+    pool->stats.idle_bytes += buf->size;
+    pool->stats.idle_count++;
+    pool_trim_locked(pool, pool->max_idle_bytes);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void rk_dmabuf_pool_trim(RkDmaBufPool* pool, size_t max_idle_bytes) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool_trim_locked(pool, max_idle_bytes);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void rk_dmabuf_pool_get_stats(RkDmaBufPool* pool, RkDmaBufPoolStats* stats) {
+    if (!pool || !stats) return;
+
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
+
 // 时间工具
 uint64_t rk_get_time_us() {
     struct timespec ts;
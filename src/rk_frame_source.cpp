@@ -0,0 +1,411 @@
+/**
+ * RK3588 Frame Sources
+ *
+ * 合成图案 / 原始帧回放：不依赖 SurfaceFlinger，用于主机 benchmark 与回归测试
+ * SurfaceFlinger 来源见 rk_surfaceflinger_capture.cpp
+ */
+
+#include "rk_internal.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_SOURCE"
+
+// 与 SurfaceFlinger GraphicBuffer 一致：行步进 64 字节对齐
+#define RK_SOURCE_HOR_ALIGN 16
+
+// 虚拟显示器 ID（display_id = 0 同样指向它）
+#define RK_SOURCE_DISPLAY_ID 1
+
+#define RK_SYNTHETIC_DEFAULT_WIDTH 1920
+#define RK_SYNTHETIC_DEFAULT_HEIGHT 1080
+
+// ============================================
+// 公共：请求解析 + 虚拟显示器
+// ============================================
+
+// 源区域与输出尺寸，以及输出列/行到源坐标的最近邻映射
+struct RkSampleMap {
+    int out_width;
+    int out_height;
+    std::vector<int> xs;
+    std::vector<int> ys;
+    bool identity;      // 无缩放无裁剪，可整行拷贝
+};
+
+static RkScreenshotError resolve_request(const RkCaptureRequest* req, int disp_width,
+                                         int disp_height, RkSampleMap* map) {
+    int cx = 0, cy = 0, cw = disp_width, ch = disp_height;
+    if (req && req->crop_width > 0 && req->crop_height > 0) {
+        cx = req->crop_x;
+        cy = req->crop_y;
+        cw = req->crop_width;
+        ch = req->crop_height;
+        if (cx < 0 || cy < 0 || cx + cw > disp_width || cy + ch > disp_height) {
+            ALOGE("❌ Crop %d,%d %dx%d outside %dx%d display", cx, cy, cw, ch,
+                  disp_width, disp_height);
+            return RKSS_ERROR_INVALID_PARAM;
+        }
+    }
+
+    map->out_width = (req && req->width > 0) ? req->width : cw;
+    map->out_height = (req && req->height > 0) ? req->height : ch;
+    map->identity = (cw == disp_width && ch == disp_height &&
+                     map->out_width == cw && map->out_height == ch);
+
+    map->xs.resize(map->out_width);
+    map->ys.resize(map->out_height);
+    for (int x = 0; x < map->out_width; x++) {
+        map->xs[x] = cx + (int)(((int64_t)x * 2 + 1) * cw / (2 * map->out_width));
+    }
+    for (int y = 0; y < map->out_height; y++) {
+        map->ys[y] = cy + (int)(((int64_t)y * 2 + 1) * ch / (2 * map->out_height));
+    }
+    return RKSS_SUCCESS;
+}
+
+static RkScreenshotError single_display_info(int width, int height, RkDisplayInfo* displays,
+                                             int max_count, int* count) {
+    if (!count || max_count < 0 || (max_count > 0 && !displays)) return RKSS_ERROR_INVALID_PARAM;
+
+    if (max_count > 0) {
+        memset(&displays[0], 0, sizeof(displays[0]));
+        displays[0].id = RK_SOURCE_DISPLAY_ID;
+        displays[0].width = width;
+        displays[0].height = height;
+        displays[0].refresh_rate = 60.0f;
+        displays[0].internal = true;
+    }
+    *count = 1;
+    return RKSS_SUCCESS;
+}
+
+static RkScreenshotError single_display_size(int disp_width, int disp_height, uint64_t display_id,
+                                             int* width, int* height) {
+    if (!width || !height) return RKSS_ERROR_INVALID_PARAM;
+    if (display_id != 0 && display_id != RK_SOURCE_DISPLAY_ID) return RKSS_ERROR_INVALID_PARAM;
+
+    *width = disp_width;
+    *height = disp_height;
+    return RKSS_SUCCESS;
+}
+
+// 从 pool 租一个输出 buffer 并开始 CPU 写
+static RkDmaBuffer* begin_frame(RkDmaBufPool* pool, const RkSampleMap* map, uint8_t** pixels) {
+    RkDmaBuffer* buf = rk_dmabuf_pool_acquire_aligned(pool, map->out_width, map->out_height,
+                                                      RK_FORMAT_RGBA8888, RK_SOURCE_HOR_ALIGN, 1);
+    if (!buf) return nullptr;
+
+    *pixels = (uint8_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    if (!*pixels) {
+        rk_dmabuf_free(buf);
+        return nullptr;
+    }
+    return buf;
+}
+
+static void end_frame(RkDmaBuffer* buf) {
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+}
+
+// ============================================
+// 合成图案：渐变背景 + 棋盘纹理 + 移动方块
+// ============================================
+struct RkSyntheticSource {
+    RkSyntheticSourceConfig cfg;
+    RkDmaBufPool* pool;
+    std::atomic<uint64_t> frame;
+};
+
+static inline uint32_t synthetic_pixel(int x, int y, int width, int height, uint64_t phase,
+                                       int box_x, int box_y, int box_w, int box_h) {
+    if (x >= box_x && x < box_x + box_w && y >= box_y && y < box_y + box_h) {
+        return 0xffffffffu;
+    }
+    uint32_t r = (uint32_t)(((int64_t)x * 256 / width + phase * 4) & 0xff);
+    uint32_t g = (uint32_t)((int64_t)y * 256 / height);
+    uint32_t b = (((x ^ y) >> 4) & 1) ? 0x40 : 0x80;
+    return 0xff000000u | (b << 16) | (g << 8) | r;     // 小端 RGBA
+}
+
+static RkScreenshotError synthetic_get_displays(RkFrameSource* src, RkDisplayInfo* displays,
+                                                int max_count, int* count) {
+    RkSyntheticSource* s = (RkSyntheticSource*)src->priv;
+    return single_display_info(s->cfg.width, s->cfg.height, displays, max_count, count);
+}
+
+static RkScreenshotError synthetic_get_display_size(RkFrameSource* src, uint64_t display_id,
+                                                    int* width, int* height) {
+    RkSyntheticSource* s = (RkSyntheticSource*)src->priv;
+    return single_display_size(s->cfg.width, s->cfg.height, display_id, width, height);
+}
+
+static RkScreenshotError synthetic_capture(RkFrameSource* src, const RkCaptureRequest* req,
+                                           RkDmaBuffer** out) {
+    RkSyntheticSource* s = (RkSyntheticSource*)src->priv;
+    if (!out) return RKSS_ERROR_INVALID_PARAM;
+    if (req && req->display_id != 0 && req->display_id != RK_SOURCE_DISPLAY_ID) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+
+    RkSampleMap map;
+    RkScreenshotError err = resolve_request(req, s->cfg.width, s->cfg.height, &map);
+    if (err != RKSS_SUCCESS) return err;
+
+    uint64_t frame = s->frame.fetch_add(1);
+    uint64_t phase = s->cfg.change_interval > 0 ? frame / s->cfg.change_interval : 0;
+
+    int width = s->cfg.width, height = s->cfg.height;
+    int box_w = width / 8, box_h = height / 8;
+    int box_x = (int)((phase * 16) % (uint64_t)(width - box_w + 1));
+    int box_y = (int)((phase * 9) % (uint64_t)(height - box_h + 1));
+
+    uint8_t* pixels = nullptr;
+    RkDmaBuffer* buf = begin_frame(s->pool, &map, &pixels);
+    if (!buf) return RKSS_ERROR_NO_MEMORY;
+
+    for (int y = 0; y < map.out_height; y++) {
+        uint32_t* row = (uint32_t*)(pixels + (size_t)y * buf->stride * 4);
+        int sy = map.ys[y];
+        for (int x = 0; x < map.out_width; x++) {
+            row[x] = synthetic_pixel(map.xs[x], sy, width, height, phase,
+                                     box_x, box_y, box_w, box_h);
+        }
+    }
+    end_frame(buf);
+
+    *out = buf;
+    return RKSS_SUCCESS;
+}
+
+static void synthetic_destroy(RkFrameSource* src) {
+    RkSyntheticSource* s = (RkSyntheticSource*)src->priv;
+    rk_dmabuf_pool_destroy(s->pool);
+    delete s;
+    delete src;
+}
+
+RkFrameSource* rk_frame_source_create_synthetic(const RkSyntheticSourceConfig* cfg) {
+    if (!cfg || cfg->width <= 0 || cfg->height <= 0 || cfg->change_interval < 0) return nullptr;
+
+    RkSyntheticSource* s = new (std::nothrow) RkSyntheticSource();
+    RkFrameSource* src = new (std::nothrow) RkFrameSource();
+    if (!s || !src) {
+        delete s;
+        delete src;
+        return nullptr;
+    }
+
+    s->cfg = *cfg;
+    if (!s->cfg.allocator) s->cfg.allocator = rk_dmabuf_default_allocator();
+    s->frame = 0;
+    // 保留约 3 帧，与 SurfaceFlinger 截图 buffer 轮转相当
+    s->pool = rk_dmabuf_pool_create(s->cfg.allocator, (size_t)cfg->width * cfg->height * 4 * 3);
+    if (!s->pool) {
+        delete s;
+        delete src;
+        return nullptr;
+    }
+
+    src->name = "synthetic";
+    src->priv = s;
+    src->get_displays = synthetic_get_displays;
+    src->get_display_size = synthetic_get_display_size;
+    src->capture = synthetic_capture;
+    src->destroy = synthetic_destroy;
+
+    ALOGI("✅ Synthetic source: %dx%d, changes every %d frames (%s)",
+          cfg->width, cfg->height, cfg->change_interval, s->cfg.allocator->name);
+    return src;
+}
+
+// ============================================
+// 原始帧回放
+// ============================================
+struct RkReplaySource {
+    int width;
+    int height;
+    const uint8_t* data;    // 只读映射整个文件
+    size_t data_size;
+    int frame_count;
+    std::atomic<uint64_t> frame;
+    RkDmaBufPool* pool;
+};
+
+static RkScreenshotError replay_get_displays(RkFrameSource* src, RkDisplayInfo* displays,
+                                             int max_count, int* count) {
+    RkReplaySource* r = (RkReplaySource*)src->priv;
+    return single_display_info(r->width, r->height, displays, max_count, count);
+}
+
+static RkScreenshotError replay_get_display_size(RkFrameSource* src, uint64_t display_id,
+                                                 int* width, int* height) {
+    RkReplaySource* r = (RkReplaySource*)src->priv;
+    return single_display_size(r->width, r->height, display_id, width, height);
+}
+
+static RkScreenshotError replay_capture(RkFrameSource* src, const RkCaptureRequest* req,
+                                        RkDmaBuffer** out) {
+    RkReplaySource* r = (RkReplaySource*)src->priv;
+    if (!out) return RKSS_ERROR_INVALID_PARAM;
+    if (req && req->display_id != 0 && req->display_id != RK_SOURCE_DISPLAY_ID) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+
+    RkSampleMap map;
+    RkScreenshotError err = resolve_request(req, r->width, r->height, &map);
+    if (err != RKSS_SUCCESS) return err;
+
+    size_t frame_bytes = (size_t)r->width * r->height * 4;
+    const uint8_t* frame = r->data + (r->frame.fetch_add(1) % r->frame_count) * frame_bytes;
+
+    uint8_t* pixels = nullptr;
+    RkDmaBuffer* buf = begin_frame(r->pool, &map, &pixels);
+    if (!buf) return RKSS_ERROR_NO_MEMORY;
+
+    for (int y = 0; y < map.out_height; y++) {
+        uint32_t* row = (uint32_t*)(pixels + (size_t)y * buf->stride * 4);
+        const uint32_t* src_row = (const uint32_t*)(frame + (size_t)map.ys[y] * r->width * 4);
+        if (map.identity) {
+            memcpy(row, src_row, (size_t)r->width * 4);
+            continue;
+        }
+        for (int x = 0; x < map.out_width; x++) {
+            row[x] = src_row[map.xs[x]];
+        }
+    }
+    end_frame(buf);
+
+    *out = buf;
+    return RKSS_SUCCESS;
+}
+
+static void replay_destroy(RkFrameSource* src) {
+    RkReplaySource* r = (RkReplaySource*)src->priv;
+    rk_dmabuf_pool_destroy(r->pool);
+    munmap((void*)r->data, r->data_size);
+    delete r;
+    delete src;
+}
+
+RkFrameSource* rk_frame_source_create_replay(const char* path, int width, int height,
+                                             const RkDmaAllocator* allocator) {
+    if (!path || width <= 0 || height <= 0) return nullptr;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        ALOGE("❌ Cannot open replay file %s: %s", path, strerror(errno));
+        return nullptr;
+    }
+
+    struct stat st;
+    size_t frame_bytes = (size_t)width * height * 4;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < frame_bytes) {
+        ALOGE("❌ Replay file %s holds no complete %dx%d RGBA frame", path, width, height);
+        close(fd);
+        return nullptr;
+    }
+    if ((size_t)st.st_size % frame_bytes != 0) {
+        ALOGW("⚠️ Replay file %s has a truncated last frame, ignored", path);
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ALOGE("❌ mmap %s failed: %s", path, strerror(errno));
+        return nullptr;
+    }
+
+    RkReplaySource* r = new (std::nothrow) RkReplaySource();
+    RkFrameSource* src = new (std::nothrow) RkFrameSource();
+    if (!allocator) allocator = rk_dmabuf_default_allocator();
+    RkDmaBufPool* pool = (r && src) ? rk_dmabuf_pool_create(allocator, frame_bytes * 3) : nullptr;
+    if (!pool) {
+        munmap(data, st.st_size);
+        delete r;
+        delete src;
+        return nullptr;
+    }
+
+    r->width = width;
+    r->height = height;
+    r->data = (const uint8_t*)data;
+    r->data_size = st.st_size;
+    r->frame_count = (int)(st.st_size / frame_bytes);
+    r->frame = 0;
+    r->pool = pool;
+
+    src->name = "replay";
+    src->priv = r;
+    src->get_displays = replay_get_displays;
+    src->get_display_size = replay_get_display_size;
+    src->capture = replay_capture;
+    src->destroy = replay_destroy;
+
+    ALOGI("✅ Replay source: %s, %d frames of %dx%d (%s)",
+          path, r->frame_count, width, height, allocator->name);
+    return src;
+}
+
+// ============================================
+// 来源选择
+// ============================================
+
+static bool parse_size(const char* str, int* width, int* height) {
+    return sscanf(str, "%dx%d", width, height) == 2 && *width > 0 && *height > 0;
+}
+
+RkFrameSource* rk_frame_source_create_from_spec(const char* spec) {
+    if (!spec || !*spec || strcmp(spec, "sf") == 0) {
+        return rk_frame_source_create_sf();
+    }
+
+    if (strncmp(spec, "synthetic", 9) == 0 && (spec[9] == '\0' || spec[9] == ':')) {
+        RkSyntheticSourceConfig cfg = {};
+        cfg.width = RK_SYNTHETIC_DEFAULT_WIDTH;
+        cfg.height = RK_SYNTHETIC_DEFAULT_HEIGHT;
+        cfg.change_interval = 1;
+        if (spec[9] == ':') {
+            const char* size = spec + 10;
+            if (!parse_size(size, &cfg.width, &cfg.height)) {
+                ALOGE("❌ Invalid synthetic size in '%s'", spec);
+                return nullptr;
+            }
+            const char* interval = strchr(size, ':');
+            if (interval) cfg.change_interval = atoi(interval + 1);
+        }
+        return rk_frame_source_create_synthetic(&cfg);
+    }
+
+    if (strncmp(spec, "replay:", 7) == 0) {
+        // 路径中可能含 ':'，尺寸取最后一段
+        const char* size = strrchr(spec + 7, ':');
+        int width = 0, height = 0;
+        if (!size || !parse_size(size + 1, &width, &height)) {
+            ALOGE("❌ Replay source needs 'replay:FILE:WxH', got '%s'", spec);
+            return nullptr;
+        }
+        std::string path(spec + 7, size - (spec + 7));
+        return rk_frame_source_create_replay(path.c_str(), width, height, nullptr);
+    }
+
+    ALOGE("❌ Unknown frame source '%s'", spec);
+    return nullptr;
+}
+
+void rk_frame_source_destroy(RkFrameSource* src) {
+    if (src && src->destroy) {
+        src->destroy(src);
+    }
+}
@@ -0,0 +1,298 @@
+/**
+ * RK3588 Import Cache
+ *
+ * 按 buffer 唯一 ID 缓存 DMA-BUF 导入结果（RGA 句柄 + MppBuffer）
+ * SurfaceFlinger 在少量 GraphicBuffer 间轮转，命中后无需重复 import
+ */
+
+#include "rk_internal.h"
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_IMPORT"
+
+// RkDmaBuffer 必须是第一个成员：借出的指针可直接转换回条目
+struct RkImportEntry {
+    RkDmaBuffer buf;
+    uint64_t id;
+    void* owner;
+    int refs;
+    uint64_t last_use;
+    bool stale;             // 已被清除，最后一次归还时销毁
+};
+
+struct RkImportCache {
+    RkImportOps ops;
+    int capacity;
+    pthread_mutex_t lock;
+    std::vector<RkImportEntry*> entries;
+    uint64_t clock;
+    int stale_leased;       // 已移出列表但仍借出的条目
+    bool closing;
+    RkImportCacheStats stats;
+};
+
+static void entry_destroy(RkImportCache* cache, RkImportEntry* entry) {
+    RkDmaBuffer* buf = &entry->buf;
+
+    if (buf->rga_handle && cache->ops.release_rga) {
+        cache->ops.release_rga(cache->ops.user, buf->rga_handle);
+    }
+    if (buf->mpp_buf && cache->ops.release_mpp) {
+        cache->ops.release_mpp(cache->ops.user, buf->mpp_buf);
+    }
+    rk_dmabuf_unmap(buf);
+    if (buf->fd >= 0) {
+        close(buf->fd);
+    }
+    if (entry->owner && cache->ops.release_owner) {
+        cache->ops.release_owner(cache->ops.user, entry->owner);
+    }
+
+    ALOGD("Import entry %llu dropped", (unsigned long long)entry->id);
+    delete entry;
+}
+
+static RkImportEntry* entry_create(RkImportCache* cache, const RkImportDesc* desc) {
+    int fd = dup(desc->fd);
+    if (fd < 0) {
+        ALOGE("❌ dup failed: %s", strerror(errno));
+        return nullptr;
+    }
+
+    RkImportEntry* entry = new (std::nothrow) RkImportEntry();
+    if (!entry) {
+        close(fd);
+        return nullptr;
+    }
+
+    RkDmaBuffer* buf = &entry->buf;
+    buf->fd = fd;
+    buf->size = desc->size;
+    buf->width = desc->width;
+    buf->height = desc->height;
+    buf->stride = desc->stride;
+    buf->height_stride = desc->height_stride;
+    buf->format = desc->format;
+    buf->import_cache = cache;
+    entry->id = desc->id;
+    entry->owner = desc->owner;
+
+    // 导入失败不致命：句柄为空时使用方按 fd 访问
+    if (cache->ops.import_rga &&
+        cache->ops.import_rga(cache->ops.user, buf, &buf->rga_handle) != 0) {
+        ALOGW("⚠️ RGA import failed for buffer %llu", (unsigned long long)desc->id);
+        buf->rga_handle = 0;
+    }
+    if (cache->ops.import_mpp &&
+        cache->ops.import_mpp(cache->ops.user, buf, &buf->mpp_buf) != 0) {
+        ALOGW("⚠️ MPP import failed for buffer %llu", (unsigned long long)desc->id);
+        buf->mpp_buf = nullptr;
+    }
+
+    ALOGD("Import entry %llu: fd=%d, %dx%d, rga=%llu, mpp=%p",
+          (unsigned long long)desc->id, fd, desc->width, desc->height,
+          (unsigned long long)buf->rga_handle, buf->mpp_buf);
+    return entry;
+}
+
+// 淘汰最久未使用且未借出的条目，调用者持有 cache->lock
+static void evict_locked(RkImportCache* cache, std::vector<RkImportEntry*>* victims) {
+    while ((int)cache->entries.size() > cache->capacity) {
+        int lru = -1;
+        for (size_t i = 0; i < cache->entries.size(); i++) {
+            RkImportEntry* e = cache->entries[i];
+            if (e->refs == 0 && (lru < 0 || e->last_use < cache->entries[lru]->last_use)) {
+                lru = (int)i;
+            }
+        }
+        if (lru < 0) break;  // 全部借出，暂时超出容量
+
+        victims->push_back(cache->entries[lru]);
+        cache->entries.erase(cache->entries.begin() + lru);
+        cache->stats.evictions++;
+    }
+    cache->stats.entries = (int)cache->entries.size();
+}
+
+static void cache_free(RkImportCache* cache) {
+    pthread_mutex_destroy(&cache->lock);
+    delete cache;
+}
+
+RkImportCache* rk_import_cache_create(const RkImportOps* ops, int capacity) {
+    if (!ops || capacity <= 0) return nullptr;
+
+    RkImportCache* cache = new (std::nothrow) RkImportCache();
+    if (!cache) return nullptr;
+
+    cache->ops = *ops;
+    cache->capacity = capacity;
+    cache->clock = 0;
+    cache->stale_leased = 0;
+    cache->closing = false;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void rk_import_cache_destroy(RkImportCache* cache) {
+    if (!cache) return;
+
+    ALOGI("Import cache: %lu hits, %lu misses, %lu evictions",
+          cache->stats.hits, cache->stats.misses, cache->stats.evictions);
+
+    rk_import_cache_clear(cache);
+
+    pthread_mutex_lock(&cache->lock);
+    bool leased = !cache->entries.empty() || cache->stale_leased > 0;
+    if (leased) {
+        // 最后一个条目归还时再释放
+        ALOGW("⚠️ Import cache destroyed with %zu leased buffers", cache->entries.size());
+        cache->closing = true;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (!leased) cache_free(cache);
+}
+
+RkScreenshotError rk_import_cache_acquire(RkImportCache* cache, const RkImportDesc* desc,
+                                          RkDmaBuffer** out) {
+    if (!cache || !desc || !out || desc->fd < 0) return RKSS_ERROR_INVALID_PARAM;
+
+    pthread_mutex_lock(&cache->lock);
+    if (cache->closing) {   // destroy 在锁内置位
+        pthread_mutex_unlock(&cache->lock);
+        if (desc->owner && cache->ops.release_owner) {
+            cache->ops.release_owner(cache->ops.user, desc->owner);
+        }
+        return RKSS_ERROR_NOT_INITIALIZED;
+    }
+    for (RkImportEntry* e : cache->entries) {
+        // 同一 ID 但几何不同（buffer 被重新分配）视为未命中
+        if (e->id == desc->id && e->buf.width == desc->width &&
+            e->buf.height == desc->height && e->buf.stride == desc->stride &&
+            e->buf.format == desc->format) {
+            e->refs++;
+            e->last_use = ++cache->clock;
+            cache->stats.hits++;
+            pthread_mutex_unlock(&cache->lock);
+
+            // 条目已持有所有者引用，本次传入的引用直接释放
+            if (desc->owner && cache->ops.release_owner) {
+                cache->ops.release_owner(cache->ops.user, desc->owner);
+            }
+            *out = &e->buf;
+            return RKSS_SUCCESS;
+        }
+    }
+    cache->stats.misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    // 导入不持锁（ioctl 可能较慢）
+    RkImportEntry* entry = entry_create(cache, desc);
+    if (!entry) {
+        if (desc->owner && cache->ops.release_owner) {
+            cache->ops.release_owner(cache->ops.user, desc->owner);
+        }
+        return RKSS_ERROR_NO_MEMORY;
+    }
+
+    std::vector<RkImportEntry*> victims;
+    pthread_mutex_lock(&cache->lock);
+    // 同 ID 旧条目已失效（几何变化），不再复用
+    for (size_t i = 0; i < cache->entries.size(); i++) {
+        RkImportEntry* e = cache->entries[i];
+        if (e->id == desc->id) {
+            cache->entries.erase(cache->entries.begin() + i);
+            if (e->refs == 0) {
+                victims.push_back(e);
+            } else {
+                e->stale = true;
+                cache->stale_leased++;
+            }
+            break;
+        }
+    }
+    entry->refs = 1;
+    entry->last_use = ++cache->clock;
+    cache->entries.push_back(entry);
+    evict_locked(cache, &victims);
+    pthread_mutex_unlock(&cache->lock);
+
+    for (RkImportEntry* e : victims) {
+        entry_destroy(cache, e);
+    }
+
+    *out = &entry->buf;
+    return RKSS_SUCCESS;
+}
+
+void rk_import_cache_release(RkImportCache* cache, RkDmaBuffer* buf) {
+    if (!cache || !buf) return;
+
+    RkImportEntry* entry = (RkImportEntry*)buf;
+    std::vector<RkImportEntry*> victims;
+    bool last = false;
+
+    pthread_mutex_lock(&cache->lock);
+    entry->refs--;
+    if (entry->refs == 0) {
+        if (entry->stale) {
+            victims.push_back(entry);
+            cache->stale_leased--;
+        } else {
+            evict_locked(cache, &victims);
+        }
+    }
+    if (cache->closing && entry->refs == 0) {
+        for (size_t i = 0; i < cache->entries.size(); i++) {
+            if (cache->entries[i] == entry) {
+                cache->entries.erase(cache->entries.begin() + i);
+                victims.push_back(entry);
+                break;
+            }
+        }
+        last = cache->entries.empty() && cache->stale_leased == 0;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    for (RkImportEntry* e : victims) {
+        entry_destroy(cache, e);
+    }
+    if (last) cache_free(cache);
+}
+
+void rk_import_cache_clear(RkImportCache* cache) {
+    if (!cache) return;
+
+    std::vector<RkImportEntry*> victims;
+    pthread_mutex_lock(&cache->lock);
+    for (size_t i = 0; i < cache->entries.size();) {
+        RkImportEntry* e = cache->entries[i];
+        if (e->refs == 0) {
+            victims.push_back(e);
+            cache->entries.erase(cache->entries.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    cache->stats.entries = (int)cache->entries.size();
+    pthread_mutex_unlock(&cache->lock);
+
+    for (RkImportEntry* e : victims) {
+        entry_destroy(cache, e);
+    }
+}
+
+void rk_import_cache_get_stats(RkImportCache* cache, RkImportCacheStats* stats) {
+    if (!cache || !stats) return;
+
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
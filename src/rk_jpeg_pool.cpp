@@ -0,0 +1,248 @@
+/**
+ * RK3588 JPEG Encoder Pool - 多个编码上下文并发编码
+ *
+ * 每个上下文独立缓存编码配置与输出 buffer（MPP 上下文各自的 buffer group），
+ * 并发截图线程借用空闲上下文，MPP 按上下文分派到不同的 JPEG 编码核心
+ * CPU 替身用软件编码并补足硬件延迟，主机上可测试池的分派与争用
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_JPEG_Pool"
+
+// ============================================
+// MPP 上下文
+// ============================================
+
+static RkScreenshotError mpp_encode(RkJpegEncoder* enc, RkDmaBuffer* src, int y, int height,
+                                    int quality, RkMppPacket* out) {
+    return rk_mpp_encode_jpeg_rows((RkMppEncoder*)enc->priv, src, y, height, out, quality);
+}
+
+static void mpp_destroy_encoder(RkJpegEncoder* enc) {
+    rk_mpp_deinit((RkMppEncoder*)enc->priv);
+    free(enc->priv);
+    free(enc);
+}
+
+RkJpegEncoder* rk_jpeg_encoder_create_mpp() {
+    RkJpegEncoder* enc = (RkJpegEncoder*)calloc(1, sizeof(RkJpegEncoder));
+    RkMppEncoder* mpp = (RkMppEncoder*)calloc(1, sizeof(RkMppEncoder));
+    if (!enc || !mpp || rk_mpp_init(mpp) != RKSS_SUCCESS) {
+        free(enc);
+        free(mpp);
+        return nullptr;
+    }
+    enc->name = "mpp";
+    enc->priv = mpp;
+    enc->encode = mpp_encode;
+    enc->destroy = mpp_destroy_encoder;
+    return enc;
+}
+
+// ============================================
+// CPU 替身
+// ============================================
+
+typedef struct {
+    int latency_us;
+} SwEncoder;
+
+static void sw_packet_release(void* buffer) {
+    free(buffer);
+}
+
+static RkScreenshotError sw_encode(RkJpegEncoder* enc, RkDmaBuffer* src, int y, int height,
+                                   int quality, RkMppPacket* out) {
+    SwEncoder* sw = (SwEncoder*)enc->priv;
+    uint64_t t0 = rk_get_time_us();
+
+    memset(out, 0, sizeof(*out));
+    RkScreenshotError err = rk_jpeg_sw_encode_rows(src, y, height, quality, &out->data,
+                                                   &out->size);
+    if (err != RKSS_SUCCESS) return err;
+    out->buffer = out->data;
+    out->release = sw_packet_release;
+
+    uint64_t elapsed = rk_get_time_us() - t0;
+    if (sw->latency_us > 0 && elapsed < (uint64_t)sw->latency_us) {
+        usleep(sw->latency_us - elapsed);
+    }
+    return RKSS_SUCCESS;
+}
+
+static void sw_destroy(RkJpegEncoder* enc) {
+    free(enc->priv);
+    free(enc);
+}
+
+RkJpegEncoder* rk_jpeg_encoder_create_sw(int latency_us) {
+    RkJpegEncoder* enc = (RkJpegEncoder*)calloc(1, sizeof(RkJpegEncoder));
+    SwEncoder* sw = (SwEncoder*)calloc(1, sizeof(SwEncoder));
+    if (!enc || !sw) {
+        free(enc);
+        free(sw);
+        return nullptr;
+    }
+    sw->latency_us = latency_us;
+    enc->name = "sw";
+    enc->priv = sw;
+    enc->encode = sw_encode;
+    enc->destroy = sw_destroy;
+    return enc;
+}
+
+void rk_jpeg_encoder_destroy(RkJpegEncoder* enc) {
+    if (enc) enc->destroy(enc);
+}
+
+// ============================================
+// 池
+// ============================================
+
+typedef struct {
+    RkJpegEncoder* enc;
+    bool busy;
+    bool has_params;
+    RkMppEncParams params;      // 上一帧的配置，用于亲和选择
+    RkJpegEncoderStats stats;
+} PoolSlot;
+
+struct RkJpegPool {
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    PoolSlot slots[RK_JPEG_POOL_MAX];
+    int count;
+    uint64_t created_us;
+    RkJpegPoolStats stats;
+};
+
+RkJpegPool* rk_jpeg_pool_create(RkJpegEncoder* const* encoders, int count) {
+    if (!encoders || count <= 0 || count > RK_JPEG_POOL_MAX) return nullptr;
+    RkJpegPool* pool = (RkJpegPool*)calloc(1, sizeof(RkJpegPool));
+    if (!pool) return nullptr;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    for (int i = 0; i < count; i++) {
+        pool->slots[i].enc = encoders[i];
+        pool->slots[i].stats.name = encoders[i]->name;
+    }
+    pool->count = count;
+    pool->created_us = rk_get_time_us();
+    return pool;
+}
+
+void rk_jpeg_pool_destroy(RkJpegPool* pool) {
+    if (!pool) return;
+
+    RkJpegPoolStats stats;
+    RkJpegEncoderStats enc_stats[RK_JPEG_POOL_MAX];
+    rk_jpeg_pool_get_stats(pool, enc_stats, &stats);
+    if (stats.encodes > 0) {
+        ALOGI("JPEG pool: %lu encodes, %lu waits (%.2f ms)", stats.encodes, stats.waits,
+              stats.wait_us / 1000.0);
+        for (int i = 0; i < pool->count; i++) {
+            ALOGI("   %s#%d: %lu frames, %lu config hits, %.1f%% busy", enc_stats[i].name, i,
+                  enc_stats[i].frames, enc_stats[i].affinity_hits,
+                  stats.elapsed_us ? enc_stats[i].busy_us * 100.0 / stats.elapsed_us : 0.0);
+        }
+    }
+
+    // 调用者保证没有进行中的编码
+    for (int i = 0; i < pool->count; i++) {
+        rk_jpeg_encoder_destroy(pool->slots[i].enc);
+    }
+    pthread_cond_destroy(&pool->idle);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+int rk_jpeg_pool_size(const RkJpegPool* pool) {
+    return pool ? pool->count : 0;
+}
+
+// 空闲上下文中：配置相同的优先，其次累计占用最少的；全忙返回 -1。调用者持有 pool->lock
+static int pick_slot_locked(RkJpegPool* pool, const RkMppEncParams* params) {
+    int best = -1;
+    for (int i = 0; i < pool->count; i++) {
+        PoolSlot* slot = &pool->slots[i];
+        if (slot->busy) continue;
+        if (params && slot->has_params && memcmp(&slot->params, params, sizeof(*params)) == 0) {
+            return i;
+        }
+        if (best < 0 || slot->stats.busy_us < pool->slots[best].stats.busy_us) best = i;
+    }
+    return best;
+}
+
+RkScreenshotError rk_jpeg_pool_encode(RkJpegPool* pool, RkDmaBuffer* src, int quality,
+                                      RkMppPacket* out) {
+    if (!src) return RKSS_ERROR_INVALID_PARAM;
+    return rk_jpeg_pool_encode_rows(pool, src, 0, src->height, quality, out);
+}
+
+RkScreenshotError rk_jpeg_pool_encode_rows(RkJpegPool* pool, RkDmaBuffer* src, int y, int height,
+                                           int quality, RkMppPacket* out) {
+    if (!pool) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!src || !out) return RKSS_ERROR_INVALID_PARAM;
+
+    // 不支持的格式由编码器报错，这里只是不参与亲和选择；条带按区域高度区分配置
+    RkMppEncParams params;
+    bool has_params = rk_mpp_enc_params(src, quality, &params) == RKSS_SUCCESS;
+    params.height = height;
+
+    pthread_mutex_lock(&pool->lock);
+    int index = pick_slot_locked(pool, has_params ? &params : nullptr);
+    if (index < 0) {
+        uint64_t t_wait = rk_get_time_us();
+        pool->stats.waits++;
+        while ((index = pick_slot_locked(pool, has_params ? &params : nullptr)) < 0) {
+            pthread_cond_wait(&pool->idle, &pool->lock);
+        }
+        pool->stats.wait_us += rk_get_time_us() - t_wait;
+    }
+    PoolSlot* slot = &pool->slots[index];
+    slot->busy = true;
+    if (has_params && slot->has_params &&
+        memcmp(&slot->params, &params, sizeof(params)) == 0) {
+        slot->stats.affinity_hits++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    uint64_t t0 = rk_get_time_us();
+    RkScreenshotError err = slot->enc->encode(slot->enc, src, y, height, quality, out);
+    uint64_t busy = rk_get_time_us() - t0;
+
+    pthread_mutex_lock(&pool->lock);
+    slot->busy = false;
+    slot->has_params = has_params && err == RKSS_SUCCESS;
+    if (slot->has_params) slot->params = params;
+    slot->stats.busy_us += busy;
+    if (err == RKSS_SUCCESS) {
+        slot->stats.frames++;
+    } else {
+        slot->stats.failures++;
+    }
+    pool->stats.encodes++;
+    pthread_cond_signal(&pool->idle);
+    pthread_mutex_unlock(&pool->lock);
+    return err;
+}
+
+void rk_jpeg_pool_get_stats(RkJpegPool* pool, RkJpegEncoderStats* encoders,
+                            RkJpegPoolStats* stats) {
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; encoders && i < pool->count; i++) {
+        encoders[i] = pool->slots[i].stats;
+    }
+    if (stats) {
+        *stats = pool->stats;
+        stats->elapsed_us = rk_get_time_us() - pool->created_us;
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,177 @@
+/**
+ * RK3588 JPEG Rate Model - 目标大小模式的质量选择
+ *
+ * MPP 只有 10 档 jpeg:quant，质量按档选择；每个分辨率维护一条大小曲线：
+ * 先验曲线给出各档的相对大小，内容系数跟踪画面复杂度（随每帧变化），
+ * 档位修正跟踪该分辨率下曲线形状与先验的偏差
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_JPEG_Rate"
+
+// 先验：桌面内容各档的字节/像素（Q90 约 0.2，与 RkMppPacketSizer 的经验一致）
+static const double k_prior_bpp[RK_JPEG_RATE_LEVELS] = {
+    0.036, 0.054, 0.068, 0.080, 0.090, 0.102, 0.120, 0.150, 0.200, 0.520,
+};
+
+// 预估留 10% 余量，换取更高的首次命中率
+#define RK_JPEG_RATE_MARGIN    1.10
+// 内容系数跟得快（画面切换），档位修正跟得慢（曲线形状稳定）
+#define RK_JPEG_RATE_ALPHA_SCALE 0.5
+#define RK_JPEG_RATE_ALPHA_ADJ   0.3
+
+static int quality_level(int quality) {
+    // 与 rk_mpp_enc_params 的 quant 量化一致
+    int quant = (quality * 10 + 50) / 100;
+    if (quant < 1) quant = 1;
+    if (quant > RK_JPEG_RATE_LEVELS) quant = RK_JPEG_RATE_LEVELS;
+    return quant - 1;
+}
+
+static inline int level_quality(int level) {
+    return (level + 1) * 10;
+}
+
+// 调用者持有 model->lock
+static RkJpegRateEntry* find_entry(RkJpegRateModel* model, int width, int height) {
+    for (int i = 0; i < RK_JPEG_RATE_ENTRIES; i++) {
+        RkJpegRateEntry* e = &model->entries[i];
+        if (e->samples > 0 && e->width == width && e->height == height) return e;
+    }
+    return nullptr;
+}
+
+// 调用者持有 model->lock；没有时替换最久未用的条目
+static RkJpegRateEntry* get_entry(RkJpegRateModel* model, int width, int height) {
+    RkJpegRateEntry* e = find_entry(model, width, height);
+    if (e) return e;
+    e = &model->entries[0];
+    for (int i = 1; i < RK_JPEG_RATE_ENTRIES; i++) {
+        if (model->entries[i].last_used < e->last_used) e = &model->entries[i];
+    }
+    memset(e, 0, sizeof(*e));
+    e->width = width;
+    e->height = height;
+    e->scale = 1.0;
+    for (int i = 0; i < RK_JPEG_RATE_LEVELS; i++) e->level_adj[i] = 1.0;
+    return e;
+}
+
+void rk_jpeg_rate_init(RkJpegRateModel* model) {
+    if (!model) return;
+    memset(model, 0, sizeof(*model));
+    pthread_mutex_init(&model->lock, NULL);
+}
+
+void rk_jpeg_rate_deinit(RkJpegRateModel* model) {
+    if (!model) return;
+    const RkJpegRateStats* s = &model->stats;
+    if (s->frames > 0) {
+        ALOGI("JPEG target size: %lu frames, %.1f%% first-pass hits, %lu re-encodes, "
+              "%lu misses, %.1f%% avg budget used",
+              s->frames, 100.0 * s->first_hits / s->frames, s->reencodes, s->misses,
+              100.0 * s->fill_sum / s->frames);
+    }
+    pthread_mutex_destroy(&model->lock);
+}
+
+int rk_jpeg_rate_pick(RkJpegRateModel* model, int width, int height, size_t max_bytes,
+                      int max_quality) {
+    if (max_quality <= 0 || max_quality > 100) max_quality = 100;
+    int top = quality_level(max_quality);
+    double pixels = (double)width * height;
+
+    pthread_mutex_lock(&model->lock);
+    const RkJpegRateEntry* e = find_entry(model, width, height);
+    double scale = e ? e->scale : 1.0;
+    int level = 0;
+    for (int i = top; i > 0; i--) {
+        double adj = e ? e->level_adj[i] : 1.0;
+        if (pixels * k_prior_bpp[i] * scale * adj * RK_JPEG_RATE_MARGIN <= max_bytes) {
+            level = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&model->lock);
+    // 最高档按调用者的 quality 取（同一 quant，软件编码器下不超过要求）
+    return level == top ? max_quality : level_quality(level);
+}
+
+void rk_jpeg_rate_update(RkJpegRateModel* model, int width, int height, int quality,
+                         size_t bytes) {
+    int level = quality_level(quality);
+    double pixels = (double)width * height;
+    if (pixels <= 0 || bytes == 0) return;
+    double ratio = bytes / (pixels * k_prior_bpp[level]);
+
+    pthread_mutex_lock(&model->lock);
+    RkJpegRateEntry* e = get_entry(model, width, height);
+    double* adj = &e->level_adj[level];
+    if (e->samples == 0) {
+        e->scale = ratio / *adj;
+    } else {
+        e->scale += RK_JPEG_RATE_ALPHA_SCALE * (ratio / *adj - e->scale);
+        *adj += RK_JPEG_RATE_ALPHA_ADJ * (ratio / e->scale - *adj);
+        if (*adj < 0.25) *adj = 0.25;
+        if (*adj > 4.0) *adj = 4.0;
+    }
+    e->samples++;
+    e->last_used = ++model->clock;
+    pthread_mutex_unlock(&model->lock);
+}
+
+RkScreenshotError rk_jpeg_encode_target(RkJpegRateModel* model, int width, int height,
+                                        size_t max_bytes, int max_quality, RkJpegEncodeFn encode,
+                                        void* user, RkMppPacket* out, int* quality) {
+    if (!model || !encode || !out || max_bytes == 0) return RKSS_ERROR_INVALID_PARAM;
+
+    int q = rk_jpeg_rate_pick(model, width, height, max_bytes, max_quality);
+    RkScreenshotError err = encode(user, q, out);
+    if (err != RKSS_SUCCESS) return err;
+    rk_jpeg_rate_update(model, width, height, q, out->size);
+
+    bool first_hit = out->size <= max_bytes;
+    bool reencoded = false;
+    int level = quality_level(q);
+    if (!first_hit && level > 0) {
+        // 模型已按本次结果修正；重选的档位至少低一档（按档比较，q - 10 可能仍在同一档）
+        int q2 = rk_jpeg_rate_pick(model, width, height, max_bytes, max_quality);
+        if (quality_level(q2) >= level) q2 = level_quality(level - 1);
+        RkMppPacket second;
+        if (encode(user, q2, &second) == RKSS_SUCCESS) {
+            rk_jpeg_rate_update(model, width, height, q2, second.size);
+            reencoded = true;
+            ALOGD("JPEG %dx%d: Q%d %zu bytes over budget %zu, Q%d -> %zu bytes", width, height,
+                  q, out->size, max_bytes, q2, second.size);
+            if (second.size <= out->size) {
+                out->release(out->buffer);
+                *out = second;
+                q = q2;
+            } else {
+                second.release(second.buffer);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&model->lock);
+    RkJpegRateStats* s = &model->stats;
+    s->frames++;
+    if (first_hit) s->first_hits++;
+    if (reencoded) s->reencodes++;
+    if (out->size > max_bytes) s->misses++;
+    s->fill_sum += (double)out->size / max_bytes;
+    pthread_mutex_unlock(&model->lock);
+
+    if (quality) *quality = q;
+    return RKSS_SUCCESS;
+}
+
+void rk_jpeg_rate_get_stats(RkJpegRateModel* model, RkJpegRateStats* stats) {
+    if (!model || !stats) return;
+    pthread_mutex_lock(&model->lock);
+    *stats = model->stats;
+    pthread_mutex_unlock(&model->lock);
+}
@@ -0,0 +1,252 @@
+/**
+ * RK3588 JPEG Strip Encoding - 大帧按水平条带并行编码
+ *
+ * 帧按 MCU 行切成等高条带（最后一条可更矮），各条带由不同编码上下文独立编码为完整 JPEG，
+ * 再拼成一个基线 JPEG：沿用第一条的表，SOF 改为整帧高度，DRI 设为一个条带的 MCU 数，
+ * 条带之间插入 RST0..RST7。条带各自从 DC 预测 0 开始、以 1 补齐到字节边界，
+ * 正好是 restart interval 的语义，熵编码数据无需改写
+ *
+ * 代价：每个条带边界一个 RST 与补齐字节，外加 DC 预测重置
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+#include <cstdlib>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_JPEG_Strip"
+
+// 条带高度对齐：4:2:0 的 MCU 高度
+#define RK_JPEG_STRIP_ALIGN 16
+// 自动模式下使用条带的最小像素数（1440p）
+#define RK_JPEG_STRIP_AUTO_PIXELS (2560 * 1440)
+
+// 一个条带 JPEG 的结构
+typedef struct {
+    size_t sof;                 // SOF0 段起点（0xFF 处）
+    size_t sos;                 // SOS 段起点
+    size_t data;                // 熵编码数据起点
+    size_t data_end;            // EOI 起点
+    int width;
+    int height;
+    int mcu_width;
+    int mcu_height;
+} StripLayout;
+
+static RkScreenshotError parse_strip(const uint8_t* p, size_t size, StripLayout* layout) {
+    memset(layout, 0, sizeof(*layout));
+    if (size < 4 || p[0] != 0xff || p[1] != 0xd8) return RKSS_ERROR_ENCODE_FAILED;
+
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (p[pos] != 0xff) return RKSS_ERROR_ENCODE_FAILED;
+        uint8_t marker = p[pos + 1];
+        size_t len = (size_t)p[pos + 2] << 8 | p[pos + 3];
+        if (len < 2 || pos + 2 + len > size) return RKSS_ERROR_ENCODE_FAILED;
+        const uint8_t* seg = p + pos + 4;
+
+        if (marker == 0xc0) {
+            // 基线 8 位，Y/Cb/Cr 三分量
+            if (len < 17 || seg[0] != 8 || seg[5] != 3) return RKSS_ERROR_UNSUPPORTED;
+            layout->sof = pos;
+            layout->height = seg[1] << 8 | seg[2];
+            layout->width = seg[3] << 8 | seg[4];
+            int hmax = 1, vmax = 1;
+            for (int c = 0; c < 3; c++) {
+                int h = seg[7 + c * 3] >> 4, v = seg[7 + c * 3] & 15;
+                if (h > hmax) hmax = h;
+                if (v > vmax) vmax = v;
+            }
+            layout->mcu_width = 8 * hmax;
+            layout->mcu_height = 8 * vmax;
+        } else if ((marker >= 0xc1 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 &&
+                    marker != 0xcc) || marker == 0xdd) {
+            // 非基线 / 已带 restart interval 的条带无法直接拼接
+            return RKSS_ERROR_UNSUPPORTED;
+        } else if (marker == 0xda) {
+            layout->sos = pos;
+            layout->data = pos + 2 + len;
+            break;
+        }
+        pos += 2 + len;
+    }
+    if (!layout->sof || !layout->data) return RKSS_ERROR_ENCODE_FAILED;
+
+    // 编码器可能在 EOI 之后补零
+    size_t end = size;
+    while (end >= layout->data + 2 && !(p[end - 2] == 0xff && p[end - 1] == 0xd9)) end--;
+    if (end < layout->data + 2) return RKSS_ERROR_ENCODE_FAILED;
+    layout->data_end = end - 2;
+    return RKSS_SUCCESS;
+}
+
+// 除 SOF 外的头部（表、SOS）须完全相同
+static bool same_tables(const uint8_t* a, const StripLayout* la, const uint8_t* b,
+                        const StripLayout* lb) {
+    size_t a_sof_end = la->sof + 2 + ((size_t)a[la->sof + 2] << 8 | a[la->sof + 3]);
+    size_t b_sof_end = lb->sof + 2 + ((size_t)b[lb->sof + 2] << 8 | b[lb->sof + 3]);
+    if (la->sof != lb->sof || la->data - a_sof_end != lb->data - b_sof_end) return false;
+    if (memcmp(a, b, la->sof) != 0) return false;
+    // SOF 中分量与采样/量化表选择（高宽之后）也须一致
+    if (a_sof_end - la->sof != b_sof_end - lb->sof ||
+        memcmp(a + la->sof + 9, b + lb->sof + 9, a_sof_end - la->sof - 9) != 0) {
+        return false;
+    }
+    return memcmp(a + a_sof_end, b + b_sof_end, la->data - a_sof_end) == 0;
+}
+
+RkScreenshotError rk_jpeg_stitch_strips(const RkMppPacket* strips, int count, int width,
+                                        int height, uint8_t** out, size_t* size) {
+    if (!strips || count < 1 || count > RK_JPEG_STRIPS_MAX || !out || !size) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+
+    StripLayout layouts[RK_JPEG_STRIPS_MAX];
+    int total_height = 0;
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        RkScreenshotError err = parse_strip(strips[i].data, strips[i].size, &layouts[i]);
+        if (err != RKSS_SUCCESS) return err;
+        const StripLayout* l = &layouts[i];
+        if (l->width != width) return RKSS_ERROR_ENCODE_FAILED;
+        if (i > 0 && !same_tables(strips[0].data, &layouts[0], strips[i].data, l)) {
+            ALOGE("❌ Strip %d tables differ from strip 0", i);
+            return RKSS_ERROR_ENCODE_FAILED;
+        }
+        // 除最后一条外等高，且为整数个 MCU 行
+        if (i < count - 1 && (l->height != layouts[0].height || l->height % l->mcu_height)) {
+            return RKSS_ERROR_INVALID_PARAM;
+        }
+        total_height += l->height;
+        total += l->data_end - l->data + 2;
+    }
+    if (total_height != height) return RKSS_ERROR_INVALID_PARAM;
+
+    const StripLayout* first = &layouts[0];
+    int mcus_per_row = (width + first->mcu_width - 1) / first->mcu_width;
+    int interval = mcus_per_row * (first->height / first->mcu_height);
+    if (count > 1 && interval > 65535) return RKSS_ERROR_UNSUPPORTED;
+
+    size_t header = first->data;
+    total += header + 6 + 2;
+    uint8_t* buf = (uint8_t*)malloc(total);
+    if (!buf) return RKSS_ERROR_NO_MEMORY;
+
+    // 头部：SOS 之前插入 DRI，SOF 高度改为整帧
+    const uint8_t* p0 = strips[0].data;
+    size_t pos = 0;
+    memcpy(buf, p0, first->sos);
+    pos = first->sos;
+    buf[first->sof + 5] = (uint8_t)(height >> 8);
+    buf[first->sof + 6] = (uint8_t)height;
+    if (count > 1) {
+        const uint8_t dri[6] = {0xff, 0xdd, 0, 4, (uint8_t)(interval >> 8), (uint8_t)interval};
+        memcpy(buf + pos, dri, sizeof(dri));
+        pos += sizeof(dri);
+    }
+    memcpy(buf + pos, p0 + first->sos, first->data - first->sos);
+    pos += first->data - first->sos;
+
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            buf[pos++] = 0xff;
+            buf[pos++] = (uint8_t)(0xd0 + (i - 1) % 8);
+        }
+        size_t len = layouts[i].data_end - layouts[i].data;
+        memcpy(buf + pos, strips[i].data + layouts[i].data, len);
+        pos += len;
+    }
+    buf[pos++] = 0xff;
+    buf[pos++] = 0xd9;
+
+    *out = buf;
+    *size = pos;
+    return RKSS_SUCCESS;
+}
+
+int rk_jpeg_strip_rows(int height, int strips) {
+    if (strips < 2 || height <= 0) return height;
+    int rows = (height + strips - 1) / strips;
+    rows = (rows + RK_JPEG_STRIP_ALIGN - 1) / RK_JPEG_STRIP_ALIGN * RK_JPEG_STRIP_ALIGN;
+    return rows < height ? rows : height;
+}
+
+int rk_jpeg_strip_count(int width, int height, int requested, int contexts) {
+    int strips = requested;
+    if (requested == RK_JPEG_STRIPS_AUTO) {
+        strips = (int64_t)width * height >= RK_JPEG_STRIP_AUTO_PIXELS ? contexts : 1;
+    }
+    if (strips > RK_JPEG_STRIPS_MAX) strips = RK_JPEG_STRIPS_MAX;
+    if (strips < 2) return 1;
+    // 按对齐后的条带高度重新计算（矮图可能切不满）
+    int rows = rk_jpeg_strip_rows(height, strips);
+    return (height + rows - 1) / rows;
+}
+
+typedef struct {
+    RkJpegPool* pool;
+    RkDmaBuffer* src;
+    int quality;
+    int rows;
+    RkMppPacket packets[RK_JPEG_STRIPS_MAX];
+    RkScreenshotError errs[RK_JPEG_STRIPS_MAX];
+} StripJob;
+
+static void strip_task(void* arg, int index) {
+    StripJob* job = (StripJob*)arg;
+    int y = index * job->rows;
+    int h = job->src->height - y < job->rows ? job->src->height - y : job->rows;
+    job->errs[index] = rk_jpeg_pool_encode_rows(job->pool, job->src, y, h, job->quality,
+                                                &job->packets[index]);
+}
+
+static void strip_release(void* buffer) {
+    free(buffer);
+}
+
+RkScreenshotError rk_jpeg_pool_encode_strips(RkJpegPool* pool, RkThreadPool* threads,
+                                             RkDmaBuffer* src, int quality, int strips,
+                                             RkMppPacket* out) {
+    if (!pool) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!src || !out) return RKSS_ERROR_INVALID_PARAM;
+
+    int rows = rk_jpeg_strip_rows(src->height, strips);
+    int count = (src->height + rows - 1) / rows;
+    if (count < 2 || !threads) {
+        return rk_jpeg_pool_encode(pool, src, quality, out);
+    }
+
+    StripJob* job = (StripJob*)calloc(1, sizeof(StripJob));
+    if (!job) return RKSS_ERROR_NO_MEMORY;
+    job->pool = pool;
+    job->src = src;
+    job->quality = quality;
+    job->rows = rows;
+
+    uint64_t t0 = rk_get_time_us();
+    rk_thread_pool_run(threads, count, strip_task, job);
+    uint64_t t_encoded = rk_get_time_us();
+
+    RkScreenshotError err = RKSS_SUCCESS;
+    for (int i = 0; i < count && err == RKSS_SUCCESS; i++) err = job->errs[i];
+    memset(out, 0, sizeof(*out));
+    if (err == RKSS_SUCCESS) {
+        err = rk_jpeg_stitch_strips(job->packets, count, src->width, src->height, &out->data,
+                                    &out->size);
+    }
+    if (err == RKSS_SUCCESS) {
+        out->buffer = out->data;
+        out->release = strip_release;
+        ALOGD("JPEG strips: %d x %d rows, encode %.2f ms + stitch %.2f ms, %zu bytes", count,
+              rows, (t_encoded - t0) / 1000.0, (rk_get_time_us() - t_encoded) / 1000.0,
+              out->size);
+    } else {
+        ALOGE("❌ Strip encode failed: %s", rk_screenshot_error_string(err));
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (job->packets[i].release) job->packets[i].release(job->packets[i].buffer);
+    }
+    free(job);
+    return err;
+}
@@ -0,0 +1,462 @@
+/**
+ * RK3588 Software JPEG Encoder - 基线 JPEG 的 CPU 实现
+ *
+ * YCbCr 4:2:0，IJG 质量缩放的标准量化表，标准 Huffman 表（JPEG 规范附录 K），浮点 AAN DCT
+ * 输入 RGBA8888 / RGBX8888（按 JFIF 全范围 BT.601 转换）或 NV12（样本直接使用）
+ * 用于无 MPP 时的主机测试与编码器池的 CPU 替身，速度远低于硬件
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+#include <cstdlib>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_JPEG_SW"
+
+// 第 k 个 zigzag 系数在 8x8 块中的位置
+static const uint8_t kNaturalOrder[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static const uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// Huffman 表：bits[i] 为长度 i+1 的码字个数
+static const uint8_t kDcLumaBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t kDcChromaBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t kDcVals[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t kAcLumaBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t kAcLumaVals[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61,
+    0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52,
+    0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25,
+    0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64,
+    0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+    0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3,
+    0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8,
+    0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+static const uint8_t kAcChromaBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t kAcChromaVals[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61,
+    0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33,
+    0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18,
+    0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63,
+    0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+    0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca,
+    0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7,
+    0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+// AAN DCT 输出的比例因子
+static const float kAanScale[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+};
+
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];
+} HuffTable;
+
+typedef struct {
+    uint8_t quant[2][64];       // zigzag 顺序，写入 DQT
+    float divisor[2][64];       // 自然顺序，含 AAN 比例
+    HuffTable dc[2];
+    HuffTable ac[2];
+} JpegTables;
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t cap;
+    uint32_t acc;
+    int nbits;
+    bool failed;
+} BitWriter;
+
+// ============================================
+// 表
+// ============================================
+
+static void build_huffman(HuffTable* t, const uint8_t bits[16], const uint8_t* vals) {
+    memset(t, 0, sizeof(*t));
+    int code = 0, k = 0;
+    for (int len = 1; len <= 16; len++) {
+        for (int i = 0; i < bits[len - 1]; i++) {
+            t->code[vals[k]] = (uint16_t)code++;
+            t->size[vals[k]] = (uint8_t)len;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+static void build_quant(uint8_t zz[64], float divisor[64], const uint8_t base[64], int quality) {
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int k = 0; k < 64; k++) {
+        int n = kNaturalOrder[k];
+        int q = (base[n] * scale + 50) / 100;
+        if (q < 1) q = 1;
+        if (q > 255) q = 255;
+        zz[k] = (uint8_t)q;
+        divisor[n] = 1.0f / (q * kAanScale[n / 8] * kAanScale[n % 8] * 8.0f);
+    }
+}
+
+static void build_tables(JpegTables* t, int quality) {
+    build_quant(t->quant[0], t->divisor[0], kLumaQuant, quality);
+    build_quant(t->quant[1], t->divisor[1], kChromaQuant, quality);
+    build_huffman(&t->dc[0], kDcLumaBits, kDcVals);
+    build_huffman(&t->dc[1], kDcChromaBits, kDcVals);
+    build_huffman(&t->ac[0], kAcLumaBits, kAcLumaVals);
+    build_huffman(&t->ac[1], kAcChromaBits, kAcChromaVals);
+}
+
+// ============================================
+// 输出
+// ============================================
+
+static bool writer_reserve(BitWriter* w, size_t extra) {
+    if (w->failed) return false;
+    if (w->size + extra <= w->cap) return true;
+    size_t cap = w->cap ? w->cap : 64 * 1024;
+    while (cap < w->size + extra) cap *= 2;
+    uint8_t* data = (uint8_t*)realloc(w->data, cap);
+    if (!data) {
+        w->failed = true;
+        return false;
+    }
+    w->data = data;
+    w->cap = cap;
+    return true;
+}
+
+// 调用者已 reserve
+static inline void put_byte(BitWriter* w, uint8_t b) {
+    w->data[w->size++] = b;
+}
+
+static void put_marker(BitWriter* w, uint8_t marker, const uint8_t* payload, int len) {
+    if (!writer_reserve(w, (size_t)len + 4)) return;
+    put_byte(w, 0xff);
+    put_byte(w, marker);
+    if (!payload) return;
+    put_byte(w, (uint8_t)((len + 2) >> 8));
+    put_byte(w, (uint8_t)(len + 2));
+    memcpy(w->data + w->size, payload, len);
+    w->size += len;
+}
+
+// 熵编码数据：0xFF 后补 0x00
+static inline void put_bits(BitWriter* w, uint32_t code, int len) {
+    w->acc = (w->acc << len) | (code & ((1u << len) - 1));
+    w->nbits += len;
+    while (w->nbits >= 8) {
+        w->nbits -= 8;
+        uint8_t b = (uint8_t)(w->acc >> w->nbits);
+        put_byte(w, b);
+        if (b == 0xff) put_byte(w, 0);
+    }
+    w->acc &= (1u << w->nbits) - 1;
+}
+
+// 补 1 到字节边界
+static void flush_bits(BitWriter* w) {
+    if (w->nbits > 0) put_bits(w, 0x7f, 8 - w->nbits);
+}
+
+static void write_headers(BitWriter* w, const JpegTables* t, int width, int height) {
+    static const uint8_t jfif[14] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    uint8_t buf[2 + 17 + 162];
+
+    put_marker(w, 0xd8, nullptr, 0);                    // SOI
+    put_marker(w, 0xe0, jfif, sizeof(jfif));            // APP0
+
+    for (int i = 0; i < 2; i++) {                       // DQT
+        buf[0] = (uint8_t)i;
+        memcpy(buf + 1, t->quant[i], 64);
+        put_marker(w, 0xdb, buf, 65);
+    }
+
+    // SOF0：Y 2x2 采样，Cb/Cr 1x1
+    const uint8_t sof[15] = {
+        8, (uint8_t)(height >> 8), (uint8_t)height, (uint8_t)(width >> 8), (uint8_t)width, 3,
+        1, 0x22, 0,
+        2, 0x11, 1,
+        3, 0x11, 1,
+    };
+    put_marker(w, 0xc0, sof, sizeof(sof));
+
+    struct { uint8_t cls_id; const uint8_t* bits; const uint8_t* vals; int nvals; } dht[4] = {
+        {0x00, kDcLumaBits, kDcVals, 12},
+        {0x10, kAcLumaBits, kAcLumaVals, 162},
+        {0x01, kDcChromaBits, kDcVals, 12},
+        {0x11, kAcChromaBits, kAcChromaVals, 162},
+    };
+    for (int i = 0; i < 4; i++) {                       // DHT
+        buf[0] = dht[i].cls_id;
+        memcpy(buf + 1, dht[i].bits, 16);
+        memcpy(buf + 17, dht[i].vals, dht[i].nvals);
+        put_marker(w, 0xc4, buf, 17 + dht[i].nvals);
+    }
+
+    static const uint8_t sos[10] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+    put_marker(w, 0xda, sos, sizeof(sos));              // SOS
+}
+
+// ============================================
+// 块编码
+// ============================================
+
+// 浮点 AAN 前向 DCT（原地，输出带 8*aan[u]*aan[v] 比例，量化时一并除掉）
+static void fdct_1d(float* d, int step) {
+    float tmp0 = d[0] + d[7 * step], tmp7 = d[0] - d[7 * step];
+    float tmp1 = d[step] + d[6 * step], tmp6 = d[step] - d[6 * step];
+    float tmp2 = d[2 * step] + d[5 * step], tmp5 = d[2 * step] - d[5 * step];
+    float tmp3 = d[3 * step] + d[4 * step], tmp4 = d[3 * step] - d[4 * step];
+
+    float tmp10 = tmp0 + tmp3, tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2, tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4 * step] = tmp10 - tmp11;
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2 * step] = tmp13 + z1;
+    d[6 * step] = tmp13 - z1;
+
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = 0.541196100f * tmp10 + z5;
+    float z4 = 1.306562965f * tmp12 + z5;
+    float z3 = tmp11 * 0.707106781f;
+    float z11 = tmp7 + z3, z13 = tmp7 - z3;
+    d[5 * step] = z13 + z2;
+    d[3 * step] = z13 - z2;
+    d[step] = z11 + z4;
+    d[7 * step] = z11 - z4;
+}
+
+static inline int bit_length(int v) {
+    int n = 0;
+    while (v) {
+        n++;
+        v >>= 1;
+    }
+    return n;
+}
+
+// block 为电平平移后的样本（-128..127），返回本块 DC 供下一块差分
+static int encode_block(BitWriter* w, float block[64], const float divisor[64],
+                        const HuffTable* dc, const HuffTable* ac, int prev_dc) {
+    for (int i = 0; i < 8; i++) fdct_1d(block + i * 8, 1);
+    for (int i = 0; i < 8; i++) fdct_1d(block + i, 8);
+
+    int coef[64];
+    for (int k = 0; k < 64; k++) {
+        int n = kNaturalOrder[k];
+        float v = block[n] * divisor[n];
+        coef[k] = (int)(v < 0 ? v - 0.5f : v + 0.5f);
+    }
+
+    int diff = coef[0] - prev_dc;
+    int mag = diff < 0 ? -diff : diff;
+    int cat = bit_length(mag);
+    put_bits(w, dc->code[cat], dc->size[cat]);
+    if (cat) put_bits(w, diff < 0 ? diff - 1 : diff, cat);
+
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+        int v = coef[k];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+        while (run >= 16) {
+            put_bits(w, ac->code[0xf0], ac->size[0xf0]);    // ZRL
+            run -= 16;
+        }
+        mag = v < 0 ? -v : v;
+        cat = bit_length(mag);
+        int sym = (run << 4) | cat;
+        put_bits(w, ac->code[sym], ac->size[sym]);
+        put_bits(w, v < 0 ? v - 1 : v, cat);
+        run = 0;
+    }
+    if (run > 0) put_bits(w, ac->code[0], ac->size[0]);   // EOB
+    return coef[0];
+}
+
+// ============================================
+// 取样
+// ============================================
+
+typedef struct {
+    const uint8_t* base;
+    int width;
+    int height;
+    int pitch;                  // 字节
+    const uint8_t* uv;          // NV12 UV 平面，RGBA 时为 NULL
+} SampleSource;
+
+// 16x16 MCU：y[4][64] 按 Y0 Y1 Y2 Y3 排列，cb/cr 各 64，均已减 128；越界取边缘像素
+static void load_mcu(const SampleSource* s, int mx, int my, float y[4][64], float cb[64],
+                     float cr[64]) {
+    if (!s->uv) {
+        float ys[16][16], cbs[16][16], crs[16][16];
+        for (int r = 0; r < 16; r++) {
+            int sy = my + r < s->height ? my + r : s->height - 1;
+            const uint8_t* row = s->base + (size_t)sy * s->pitch;
+            for (int c = 0; c < 16; c++) {
+                int sx = mx + c < s->width ? mx + c : s->width - 1;
+                const uint8_t* p = row + sx * 4;
+                float R = p[0], G = p[1], B = p[2];
+                ys[r][c] = 0.299f * R + 0.587f * G + 0.114f * B - 128.0f;
+                cbs[r][c] = -0.168736f * R - 0.331264f * G + 0.5f * B;
+                crs[r][c] = 0.5f * R - 0.418688f * G - 0.081312f * B;
+            }
+        }
+        for (int r = 0; r < 16; r++) {
+            for (int c = 0; c < 16; c++) {
+                y[(r / 8) * 2 + c / 8][(r % 8) * 8 + c % 8] = ys[r][c];
+            }
+        }
+        for (int r = 0; r < 8; r++) {
+            for (int c = 0; c < 8; c++) {
+                cb[r * 8 + c] = (cbs[2 * r][2 * c] + cbs[2 * r][2 * c + 1] +
+                                 cbs[2 * r + 1][2 * c] + cbs[2 * r + 1][2 * c + 1]) * 0.25f;
+                cr[r * 8 + c] = (crs[2 * r][2 * c] + crs[2 * r][2 * c + 1] +
+                                 crs[2 * r + 1][2 * c] + crs[2 * r + 1][2 * c + 1]) * 0.25f;
+            }
+        }
+        return;
+    }
+
+    for (int r = 0; r < 16; r++) {
+        int sy = my + r < s->height ? my + r : s->height - 1;
+        const uint8_t* row = s->base + (size_t)sy * s->pitch;
+        for (int c = 0; c < 16; c++) {
+            int sx = mx + c < s->width ? mx + c : s->width - 1;
+            y[(r / 8) * 2 + c / 8][(r % 8) * 8 + c % 8] = row[sx] - 128.0f;
+        }
+    }
+    int cw = (s->width + 1) / 2, ch = (s->height + 1) / 2;
+    for (int r = 0; r < 8; r++) {
+        int sy = my / 2 + r < ch ? my / 2 + r : ch - 1;
+        const uint8_t* row = s->uv + (size_t)sy * s->pitch;
+        for (int c = 0; c < 8; c++) {
+            int sx = mx / 2 + c < cw ? mx / 2 + c : cw - 1;
+            cb[r * 8 + c] = row[sx * 2] - 128.0f;
+            cr[r * 8 + c] = row[sx * 2 + 1] - 128.0f;
+        }
+    }
+}
+
+static void encode_scan(BitWriter* w, const JpegTables* t, const SampleSource* s) {
+    // 每个 MCU 最坏约 6 块 x 64 系数 x 27 位，再加字节填充
+    const size_t mcu_worst = 4096;
+    int dc[3] = {0, 0, 0};
+    float y[4][64], cb[64], cr[64];
+
+    for (int my = 0; my < s->height; my += 16) {
+        for (int mx = 0; mx < s->width; mx += 16) {
+            if (!writer_reserve(w, mcu_worst)) return;
+            load_mcu(s, mx, my, y, cb, cr);
+            for (int i = 0; i < 4; i++) {
+                dc[0] = encode_block(w, y[i], t->divisor[0], &t->dc[0], &t->ac[0], dc[0]);
+            }
+            dc[1] = encode_block(w, cb, t->divisor[1], &t->dc[1], &t->ac[1], dc[1]);
+            dc[2] = encode_block(w, cr, t->divisor[1], &t->dc[1], &t->ac[1], dc[2]);
+        }
+    }
+    if (writer_reserve(w, 16)) flush_bits(w);
+}
+
+RkScreenshotError rk_jpeg_sw_encode(RkDmaBuffer* src, int quality, uint8_t** out, size_t* size) {
+    if (!src) return RKSS_ERROR_INVALID_PARAM;
+    return rk_jpeg_sw_encode_rows(src, 0, src->height, quality, out, size);
+}
+
+RkScreenshotError rk_jpeg_sw_encode_rows(RkDmaBuffer* src, int y, int height, int quality,
+                                         uint8_t** out, size_t* size) {
+    if (!src || !out || !size) return RKSS_ERROR_INVALID_PARAM;
+    if (src->width <= 0 || src->width > 65535 || height <= 0 || height > 65535) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+    if (y < 0 || (y & 1) || y + height > src->height) return RKSS_ERROR_INVALID_PARAM;
+
+    SampleSource s;
+    memset(&s, 0, sizeof(s));
+    s.width = src->width;
+    s.height = height;
+    switch (src->format) {
+        case RK_FORMAT_RGBA8888:
+        case RK_FORMAT_RGBX8888:
+            s.pitch = src->stride * 4;
+            break;
+        case RK_FORMAT_YUV420SP:
+            s.pitch = src->stride;
+            break;
+        default:
+            return RKSS_ERROR_UNSUPPORTED;
+    }
+
+    const uint8_t* vir = (const uint8_t*)rk_dmabuf_begin_cpu_access(src, RK_DMABUF_CPU_READ, 0,
+                                                                    src->size);
+    if (!vir) return RKSS_ERROR_ENCODE_FAILED;
+    s.base = vir + (size_t)y * s.pitch;
+    if (src->format == RK_FORMAT_YUV420SP) {
+        s.uv = vir + (size_t)src->stride * src->height_stride + (size_t)(y / 2) * s.pitch;
+    }
+
+    JpegTables tables;
+    build_tables(&tables, quality);
+
+    BitWriter w;
+    memset(&w, 0, sizeof(w));
+    write_headers(&w, &tables, s.width, s.height);
+    encode_scan(&w, &tables, &s);
+    put_marker(&w, 0xd9, nullptr, 0);                   // EOI
+    rk_dmabuf_end_cpu_access(src, RK_DMABUF_CPU_READ, 0, src->size);
+
+    if (w.failed) {
+        free(w.data);
+        return RKSS_ERROR_NO_MEMORY;
+    }
+    *out = w.data;
+    *size = w.size;
+    return RKSS_SUCCESS;
+}
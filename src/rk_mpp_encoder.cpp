@@ -3,18 +3,155 @@
  * 
  * 当输入 buffer 满足 MPP 16 像素对齐要求时，使用 DMA-BUF fd 零拷贝
  * 否则使用 MPP 内部 buffer + memcpy
+ *
+ * 编码器记住生效配置，尺寸/步进/格式/质量档不变时不再 SET_CFG；帧间不 reset，只在出错后 reset
+ *
+ * 输出 packet 来自编码器自己的 buffer group（KEY_OUTPUT_PACKET），编码结果直接借给调用者，不再拷贝；
+ * 容量按观测到的 JPEG 字节/像素估计，估小了（硬件报溢出）按原始帧大小重编一次
  */
 
 #include "rk_internal.h"
 #include <mpp_frame.h>
 #include <mpp_packet.h>
 #include <mpp_buffer.h>
+#include <mpp_meta.h>
 #include <cstring>
 #include <cstdlib>
 
 #undef LOG_TAG
 #define LOG_TAG "RK_MPP"
 
+static inline int align16(int v) {
+    return (v + RK_MPP_ALIGN - 1) / RK_MPP_ALIGN * RK_MPP_ALIGN;
+}
+
+// 输出 buffer 容量按 64KB 取整，相近尺寸的帧复用同一批 buffer
+#define RK_MPP_PACKET_ALIGN (64 * 1024)
+// 编码结果离容量不足 1KB 时视为可能截断
+#define RK_MPP_PACKET_SLACK 1024
+
+static inline size_t align_packet(double bytes) {
+    size_t n = (size_t)bytes + RK_MPP_PACKET_ALIGN - 1;
+    return n / RK_MPP_PACKET_ALIGN * RK_MPP_PACKET_ALIGN;
+}
+
+// 编码器可直接读取的输入格式
+static bool mpp_input_format(int format, MppFrameFormat* mpp_fmt) {
+    switch (format) {
+        case RK_FORMAT_RGBA8888:
+        case RK_FORMAT_RGBX8888:
+            *mpp_fmt = MPP_FMT_RGBA8888;
+            return true;
+        case RK_FORMAT_YUV420SP:
+            *mpp_fmt = MPP_FMT_YUV420SP;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool rk_mpp_can_import(const RkDmaBuffer* buf) {
+    MppFrameFormat mpp_fmt;
+    if (!buf || buf->fd < 0) return false;
+    if (!mpp_input_format(buf->format, &mpp_fmt)) return false;
+    if (buf->stride % RK_MPP_ALIGN != 0 || buf->height_stride % RK_MPP_ALIGN != 0) return false;
+    return buf->size >= rk_format_frame_size(buf->format, buf->stride, buf->height_stride);
+}
+
+void* rk_mpp_import(const RkDmaBuffer* buf) {
+    if (!rk_mpp_can_import(buf)) return nullptr;
+
+    MppBufferInfo info;
+    memset(&info, 0, sizeof(info));
+    info.type = MPP_BUFFER_TYPE_DRM;
+    info.fd = buf->fd;
+    info.size = buf->size;
+    info.ptr = nullptr;
+
+    MppBuffer mpp_buf = nullptr;
+    if (mpp_buffer_import(&mpp_buf, &info) != MPP_OK || !mpp_buf) {
+        ALOGW("⚠️ mpp_buffer_import failed: fd=%d", buf->fd);
+        return nullptr;
+    }
+    return mpp_buf;
+}
+
+void rk_mpp_release_import(void* mpp_buf) {
+    if (mpp_buf) {
+        mpp_buffer_put((MppBuffer)mpp_buf);
+    }
+}
+
+RkScreenshotError rk_mpp_enc_params(const RkDmaBuffer* src, int quality, RkMppEncParams* params) {
+    MppFrameFormat mpp_fmt;
+    if (!src || !params) return RKSS_ERROR_INVALID_PARAM;
+    if (!mpp_input_format(src->format, &mpp_fmt)) return RKSS_ERROR_UNSUPPORTED;
+    bool nv12 = (mpp_fmt == MPP_FMT_YUV420SP);
+
+    // 零拷贝直接沿用源 buffer 的步进，否则拷贝到 16 对齐的 MPP buffer
+    bool zero_copy = rk_mpp_can_import(src);
+    int hor_stride = zero_copy ? src->stride : align16(src->width);
+
+    // MPP JPEG quality: 0-10 (10=最高质量)
+    int quant = (quality * 10 + 50) / 100;
+    if (quant < 1) quant = 1;
+    if (quant > 10) quant = 10;
+
+    memset(params, 0, sizeof(*params));
+    params->width = src->width;
+    params->height = src->height;
+    // prep:hor_stride 为字节数；NV12 为 Y 平面行字节（UV 平面同宽）
+    params->hor_stride = hor_stride * (nv12 ? 1 : 4);
+    params->ver_stride = zero_copy ? src->height_stride : align16(src->height);
+    params->format = mpp_fmt;
+    params->quant = quant;
+    return RKSS_SUCCESS;
+}
+
+void rk_mpp_packet_sizer_init(RkMppPacketSizer* sizer) {
+    // 1080p 桌面 Q90 约 0.2 字节/像素，首帧按 0.5 留足余量
+    sizer->bytes_per_px = 0.5;
+}
+
+size_t rk_mpp_packet_capacity(const RkMppPacketSizer* sizer, int width, int height) {
+    double pixels = (double)width * height;
+    size_t worst = align_packet(pixels * 4);
+    size_t capacity = align_packet(pixels * sizer->bytes_per_px * 1.25 + 16 * 1024);
+    return capacity < worst ? capacity : worst;
+}
+
+size_t rk_mpp_packet_capacity_max(int width, int height) {
+    return align_packet((double)width * height * 4);
+}
+
+void rk_mpp_packet_sizer_update(RkMppPacketSizer* sizer, size_t bytes, int width, int height) {
+    if (width <= 0 || height <= 0) return;
+    double ratio = (double)bytes / ((double)width * height);
+    // 变大立即跟上，变小缓慢回落，避免内容切换时反复溢出
+    if (ratio > sizer->bytes_per_px) {
+        sizer->bytes_per_px = ratio;
+    } else {
+        sizer->bytes_per_px += (ratio - sizer->bytes_per_px) * 0.1;
+    }
+}
+
+void rk_mpp_packet_release(void* buffer) {
+    if (buffer) {
+        mpp_buffer_put((MppBuffer)buffer);
+    }
+}
+
+void rk_mpp_get_stats(RkMppEncoder* enc, RkMppEncStats* stats) {
+    if (!enc || !stats) return;
+    if (!enc->initialized) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    pthread_mutex_lock(&enc->lock);
+    *stats = enc->stats;
+    pthread_mutex_unlock(&enc->lock);
+}
+
 RkScreenshotError rk_mpp_init(RkMppEncoder* enc) {
     if (!enc) return RKSS_ERROR_INVALID_PARAM;
 
@@ -40,6 +177,17 @@ RkScreenshotError rk_mpp_init(RkMppEncoder* enc) {
         return RKSS_ERROR_ENCODE_FAILED;
     }
 
+    // 输出 packet 的 buffer group：不带 cache，硬件写完 CPU 直接读，无需同步
+    ret = mpp_buffer_group_get_internal(&enc->buf_grp, MPP_BUFFER_TYPE_DRM);
+    if (ret != MPP_OK) {
+        ALOGE("❌ mpp_buffer_group_get_internal failed: %d", ret);
+        mpp_enc_cfg_deinit(enc->cfg);
+        mpp_destroy(enc->ctx);
+        return RKSS_ERROR_ENCODE_FAILED;
+    }
+    rk_mpp_packet_sizer_init(&enc->sizer);
+
+    pthread_mutex_init(&enc->lock, NULL);
     enc->initialized = true;
     ALOGI("✅ MPP JPEG encoder ready");
     return RKSS_SUCCESS;
@@ -48,6 +196,13 @@ RkScreenshotError rk_mpp_init(RkMppEncoder* enc) {
 void rk_mpp_deinit(RkMppEncoder* enc) {
     if (!enc || !enc->initialized) return;
 
+    if (enc->stats.frames > 0) {
+        ALOGI("MPP stats: %lu frames, %lu reconfigs, %lu reuses, %lu resets, %lu overflows, "
+              "%.3f bytes/px",
+              enc->stats.frames, enc->stats.reconfigs, enc->stats.reuses, enc->stats.resets,
+              enc->stats.overflows, enc->sizer.bytes_per_px);
+    }
+
     if (enc->cfg) {
         mpp_enc_cfg_deinit(enc->cfg);
         enc->cfg = nullptr;
@@ -59,72 +214,147 @@ void rk_mpp_deinit(RkMppEncoder* enc) {
         enc->api = nullptr;
     }
 
+    // 仍被结果借用的 buffer 归还时由 MPP 释放（group 转为孤儿，最后一个 buffer put 后销毁）
+    if (enc->buf_grp) {
+        mpp_buffer_group_put(enc->buf_grp);
+        enc->buf_grp = nullptr;
+    }
+
+    pthread_mutex_destroy(&enc->lock);
     enc->initialized = false;
     ALOGI("MPP encoder stopped");
 }
 
-RkScreenshotError rk_mpp_encode_jpeg(
+// 配置与上一帧不同时才下发；失败后 configured 清零，下一帧重新下发
+static RkScreenshotError apply_params_locked(RkMppEncoder* enc, const RkMppEncParams* params) {
+    if (enc->configured && memcmp(&enc->active, params, sizeof(*params)) == 0) {
+        enc->stats.reuses++;
+        return RKSS_SUCCESS;
+    }
+
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:width", params->width);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:height", params->height);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:hor_stride", params->hor_stride);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:ver_stride", params->ver_stride);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:format", params->format);
+    mpp_enc_cfg_set_s32(enc->cfg, "jpeg:quant", params->quant);
+
+    MPP_RET ret = enc->api->control(enc->ctx, MPP_ENC_SET_CFG, enc->cfg);
+    if (ret != MPP_OK) {
+        ALOGE("❌ MPP config failed: %d", ret);
+        enc->configured = false;
+        return RKSS_ERROR_ENCODE_FAILED;
+    }
+    ALOGD("MPP reconfigured: %dx%d, stride %dx%d, quant %d",
+          params->width, params->height, params->hor_stride, params->ver_stride, params->quant);
+    enc->active = *params;
+    enc->configured = true;
+    enc->stats.reconfigs++;
+    return RKSS_SUCCESS;
+}
+
+// 编码一帧到容量为 capacity 的输出 buffer；成功时 buffer 的引用转给 out
+// *overflow 表示硬件报错或结果贴近容量（可能被截断）
+static RkScreenshotError encode_packet_locked(RkMppEncoder* enc, MppFrame frame, size_t capacity,
+                                              RkMppPacket* out, bool* overflow) {
+    *overflow = false;
+
+    MppBuffer pkt_buf = nullptr;
+    MPP_RET ret = mpp_buffer_get(enc->buf_grp, &pkt_buf, capacity);
+    if (ret != MPP_OK || !pkt_buf) {
+        ALOGE("❌ mpp_buffer_get (packet, %zu bytes) failed: %d", capacity, ret);
+        return RKSS_ERROR_NO_MEMORY;
+    }
+
+    // 指定输出 packet，编码器直接写入 pkt_buf
+    MppPacket packet = nullptr;
+    mpp_packet_init_with_buffer(&packet, pkt_buf);
+    mpp_packet_set_length(packet, 0);
+    mpp_meta_set_packet(mpp_frame_get_meta(frame), KEY_OUTPUT_PACKET, packet);
+
+    RkScreenshotError err = RKSS_SUCCESS;
+    MppPacket got = nullptr;
+    ret = enc->api->encode_put_frame(enc->ctx, frame);
+    if (ret == MPP_OK) {
+        ret = enc->api->encode_get_packet(enc->ctx, &got);
+    }
+    if (ret != MPP_OK || !got) {
+        ALOGW("⚠️ JPEG encode into %zu-byte packet failed: %d", capacity, ret);
+        *overflow = true;
+        err = RKSS_ERROR_ENCODE_FAILED;
+    } else if (got != packet) {
+        ALOGE("❌ Encoder ignored KEY_OUTPUT_PACKET");
+        err = RKSS_ERROR_ENCODE_FAILED;
+    } else if (mpp_packet_get_length(packet) + RK_MPP_PACKET_SLACK > capacity) {
+        *overflow = true;
+        err = RKSS_ERROR_ENCODE_FAILED;
+    } else {
+        out->data = (uint8_t*)mpp_packet_get_pos(packet);
+        out->size = mpp_packet_get_length(packet);
+        out->buffer = pkt_buf;
+        out->release = rk_mpp_packet_release;
+        pkt_buf = nullptr;
+    }
+
+    if (got && got != packet) mpp_packet_deinit(&got);
+    mpp_packet_deinit(&packet);
+    if (pkt_buf) mpp_buffer_put(pkt_buf);
+    return err;
+}
+
+// 编码 src 的 [row_y, row_y + height) 行；调用者持有 enc->lock
+static RkScreenshotError encode_jpeg_locked(
     RkMppEncoder* enc,
     RkDmaBuffer* src,
-    uint8_t** out_data,
-    size_t* out_size,
+    int row_y,
+    int height,
+    RkMppPacket* out,
     int quality)
 {
-    if (!enc || !enc->initialized) return RKSS_ERROR_NOT_INITIALIZED;
-    if (!src || !out_data || !out_size) return RKSS_ERROR_INVALID_PARAM;
+    RkMppEncParams params;
+    RkScreenshotError err = rk_mpp_enc_params(src, quality, &params);
+    if (err != RKSS_SUCCESS) return err;
+    MppFrameFormat mpp_fmt = (MppFrameFormat)params.format;
+    bool nv12 = (mpp_fmt == MPP_FMT_YUV420SP);
 
     uint64_t t0 = rk_get_time_us();
     MPP_RET ret = MPP_OK;
-    RkScreenshotError err = RKSS_SUCCESS;
 
     int width = src->width;
-    int height = src->height;
     
-    // MPP 需要 16 像素对齐
-    int hor_stride_aligned = ((width + 15) / 16) * 16;
-    int ver_stride_aligned = ((height + 15) / 16) * 16;
-    int hor_stride_bytes = hor_stride_aligned * 4;
-    
-    // 零拷贝条件：width 和 height 都必须是 16 对齐
-    bool zero_copy = (width == hor_stride_aligned) && 
-                     (height == ver_stride_aligned) && 
-                     (src->fd >= 0);
+    // 零拷贝条件：源 buffer 的步进已满足 16 对齐（见 rk_mpp_can_import）
+    // 行区间（条带）一律拷贝这些行：JPEG 编码器是否遵守帧的 offset_y 未在设备上验证
+    bool whole = (row_y == 0 && height == src->height);
+    bool zero_copy = whole && rk_mpp_can_import(src);
+
+    params.height = height;
+    if (!zero_copy) params.ver_stride = align16(height);
     
-    // MPP JPEG quality: 0-10 (10=最高质量)
-    int mpp_quant = (quality * 10 + 50) / 100;
-    if (mpp_quant < 1) mpp_quant = 1;
-    if (mpp_quant > 10) mpp_quant = 10;
-
-    ALOGD("JPEG encode: %dx%d (aligned %dx%d), Q%d->%d, %s", 
-          width, height, hor_stride_aligned, ver_stride_aligned, quality, mpp_quant,
-          zero_copy ? "🚀 ZERO-COPY" : "📋 MEMCPY");
-
-    // 配置编码参数
-    mpp_enc_cfg_set_s32(enc->cfg, "prep:width", width);
-    mpp_enc_cfg_set_s32(enc->cfg, "prep:height", height);
-    mpp_enc_cfg_set_s32(enc->cfg, "prep:hor_stride", hor_stride_bytes);
-    mpp_enc_cfg_set_s32(enc->cfg, "prep:ver_stride", ver_stride_aligned);
-    mpp_enc_cfg_set_s32(enc->cfg, "prep:format", MPP_FMT_RGBA8888);
-    mpp_enc_cfg_set_s32(enc->cfg, "jpeg:quant", mpp_quant);
-
-    ret = enc->api->control(enc->ctx, MPP_ENC_SET_CFG, enc->cfg);
-    if (ret != MPP_OK) {
-        ALOGE("❌ MPP config failed: %d", ret);
-        return RKSS_ERROR_ENCODE_FAILED;
-    }
+    // MPP 需要 16 像素对齐；零拷贝时直接沿用源 buffer 的步进
+    int hor_stride_bytes = params.hor_stride;
+    int hor_stride_aligned = hor_stride_bytes / (nv12 ? 1 : 4);
+    int ver_stride_aligned = params.ver_stride;
+
+    ALOGD("JPEG encode: %dx%d (aligned %dx%d), %s, Q%d->%d, %s", 
+          width, height, hor_stride_aligned, ver_stride_aligned, nv12 ? "NV12" : "RGBA",
+          quality, params.quant, zero_copy ? "🚀 ZERO-COPY" : "📋 MEMCPY");
+
+    err = apply_params_locked(enc, &params);
+    if (err != RKSS_SUCCESS) return err;
+    enc->stats.frames++;
 
     MppFrame frame = nullptr;
-    MppPacket packet = nullptr;
     MppBuffer frame_buf = nullptr;
-    size_t frame_size = (size_t)hor_stride_bytes * ver_stride_aligned;
-    
-    // 分配输出缓冲
-    void* pkt_data = malloc(frame_size);
-    if (!pkt_data) {
-        return RKSS_ERROR_NO_MEMORY;
-    }
+    size_t frame_size = rk_format_frame_size(src->format, hor_stride_aligned, ver_stride_aligned);
+    size_t capacity = rk_mpp_packet_capacity(&enc->sizer, width, height);
+    size_t capacity_max = rk_mpp_packet_capacity_max(width, height);
+    bool overflow = false;
 
-    if (zero_copy) {
+    // 导入缓存中已有 MppBuffer：直接借用，不在本次编码中释放
+    bool borrowed = zero_copy && src->mpp_buf;
+    if (borrowed) {
+        frame_buf = (MppBuffer)src->mpp_buf;
+    } else if (zero_copy) {
         // ========== 零拷贝模式：直接使用 DMA-BUF fd ==========
         MppBufferInfo info;
         memset(&info, 0, sizeof(info));
@@ -146,36 +376,47 @@ RkScreenshotError rk_mpp_encode_jpeg(
         ret = mpp_buffer_get(nullptr, &frame_buf, frame_size);
         if (ret != MPP_OK || !frame_buf) {
             ALOGE("❌ mpp_buffer_get failed: %d", ret);
-            free(pkt_data);
             return RKSS_ERROR_NO_MEMORY;
         }
         
-        // 映射源 DMA-BUF
-        void* src_vir = rk_dmabuf_map(src);
+        // 映射源 DMA-BUF（映射常驻，仅做 cache 同步）
+        int src_stride = src->stride * (nv12 ? 1 : 4);
+        int row_bytes = width * (nv12 ? 1 : 4);
+        size_t src_len = nv12 ? src->size : (size_t)(row_y + height) * src_stride;
+        uint8_t* src_vir = (uint8_t*)rk_dmabuf_begin_cpu_access(src, RK_DMABUF_CPU_READ, 0, src_len);
         if (!src_vir) {
             ALOGE("❌ Failed to map source buffer");
             mpp_buffer_put(frame_buf);
-            free(pkt_data);
             return RKSS_ERROR_ENCODE_FAILED;
         }
         
         // 获取 MPP buffer 的虚拟地址并拷贝数据
         void* frame_ptr = mpp_buffer_get_ptr(frame_buf);
-        int src_stride = width * 4;
         
-        if (hor_stride_bytes == src_stride) {
-            memcpy(frame_ptr, src_vir, height * src_stride);
+        if (hor_stride_bytes == src_stride && !nv12) {
+            memcpy(frame_ptr, src_vir + (size_t)row_y * src_stride, (size_t)height * src_stride);
         } else {
             // 处理 stride 对齐
             uint8_t* dst_row = (uint8_t*)frame_ptr;
-            uint8_t* src_row = (uint8_t*)src_vir;
+            uint8_t* src_row = src_vir + (size_t)row_y * src_stride;
             for (int y = 0; y < height; y++) {
-                memcpy(dst_row, src_row, src_stride);
+                memcpy(dst_row, src_row, row_bytes);
                 dst_row += hor_stride_bytes;
                 src_row += src_stride;
             }
+            if (nv12) {
+                // UV 平面紧随 Y 平面（各自的垂直步进之后）
+                dst_row = (uint8_t*)frame_ptr + (size_t)hor_stride_bytes * ver_stride_aligned;
+                src_row = src_vir + (size_t)src_stride * src->height_stride +
+                          (size_t)(row_y / 2) * src_stride;
+                for (int y = 0; y < (height + 1) / 2; y++) {
+                    memcpy(dst_row, src_row, row_bytes);
+                    dst_row += hor_stride_bytes;
+                    src_row += src_stride;
+                }
+            }
         }
-        rk_dmabuf_unmap(src);
+        rk_dmabuf_end_cpu_access(src, RK_DMABUF_CPU_READ, 0, src_len);
     }
     
     // 创建 frame
@@ -184,65 +425,68 @@ RkScreenshotError rk_mpp_encode_jpeg(
     mpp_frame_set_height(frame, height);
     mpp_frame_set_hor_stride(frame, hor_stride_aligned);
     mpp_frame_set_ver_stride(frame, ver_stride_aligned);
-    mpp_frame_set_fmt(frame, MPP_FMT_RGBA8888);
-    mpp_frame_set_eos(frame, 1);
+    mpp_frame_set_fmt(frame, mpp_fmt);
+    // 连续编码不设 EOS：EOS 之后编码器要 reset 才接收下一帧
     mpp_frame_set_buffer(frame, frame_buf);
 
-    // 创建输出 packet
-    mpp_packet_init(&packet, pkt_data, frame_size);
-    mpp_packet_set_length(packet, 0);
-
-    // 编码
-    ret = enc->api->encode_put_frame(enc->ctx, frame);
-    if (ret != MPP_OK) {
-        ALOGE("❌ encode_put_frame failed: %d", ret);
-        err = RKSS_ERROR_ENCODE_FAILED;
-        goto cleanup;
-    }
-
-    ret = enc->api->encode_get_packet(enc->ctx, &packet);
-    if (ret != MPP_OK || !packet) {
-        ALOGE("❌ encode_get_packet failed: %d", ret);
-        err = RKSS_ERROR_ENCODE_FAILED;
-        goto cleanup;
+    // 编码：容量估小时 reset 后按原始帧大小重编一次
+    err = encode_packet_locked(enc, frame, capacity, out, &overflow);
+    if (err != RKSS_SUCCESS && overflow && capacity < capacity_max) {
+        ALOGW("⚠️ JPEG packet overflow at %zu bytes, retrying with %zu", capacity, capacity_max);
+        enc->api->reset(enc->ctx);
+        enc->stats.resets++;
+        enc->stats.overflows++;
+        capacity = capacity_max;
+        err = encode_packet_locked(enc, frame, capacity, out, &overflow);
     }
 
-    // 获取输出数据
-    {
-        void* pkt_ptr = mpp_packet_get_pos(packet);
-        size_t pkt_len = mpp_packet_get_length(packet);
-
-        *out_data = (uint8_t*)malloc(pkt_len);
-        if (!*out_data) {
-            err = RKSS_ERROR_NO_MEMORY;
-            goto cleanup;
-        }
-        
-        memcpy(*out_data, pkt_ptr, pkt_len);
-        *out_size = pkt_len;
-
+    if (err == RKSS_SUCCESS) {
+        rk_mpp_packet_sizer_update(&enc->sizer, out->size, width, height);
         uint64_t elapsed = rk_get_time_us() - t0;
-        ALOGI("✅ JPEG: %zu bytes in %.2f ms", pkt_len, elapsed / 1000.0);
-    }
-
-cleanup:
-    // 重置编码器释放内部引用
-    if (enc->api && enc->ctx) {
+        ALOGI("✅ JPEG: %zu bytes in %.2f ms (packet %zu KB)", out->size, elapsed / 1000.0,
+              capacity / 1024);
+    } else if (enc->api && enc->ctx) {
+        // 出错时编码器内部可能还留着本帧，reset 释放引用；配置保留，无需重新下发
         enc->api->reset(enc->ctx);
+        enc->stats.resets++;
     }
-    
-    if (frame) {
-        mpp_frame_set_buffer(frame, nullptr);
-        mpp_frame_deinit(&frame);
-    }
-    if (frame_buf) {
+
+    mpp_frame_set_buffer(frame, nullptr);
+    mpp_frame_deinit(&frame);
+    if (frame_buf && !borrowed) {
         mpp_buffer_put(frame_buf);
     }
-    if (packet) {
-        mpp_packet_deinit(&packet);
+    return err;
+}
+
+RkScreenshotError rk_mpp_encode_jpeg(
+    RkMppEncoder* enc,
+    RkDmaBuffer* src,
+    RkMppPacket* out,
+    int quality)
+{
+    if (!src) return RKSS_ERROR_INVALID_PARAM;
+    return rk_mpp_encode_jpeg_rows(enc, src, 0, src->height, out, quality);
+}
+
+RkScreenshotError rk_mpp_encode_jpeg_rows(
+    RkMppEncoder* enc,
+    RkDmaBuffer* src,
+    int y,
+    int height,
+    RkMppPacket* out,
+    int quality)
+{
+    if (!enc || !enc->initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!src || !out) return RKSS_ERROR_INVALID_PARAM;
+    // 起始行须为偶数（NV12 色度按 2 行一组）
+    if (y < 0 || (y & 1) || height <= 0 || y + height > src->height) {
+        return RKSS_ERROR_INVALID_PARAM;
     }
-    
-    free(pkt_data);
+    memset(out, 0, sizeof(*out));
 
+    pthread_mutex_lock(&enc->lock);
+    RkScreenshotError err = encode_jpeg_locked(enc, src, y, height, out, quality);
+    pthread_mutex_unlock(&enc->lock);
     return err;
 }
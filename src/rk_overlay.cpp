@@ -0,0 +1,416 @@
+/**
+ * RK3588 Overlay - 水印叠加
+ *
+ * 水印创建时转为预乘 RGBA 写入 DMA-BUF 并导入 RGA，之后每帧复用：
+ * RGBA 输出由 RGA SRC_OVER 直接在输出 DMA-BUF 上混合（编码前）；
+ * 其余格式（RGB888/BGR888/NV12/I420）或 RGA 失败时走 CPU：按目标格式缓存预乘平面与 255 - alpha，
+ * 逐字节 d' = p + d * (255 - a) / 255，核心循环有 NEON（arm64）与 SSE2（x86）实现
+ */
+
+#include "rk_internal.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#undef LOG_TAG
+#define LOG_TAG "RK_Overlay"
+
+// 目标平面上的一块叠加区域，以字节计
+typedef struct {
+    uint8_t* pre;               // 预乘值
+    uint8_t* inv;               // 255 - alpha，与 pre 逐字节对应
+    int x;                      // 平面内起始字节（像素/色度单元对齐）
+    int y;                      // 起始行
+    int bytes;                  // 每行字节
+    int rows;
+} OverlayPlane;
+
+typedef struct {
+    int count;
+    OverlayPlane planes[3];
+} OverlayLayout;
+
+enum { LAYOUT_RGBA, LAYOUT_RGB, LAYOUT_BGR, LAYOUT_NV12, LAYOUT_I420, LAYOUT_COUNT };
+
+struct RkOverlay {
+    int refs;
+    int width;
+    int height;
+    int x;
+    int y;
+    uint32_t* pixels;           // 非预乘 RGBA，alpha 已乘整体透明度
+    RkDmaBuffer* buf;           // 预乘 RGBA，RGA 混合源；NULL 表示只走 CPU
+    pthread_mutex_t lock;       // 保护 layouts 的惰性生成
+    OverlayLayout* layouts[LAYOUT_COUNT];
+};
+
+// x / 255 四舍五入（x <= 255 * 255）
+static inline int div255(int x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline int px_r(uint32_t p) { return p & 0xff; }
+static inline int px_g(uint32_t p) { return (p >> 8) & 0xff; }
+static inline int px_b(uint32_t p) { return (p >> 16) & 0xff; }
+static inline int px_a(uint32_t p) { return p >> 24; }
+
+// JFIF 全范围 BT.601，与 RGA / CPU 后端的颜色转换一致
+static inline int luma(uint32_t p) {
+    return (77 * px_r(p) + 150 * px_g(p) + 29 * px_b(p) + 128) >> 8;
+}
+
+static inline int chroma_u(uint32_t p) {
+    int u = ((-43 * px_r(p) - 85 * px_g(p) + 128 * px_b(p) + 128) >> 8) + 128;
+    return u < 0 ? 0 : u > 255 ? 255 : u;
+}
+
+static inline int chroma_v(uint32_t p) {
+    int v = ((128 * px_r(p) - 107 * px_g(p) - 21 * px_b(p) + 128) >> 8) + 128;
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// ============================================
+// 混合核心：d = p + d * inv / 255（饱和）
+// ============================================
+
+static void blend_bytes(uint8_t* d, const uint8_t* p, const uint8_t* inv, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t dv = vld1q_u8(d + i);
+        uint8x16_t iv = vld1q_u8(inv + i);
+        uint16x8_t lo = vmull_u8(vget_low_u8(dv), vget_low_u8(iv));
+        uint16x8_t hi = vmull_u8(vget_high_u8(dv), vget_high_u8(iv));
+        // (x + 128 + ((x + 128) >> 8)) >> 8
+        uint8x8_t lo8 = vraddhn_u16(lo, vrshrq_n_u16(lo, 8));
+        uint8x8_t hi8 = vraddhn_u16(hi, vrshrq_n_u16(hi, 8));
+        vst1q_u8(d + i, vqaddq_u8(vld1q_u8(p + i), vcombine_u8(lo8, hi8)));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+    for (; i + 16 <= n; i += 16) {
+        __m128i dv = _mm_loadu_si128((const __m128i*)(d + i));
+        __m128i iv = _mm_loadu_si128((const __m128i*)(inv + i));
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(dv, zero), _mm_unpacklo_epi8(iv, zero));
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(dv, zero), _mm_unpackhi_epi8(iv, zero));
+        lo = _mm_add_epi16(lo, half);
+        hi = _mm_add_epi16(hi, half);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        __m128i pv = _mm_loadu_si128((const __m128i*)(p + i));
+        _mm_storeu_si128((__m128i*)(d + i), _mm_adds_epu8(pv, _mm_packus_epi16(lo, hi)));
+    }
+#endif
+    for (; i < n; i++) {
+        int v = p[i] + div255(d[i] * inv[i]);
+        d[i] = (uint8_t)(v > 255 ? 255 : v);
+    }
+}
+
+// ============================================
+// 按目标格式生成预乘平面
+// ============================================
+
+static bool plane_alloc(OverlayPlane* pl, int x, int y, int bytes, int rows) {
+    pl->pre = (uint8_t*)malloc((size_t)bytes * rows);
+    pl->inv = (uint8_t*)malloc((size_t)bytes * rows);
+    pl->x = x;
+    pl->y = y;
+    pl->bytes = bytes;
+    pl->rows = rows;
+    return pl->pre && pl->inv;
+}
+
+static void layout_free(OverlayLayout* l) {
+    if (!l) return;
+    for (int i = 0; i < l->count; i++) {
+        free(l->planes[i].pre);
+        free(l->planes[i].inv);
+    }
+    free(l);
+}
+
+// 打包像素格式：RGBA 保留 alpha 字节（SRC_OVER），RGB/BGR 三字节
+static bool build_packed(const RkOverlay* ov, OverlayLayout* l, int bpp, bool bgr) {
+    OverlayPlane* pl = &l->planes[l->count++];
+    if (!plane_alloc(pl, ov->x * bpp, ov->y, ov->width * bpp, ov->height)) return false;
+
+    for (int i = 0; i < ov->width * ov->height; i++) {
+        uint32_t px = ov->pixels[i];
+        int a = px_a(px);
+        uint8_t* pre = pl->pre + (size_t)i * bpp;
+        int r = div255(px_r(px) * a), g = div255(px_g(px) * a), b = div255(px_b(px) * a);
+        pre[0] = (uint8_t)(bgr ? b : r);
+        pre[1] = (uint8_t)g;
+        pre[2] = (uint8_t)(bgr ? r : b);
+        if (bpp == 4) pre[3] = (uint8_t)a;
+        memset(pl->inv + (size_t)i * bpp, 255 - a, bpp);
+    }
+    return true;
+}
+
+// YUV420：Y 逐像素；色度按目标 2x2 网格累加，水印未覆盖的像素按 alpha 0 计
+static bool build_yuv420(const RkOverlay* ov, OverlayLayout* l, bool nv12) {
+    OverlayPlane* y_pl = &l->planes[l->count++];
+    if (!plane_alloc(y_pl, ov->x, ov->y, ov->width, ov->height)) return false;
+    for (int i = 0; i < ov->width * ov->height; i++) {
+        uint32_t px = ov->pixels[i];
+        int a = px_a(px);
+        y_pl->pre[i] = (uint8_t)div255(luma(px) * a);
+        y_pl->inv[i] = (uint8_t)(255 - a);
+    }
+
+    int cx0 = ov->x / 2, cy0 = ov->y / 2;
+    int cw = (ov->x + ov->width - 1) / 2 - cx0 + 1;
+    int ch = (ov->y + ov->height - 1) / 2 - cy0 + 1;
+    OverlayPlane* u_pl = &l->planes[l->count++];
+    OverlayPlane* v_pl = nv12 ? u_pl : &l->planes[l->count++];
+    int step = nv12 ? 2 : 1;
+    if (!plane_alloc(u_pl, cx0 * step, cy0, cw * step, ch)) return false;
+    if (!nv12 && !plane_alloc(v_pl, cx0, cy0, cw, ch)) return false;
+    int v_off = nv12 ? 1 : 0;
+
+    for (int cy = 0; cy < ch; cy++) {
+        for (int cx = 0; cx < cw; cx++) {
+            int sum_u = 0, sum_v = 0, sum_a = 0;
+            for (int k = 0; k < 4; k++) {
+                int px_x = (cx0 + cx) * 2 + (k & 1) - ov->x;
+                int px_y = (cy0 + cy) * 2 + (k >> 1) - ov->y;
+                if (px_x < 0 || px_x >= ov->width || px_y < 0 || px_y >= ov->height) continue;
+                uint32_t px = ov->pixels[px_y * ov->width + px_x];
+                int a = px_a(px);
+                sum_u += chroma_u(px) * a;
+                sum_v += chroma_v(px) * a;
+                sum_a += a;
+            }
+            size_t i = (size_t)cy * cw * step + cx * step;
+            u_pl->pre[i] = (uint8_t)((sum_u + 510) / 1020);
+            u_pl->inv[i] = (uint8_t)(255 - (sum_a + 2) / 4);
+            v_pl->pre[i + v_off] = (uint8_t)((sum_v + 510) / 1020);
+            v_pl->inv[i + v_off] = u_pl->inv[i];
+        }
+    }
+    return true;
+}
+
+static int layout_index(int format) {
+    switch (format) {
+        case RK_FORMAT_RGBA8888:
+        case RK_FORMAT_RGBX8888: return LAYOUT_RGBA;
+        case RK_FORMAT_RGB888: return LAYOUT_RGB;
+        case RK_FORMAT_BGR888: return LAYOUT_BGR;
+        case RK_FORMAT_YUV420SP: return LAYOUT_NV12;
+        case RK_FORMAT_YUV420P: return LAYOUT_I420;
+        default: return -1;
+    }
+}
+
+// 首次用到某格式时生成，之后只读
+static const OverlayLayout* get_layout(RkOverlay* ov, int format) {
+    int index = layout_index(format);
+    if (index < 0) return nullptr;
+
+    pthread_mutex_lock(&ov->lock);
+    OverlayLayout* l = ov->layouts[index];
+    if (!l) {
+        l = (OverlayLayout*)calloc(1, sizeof(OverlayLayout));
+        bool ok = l != nullptr;
+        switch (index) {
+            case LAYOUT_RGBA: ok = ok && build_packed(ov, l, 4, false); break;
+            case LAYOUT_RGB:  ok = ok && build_packed(ov, l, 3, false); break;
+            case LAYOUT_BGR:  ok = ok && build_packed(ov, l, 3, true); break;
+            case LAYOUT_NV12: ok = ok && build_yuv420(ov, l, true); break;
+            case LAYOUT_I420: ok = ok && build_yuv420(ov, l, false); break;
+        }
+        if (ok) {
+            ov->layouts[index] = l;
+        } else {
+            layout_free(l);
+            l = nullptr;
+        }
+    }
+    pthread_mutex_unlock(&ov->lock);
+    return l;
+}
+
+// planes/pitches/widths/heights：目标各平面首地址、行字节、宽（字节）、行数，与 layout 平面一一对应
+static void blend_layout(const OverlayLayout* l, uint8_t* const* planes, const size_t* pitches,
+                         const int* widths, const int* heights) {
+    for (int i = 0; i < l->count; i++) {
+        const OverlayPlane* pl = &l->planes[i];
+        int bytes = widths[i] - pl->x < pl->bytes ? widths[i] - pl->x : pl->bytes;
+        int rows = heights[i] - pl->y < pl->rows ? heights[i] - pl->y : pl->rows;
+        for (int r = 0; r < rows; r++) {
+            blend_bytes(planes[i] + (size_t)(pl->y + r) * pitches[i] + pl->x,
+                        pl->pre + (size_t)r * pl->bytes, pl->inv + (size_t)r * pl->bytes, bytes);
+        }
+    }
+}
+
+// 按格式填写平面参数；luma_pitch 为首平面行字节，chroma_pitch/chroma_rows 为 YUV 色度平面行字节/行步进
+static void fill_planes(const OverlayLayout* l, int format, int width, int height,
+                        uint8_t* base, size_t luma_pitch, size_t luma_rows,
+                        size_t chroma_pitch, size_t chroma_rows) {
+    uint8_t* planes[3] = {base, nullptr, nullptr};
+    size_t pitches[3] = {luma_pitch, chroma_pitch, chroma_pitch};
+    int widths[3] = {width, (width + 1) / 2, (width + 1) / 2};
+    int heights[3] = {height, (height + 1) / 2, (height + 1) / 2};
+    switch (format) {
+        case RK_FORMAT_YUV420SP:
+            planes[1] = base + luma_pitch * luma_rows;
+            widths[1] *= 2;
+            break;
+        case RK_FORMAT_YUV420P:
+            planes[1] = base + luma_pitch * luma_rows;
+            planes[2] = planes[1] + chroma_pitch * chroma_rows;
+            break;
+        default:
+            widths[0] = width * (rk_format_bits_per_pixel(format) / 8);
+            break;
+    }
+    blend_layout(l, planes, pitches, widths, heights);
+}
+
+// ============================================
+// 公共接口
+// ============================================
+
+RkOverlay* rk_overlay_create(const uint8_t* rgba, int width, int height, int x, int y,
+                             uint8_t alpha, RkRgaProcessor* rga) {
+    if (!rgba || width <= 0 || height <= 0 || x < 0 || y < 0) return nullptr;
+
+    RkOverlay* ov = (RkOverlay*)calloc(1, sizeof(RkOverlay));
+    if (!ov) return nullptr;
+    ov->pixels = (uint32_t*)malloc((size_t)width * height * 4);
+    if (!ov->pixels) {
+        free(ov);
+        return nullptr;
+    }
+    ov->refs = 1;
+    ov->width = width;
+    ov->height = height;
+    ov->x = x;
+    ov->y = y;
+    pthread_mutex_init(&ov->lock, NULL);
+
+    // 整体透明度并入逐像素 alpha，之后 RGA 与 CPU 路径只看像素 alpha
+    for (int i = 0; i < width * height; i++) {
+        const uint8_t* p = rgba + (size_t)i * 4;
+        uint32_t a = (uint32_t)div255(p[3] * alpha);
+        ov->pixels[i] = p[0] | (p[1] << 8) | (p[2] << 16) | (a << 24);
+    }
+
+    if (rga && rga->initialized) {
+        // RGA 要求 RGBA 行步进 4 像素对齐
+        ov->buf = rk_dmabuf_alloc_aligned(rk_dmabuf_default_allocator(), width, height,
+                                          RK_FORMAT_RGBA8888, 4, 1);
+        const OverlayLayout* l = ov->buf ? get_layout(ov, RK_FORMAT_RGBA8888) : nullptr;
+        uint8_t* vir = l ? (uint8_t*)rk_dmabuf_begin_cpu_access(ov->buf, RK_DMABUF_CPU_WRITE,
+                                                                0, ov->buf->size)
+                         : nullptr;
+        if (vir) {
+            for (int r = 0; r < height; r++) {
+                memcpy(vir + (size_t)r * ov->buf->stride * 4,
+                       l->planes[0].pre + (size_t)r * width * 4, (size_t)width * 4);
+            }
+            rk_dmabuf_end_cpu_access(ov->buf, RK_DMABUF_CPU_WRITE, 0, ov->buf->size);
+            ov->buf->rga_handle = rk_rga_import(ov->buf);
+        } else {
+            ALOGW("⚠️ Overlay DMA-BUF unavailable, CPU blending only");
+            rk_dmabuf_free(ov->buf);
+            ov->buf = nullptr;
+        }
+    }
+
+    ALOGD("✅ Overlay: %dx%d at (%d,%d), alpha %d (%s)", width, height, x, y, alpha,
+          ov->buf ? "RGA" : "CPU");
+    return ov;
+}
+
+RkOverlay* rk_overlay_ref(RkOverlay* ov) {
+    if (ov) __atomic_add_fetch(&ov->refs, 1, __ATOMIC_RELAXED);
+    return ov;
+}
+
+void rk_overlay_unref(RkOverlay* ov) {
+    if (!ov || __atomic_sub_fetch(&ov->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+
+    if (ov->buf) {
+        rk_rga_release_import(ov->buf->rga_handle);
+        ov->buf->rga_handle = 0;
+        rk_dmabuf_free(ov->buf);
+    }
+    for (int i = 0; i < LAYOUT_COUNT; i++) {
+        layout_free(ov->layouts[i]);
+    }
+    pthread_mutex_destroy(&ov->lock);
+    free(ov->pixels);
+    free(ov);
+}
+
+RkScreenshotError rk_overlay_blend_cpu(RkOverlay* ov, RkDmaBuffer* dst) {
+    if (!ov || !dst) return RKSS_ERROR_INVALID_PARAM;
+    const OverlayLayout* l = get_layout(ov, dst->format);
+    if (!l) return RKSS_ERROR_UNSUPPORTED;
+
+    uint8_t* vir = (uint8_t*)rk_dmabuf_begin_cpu_access(
+        dst, RK_DMABUF_CPU_READ | RK_DMABUF_CPU_WRITE, 0, dst->size);
+    if (!vir) return RKSS_ERROR_NO_MEMORY;
+
+    bool yuv = dst->format == RK_FORMAT_YUV420SP || dst->format == RK_FORMAT_YUV420P;
+    size_t luma_pitch = yuv ? dst->stride
+                            : (size_t)dst->stride * (rk_format_bits_per_pixel(dst->format) / 8);
+    size_t chroma_pitch = dst->format == RK_FORMAT_YUV420P ? dst->stride / 2 : dst->stride;
+    fill_planes(l, dst->format, dst->width, dst->height, vir, luma_pitch, dst->height_stride,
+                chroma_pitch, dst->height_stride / 2);
+
+    rk_dmabuf_end_cpu_access(dst, RK_DMABUF_CPU_READ | RK_DMABUF_CPU_WRITE, 0, dst->size);
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_overlay_blend_packed(RkOverlay* ov, uint8_t* data, int format,
+                                          int width, int height) {
+    if (!ov || !data || width <= 0 || height <= 0) return RKSS_ERROR_INVALID_PARAM;
+    const OverlayLayout* l = get_layout(ov, format);
+    if (!l) return RKSS_ERROR_UNSUPPORTED;
+
+    // 紧凑布局同 rk_format_packed_size：NV12 色度行 (w+1)/2*2 字节，I420 色度平面 (w+1)/2 x (h+1)/2
+    bool yuv = format == RK_FORMAT_YUV420SP || format == RK_FORMAT_YUV420P;
+    size_t luma_pitch = yuv ? width : (size_t)width * (rk_format_bits_per_pixel(format) / 8);
+    size_t chroma_pitch = (size_t)(width + 1) / 2 * (format == RK_FORMAT_YUV420SP ? 2 : 1);
+    fill_planes(l, format, width, height, data, luma_pitch, height,
+                chroma_pitch, (height + 1) / 2);
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_overlay_apply(RkOverlay* ov, RkRgaProcessor* rga, RkDmaBuffer* dst) {
+    if (!ov || !dst) return RKSS_ERROR_INVALID_PARAM;
+    if (ov->x >= dst->width || ov->y >= dst->height) return RKSS_SUCCESS;
+
+    bool rgba = dst->format == RK_FORMAT_RGBA8888 || dst->format == RK_FORMAT_RGBX8888;
+    if (rgba && ov->buf && rga && rga->initialized) {
+        int width = dst->width - ov->x < ov->width ? dst->width - ov->x : ov->width;
+        int height = dst->height - ov->y < ov->height ? dst->height - ov->y : ov->height;
+        uint64_t t0 = rk_get_time_us();
+        RkScreenshotError err = rk_rga_blend(rga, ov->buf, dst, ov->x, ov->y, width, height);
+        if (err == RKSS_SUCCESS) {
+            ALOGD("💧 Overlay (RGA): %dx%d in %.2f ms", width, height,
+                  (rk_get_time_us() - t0) / 1000.0);
+            return RKSS_SUCCESS;
+        }
+        ALOGW("⚠️ RGA blend failed, falling back to CPU");
+    }
+
+    uint64_t t0 = rk_get_time_us();
+    RkScreenshotError err = rk_overlay_blend_cpu(ov, dst);
+    ALOGD("💧 Overlay (CPU): %dx%d %s in %.2f ms", ov->width, ov->height,
+          rk_format_name(dst->format), (rk_get_time_us() - t0) / 1000.0);
+    return err;
+}
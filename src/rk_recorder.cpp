@@ -0,0 +1,210 @@
+/**
+ * RK3588 Screen Recorder - 按帧率节拍取帧、编码、封装
+ *
+ * 专用线程在固定节拍网格上运行，pts 取节拍序号（不受处理抖动影响）；
+ * 画面未变（Y 平面签名相同）的节拍不编码，MP4 中由上一帧延长覆盖，
+ * 但每 gop 个节拍至少强制一个 IDR，保证可随机访问；处理超时错过的节拍计入 late_ticks
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <cerrno>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_Recorder"
+
+struct RkRecorder {
+    RkVideoEncParams params;
+    RkRecorderSource source;
+    RkVideoEncoder* enc;
+    RkVideoMuxer* mux;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // CLOCK_MONOTONIC
+    bool stop;
+    uint64_t start_us;
+    int64_t end_us;             // 最后处理节拍的结束时刻（相对 start）
+    RkRecorderStats stats;
+};
+
+// Y 平面签名：隔行取 8 字节字做 FNV 式混合，只用于判断画面是否变化
+static bool frame_signature(RkDmaBuffer* buf, uint64_t* sig) {
+    size_t len = (size_t)buf->stride * buf->height;
+    uint8_t* y = (uint8_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_READ, 0, len);
+    if (!y) return false;
+    uint64_t h = 0xcbf29ce484222325ull;
+    size_t words = buf->width / 8;
+    for (int row = 0; row < buf->height; row += 2) {
+        const uint8_t* line = y + (size_t)row * buf->stride;
+        for (size_t i = 0; i < words; i++) {
+            uint64_t w;
+            memcpy(&w, line + i * 8, 8);
+            h = (h ^ w) * 0x100000001b3ull;
+        }
+    }
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_READ, 0, len);
+    *sig = h;
+    return true;
+}
+
+// 等到 due_us（绝对时刻）或被 stop 唤醒；返回 false 表示已停止
+static bool wait_until(RkRecorder* rec, uint64_t due_us) {
+    struct timespec ts;
+    ts.tv_sec = due_us / 1000000;
+    ts.tv_nsec = (due_us % 1000000) * 1000;
+    pthread_mutex_lock(&rec->lock);
+    while (!rec->stop && rk_get_time_us() < due_us) {
+        if (pthread_cond_timedwait(&rec->wake, &rec->lock, &ts) == ETIMEDOUT) break;
+    }
+    bool running = !rec->stop;
+    pthread_mutex_unlock(&rec->lock);
+    return running;
+}
+
+static void* record_thread(void* arg) {
+    RkRecorder* rec = (RkRecorder*)arg;
+    const uint64_t interval = 1000000 / rec->params.fps;
+    const uint64_t gop = rec->params.gop;
+    uint64_t tick = 0;
+    uint64_t last_key_tick = 0;
+    uint64_t last_sig = 0;
+    bool have_frame = false;
+
+    while (wait_until(rec, rec->start_us + tick * interval)) {
+        RkDmaBuffer* buf = nullptr;
+        RkScreenshotError err = rec->source.acquire(rec->source.user, &buf);
+        bool key_due = !have_frame || tick - last_key_tick >= gop;
+        bool encoded = false, key = false, failed = err != RKSS_SUCCESS;
+        size_t bytes = 0;
+        uint64_t encode_us = 0;
+
+        uint64_t sig = 0;
+        bool have_sig = !failed && frame_signature(buf, &sig);
+        if (!failed && !key_due && have_sig && sig == last_sig) {
+            // 画面未变：不编码，上一帧时长延长
+        } else if (!failed) {
+            RkMppPacket pkt;
+            uint64_t t0 = rk_get_time_us();
+            err = rec->enc->encode(rec->enc, buf, key_due, &pkt);
+            encode_us = rk_get_time_us() - t0;
+            if (err == RKSS_SUCCESS) {
+                key = rk_video_au_is_keyframe(rec->params.codec, pkt.data, pkt.size);
+                err = rk_video_muxer_write(rec->mux, pkt.data, pkt.size,
+                                           (int64_t)(tick * interval));
+                bytes = pkt.size;
+                pkt.release(pkt.buffer);
+            }
+            if (err == RKSS_SUCCESS) {
+                encoded = true;
+                have_frame = true;
+                last_sig = have_sig ? sig : ~sig;
+                if (key) last_key_tick = tick;
+            } else {
+                failed = true;
+            }
+        }
+        if (buf) rk_dmabuf_free(buf);
+
+        // 下一个节拍：处理超时则跳过已错过的节拍
+        uint64_t next = tick + 1;
+        uint64_t now_tick = (rk_get_time_us() - rec->start_us) / interval;
+        uint64_t late = now_tick > next ? now_tick - next : 0;
+
+        pthread_mutex_lock(&rec->lock);
+        rec->stats.ticks += 1 + late;
+        rec->stats.late_ticks += late;
+        if (encoded) {
+            rec->stats.frames++;
+            rec->stats.bytes += bytes;
+            rec->stats.encode_us += encode_us;
+            if (key) rec->stats.keyframes++;
+        } else if (failed) {
+            rec->stats.failures++;
+            if (rec->stats.failures == 1) {
+                ALOGW("⚠️ Recording tick %lu failed: %d", tick, err);
+            }
+        } else {
+            rec->stats.static_skips++;
+        }
+        if (have_frame) rec->end_us = (int64_t)((next + late) * interval);
+        pthread_mutex_unlock(&rec->lock);
+
+        tick = next + late;
+    }
+    return nullptr;
+}
+
+RkRecorder* rk_recorder_start(const RkVideoEncParams* params, const RkRecorderSource* source,
+                              RkVideoEncoder* enc, RkVideoMuxer* mux) {
+    RkRecorder* rec = nullptr;
+    if (params && source && source->acquire && enc && mux && params->fps > 0 &&
+        params->fps <= 1000 && params->gop > 0) {
+        rec = (RkRecorder*)calloc(1, sizeof(RkRecorder));
+    }
+    if (!rec) {
+        if (mux) rk_video_muxer_close(mux, 0);
+        rk_video_encoder_destroy(enc);
+        return nullptr;
+    }
+
+    rec->params = *params;
+    rec->source = *source;
+    rec->enc = enc;
+    rec->mux = mux;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&rec->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&rec->lock, NULL);
+    rec->start_us = rk_get_time_us();
+    if (pthread_create(&rec->thread, NULL, record_thread, rec) != 0) {
+        ALOGE("❌ Failed to start recording thread");
+        pthread_cond_destroy(&rec->wake);
+        pthread_mutex_destroy(&rec->lock);
+        rk_video_muxer_close(mux, 0);
+        rk_video_encoder_destroy(enc);
+        free(rec);
+        return nullptr;
+    }
+
+    ALOGI("🎥 Recording started: %dx%d @ %d fps, GOP %d, %d kbps (%s)", params->width,
+          params->height, params->fps, params->gop, params->bitrate / 1000, enc->name);
+    return rec;
+}
+
+void rk_recorder_get_stats(RkRecorder* rec, RkRecorderStats* stats) {
+    if (!rec || !stats) return;
+    pthread_mutex_lock(&rec->lock);
+    *stats = rec->stats;
+    pthread_mutex_unlock(&rec->lock);
+    stats->elapsed_us = rk_get_time_us() - rec->start_us;
+}
+
+RkScreenshotError rk_recorder_stop(RkRecorder* rec, RkRecorderStats* stats) {
+    if (!rec) return RKSS_ERROR_INVALID_PARAM;
+
+    pthread_mutex_lock(&rec->lock);
+    rec->stop = true;
+    pthread_cond_signal(&rec->wake);
+    pthread_mutex_unlock(&rec->lock);
+    pthread_join(rec->thread, NULL);
+
+    RkRecorderStats s;
+    rk_recorder_get_stats(rec, &s);
+    RkScreenshotError err = rk_video_muxer_close(rec->mux, rec->end_us);
+    rk_video_encoder_destroy(rec->enc);
+
+    ALOGI("🎥 Recording stopped: %lu ticks, %lu frames (%lu key), %lu static, %lu late, "
+          "%lu failed, %.1f KB, encode %.2f ms/frame",
+          s.ticks, s.frames, s.keyframes, s.static_skips, s.late_ticks, s.failures,
+          s.bytes / 1024.0, s.frames ? s.encode_us / 1000.0 / s.frames : 0.0);
+    if (stats) *stats = s;
+
+    pthread_cond_destroy(&rec->wake);
+    pthread_mutex_destroy(&rec->lock);
+    free(rec);
+    return err;
+}
@@ -0,0 +1,465 @@
+/**
+ * RK3588 RGA Executor - 异步作业提交 + 完成 fence
+ *
+ * 硬件执行器：improcess(IM_ASYNC)，完成句柄为 RGA 驱动的 sync_file
+ * 模拟执行器：单线程按 FIFO 在 CPU 上执行作业并补足 RGA 延迟，完成句柄为 pipe 读端
+ *            （成功时写入一字节后关闭，失败时直接关闭），主机上可测试提交/等待/级联的调度逻辑
+ * CPU 执行器：rk_cpu_process_job_ex 在提交线程上同步完成，无 RGA 或小作业时使用
+ * 混合执行器：小作业走 CPU，其余走 RGA，RGA 失败时退回 CPU
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/sync_file.h>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_RGA_Exec"
+
+// ============================================
+// Fence
+// ============================================
+
+RkScreenshotError rk_fence_wait(int fence, int timeout_ms) {
+    if (fence < 0) return RKSS_SUCCESS;
+
+    uint64_t deadline = timeout_ms < 0 ? 0 : rk_get_time_us() + (uint64_t)timeout_ms * 1000;
+    for (;;) {
+        int wait_ms = -1;
+        if (timeout_ms >= 0) {
+            uint64_t now = rk_get_time_us();
+            wait_ms = now >= deadline ? 0 : (int)((deadline - now + 999) / 1000);
+        }
+
+        struct pollfd pfd = {fence, POLLIN, 0};
+        int ret = poll(&pfd, 1, wait_ms);
+        if (ret > 0) {
+            if (pfd.revents & (POLLERR | POLLNVAL)) return RKSS_ERROR_RGA_FAILED;
+            // 以错误触发的 sync_file 同样只报 POLLIN，状态要另外读
+            struct sync_file_info info;
+            memset(&info, 0, sizeof(info));
+            if (ioctl(fence, SYNC_IOC_FILE_INFO, &info) == 0) {
+                if (info.status < 0) {
+                    ALOGE("❌ Fence %d signaled with error %d", fence, info.status);
+                    return RKSS_ERROR_RGA_FAILED;
+                }
+                return RKSS_SUCCESS;
+            }
+            // 不是 sync_file（模拟执行器的 pipe）：只挂断没有数据表示作业失败
+            return (pfd.revents & POLLIN) ? RKSS_SUCCESS : RKSS_ERROR_RGA_FAILED;
+        }
+        if (ret == 0) return RKSS_ERROR_TIMEOUT;
+        if (errno != EINTR) {
+            ALOGE("❌ Fence %d poll failed: %s", fence, strerror(errno));
+            return RKSS_ERROR_RGA_FAILED;
+        }
+    }
+}
+
+void rk_fence_close(int fence) {
+    if (fence >= 0) close(fence);
+}
+
+// ============================================
+// 硬件执行器
+// ============================================
+
+typedef struct {
+    RkRgaProcessor* proc;
+    int core;
+} HwExecutor;
+
+static RkScreenshotError hw_submit(RkRgaExecutor* exec, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                   const RkRgaJob* job, int acquire_fence, int* release_fence) {
+    HwExecutor* hw = (HwExecutor*)exec->priv;
+    return rk_rga_submit_job(hw->proc, src, dst, job, hw->core, acquire_fence, release_fence);
+}
+
+static RkScreenshotError hw_submit_batch(RkRgaExecutor* exec, RkDmaBuffer* src,
+                                         RkDmaBuffer* const* dsts, const RkRgaJob* jobs,
+                                         int count, int acquire_fence, int* release_fence) {
+    HwExecutor* hw = (HwExecutor*)exec->priv;
+    return rk_rga_submit_batch(hw->proc, src, dsts, jobs, count, hw->core,
+                               acquire_fence, release_fence);
+}
+
+static void hw_destroy(RkRgaExecutor* exec) {
+    free(exec->priv);
+    free(exec);
+}
+
+RkRgaExecutor* rk_rga_executor_create_hw(RkRgaProcessor* proc, int core) {
+    if (!proc || !proc->initialized) return nullptr;
+    if (core < RK_RGA_CORE_AUTO || core >= RK_RGA_CORE_COUNT) return nullptr;
+
+    RkRgaExecutor* exec = (RkRgaExecutor*)calloc(1, sizeof(RkRgaExecutor));
+    HwExecutor* hw = (HwExecutor*)calloc(1, sizeof(HwExecutor));
+    if (!exec || !hw) {
+        free(exec);
+        free(hw);
+        return nullptr;
+    }
+
+    static const char* const names[RK_RGA_CORE_COUNT] = {"rga3_core0", "rga3_core1", "rga2"};
+    hw->proc = proc;
+    hw->core = core;
+    exec->name = core == RK_RGA_CORE_AUTO ? "rga" : names[core];
+    exec->priv = hw;
+    exec->submit = hw_submit;
+    exec->submit_batch = hw_submit_batch;
+    exec->destroy = hw_destroy;
+    return exec;
+}
+
+// ============================================
+// 模拟执行器（CPU）
+// ============================================
+
+typedef struct EmuJob {
+    RkDmaBuffer* src;
+    RkDmaBuffer* dsts[RK_RGA_BATCH_MAX];
+    RkRgaJob jobs[RK_RGA_BATCH_MAX];
+    int count;              // 批量作业按顺序执行，每个作业各计一次延迟
+    int acquire_fence;      // dup，执行前等待，失败时本作业也失败
+    int signal_fd;          // pipe 写端，成功时写入一字节，完成后关闭
+    struct EmuJob* next;
+} EmuJob;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // 有新作业 / 停止
+    pthread_cond_t space;   // 队列有空位
+    EmuJob* head;
+    EmuJob* tail;
+    int queued;
+    int queue_depth;
+    int latency_us;
+    bool stop;
+    pthread_t thread;
+    uint64_t completed;
+    uint64_t failed;
+} EmuExecutor;
+
+static void* emu_thread(void* arg) {
+    EmuExecutor* emu = (EmuExecutor*)arg;
+
+    pthread_mutex_lock(&emu->lock);
+    for (;;) {
+        while (!emu->head && !emu->stop) {
+            pthread_cond_wait(&emu->work, &emu->lock);
+        }
+        EmuJob* j = emu->head;
+        if (!j) break;      // stop 且队列已空
+        pthread_mutex_unlock(&emu->lock);
+
+        // 级联：等待上一阶段，上一阶段失败则不执行
+        RkScreenshotError err = rk_fence_wait(j->acquire_fence, -1);
+        rk_fence_close(j->acquire_fence);
+
+        uint64_t t0 = rk_get_time_us();
+        for (int i = 0; i < j->count && err == RKSS_SUCCESS; i++) {
+            err = rk_cpu_process_job(j->src, j->dsts[i], &j->jobs[i]);
+        }
+        uint64_t elapsed = rk_get_time_us() - t0;
+        int64_t latency = (int64_t)emu->latency_us * j->count;
+        if ((int64_t)elapsed < latency) {
+            usleep(latency - elapsed);
+        }
+        if (err != RKSS_SUCCESS) {
+            ALOGE("❌ Emulated RGA job failed: %d", err);
+        }
+
+        uint8_t done = 1;
+        if (err == RKSS_SUCCESS && write(j->signal_fd, &done, 1) != 1) {
+            ALOGE("❌ Fence signal failed: %s", strerror(errno));
+        }
+        close(j->signal_fd);
+
+        pthread_mutex_lock(&emu->lock);
+        emu->head = j->next;
+        if (!emu->head) emu->tail = nullptr;
+        emu->queued--;
+        emu->completed++;
+        if (err != RKSS_SUCCESS) emu->failed++;
+        pthread_cond_signal(&emu->space);
+        free(j);
+    }
+    pthread_mutex_unlock(&emu->lock);
+    return nullptr;
+}
+
+static RkScreenshotError emu_submit_batch(RkRgaExecutor* exec, RkDmaBuffer* src,
+                                          RkDmaBuffer* const* dsts, const RkRgaJob* jobs,
+                                          int count, int acquire_fence, int* release_fence) {
+    EmuExecutor* emu = (EmuExecutor*)exec->priv;
+    if (!release_fence) return RKSS_ERROR_INVALID_PARAM;
+    *release_fence = -1;
+    if (!dsts || !jobs || count <= 0 || count > RK_RGA_BATCH_MAX) return RKSS_ERROR_INVALID_PARAM;
+
+    // 参数错误同步返回，与硬件提交一致
+    for (int i = 0; i < count; i++) {
+        RkScreenshotError err = rk_rga_job_check(src, dsts[i], &jobs[i]);
+        if (err != RKSS_SUCCESS) return err;
+    }
+
+    EmuJob* j = (EmuJob*)calloc(1, sizeof(EmuJob));
+    if (!j) return RKSS_ERROR_NO_MEMORY;
+    j->src = src;
+    j->count = count;
+    for (int i = 0; i < count; i++) {
+        j->dsts[i] = dsts[i];
+        j->jobs[i] = jobs[i];
+    }
+    j->acquire_fence = acquire_fence >= 0 ? dup(acquire_fence) : -1;
+
+    int pipe_fds[2] = {-1, -1};
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0 || (acquire_fence >= 0 && j->acquire_fence < 0)) {
+        rk_fence_close(pipe_fds[0]);
+        rk_fence_close(pipe_fds[1]);
+        rk_fence_close(j->acquire_fence);
+        free(j);
+        return RKSS_ERROR_NO_MEMORY;
+    }
+    int fence = pipe_fds[0];
+    j->signal_fd = pipe_fds[1];
+
+    pthread_mutex_lock(&emu->lock);
+    while (emu->queued >= emu->queue_depth) {
+        pthread_cond_wait(&emu->space, &emu->lock);
+    }
+    if (emu->tail) {
+        emu->tail->next = j;
+    } else {
+        emu->head = j;
+    }
+    emu->tail = j;
+    emu->queued++;
+    pthread_cond_signal(&emu->work);
+    pthread_mutex_unlock(&emu->lock);
+
+    *release_fence = fence;
+    return RKSS_SUCCESS;
+}
+
+static RkScreenshotError emu_submit(RkRgaExecutor* exec, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                    const RkRgaJob* job, int acquire_fence, int* release_fence) {
+    return emu_submit_batch(exec, src, &dst, job, 1, acquire_fence, release_fence);
+}
+
+static void emu_destroy(RkRgaExecutor* exec) {
+    EmuExecutor* emu = (EmuExecutor*)exec->priv;
+
+    pthread_mutex_lock(&emu->lock);
+    emu->stop = true;
+    pthread_cond_signal(&emu->work);
+    pthread_mutex_unlock(&emu->lock);
+    pthread_join(emu->thread, nullptr);
+
+    ALOGD("Emulated RGA: %lu jobs, %lu failed", emu->completed, emu->failed);
+    pthread_cond_destroy(&emu->space);
+    pthread_cond_destroy(&emu->work);
+    pthread_mutex_destroy(&emu->lock);
+    free(emu);
+    free(exec);
+}
+
+RkRgaExecutor* rk_rga_executor_create_emulated(int latency_us, int queue_depth) {
+    if (latency_us < 0 || queue_depth <= 0) return nullptr;
+
+    RkRgaExecutor* exec = (RkRgaExecutor*)calloc(1, sizeof(RkRgaExecutor));
+    EmuExecutor* emu = (EmuExecutor*)calloc(1, sizeof(EmuExecutor));
+    if (!exec || !emu) {
+        free(exec);
+        free(emu);
+        return nullptr;
+    }
+
+    emu->latency_us = latency_us;
+    emu->queue_depth = queue_depth;
+    pthread_mutex_init(&emu->lock, NULL);
+    pthread_cond_init(&emu->work, NULL);
+    pthread_cond_init(&emu->space, NULL);
+    if (pthread_create(&emu->thread, NULL, emu_thread, emu) != 0) {
+        pthread_cond_destroy(&emu->space);
+        pthread_cond_destroy(&emu->work);
+        pthread_mutex_destroy(&emu->lock);
+        free(emu);
+        free(exec);
+        return nullptr;
+    }
+
+    exec->name = "emulated";
+    exec->priv = emu;
+    exec->submit = emu_submit;
+    exec->submit_batch = emu_submit_batch;
+    exec->destroy = emu_destroy;
+    return exec;
+}
+
+// ============================================
+// CPU 执行器
+// ============================================
+
+typedef struct {
+    RkThreadPool* pool;
+    RkCpuFilter filter;
+    uint64_t jobs;          // 原子累加
+    uint64_t busy_us;
+} CpuExecutor;
+
+static RkScreenshotError cpu_submit_batch(RkRgaExecutor* exec, RkDmaBuffer* src,
+                                          RkDmaBuffer* const* dsts, const RkRgaJob* jobs,
+                                          int count, int acquire_fence, int* release_fence) {
+    CpuExecutor* cpu = (CpuExecutor*)exec->priv;
+    if (!release_fence) return RKSS_ERROR_INVALID_PARAM;
+    *release_fence = -1;
+    if (!dsts || !jobs || count <= 0 || count > RK_RGA_BATCH_MAX) return RKSS_ERROR_INVALID_PARAM;
+
+    for (int i = 0; i < count; i++) {
+        RkScreenshotError err = rk_rga_job_check(src, dsts[i], &jobs[i]);
+        if (err != RKSS_SUCCESS) return err;
+    }
+
+    // 同步执行：返回时已完成，release fence 为 -1（rk_fence_wait 视为已触发）
+    RkScreenshotError err = rk_fence_wait(acquire_fence, -1);
+    if (err != RKSS_SUCCESS) return err;
+
+    uint64_t t0 = rk_get_time_us();
+    for (int i = 0; i < count && err == RKSS_SUCCESS; i++) {
+        err = rk_cpu_process_job_ex(src, dsts[i], &jobs[i], cpu->filter, cpu->pool);
+    }
+    __atomic_add_fetch(&cpu->jobs, (uint64_t)count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&cpu->busy_us, rk_get_time_us() - t0, __ATOMIC_RELAXED);
+    return err;
+}
+
+static RkScreenshotError cpu_submit(RkRgaExecutor* exec, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                    const RkRgaJob* job, int acquire_fence, int* release_fence) {
+    return cpu_submit_batch(exec, src, &dst, job, 1, acquire_fence, release_fence);
+}
+
+static void cpu_destroy(RkRgaExecutor* exec) {
+    CpuExecutor* cpu = (CpuExecutor*)exec->priv;
+    ALOGD("CPU executor: %lu jobs, %.2f ms busy (%d threads)", cpu->jobs,
+          cpu->busy_us / 1000.0, rk_thread_pool_size(cpu->pool));
+    rk_thread_pool_destroy(cpu->pool);
+    free(cpu);
+    free(exec);
+}
+
+RkRgaExecutor* rk_rga_executor_create_cpu(int threads, RkCpuFilter filter) {
+    RkRgaExecutor* exec = (RkRgaExecutor*)calloc(1, sizeof(RkRgaExecutor));
+    CpuExecutor* cpu = (CpuExecutor*)calloc(1, sizeof(CpuExecutor));
+    RkThreadPool* pool = threads == 1 ? nullptr : rk_thread_pool_create(threads);
+    if (!exec || !cpu || (threads != 1 && !pool)) {
+        rk_thread_pool_destroy(pool);
+        free(exec);
+        free(cpu);
+        return nullptr;
+    }
+
+    cpu->pool = pool;
+    cpu->filter = filter;
+    exec->name = "cpu";
+    exec->priv = cpu;
+    exec->submit = cpu_submit;
+    exec->submit_batch = cpu_submit_batch;
+    exec->destroy = cpu_destroy;
+    return exec;
+}
+
+// ============================================
+// 混合执行器（RGA + CPU）
+// ============================================
+
+typedef struct {
+    RkRgaExecutor* rga;
+    RkRgaExecutor* cpu;
+    uint64_t rga_jobs;      // 原子累加
+    uint64_t tiny_jobs;
+    uint64_t fallback_jobs;
+} HybridExecutor;
+
+static bool batch_is_tiny(RkDmaBuffer* src, RkDmaBuffer* const* dsts, const RkRgaJob* jobs,
+                          int count) {
+    for (int i = 0; i < count; i++) {
+        RkRgaJobDesc desc;
+        rk_rga_job_describe(src, dsts[i], &jobs[i], &desc);
+        if (!rk_cpu_job_is_tiny(&desc)) return false;
+    }
+    return true;
+}
+
+static RkScreenshotError hybrid_submit_batch(RkRgaExecutor* exec, RkDmaBuffer* src,
+                                             RkDmaBuffer* const* dsts, const RkRgaJob* jobs,
+                                             int count, int acquire_fence, int* release_fence) {
+    HybridExecutor* hy = (HybridExecutor*)exec->priv;
+    if (!release_fence) return RKSS_ERROR_INVALID_PARAM;
+    *release_fence = -1;
+    if (!dsts || !jobs || count <= 0 || count > RK_RGA_BATCH_MAX) return RKSS_ERROR_INVALID_PARAM;
+
+    if (batch_is_tiny(src, dsts, jobs, count)) {
+        __atomic_add_fetch(&hy->tiny_jobs, (uint64_t)count, __ATOMIC_RELAXED);
+        return hy->cpu->submit_batch(hy->cpu, src, dsts, jobs, count, acquire_fence,
+                                     release_fence);
+    }
+
+    RkScreenshotError err = count == 1
+        ? hy->rga->submit(hy->rga, src, dsts[0], jobs, acquire_fence, release_fence)
+        : hy->rga->submit_batch(hy->rga, src, dsts, jobs, count, acquire_fence, release_fence);
+    if (err != RKSS_ERROR_RGA_FAILED) {
+        if (err == RKSS_SUCCESS) __atomic_add_fetch(&hy->rga_jobs, (uint64_t)count, __ATOMIC_RELAXED);
+        return err;
+    }
+
+    // 提交失败（核心不支持该尺寸/格式、驱动错误）：CPU 完成
+    ALOGW("⚠️ RGA submit failed, running %d job(s) on CPU", count);
+    __atomic_add_fetch(&hy->fallback_jobs, (uint64_t)count, __ATOMIC_RELAXED);
+    return hy->cpu->submit_batch(hy->cpu, src, dsts, jobs, count, acquire_fence, release_fence);
+}
+
+static RkScreenshotError hybrid_submit(RkRgaExecutor* exec, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                       const RkRgaJob* job, int acquire_fence,
+                                       int* release_fence) {
+    return hybrid_submit_batch(exec, src, &dst, job, 1, acquire_fence, release_fence);
+}
+
+static void hybrid_destroy(RkRgaExecutor* exec) {
+    HybridExecutor* hy = (HybridExecutor*)exec->priv;
+    ALOGD("Hybrid executor: %lu on %s, %lu tiny + %lu fallback on CPU", hy->rga_jobs,
+          hy->rga->name, hy->tiny_jobs, hy->fallback_jobs);
+    rk_rga_executor_destroy(hy->rga);
+    rk_rga_executor_destroy(hy->cpu);
+    free(hy);
+    free(exec);
+}
+
+RkRgaExecutor* rk_rga_executor_create_hybrid(RkRgaExecutor* rga, RkRgaExecutor* cpu) {
+    if (!rga || !cpu) return nullptr;
+
+    RkRgaExecutor* exec = (RkRgaExecutor*)calloc(1, sizeof(RkRgaExecutor));
+    HybridExecutor* hy = (HybridExecutor*)calloc(1, sizeof(HybridExecutor));
+    if (!exec || !hy) {
+        free(exec);
+        free(hy);
+        return nullptr;
+    }
+
+    hy->rga = rga;
+    hy->cpu = cpu;
+    exec->name = "hybrid";
+    exec->priv = hy;
+    exec->submit = hybrid_submit;
+    exec->submit_batch = hybrid_submit_batch;
+    exec->destroy = hybrid_destroy;
+    return exec;
+}
+
+void rk_rga_executor_destroy(RkRgaExecutor* exec) {
+    if (exec) exec->destroy(exec);
+}
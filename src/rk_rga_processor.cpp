@@ -10,6 +10,43 @@
 #undef LOG_TAG
 #define LOG_TAG "RK_RGA"
 
+// RkImageFormat -> RGA 格式（rk_rga_job_check 已限定取值）
+static int rga_format(int format) {
+    switch (format) {
+        case RK_FORMAT_RGB888: return RK_FORMAT_RGB_888;
+        case RK_FORMAT_BGR888: return RK_FORMAT_BGR_888;
+        case RK_FORMAT_YUV420SP: return RK_FORMAT_YCbCr_420_SP;
+        case RK_FORMAT_YUV420P: return RK_FORMAT_YCbCr_420_P;
+        default: return RK_FORMAT_RGBA_8888;
+    }
+}
+
+static rga_buffer_t wrap_buffer(const RkDmaBuffer* buf) {
+    if (buf->rga_handle) {
+        return wrapbuffer_handle((rga_buffer_handle_t)buf->rga_handle, buf->width, buf->height,
+                                 rga_format(buf->format), buf->stride, buf->height_stride);
+    }
+    return wrapbuffer_fd(buf->fd, buf->width, buf->height,
+                         rga_format(buf->format), buf->stride, buf->height_stride);
+}
+
+uint64_t rk_rga_import(const RkDmaBuffer* buf) {
+    if (!buf || buf->fd < 0) return 0;
+
+    rga_buffer_handle_t handle = importbuffer_fd(buf->fd, (int)buf->size);
+    if (!handle) {
+        ALOGW("⚠️ importbuffer_fd failed: fd=%d", buf->fd);
+        return 0;
+    }
+    return (uint64_t)handle;
+}
+
+void rk_rga_release_import(uint64_t handle) {
+    if (handle) {
+        releasebuffer_handle((rga_buffer_handle_t)handle);
+    }
+}
+
 RkScreenshotError rk_rga_init(RkRgaProcessor* proc) {
     if (!proc) return RKSS_ERROR_INVALID_PARAM;
 
@@ -22,6 +59,18 @@ RkScreenshotError rk_rga_init(RkRgaProcessor* proc) {
     }
 
     ALOGI("RGA: %s", version);
+    size_t len = strcspn(version, "\n");
+    if (len >= sizeof(proc->version)) len = sizeof(proc->version) - 1;
+    memcpy(proc->version, version, len);
+    proc->version[len] = '\0';
+
+    // 版本串按核心列出，如 "RGA_3 [0x...]" / "RGA_2_Enhance [0x...]"
+    if (strstr(version, "RGA_3")) {
+        proc->core_mask |= (1u << RK_RGA_CORE_RGA3_0) | (1u << RK_RGA_CORE_RGA3_1);
+    }
+    if (strstr(version, "RGA_2")) {
+        proc->core_mask |= 1u << RK_RGA_CORE_RGA2;
+    }
     pthread_mutex_init(&proc->lock, NULL);
     proc->initialized = true;
     return RKSS_SUCCESS;
@@ -30,9 +79,11 @@ RkScreenshotError rk_rga_init(RkRgaProcessor* proc) {
 void rk_rga_deinit(RkRgaProcessor* proc) {
     if (!proc || !proc->initialized) return;
     
+    uint64_t sync_ops = proc->total_ops - proc->async_ops;
     if (proc->total_ops > 0) {
-        ALOGI("RGA stats: %lu ops, avg %.2f ms",
-              proc->total_ops, proc->total_time_us / proc->total_ops / 1000.0);
+        ALOGI("RGA stats: %lu ops (%lu async), sync avg %.2f ms",
+              proc->total_ops, proc->async_ops,
+              sync_ops ? proc->total_time_us / sync_ops / 1000.0 : 0.0);
     }
     
     pthread_mutex_destroy(&proc->lock);
@@ -45,44 +96,297 @@ RkScreenshotError rk_rga_process(
     RkDmaBuffer* dst,
     int rotation)
 {
+    RkRgaJob job;
+    memset(&job, 0, sizeof(job));
+    job.rotation = rotation;
+    return rk_rga_process_job(proc, src, dst, &job);
+}
+
+// 作业 -> improcess usage（不含 IM_SYNC/IM_ASYNC）
+// 两个方向同时镜像等价于旋转 180 度；RGA 先镜像后旋转，
+// 而作业语义是镜像输出图像，90/270 度时镜像方向需互换
+static int job_usage(const RkRgaJob* job) {
+    int rotation = job->rotation;
+    bool flip_h = job->flip_horizontal;
+    bool flip_v = job->flip_vertical;
+    if (flip_h && flip_v) {
+        rotation = (rotation + 180) % 360;
+        flip_h = flip_v = false;
+    }
+    if (rotation == 90 || rotation == 270) {
+        bool t = flip_h;
+        flip_h = flip_v;
+        flip_v = t;
+    }
+
+    int usage = 0;
+    switch (rotation) {
+        case 90:  usage |= IM_HAL_TRANSFORM_ROT_90; break;
+        case 180: usage |= IM_HAL_TRANSFORM_ROT_180; break;
+        case 270: usage |= IM_HAL_TRANSFORM_ROT_270; break;
+        default: break;
+    }
+    if (flip_h) usage |= IM_HAL_TRANSFORM_FLIP_H;
+    if (flip_v) usage |= IM_HAL_TRANSFORM_FLIP_V;
+    return usage;
+}
+
+// 一次 improcess 的全部参数
+typedef struct {
+    rga_buffer_t src;
+    rga_buffer_t dst;
+    rga_buffer_t pat;
+    im_rect src_rect;
+    im_rect dst_rect;
+    im_rect pat_rect;
+    int usage;
+} RgaTask;
+
+static RkScreenshotError build_task(RkRgaProcessor* proc, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                    const RkRgaJob* job, RgaTask* task) {
     if (!proc || !proc->initialized) return RKSS_ERROR_NOT_INITIALIZED;
     if (!src || !dst || src->fd < 0 || dst->fd < 0) return RKSS_ERROR_INVALID_PARAM;
 
+    RkScreenshotError err = rk_rga_job_check(src, dst, job);
+    if (err != RKSS_SUCCESS) return err;
+
+    // 已导入的 buffer 直接用句柄，否则按 DMA-BUF fd 创建 RGA buffer
+    task->src = wrap_buffer(src);
+    task->dst = wrap_buffer(dst);
+    if (dst->format == RK_FORMAT_YUV420SP || dst->format == RK_FORMAT_YUV420P) {
+        // JPEG (JFIF) 按全范围 BT.601 解码
+        task->dst.color_space_mode = IM_RGB_TO_YUV_BT601_FULL;
+    }
+    memset(&task->pat, 0, sizeof(task->pat));
+
+    task->src_rect = {0, 0, src->width, src->height};
+    if (job->crop_width > 0 && job->crop_height > 0) {
+        task->src_rect = {job->crop_x, job->crop_y, job->crop_width, job->crop_height};
+    }
+    task->dst_rect = {0, 0, dst->width, dst->height};
+    if (job->dst_width > 0 && job->dst_height > 0) {
+        task->dst_rect = {job->dst_x, job->dst_y, job->dst_width, job->dst_height};
+    }
+    task->pat_rect = {0, 0, 0, 0};
+    task->usage = job_usage(job);
+    return RKSS_SUCCESS;
+}
+
+static RkScreenshotError process_one(RkRgaProcessor* proc, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                     const RkRgaJob* job) {
+    RgaTask task;
+    RkScreenshotError err = build_task(proc, src, dst, job, &task);
+    if (err != RKSS_SUCCESS) return err;
+
+    uint64_t t0 = rk_get_time_us();
+
+    // 裁剪 + 缩放 + 旋转 + 镜像一次提交，只读写 DMA-BUF 一遍
+    // librga 自身支持多线程提交，阻塞等待期间不持 proc->lock
+    IM_STATUS status = improcess(task.src, task.dst, task.pat, task.src_rect, task.dst_rect,
+                                 task.pat_rect, task.usage | IM_SYNC);
+
+    uint64_t elapsed = rk_get_time_us() - t0;
     pthread_mutex_lock(&proc->lock);
+    proc->total_ops++;
+    proc->total_time_us += elapsed;
+    pthread_mutex_unlock(&proc->lock);
+
+    if (status != IM_STATUS_SUCCESS) {
+        ALOGE("❌ RGA failed: %s", imStrError(status));
+        return RKSS_ERROR_RGA_FAILED;
+    }
+
+    ALOGD("✅ RGA: %dx%d [%d,%d %dx%d] -> %dx%d %s (rot %d%s%s) in %.2f ms",
+          src->width, src->height, task.src_rect.x, task.src_rect.y,
+          task.src_rect.width, task.src_rect.height,
+          dst->width, dst->height, rk_format_name(dst->format),
+          job->rotation,
+          job->flip_horizontal ? ", flip H" : "", job->flip_vertical ? ", flip V" : "",
+          elapsed / 1000.0);
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_rga_process_job(
+    RkRgaProcessor* proc,
+    RkDmaBuffer* src,
+    RkDmaBuffer* dst,
+    const RkRgaJob* job)
+{
+    if (!proc || !proc->initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!src || !dst || !job) return RKSS_ERROR_INVALID_PARAM;
+
+    // 超出单次尺寸上限时逐块同步处理；无法切分时仍整体提交，由驱动报错
+    RkRgaJob tiles[RK_RGA_TILE_MAX];
+    int count = rk_rga_job_split(src, dst, job, proc->core_mask, tiles);
+    if (count <= 1) return process_one(proc, src, dst, job);
+
     uint64_t t0 = rk_get_time_us();
+    for (int i = 0; i < count; i++) {
+        uint64_t t_tile = rk_get_time_us();
+        RkScreenshotError err = process_one(proc, src, dst, &tiles[i]);
+        if (err != RKSS_SUCCESS) return err;
+        ALOGD("   tile %d/%d: [%d,%d %dx%d] -> [%d,%d %dx%d] in %.2f ms", i + 1, count,
+              tiles[i].crop_x, tiles[i].crop_y, tiles[i].crop_width, tiles[i].crop_height,
+              tiles[i].dst_x, tiles[i].dst_y, tiles[i].dst_width, tiles[i].dst_height,
+              (rk_get_time_us() - t_tile) / 1000.0);
+    }
+    ALOGD("✅ RGA tiled: %d tiles in %.2f ms", count, (rk_get_time_us() - t0) / 1000.0);
+    return RKSS_SUCCESS;
+}
 
-    // 使用 DMA-BUF fd 创建 RGA buffer
-    rga_buffer_t rga_src = wrapbuffer_fd(src->fd, src->width, src->height,
-                                         RK_FORMAT_RGBA_8888, src->stride, src->height);
-    rga_buffer_t rga_dst = wrapbuffer_fd(dst->fd, dst->width, dst->height,
-                                         RK_FORMAT_RGBA_8888, dst->stride, dst->height);
+// 指定执行核心，RK_RGA_CORE_AUTO 时 opt.core = 0 由驱动调度
+static void core_opt(int core, im_opt_t* opt) {
+    memset(opt, 0, sizeof(*opt));
+    switch (core) {
+        case RK_RGA_CORE_RGA3_0: opt->core = IM_SCHEDULER_RGA3_CORE0; break;
+        case RK_RGA_CORE_RGA3_1: opt->core = IM_SCHEDULER_RGA3_CORE1; break;
+        case RK_RGA_CORE_RGA2:   opt->core = IM_SCHEDULER_RGA2_CORE0; break;
+        default: break;
+    }
+}
 
-    IM_STATUS status;
-    
-    if (rotation == 90) {
-        status = imrotate(rga_src, rga_dst, IM_HAL_TRANSFORM_ROT_90);
-    } else if (rotation == 180) {
-        status = imrotate(rga_src, rga_dst, IM_HAL_TRANSFORM_ROT_180);
-    } else if (rotation == 270) {
-        status = imrotate(rga_src, rga_dst, IM_HAL_TRANSFORM_ROT_270);
-    } else if (src->width == dst->width && src->height == dst->height) {
-        status = imcopy(rga_src, rga_dst);
+RkScreenshotError rk_rga_submit_job(
+    RkRgaProcessor* proc,
+    RkDmaBuffer* src,
+    RkDmaBuffer* dst,
+    const RkRgaJob* job,
+    int core,
+    int acquire_fence,
+    int* release_fence)
+{
+    if (!release_fence) return RKSS_ERROR_INVALID_PARAM;
+    *release_fence = -1;
+
+    RgaTask task;
+    RkScreenshotError err = build_task(proc, src, dst, job, &task);
+    if (err != RKSS_SUCCESS) return err;
+
+    im_opt_t opt;
+    core_opt(core, &opt);
+
+    int fence = -1;
+    IM_STATUS status = improcess(task.src, task.dst, task.pat, task.src_rect, task.dst_rect,
+                                 task.pat_rect, acquire_fence, &fence, &opt,
+                                 task.usage | IM_ASYNC);
+
+    pthread_mutex_lock(&proc->lock);
+    proc->total_ops++;
+    proc->async_ops++;
+    pthread_mutex_unlock(&proc->lock);
+
+    if (status != IM_STATUS_SUCCESS) {
+        ALOGE("❌ RGA submit failed: %s", imStrError(status));
+        if (fence >= 0) rk_fence_close(fence);
+        return RKSS_ERROR_RGA_FAILED;
+    }
+
+    ALOGD("✅ RGA submitted: %dx%d -> %dx%d %s, core %d, fence %d",
+          src->width, src->height, dst->width, dst->height, rk_format_name(dst->format),
+          core, fence);
+    *release_fence = fence;
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_rga_submit_batch(
+    RkRgaProcessor* proc,
+    RkDmaBuffer* src,
+    RkDmaBuffer* const* dsts,
+    const RkRgaJob* jobs,
+    int count,
+    int core,
+    int acquire_fence,
+    int* release_fence)
+{
+    if (!release_fence) return RKSS_ERROR_INVALID_PARAM;
+    *release_fence = -1;
+    if (!dsts || !jobs || count <= 0 || count > RK_RGA_BATCH_MAX) return RKSS_ERROR_INVALID_PARAM;
+
+    // 参数全部校验通过再开始 job，避免提交半批
+    RgaTask tasks[RK_RGA_BATCH_MAX];
+    for (int i = 0; i < count; i++) {
+        RkScreenshotError err = build_task(proc, src, dsts[i], &jobs[i], &tasks[i]);
+        if (err != RKSS_SUCCESS) return err;
+    }
+
+    im_opt_t opt;
+    core_opt(core, &opt);
+
+    // 一个 job 内多个 task：驱动一次调度，源图各 task 共享
+    im_job_handle_t handle = imbeginJob();
+    if (!handle) {
+        ALOGE("❌ RGA imbeginJob failed");
+        return RKSS_ERROR_RGA_FAILED;
+    }
+
+    IM_STATUS status = IM_STATUS_SUCCESS;
+    for (int i = 0; i < count && status == IM_STATUS_SUCCESS; i++) {
+        RgaTask* t = &tasks[i];
+        status = improcessTask(handle, t->src, t->dst, t->pat, t->src_rect, t->dst_rect,
+                               t->pat_rect, &opt, t->usage);
+    }
+
+    int fence = -1;
+    if (status == IM_STATUS_SUCCESS) {
+        status = imendJob(handle, IM_ASYNC, acquire_fence, &fence);
     } else {
-        status = imresize(rga_src, rga_dst);
+        imcancelJob(handle);
     }
 
+    pthread_mutex_lock(&proc->lock);
+    proc->total_ops += count;
+    proc->async_ops += count;
+    pthread_mutex_unlock(&proc->lock);
+
+    if (status != IM_STATUS_SUCCESS) {
+        ALOGE("❌ RGA batch submit failed: %s", imStrError(status));
+        if (fence >= 0) rk_fence_close(fence);
+        return RKSS_ERROR_RGA_FAILED;
+    }
+
+    ALOGD("✅ RGA batch submitted: %dx%d -> %d outputs, core %d, fence %d",
+          src->width, src->height, count, core, fence);
+    *release_fence = fence;
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_rga_blend(
+    RkRgaProcessor* proc,
+    RkDmaBuffer* fg,
+    RkDmaBuffer* dst,
+    int x,
+    int y,
+    int width,
+    int height)
+{
+    if (!proc || !proc->initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!fg || !dst || fg->fd < 0 || dst->fd < 0 || width <= 0 || height <= 0 ||
+        width > fg->width || height > fg->height || x < 0 || y < 0 ||
+        x + width > dst->width || y + height > dst->height) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+
+    // pat 为空时 RGA 以 dst 为背景：dst = fg + dst * (1 - fg.a)，fg 已预乘
+    rga_buffer_t src = wrap_buffer(fg);
+    rga_buffer_t bg = wrap_buffer(dst);
+    rga_buffer_t pat;
+    memset(&pat, 0, sizeof(pat));
+    im_rect src_rect = {0, 0, width, height};
+    im_rect dst_rect = {x, y, width, height};
+    im_rect pat_rect = {0, 0, 0, 0};
+
+    uint64_t t0 = rk_get_time_us();
+    IM_STATUS status = improcess(src, bg, pat, src_rect, dst_rect, pat_rect,
+                                 IM_ALPHA_BLEND_SRC_OVER | IM_ALPHA_BLEND_PRE_MUL | IM_SYNC);
+
     uint64_t elapsed = rk_get_time_us() - t0;
+    pthread_mutex_lock(&proc->lock);
     proc->total_ops++;
     proc->total_time_us += elapsed;
-    
     pthread_mutex_unlock(&proc->lock);
 
     if (status != IM_STATUS_SUCCESS) {
-        ALOGE("❌ RGA failed: %s", imStrError(status));
+        ALOGE("❌ RGA blend failed: %s", imStrError(status));
         return RKSS_ERROR_RGA_FAILED;
     }
-
-    ALOGD("✅ RGA: %dx%d -> %dx%d in %.2f ms",
-          src->width, src->height, dst->width, dst->height, elapsed / 1000.0);
     return RKSS_SUCCESS;
 }
@@ -0,0 +1,426 @@
+/**
+ * RK3588 RGA Scheduler - RGA3 core0/core1 + RGA2 多核分派
+ *
+ * 策略（rk_rga_sched_pick）是纯函数：按核心能力过滤，再选
+ * "在途估计耗时 + 本作业估计耗时" 最小的核心，两核 RGA3 自然轮流分担；
+ * 批量作业整体放在一个同时支持其全部作业的核心上。
+ * 调度器本身也是 RkRgaExecutor，每核一个子执行器；设备上为指定核心的 hw 执行器，
+ * 主机上换成模拟执行器即可测试和压测策略。
+ * 回收线程 poll 所有在途 fence，统计每核实测占用时间与队列深度。
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_RGA_Sched"
+
+// ============================================
+// 核心能力与成本（RK RGA 手册 + 实测标定）
+// ============================================
+
+typedef struct {
+    int min_size;               // 输入/输出最小宽高
+    int max_src;                // 输入最大宽高
+    int max_dst;                // 输出最大宽高
+    int max_scale;              // 放大/缩小倍数上限
+    bool planar_yuv_out;        // 可输出 I420
+    uint32_t setup_us;          // 单作业固定开销
+    uint32_t pixels_per_us;     // 吞吐（按源/目标中较大者计像素）
+    uint32_t rotate_cost_pct;   // 90/270 度旋转的耗时倍率
+    bool addr_32bit;            // 只能访问 4G 以下物理地址
+} RgaCoreCaps;
+
+static const RgaCoreCaps kCoreCaps[RK_RGA_CORE_COUNT] = {
+    // RGA3：大图吞吐约为 RGA2 的两倍，但启动开销高，不支持平面 YUV
+    {68, 8176, 8128, 8, false, 150, 900, 125, false},
+    {68, 8176, 8128, 8, false, 150, 900, 125, false},
+    // RGA2-Enhance：输出最大 4096，缩放范围更大，小作业更快；MMU 只有 32 位
+    {2, 8192, 4096, 16, true, 60, 450, 150, true},
+};
+
+static const char* const kCoreNames[RK_RGA_CORE_COUNT] = {"rga3_core0", "rga3_core1", "rga2"};
+
+void rk_rga_job_describe(const RkDmaBuffer* src, const RkDmaBuffer* dst, const RkRgaJob* job,
+                         RkRgaJobDesc* desc) {
+    bool crop = job->crop_width > 0 && job->crop_height > 0;
+    bool rect = job->dst_width > 0 && job->dst_height > 0;
+    desc->src_width = crop ? job->crop_width : src->width;
+    desc->src_height = crop ? job->crop_height : src->height;
+    desc->dst_width = rect ? job->dst_width : dst->width;
+    desc->dst_height = rect ? job->dst_height : dst->height;
+    desc->dst_format = dst->format;
+    desc->rotation = job->rotation;
+    // SurfaceFlinger / 外部导入的 buffer 地址未知，按可能在 4G 以上处理
+    desc->high_mem = !src->dma32 || !dst->dma32;
+}
+
+bool rk_rga_core_supports(int core, const RkRgaJobDesc* desc) {
+    if (core < 0 || core >= RK_RGA_CORE_COUNT || !desc) return false;
+    const RgaCoreCaps* caps = &kCoreCaps[core];
+
+    if (desc->src_width < caps->min_size || desc->src_height < caps->min_size ||
+        desc->dst_width < caps->min_size || desc->dst_height < caps->min_size) {
+        return false;
+    }
+    if (desc->src_width > caps->max_src || desc->src_height > caps->max_src ||
+        desc->dst_width > caps->max_dst || desc->dst_height > caps->max_dst) {
+        return false;
+    }
+    if (desc->dst_format == RK_FORMAT_YUV420P && !caps->planar_yuv_out) return false;
+    if (desc->high_mem && caps->addr_32bit) return false;
+
+    // 缩放比按旋转后的方向比较
+    bool swap = desc->rotation == 90 || desc->rotation == 270;
+    int out_w = swap ? desc->dst_height : desc->dst_width;
+    int out_h = swap ? desc->dst_width : desc->dst_height;
+    int m = caps->max_scale;
+    if (out_w > desc->src_width * m || desc->src_width > out_w * m) return false;
+    if (out_h > desc->src_height * m || desc->src_height > out_h * m) return false;
+    return true;
+}
+
+void rk_rga_core_max_size(int core, int* max_src, int* max_dst) {
+    bool valid = core >= 0 && core < RK_RGA_CORE_COUNT;
+    if (max_src) *max_src = valid ? kCoreCaps[core].max_src : 0;
+    if (max_dst) *max_dst = valid ? kCoreCaps[core].max_dst : 0;
+}
+
+uint32_t rk_rga_core_cost_us(int core, const RkRgaJobDesc* desc) {
+    if (core < 0 || core >= RK_RGA_CORE_COUNT || !desc) return 0;
+    const RgaCoreCaps* caps = &kCoreCaps[core];
+
+    uint64_t src_px = (uint64_t)desc->src_width * desc->src_height;
+    uint64_t dst_px = (uint64_t)desc->dst_width * desc->dst_height;
+    uint64_t us = (src_px > dst_px ? src_px : dst_px) / caps->pixels_per_us;
+    if (desc->rotation == 90 || desc->rotation == 270) {
+        us = us * caps->rotate_cost_pct / 100;
+    }
+    return (uint32_t)(caps->setup_us + us);
+}
+
+// 核心须支持全部作业，返回成本之和；不支持返回 0
+static uint64_t batch_cost_us(int core, const RkRgaJobDesc* descs, int count) {
+    uint64_t cost = 0;
+    for (int i = 0; i < count; i++) {
+        if (!rk_rga_core_supports(core, &descs[i])) return 0;
+        cost += rk_rga_core_cost_us(core, &descs[i]);
+    }
+    return cost;
+}
+
+int rk_rga_sched_pick(const RkRgaJobDesc* desc, const uint64_t pending_us[RK_RGA_CORE_COUNT],
+                      uint32_t core_mask) {
+    return rk_rga_sched_pick_batch(desc, 1, pending_us, core_mask);
+}
+
+int rk_rga_sched_pick_batch(const RkRgaJobDesc* descs, int count,
+                            const uint64_t pending_us[RK_RGA_CORE_COUNT], uint32_t core_mask) {
+    if (!descs || count <= 0) return -1;
+
+    int best = -1;
+    uint64_t best_finish = 0;
+    for (int core = 0; core < RK_RGA_CORE_COUNT; core++) {
+        if (!(core_mask & (1u << core))) continue;
+        uint64_t cost = batch_cost_us(core, descs, count);
+        if (!cost) continue;
+
+        uint64_t finish = pending_us[core] + cost;
+        // 同样完成时间取在途更少的核心，再按编号
+        if (best < 0 || finish < best_finish ||
+            (finish == best_finish && pending_us[core] < pending_us[best])) {
+            best = core;
+            best_finish = finish;
+        }
+    }
+    return best;
+}
+
+// ============================================
+// 调度执行器
+// ============================================
+
+typedef struct {
+    int core;
+    int fence;              // release fence 的 dup，回收线程关闭
+    uint64_t submit_us;
+    uint64_t cost_us;
+} InFlightJob;
+
+typedef struct {
+    RkRgaExecutor* cores[RK_RGA_CORE_COUNT];
+    uint32_t core_mask;
+
+    pthread_mutex_t lock;
+    RkRgaCoreStats stats[RK_RGA_CORE_COUNT];
+    uint64_t last_done_us[RK_RGA_CORE_COUNT];
+    InFlightJob* inflight;
+    int inflight_count;
+    int inflight_cap;
+    uint64_t unsupported;   // 无核心可执行的作业
+
+    int wake_fd;            // eventfd：新作业 / 停止
+    bool stop;
+    pthread_t thread;
+    uint64_t start_us;
+} RgaScheduler;
+
+static void wake_reaper(RgaScheduler* s) {
+    uint64_t one = 1;
+    if (write(s->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        ALOGE("❌ Scheduler wake failed: %s", strerror(errno));
+    }
+}
+
+// 同一核心的作业按提交顺序完成：占用从 max(提交, 上一作业完成) 算起
+// （等待 acquire fence 的时间也计入占用，偏保守）
+static void retire_locked(RgaScheduler* s, int index, uint64_t now) {
+    InFlightJob* j = &s->inflight[index];
+    RkRgaCoreStats* st = &s->stats[j->core];
+
+    uint64_t start = j->submit_us > s->last_done_us[j->core] ? j->submit_us
+                                                             : s->last_done_us[j->core];
+    if (now > start) st->busy_us += now - start;
+    s->last_done_us[j->core] = now;
+    st->pending_us -= j->cost_us;
+    st->queued--;
+    close(j->fence);
+
+    s->inflight[index] = s->inflight[--s->inflight_count];
+}
+
+static void* reaper_thread(void* arg) {
+    RgaScheduler* s = (RgaScheduler*)arg;
+    struct pollfd* pfds = nullptr;
+    int pfd_cap = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        if (s->stop && s->inflight_count == 0) {
+            pthread_mutex_unlock(&s->lock);
+            break;
+        }
+        int n = s->inflight_count + 1;
+        if (n > pfd_cap) {
+            struct pollfd* p = (struct pollfd*)realloc(pfds, n * sizeof(*pfds));
+            if (!p) {
+                pthread_mutex_unlock(&s->lock);
+                usleep(1000);
+                continue;
+            }
+            pfds = p;
+            pfd_cap = n;
+        }
+        pfds[0] = {s->wake_fd, POLLIN, 0};
+        for (int i = 0; i < s->inflight_count; i++) {
+            pfds[i + 1] = {s->inflight[i].fence, POLLIN, 0};
+        }
+        pthread_mutex_unlock(&s->lock);
+
+        // fd 只由本线程关闭，解锁后仍然有效
+        if (poll(pfds, n, -1) < 0) {
+            if (errno != EINTR) {
+                ALOGE("❌ Scheduler poll failed: %s", strerror(errno));
+                usleep(1000);
+            }
+            continue;
+        }
+
+        if (pfds[0].revents) {
+            uint64_t v;
+            if (read(s->wake_fd, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+                ALOGE("❌ Scheduler wake read failed: %s", strerror(errno));
+            }
+        }
+
+        uint64_t now = rk_get_time_us();
+        pthread_mutex_lock(&s->lock);
+        for (int i = 1; i < n; i++) {
+            if (!pfds[i].revents) continue;
+            for (int k = 0; k < s->inflight_count; k++) {
+                if (s->inflight[k].fence == pfds[i].fd) {
+                    retire_locked(s, k, now);
+                    break;
+                }
+            }
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    free(pfds);
+    return nullptr;
+}
+
+static RkScreenshotError sched_submit_batch(RkRgaExecutor* exec, RkDmaBuffer* src,
+                                            RkDmaBuffer* const* dsts, const RkRgaJob* jobs,
+                                            int count, int acquire_fence, int* release_fence) {
+    RgaScheduler* s = (RgaScheduler*)exec->priv;
+    if (!release_fence) return RKSS_ERROR_INVALID_PARAM;
+    *release_fence = -1;
+    if (!dsts || !jobs || count <= 0 || count > RK_RGA_BATCH_MAX) return RKSS_ERROR_INVALID_PARAM;
+
+    RkRgaJobDesc descs[RK_RGA_BATCH_MAX];
+    for (int i = 0; i < count; i++) {
+        RkScreenshotError err = rk_rga_job_check(src, dsts[i], &jobs[i]);
+        if (err != RKSS_SUCCESS) return err;
+        rk_rga_job_describe(src, dsts[i], &jobs[i], &descs[i]);
+    }
+
+    // 选核并预占，子执行器可能阻塞（队列满），提交时不持锁
+    pthread_mutex_lock(&s->lock);
+    uint64_t pending[RK_RGA_CORE_COUNT];
+    for (int i = 0; i < RK_RGA_CORE_COUNT; i++) pending[i] = s->stats[i].pending_us;
+    int core = rk_rga_sched_pick_batch(descs, count, pending, s->core_mask);
+    if (core < 0) {
+        s->unsupported++;
+        pthread_mutex_unlock(&s->lock);
+        ALOGW("⚠️ No RGA core for %dx%d -> %dx%d %s (rot %d)%s",
+              descs[0].src_width, descs[0].src_height, descs[0].dst_width, descs[0].dst_height,
+              rk_format_name(descs[0].dst_format), descs[0].rotation,
+              count > 1 ? " in batch" : "");
+        return RKSS_ERROR_RGA_FAILED;
+    }
+    uint64_t cost = batch_cost_us(core, descs, count);
+    RkRgaCoreStats* st = &s->stats[core];
+    st->pending_us += cost;
+    st->queued++;
+    if (st->queued > st->max_queued) st->max_queued = st->queued;
+    pthread_mutex_unlock(&s->lock);
+
+    uint64_t t_submit = rk_get_time_us();
+    int fence = -1;
+    RkRgaExecutor* child = s->cores[core];
+    RkScreenshotError err =
+        count == 1 ? child->submit(child, src, dsts[0], &jobs[0], acquire_fence, &fence)
+                   : child->submit_batch(child, src, dsts, jobs, count, acquire_fence, &fence);
+
+    // 无 fence（同步完成）或 dup 失败时不跟踪，直接按已完成处理
+    int tracked = err == RKSS_SUCCESS && fence >= 0 ? dup(fence) : -1;
+
+    pthread_mutex_lock(&s->lock);
+    if (tracked >= 0 && s->inflight_count == s->inflight_cap) {
+        int cap = s->inflight_cap ? s->inflight_cap * 2 : 16;
+        InFlightJob* p = (InFlightJob*)realloc(s->inflight, cap * sizeof(InFlightJob));
+        if (p) {
+            s->inflight = p;
+            s->inflight_cap = cap;
+        } else {
+            close(tracked);
+            tracked = -1;
+        }
+    }
+    if (err == RKSS_SUCCESS) st->jobs += count;
+    if (tracked >= 0) {
+        s->inflight[s->inflight_count++] = {core, tracked, t_submit, cost};
+    } else {
+        st->pending_us -= cost;
+        st->queued--;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    if (tracked >= 0) wake_reaper(s);
+    if (err != RKSS_SUCCESS) return err;
+
+    *release_fence = fence;
+    return RKSS_SUCCESS;
+}
+
+static RkScreenshotError sched_submit(RkRgaExecutor* exec, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                      const RkRgaJob* job, int acquire_fence,
+                                      int* release_fence) {
+    return sched_submit_batch(exec, src, &dst, job, 1, acquire_fence, release_fence);
+}
+
+static void log_stats(RgaScheduler* s) {
+    uint64_t elapsed = rk_get_time_us() - s->start_us;
+    for (int i = 0; i < RK_RGA_CORE_COUNT; i++) {
+        if (!s->cores[i]) continue;
+        const RkRgaCoreStats* st = &s->stats[i];
+        ALOGI("RGA %s: %lu jobs, busy %.1f%%, max queue %d",
+              kCoreNames[i], st->jobs, elapsed ? st->busy_us * 100.0 / elapsed : 0.0,
+              st->max_queued);
+    }
+    if (s->unsupported > 0) {
+        ALOGI("RGA scheduler: %lu jobs unsupported by any core", s->unsupported);
+    }
+}
+
+static void sched_destroy(RkRgaExecutor* exec) {
+    RgaScheduler* s = (RgaScheduler*)exec->priv;
+
+    // 子执行器先排空，回收线程再收完剩余 fence 后退出
+    for (int i = 0; i < RK_RGA_CORE_COUNT; i++) {
+        rk_rga_executor_destroy(s->cores[i]);
+    }
+    pthread_mutex_lock(&s->lock);
+    s->stop = true;
+    pthread_mutex_unlock(&s->lock);
+    wake_reaper(s);
+    pthread_join(s->thread, nullptr);
+
+    log_stats(s);
+    close(s->wake_fd);
+    pthread_mutex_destroy(&s->lock);
+    free(s->inflight);
+    free(s);
+    free(exec);
+}
+
+RkRgaExecutor* rk_rga_executor_create_scheduler(RkRgaExecutor* cores[RK_RGA_CORE_COUNT]) {
+    if (!cores) return nullptr;
+
+    uint32_t mask = 0;
+    for (int i = 0; i < RK_RGA_CORE_COUNT; i++) {
+        if (cores[i]) mask |= 1u << i;
+    }
+    if (!mask) return nullptr;
+
+    RkRgaExecutor* exec = (RkRgaExecutor*)calloc(1, sizeof(RkRgaExecutor));
+    RgaScheduler* s = (RgaScheduler*)calloc(1, sizeof(RgaScheduler));
+    int wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (!exec || !s || wake_fd < 0) {
+        free(exec);
+        free(s);
+        rk_fence_close(wake_fd);
+        return nullptr;
+    }
+
+    s->core_mask = mask;
+    s->wake_fd = wake_fd;
+    s->start_us = rk_get_time_us();
+    pthread_mutex_init(&s->lock, NULL);
+    if (pthread_create(&s->thread, NULL, reaper_thread, s) != 0) {
+        pthread_mutex_destroy(&s->lock);
+        close(wake_fd);
+        free(s);
+        free(exec);
+        return nullptr;
+    }
+    // 创建成功后才接管子执行器
+    memcpy(s->cores, cores, sizeof(s->cores));
+
+    exec->name = "rga_sched";
+    exec->priv = s;
+    exec->submit = sched_submit;
+    exec->submit_batch = sched_submit_batch;
+    exec->destroy = sched_destroy;
+    return exec;
+}
+
+RkScreenshotError rk_rga_scheduler_get_stats(RkRgaExecutor* sched,
+                                             RkRgaCoreStats stats[RK_RGA_CORE_COUNT],
+                                             uint64_t* elapsed_us) {
+    if (!sched || sched->destroy != sched_destroy || !stats) return RKSS_ERROR_INVALID_PARAM;
+    RgaScheduler* s = (RgaScheduler*)sched->priv;
+
+    pthread_mutex_lock(&s->lock);
+    memcpy(stats, s->stats, sizeof(s->stats));
+    pthread_mutex_unlock(&s->lock);
+    if (elapsed_us) *elapsed_us = rk_get_time_us() - s->start_us;
+    return RKSS_SUCCESS;
+}
@@ -0,0 +1,462 @@
+/**
+ * RK3588 RGA Tiler - 超出单次尺寸上限的作业分块
+ *
+ * 在缩放后、旋转前的坐标系里把图像切成网格，每块换算成源区域裁剪 + dst 内输出区域，
+ * 旋转/镜像与整图相同。块边界对齐到缩放比例的格点（源坐标为整数）时，
+ * 每块的采样位置与单次处理完全一致，接缝处只有滤波邻域被截断的差异。
+ *
+ * 分块执行器逐块提交给内层执行器（多核调度器按核心分派），块 fence 用
+ * SYNC_IOC_MERGE 合并为一个；块耗时取 sync_file 记录的触发时间。
+ */
+
+#include "rk_internal.h"
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/sync_file.h>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_RGA_Tile"
+
+// ============================================
+// 切分
+// ============================================
+
+static int gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// [0, len) 切成 n 段；边界对齐到 step，对齐会让段长偏差超过 1/4 时放弃对齐
+static void split_axis(int len, int n, int step, int* bounds) {
+    int seg = len / n;
+    bool align = step > 1 && step * 4 <= seg;
+    for (int i = 0; i <= n; i++) {
+        int b = (int)((int64_t)len * i / n);
+        if (align && i > 0 && i < n) b = (b + step / 2) / step * step;
+        bounds[i] = b;
+    }
+}
+
+typedef struct {
+    int cx, cy, cw, ch;         // 源区域
+    int rx, ry, rw, rh;         // 输出区域
+    int sw, sh;                 // 缩放后、旋转前
+    int format;                 // 输出格式
+    bool yuv;
+} SplitGeom;
+
+// 旋转前的块 [px0, px1) x [py0, py1) -> 作业
+static void make_tile(const SplitGeom* g, const RkRgaJob* job, int px0, int px1, int py0,
+                      int py1, RkRgaJob* tile) {
+    int xo0, xo1, yo0, yo1;
+    switch (job->rotation) {
+        case 90:
+            xo0 = g->sh - py1; xo1 = g->sh - py0;
+            yo0 = px0;         yo1 = px1;
+            break;
+        case 180:
+            xo0 = g->sw - px1; xo1 = g->sw - px0;
+            yo0 = g->sh - py1; yo1 = g->sh - py0;
+            break;
+        case 270:
+            xo0 = py0;         xo1 = py1;
+            yo0 = g->sw - px1; yo1 = g->sw - px0;
+            break;
+        default:
+            xo0 = px0; xo1 = px1;
+            yo0 = py0; yo1 = py1;
+            break;
+    }
+    if (job->flip_horizontal) {
+        int t = xo0;
+        xo0 = g->rw - xo1;
+        xo1 = g->rw - t;
+    }
+    if (job->flip_vertical) {
+        int t = yo0;
+        yo0 = g->rh - yo1;
+        yo1 = g->rh - t;
+    }
+
+    *tile = *job;
+    int sx0 = (int)((int64_t)px0 * g->cw / g->sw);
+    int sx1 = (int)((int64_t)px1 * g->cw / g->sw);
+    int sy0 = (int)((int64_t)py0 * g->ch / g->sh);
+    int sy1 = (int)((int64_t)py1 * g->ch / g->sh);
+    tile->crop_x = g->cx + sx0;
+    tile->crop_y = g->cy + sy0;
+    tile->crop_width = sx1 - sx0;
+    tile->crop_height = sy1 - sy0;
+    tile->dst_x = g->rx + xo0;
+    tile->dst_y = g->ry + yo0;
+    tile->dst_width = xo1 - xo0;
+    tile->dst_height = yo1 - yo0;
+}
+
+// nx x ny 网格全部由 core 支持时写入 tiles
+static bool try_grid(const SplitGeom* g, const RkRgaJob* job, int core, int nx, int ny,
+                     RkRgaJob* tiles) {
+    // 格点：旋转前坐标为 step 的倍数时源坐标为整数；YUV 输出区域起点须为偶数
+    int step_x = g->sw / gcd(g->cw, g->sw);
+    int step_y = g->sh / gcd(g->ch, g->sh);
+    if (g->yuv) {
+        if (step_x & 1) step_x *= 2;
+        if (step_y & 1) step_y *= 2;
+    }
+    int bx[RK_RGA_TILE_MAX + 1], by[RK_RGA_TILE_MAX + 1];
+    split_axis(g->sw, nx, step_x, bx);
+    split_axis(g->sh, ny, step_y, by);
+
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            RkRgaJob* tile = &tiles[j * nx + i];
+            make_tile(g, job, bx[i], bx[i + 1], by[j], by[j + 1], tile);
+            if (g->yuv && ((tile->dst_x | tile->dst_y) & 1)) return false;
+
+            RkRgaJobDesc desc = {tile->crop_width, tile->crop_height, tile->dst_width,
+                                 tile->dst_height, g->format, job->rotation};
+            if (tile->crop_width <= 0 || tile->crop_height <= 0 ||
+                !rk_rga_core_supports(core, &desc)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int rk_rga_job_split(const RkDmaBuffer* src, const RkDmaBuffer* dst, const RkRgaJob* job,
+                     uint32_t core_mask, RkRgaJob tiles[RK_RGA_TILE_MAX]) {
+    if (!src || !dst || !job || !tiles) return 0;
+    if (rk_rga_job_check(src, dst, job) != RKSS_SUCCESS) return 0;
+
+    // 版本串未识别出核心时按 RGA2 的上限（更保守）
+    if (core_mask == 0) core_mask = 1u << RK_RGA_CORE_RGA2;
+
+    RkRgaJobDesc desc;
+    rk_rga_job_describe(src, dst, job, &desc);
+    desc.high_mem = false;   // 分块只看尺寸，地址限制由调度器选核时处理
+    for (int core = 0; core < RK_RGA_CORE_COUNT; core++) {
+        if ((core_mask & (1u << core)) && rk_rga_core_supports(core, &desc)) {
+            tiles[0] = *job;
+            return 1;
+        }
+    }
+
+    SplitGeom g;
+    g.cx = job->crop_width > 0 && job->crop_height > 0 ? job->crop_x : 0;
+    g.cy = job->crop_width > 0 && job->crop_height > 0 ? job->crop_y : 0;
+    g.cw = desc.src_width;
+    g.ch = desc.src_height;
+    bool rect = job->dst_width > 0 && job->dst_height > 0;
+    g.rx = rect ? job->dst_x : 0;
+    g.ry = rect ? job->dst_y : 0;
+    g.rw = desc.dst_width;
+    g.rh = desc.dst_height;
+    bool transpose = job->rotation == 90 || job->rotation == 270;
+    g.sw = transpose ? g.rh : g.rw;
+    g.sh = transpose ? g.rw : g.rh;
+    g.format = dst->format;
+    g.yuv = dst->format == RK_FORMAT_YUV420SP || dst->format == RK_FORMAT_YUV420P;
+
+    // 块数从少到多；同样块数时 RGA3（两个核心可并行）优先
+    RkRgaJob grid[RK_RGA_TILE_MAX];
+    for (int n = 2; n <= RK_RGA_TILE_MAX; n++) {
+        for (int core = 0; core < RK_RGA_CORE_COUNT; core++) {
+            if (!(core_mask & (1u << core))) continue;
+            for (int nx = 1; nx <= n; nx++) {
+                if (n % nx) continue;
+                if (try_grid(&g, job, core, nx, n / nx, grid)) {
+                    memcpy(tiles, grid, sizeof(RkRgaJob) * n);
+                    return n;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// ============================================
+// Fence 合并 / 计时
+// ============================================
+
+// sync_file 合并；任一方不是 sync_file 时失败
+static int fence_merge(int a, int b) {
+    struct sync_merge_data data;
+    memset(&data, 0, sizeof(data));
+    strncpy(data.name, "rk_tiles", sizeof(data.name) - 1);
+    data.fd2 = b;
+    if (ioctl(a, SYNC_IOC_MERGE, &data) < 0) return -1;
+    return data.fence;
+}
+
+// 已触发的 sync_file 返回触发时间（CLOCK_MONOTONIC us），未触发或不是 sync_file 返回 0
+static uint64_t fence_signal_time_us(int fence) {
+    struct sync_file_info info;
+    memset(&info, 0, sizeof(info));
+    if (ioctl(fence, SYNC_IOC_FILE_INFO, &info) < 0 || info.status != 1) return 0;
+    if (info.num_fences == 0 || info.num_fences > 16) return 0;
+
+    struct sync_fence_info fences[16];
+    memset(fences, 0, sizeof(fences));
+    info.sync_fence_info = (uint64_t)(uintptr_t)fences;
+    if (ioctl(fence, SYNC_IOC_FILE_INFO, &info) < 0) return 0;
+
+    uint64_t ns = 0;
+    for (uint32_t i = 0; i < info.num_fences; i++) {
+        if (fences[i].timestamp_ns > ns) ns = fences[i].timestamp_ns;
+    }
+    return ns / 1000;
+}
+
+// ============================================
+// 分块执行器
+// ============================================
+
+#define RK_TILE_PENDING_MAX 64
+
+typedef struct {
+    int fence;                  // 块自己的 fence（合并后保留用于计时）
+    uint64_t t_submit;
+    RkRgaJob tile;
+} TilePending;
+
+typedef struct {
+    RkRgaExecutor* inner;
+    uint32_t core_mask;
+    pthread_mutex_t lock;       // 统计 + pending
+    RkRgaTileStats stats;
+    TilePending pending[RK_TILE_PENDING_MAX];
+    int pending_count;
+} TiledExecutor;
+
+static void record_tile_locked(TiledExecutor* t, const TilePending* p, uint64_t done_us) {
+    uint64_t us = done_us > p->t_submit ? done_us - p->t_submit : 0;
+    t->stats.tiles++;
+    t->stats.tile_us_total += us;
+    if (us > t->stats.tile_us_max) t->stats.tile_us_max = (uint32_t)us;
+    ALOGD("   tile [%d,%d %dx%d] -> [%d,%d %dx%d]: %.2f ms", p->tile.crop_x, p->tile.crop_y,
+          p->tile.crop_width, p->tile.crop_height, p->tile.dst_x, p->tile.dst_y,
+          p->tile.dst_width, p->tile.dst_height, us / 1000.0);
+}
+
+// 已触发的块计时并关闭 fence；wait 时先等全部触发
+static void reap_pending_locked(TiledExecutor* t, bool wait) {
+    int kept = 0;
+    for (int i = 0; i < t->pending_count; i++) {
+        TilePending* p = &t->pending[i];
+        if (wait) rk_fence_wait(p->fence, -1);
+        uint64_t done = fence_signal_time_us(p->fence);
+        if (!done && !wait) {
+            t->pending[kept++] = *p;
+            continue;
+        }
+        if (done) record_tile_locked(t, p, done);
+        rk_fence_close(p->fence);
+    }
+    t->pending_count = kept;
+}
+
+// 不能合并的 fence：同时 poll 全部块，按各自触发时刻计时后关闭
+static RkScreenshotError wait_tiles(TiledExecutor* t, TilePending* tiles, int count) {
+    RkScreenshotError result = RKSS_SUCCESS;
+    int left = 0;
+    for (int i = 0; i < count; i++) {
+        if (tiles[i].fence >= 0) left++;
+    }
+    while (left > 0) {
+        struct pollfd pfds[RK_RGA_BATCH_MAX * RK_RGA_TILE_MAX];
+        int index[RK_RGA_BATCH_MAX * RK_RGA_TILE_MAX];
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            if (tiles[i].fence < 0) continue;
+            pfds[n] = {tiles[i].fence, POLLIN, 0};
+            index[n++] = i;
+        }
+        int ret = poll(pfds, n, -1);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            ALOGE("❌ Tile fence poll failed: %s", strerror(errno));
+            result = RKSS_ERROR_RGA_FAILED;
+            for (int k = 0; k < n; k++) rk_fence_wait(pfds[k].fd, -1);
+        }
+
+        uint64_t now = rk_get_time_us();
+        pthread_mutex_lock(&t->lock);
+        for (int k = 0; k < n; k++) {
+            if (ret > 0 && !pfds[k].revents) continue;
+            TilePending* p = &tiles[index[k]];
+            // 已触发，rk_fence_wait 立即返回并检查错误状态
+            if (rk_fence_wait(p->fence, 0) != RKSS_SUCCESS) result = RKSS_ERROR_RGA_FAILED;
+            record_tile_locked(t, p, now);
+            rk_fence_close(p->fence);
+            p->fence = -1;
+            left--;
+        }
+        pthread_mutex_unlock(&t->lock);
+    }
+    return result;
+}
+
+static RkScreenshotError tiled_submit_batch(RkRgaExecutor* exec, RkDmaBuffer* src,
+                                            RkDmaBuffer* const* dsts, const RkRgaJob* jobs,
+                                            int count, int acquire_fence, int* release_fence) {
+    TiledExecutor* t = (TiledExecutor*)exec->priv;
+    if (!release_fence) return RKSS_ERROR_INVALID_PARAM;
+    *release_fence = -1;
+    if (!dsts || !jobs || count <= 0 || count > RK_RGA_BATCH_MAX) return RKSS_ERROR_INVALID_PARAM;
+
+    pthread_mutex_lock(&t->lock);
+    reap_pending_locked(t, false);
+    t->stats.jobs += count;
+    pthread_mutex_unlock(&t->lock);
+
+    // 全部可单次完成（或无法切分，交给内层报错）时原样提交
+    RkRgaJob tiles[RK_RGA_BATCH_MAX][RK_RGA_TILE_MAX];
+    int tile_count[RK_RGA_BATCH_MAX];
+    bool tiled = false;
+    for (int i = 0; i < count; i++) {
+        tile_count[i] = rk_rga_job_split(src, dsts[i], &jobs[i], t->core_mask, tiles[i]);
+        if (tile_count[i] == 0) {
+            tiled = false;
+            break;
+        }
+        if (tile_count[i] > 1) tiled = true;
+    }
+    if (!tiled) {
+        return count == 1
+            ? t->inner->submit(t->inner, src, dsts[0], jobs, acquire_fence, release_fence)
+            : t->inner->submit_batch(t->inner, src, dsts, jobs, count, acquire_fence,
+                                     release_fence);
+    }
+
+    // 逐块提交，调度器按各块尺寸选核心
+    TilePending subs[RK_RGA_BATCH_MAX * RK_RGA_TILE_MAX];
+    int n = 0;
+    int tiled_jobs = 0;
+    RkScreenshotError err = RKSS_SUCCESS;
+    for (int i = 0; i < count && err == RKSS_SUCCESS; i++) {
+        if (tile_count[i] > 1) tiled_jobs++;
+        for (int k = 0; k < tile_count[i] && err == RKSS_SUCCESS; k++) {
+            TilePending* p = &subs[n];
+            p->tile = tiles[i][k];
+            p->t_submit = rk_get_time_us();
+            p->fence = -1;
+            err = t->inner->submit(t->inner, src, dsts[i], &p->tile, acquire_fence, &p->fence);
+            if (err == RKSS_SUCCESS) n++;
+        }
+    }
+    if (err != RKSS_SUCCESS) {
+        // 已提交的块仍在读写 buffer，返回前等完
+        ALOGE("❌ Tile submit failed after %d tiles: %d", n, err);
+        wait_tiles(t, subs, n);
+        return err;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    t->stats.tiled_jobs += tiled_jobs;
+    pthread_mutex_unlock(&t->lock);
+
+    // 合并为一个 release fence；块 fence 留作计时
+    int merged = -1;
+    bool mergeable = true;
+    for (int i = 0; i < n && mergeable; i++) {
+        if (subs[i].fence < 0) continue;
+        if (merged < 0) {
+            merged = dup(subs[i].fence);
+            mergeable = merged >= 0;
+            continue;
+        }
+        int next = fence_merge(merged, subs[i].fence);
+        rk_fence_close(merged);
+        merged = next;
+        mergeable = next >= 0;
+    }
+    if (!mergeable) {
+        // 模拟执行器的 pipe 无法合并：同步等待
+        rk_fence_close(merged);
+        return wait_tiles(t, subs, n);
+    }
+
+    pthread_mutex_lock(&t->lock);
+    for (int i = 0; i < n; i++) {
+        if (subs[i].fence < 0) continue;
+        if (t->pending_count == RK_TILE_PENDING_MAX) {
+            reap_pending_locked(t, false);
+        }
+        if (t->pending_count < RK_TILE_PENDING_MAX) {
+            t->pending[t->pending_count++] = subs[i];
+        } else {
+            rk_fence_close(subs[i].fence);      // 计时记录已满，不再跟踪
+        }
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    ALOGD("✅ RGA tiled submit: %d job(s) -> %d tiles, fence %d", count, n, merged);
+    *release_fence = merged;
+    return RKSS_SUCCESS;
+}
+
+static RkScreenshotError tiled_submit(RkRgaExecutor* exec, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                      const RkRgaJob* job, int acquire_fence,
+                                      int* release_fence) {
+    return tiled_submit_batch(exec, src, &dst, job, 1, acquire_fence, release_fence);
+}
+
+static void tiled_destroy(RkRgaExecutor* exec) {
+    TiledExecutor* t = (TiledExecutor*)exec->priv;
+
+    rk_rga_executor_destroy(t->inner);
+    pthread_mutex_lock(&t->lock);
+    reap_pending_locked(t, true);
+    pthread_mutex_unlock(&t->lock);
+    if (t->stats.tiled_jobs > 0) {
+        ALOGI("RGA tiling: %lu of %lu jobs tiled, %lu tiles avg %.2f ms (max %.2f ms)",
+              t->stats.tiled_jobs, t->stats.jobs, t->stats.tiles,
+              t->stats.tiles ? t->stats.tile_us_total / t->stats.tiles / 1000.0 : 0.0,
+              t->stats.tile_us_max / 1000.0);
+    }
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+    free(exec);
+}
+
+RkRgaExecutor* rk_rga_executor_create_tiled(RkRgaExecutor* inner, uint32_t core_mask) {
+    if (!inner) return nullptr;
+
+    RkRgaExecutor* exec = (RkRgaExecutor*)calloc(1, sizeof(RkRgaExecutor));
+    TiledExecutor* t = (TiledExecutor*)calloc(1, sizeof(TiledExecutor));
+    if (!exec || !t) {
+        free(exec);
+        free(t);
+        return nullptr;
+    }
+
+    t->inner = inner;
+    t->core_mask = core_mask;
+    pthread_mutex_init(&t->lock, NULL);
+    exec->name = inner->name;       // 对外仍报告内层（调度器 / 单核）
+    exec->priv = t;
+    exec->submit = tiled_submit;
+    exec->submit_batch = tiled_submit_batch;
+    exec->destroy = tiled_destroy;
+    return exec;
+}
+
+RkScreenshotError rk_rga_tiled_get_stats(RkRgaExecutor* tiled, RkRgaTileStats* stats) {
+    if (!tiled || !stats || tiled->destroy != tiled_destroy) return RKSS_ERROR_INVALID_PARAM;
+    TiledExecutor* t = (TiledExecutor*)tiled->priv;
+
+    pthread_mutex_lock(&t->lock);
+    reap_pending_locked(t, false);
+    *stats = t->stats;
+    pthread_mutex_unlock(&t->lock);
+    return RKSS_SUCCESS;
+}
@@ -7,12 +7,167 @@
 #include "rk_internal.h"
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
+#include <ctime>
+#include <dirent.h>
 
 #undef LOG_TAG
 #define LOG_TAG "RK_Screenshot"
 
+// RGA 输出 buffer 池上限（约 5 张 1080p RGBA）
+#define RK_DMABUF_POOL_MAX_IDLE (40 * 1024 * 1024)
+
 static RkScreenshotContext g_ctx = {};
 
+// rk_screenshot_set_frame_source 设置，为空时读取环境变量
+static char g_source_spec[256] = "";
+
+// rk_screenshot_set_watermark 设置，捕获时各取一个引用，替换不影响进行中的帧
+static pthread_mutex_t g_overlay_lock = PTHREAD_MUTEX_INITIALIZER;
+static RkOverlay* g_overlay = nullptr;
+
+static void async_stop();
+static void recordings_stop();
+
+static RkOverlay* current_overlay() {
+    pthread_mutex_lock(&g_overlay_lock);
+    RkOverlay* ov = rk_overlay_ref(g_overlay);
+    pthread_mutex_unlock(&g_overlay_lock);
+    return ov;
+}
+
+// 探测到多个 RGA 核心时按作业分派（RK_SCREENSHOT_RGA_SCHED=driver 交回驱动调度）
+static RkRgaExecutor* create_core_executor(RkRgaProcessor* rga) {
+    const char* mode = getenv("RK_SCREENSHOT_RGA_SCHED");
+    bool driver = mode && strcmp(mode, "driver") == 0;
+    if (driver || __builtin_popcount(rga->core_mask) < 2) {
+        return rk_rga_executor_create_hw(rga, RK_RGA_CORE_AUTO);
+    }
+
+    RkRgaExecutor* cores[RK_RGA_CORE_COUNT] = {};
+    for (int i = 0; i < RK_RGA_CORE_COUNT; i++) {
+        if (!(rga->core_mask & (1u << i))) continue;
+        cores[i] = rk_rga_executor_create_hw(rga, i);
+        if (!cores[i]) break;
+    }
+    RkRgaExecutor* sched = rk_rga_executor_create_scheduler(cores);
+    if (!sched) {
+        for (int i = 0; i < RK_RGA_CORE_COUNT; i++) rk_rga_executor_destroy(cores[i]);
+        return rk_rga_executor_create_hw(rga, RK_RGA_CORE_AUTO);
+    }
+    return sched;
+}
+
+// 超出单次尺寸上限的作业（8K 源、RGA2 4096 输出等）分块后逐块提交
+static RkRgaExecutor* create_rga_executor(RkRgaProcessor* rga) {
+    RkRgaExecutor* cores = create_core_executor(rga);
+    if (!cores) return nullptr;
+    RkRgaExecutor* tiled = rk_rga_executor_create_tiled(cores, rga->core_mask);
+    if (!tiled) rk_rga_executor_destroy(cores);
+    return tiled;
+}
+
+// 处理后端（RK_SCREENSHOT_PROCESSOR）：
+//   auto（默认）RGA + CPU 混合，小作业与 RGA 失败的作业走 CPU；无 RGA 时只用 CPU
+//   rga          只用 RGA（失败的作业仍由 CPU 参考实现兜底）
+//   cpu          只用 CPU，不初始化 RGA
+static RkScreenshotError create_processor(RkRgaProcessor* rga, RkRgaExecutor** exec) {
+    const char* mode = getenv("RK_SCREENSHOT_PROCESSOR");
+    if (!mode || !mode[0]) mode = "auto";
+    bool use_rga = strcmp(mode, "cpu") != 0;
+    bool use_cpu = strcmp(mode, "rga") != 0;
+    if (use_rga && use_cpu && strcmp(mode, "auto") != 0) {
+        ALOGE("❌ Unknown RK_SCREENSHOT_PROCESSOR: %s", mode);
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+
+    if (use_rga) {
+        RkScreenshotError err = rk_rga_init(rga);
+        if (err != RKSS_SUCCESS) {
+            if (!use_cpu) {
+                ALOGE("❌ RGA init failed");
+                return err;
+            }
+            ALOGW("⚠️ RGA unavailable, using CPU processor");
+            use_rga = false;
+        }
+    }
+
+    RkRgaExecutor* rga_exec = use_rga ? create_rga_executor(rga) : nullptr;
+    RkRgaExecutor* cpu_exec = use_cpu ? rk_rga_executor_create_cpu(0, RK_CPU_FILTER_AUTO)
+                                      : nullptr;
+    if ((use_rga && !rga_exec) || (use_cpu && !cpu_exec)) {
+        rk_rga_executor_destroy(rga_exec);
+        rk_rga_executor_destroy(cpu_exec);
+        rk_rga_deinit(rga);
+        return RKSS_ERROR_NO_MEMORY;
+    }
+
+    *exec = rga_exec && cpu_exec ? rk_rga_executor_create_hybrid(rga_exec, cpu_exec)
+                                 : rga_exec ? rga_exec : cpu_exec;
+    if (!*exec) {
+        rk_rga_executor_destroy(rga_exec);
+        rk_rga_executor_destroy(cpu_exec);
+        rk_rga_deinit(rga);
+        return RKSS_ERROR_NO_MEMORY;
+    }
+    return RKSS_SUCCESS;
+}
+
+// JPEG 编码上下文数：RK_SCREENSHOT_JPEG_ENCODERS，默认 /proc/mpp_service 下的 jpege 核心数
+static int jpeg_encoder_count() {
+    const char* env = getenv("RK_SCREENSHOT_JPEG_ENCODERS");
+    int count = env && env[0] ? atoi(env) : 0;
+    if (count <= 0) {
+        DIR* dir = opendir("/proc/mpp_service");
+        if (dir) {
+            struct dirent* ent;
+            while ((ent = readdir(dir)) != nullptr) {
+                if (strncmp(ent->d_name, "jpege", 5) == 0 && !strstr(ent->d_name, "ccu")) count++;
+            }
+            closedir(dir);
+        }
+    }
+    if (count < 1) count = 1;
+    if (count > RK_JPEG_POOL_MAX) count = RK_JPEG_POOL_MAX;
+    return count;
+}
+
+// /proc/mpp_service 下有 rkvenc 核心
+static bool video_encoder_present() {
+    bool found = false;
+    DIR* dir = opendir("/proc/mpp_service");
+    if (dir) {
+        struct dirent* ent;
+        while (!found && (ent = readdir(dir)) != nullptr) {
+            found = strncmp(ent->d_name, "rkvenc", 6) == 0;
+        }
+        closedir(dir);
+    }
+    return found;
+}
+
+// 部分上下文创建失败时用已成功的；一个都没有才报错
+static RkScreenshotError create_jpeg_pool(RkJpegPool** pool) {
+    RkJpegEncoder* encoders[RK_JPEG_POOL_MAX];
+    int wanted = jpeg_encoder_count();
+    int count = 0;
+    while (count < wanted) {
+        encoders[count] = rk_jpeg_encoder_create_mpp();
+        if (!encoders[count]) break;
+        count++;
+    }
+    if (count == 0) return RKSS_ERROR_ENCODE_FAILED;
+    if (count < wanted) ALOGW("⚠️ Only %d of %d MPP JPEG contexts created", count, wanted);
+
+    *pool = rk_jpeg_pool_create(encoders, count);
+    if (!*pool) {
+        for (int i = 0; i < count; i++) rk_jpeg_encoder_destroy(encoders[i]);
+        return RKSS_ERROR_NO_MEMORY;
+    }
+    return RKSS_SUCCESS;
+}
+
 // ============================================
 // 公共 API
 // ============================================
@@ -31,32 +186,55 @@ RkScreenshotError rk_screenshot_init() {
     ALOGI("   Pipeline: SF -> RGA -> MPP (DMA-BUF)");
     ALOGI("========================================");
 
-    // 1. SurfaceFlinger
-    RkScreenshotError err = rk_sf_init(&g_ctx.sf_ctx);
-    if (err != RKSS_SUCCESS) {
-        ALOGE("❌ SurfaceFlinger init failed");
-        return err;
+    // 1. 帧来源（默认 SurfaceFlinger）
+    const char* spec = g_source_spec[0] ? g_source_spec : getenv("RK_SCREENSHOT_SOURCE");
+    g_ctx.source = rk_frame_source_create_from_spec(spec);
+    if (!g_ctx.source) {
+        ALOGE("❌ Frame source init failed (%s)", spec ? spec : "sf");
+        return RKSS_ERROR_CAPTURE_FAILED;
     }
-    ALOGI("✅ SurfaceFlinger ready");
+    ALOGI("✅ Frame source ready: %s", g_ctx.source->name);
 
-    // 2. RGA
-    err = rk_rga_init(&g_ctx.rga);
+    RkScreenshotError err;
+
+    // 2. RGA / CPU 处理后端
+    err = create_processor(&g_ctx.rga, &g_ctx.rga_exec);
     if (err != RKSS_SUCCESS) {
-        ALOGE("❌ RGA init failed");
-        rk_sf_deinit(g_ctx.sf_ctx);
+        rk_frame_source_destroy(g_ctx.source);
         return err;
     }
-    ALOGI("✅ RGA ready");
+    ALOGI("✅ Processor ready: %s", g_ctx.rga_exec->name);
 
-    // 3. MPP
-    err = rk_mpp_init(&g_ctx.mpp);
+    // 3. MPP 编码上下文池
+    err = create_jpeg_pool(&g_ctx.jpeg);
     if (err != RKSS_SUCCESS) {
         ALOGE("❌ MPP init failed");
+        rk_rga_executor_destroy(g_ctx.rga_exec);
         rk_rga_deinit(&g_ctx.rga);
-        rk_sf_deinit(g_ctx.sf_ctx);
+        rk_frame_source_destroy(g_ctx.source);
         return err;
     }
-    ALOGI("✅ MPP ready");
+    int encoders = rk_jpeg_pool_size(g_ctx.jpeg);
+    // 批量输出并行编码；创建失败时退回逐个编码
+    g_ctx.encode_threads = encoders > 1 ? rk_thread_pool_create(encoders) : nullptr;
+    ALOGI("✅ MPP ready: %d JPEG context%s", encoders, encoders > 1 ? "s" : "");
+
+    // 4. DMA-BUF pool
+    g_ctx.pool = rk_dmabuf_pool_create(rk_dmabuf_default_allocator(), RK_DMABUF_POOL_MAX_IDLE);
+    if (!g_ctx.pool) {
+        ALOGE("❌ DMA-BUF pool init failed");
+        rk_thread_pool_destroy(g_ctx.encode_threads);
+        g_ctx.encode_threads = nullptr;
+        rk_jpeg_pool_destroy(g_ctx.jpeg);
+        g_ctx.jpeg = nullptr;
+        rk_rga_executor_destroy(g_ctx.rga_exec);
+        rk_rga_deinit(&g_ctx.rga);
+        rk_frame_source_destroy(g_ctx.source);
+        return RKSS_ERROR_NO_MEMORY;
+    }
+
+    rk_scaler_model_init(&g_ctx.scaler_model);
+    rk_jpeg_rate_init(&g_ctx.jpeg_rate);
 
     g_ctx.initialized = true;
     ALOGI("========================================");
@@ -66,15 +244,39 @@ RkScreenshotError rk_screenshot_init() {
 void rk_screenshot_deinit() {
     if (!g_ctx.initialized) return;
 
-    rk_mpp_deinit(&g_ctx.mpp);
+    recordings_stop();
+    async_stop();
+    rk_screenshot_set_watermark(nullptr, 0, 0, 0, 0, 0);
+    rk_scaler_model_deinit(&g_ctx.scaler_model);
+    rk_jpeg_rate_deinit(&g_ctx.jpeg_rate);
+    rk_dmabuf_pool_destroy(g_ctx.pool);
+    g_ctx.pool = nullptr;
+    rk_thread_pool_destroy(g_ctx.encode_threads);
+    g_ctx.encode_threads = nullptr;
+    rk_jpeg_pool_destroy(g_ctx.jpeg);
+    g_ctx.jpeg = nullptr;
+    rk_rga_executor_destroy(g_ctx.rga_exec);
+    g_ctx.rga_exec = nullptr;
     rk_rga_deinit(&g_ctx.rga);
-    rk_sf_deinit(g_ctx.sf_ctx);
-    g_ctx.sf_ctx = nullptr;
+    rk_frame_source_destroy(g_ctx.source);
+    g_ctx.source = nullptr;
     g_ctx.initialized = false;
 
     ALOGI("🔴 Screenshot engine stopped");
 }
 
+RkScreenshotError rk_screenshot_set_frame_source(const char* spec) {
+    if (g_ctx.initialized) return RKSS_ERROR_INVALID_PARAM;   // 仅在 init 前生效
+
+    if (!spec) {
+        g_source_spec[0] = '\0';
+        return RKSS_SUCCESS;
+    }
+    if (strlen(spec) >= sizeof(g_source_spec)) return RKSS_ERROR_INVALID_PARAM;
+    strcpy(g_source_spec, spec);
+    return RKSS_SUCCESS;
+}
+
 void rk_screenshot_get_default_config(RkScreenshotConfig* cfg) {
     if (!cfg) return;
     memset(cfg, 0, sizeof(*cfg));
@@ -84,128 +286,1436 @@ void rk_screenshot_get_default_config(RkScreenshotConfig* cfg) {
     cfg->quality = 90;
 }
 
-RkScreenshotError rk_screenshot_capture(
-    const RkScreenshotConfig* cfg,
-    RkScreenshotResult** result)
-{
+// 目前只填 RGA / MPP 部分；rga_max_* 为单次作业的输出上限，更大的输出自动分块
+RkScreenshotError rk_screenshot_query_hardware(RkHardwareInfo* info) {
+    if (!info) return RKSS_ERROR_INVALID_PARAM;
     if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
-    if (!cfg || !result) return RKSS_ERROR_INVALID_PARAM;
+    memset(info, 0, sizeof(*info));
 
-    uint64_t t_start = rk_get_time_us();
-    RkScreenshotError err;
+    info->rga_available = g_ctx.rga.initialized;
+    if (g_ctx.rga.initialized) {
+        strncpy(info->rga_version, g_ctx.rga.version, sizeof(info->rga_version) - 1);
+        uint32_t mask = g_ctx.rga.core_mask ? g_ctx.rga.core_mask : 1u << RK_RGA_CORE_RGA2;
+        for (int core = 0; core < RK_RGA_CORE_COUNT; core++) {
+            if (!(mask & (1u << core))) continue;
+            int max_dst = 0;
+            rk_rga_core_max_size(core, NULL, &max_dst);
+            if (max_dst > info->rga_max_width) {
+                info->rga_max_width = max_dst;
+                info->rga_max_height = max_dst;
+            }
+        }
+    }
 
-    // 分配结果
-    RkScreenshotResult* res = (RkScreenshotResult*)calloc(1, sizeof(RkScreenshotResult));
-    if (!res) return RKSS_ERROR_NO_MEMORY;
+    info->mpp_available = g_ctx.jpeg != nullptr;
+    info->support_jpeg = g_ctx.jpeg != nullptr;
+    // RK3588 的 rkvenc 核心同时支持 H.264 / H.265 编码
+    info->support_h264 = info->mpp_available && video_encoder_present();
+    info->support_h265 = info->support_h264;
+    return RKSS_SUCCESS;
+}
+
+static const char* scaler_name(RkScaler scaler) {
+    switch (scaler) {
+        case RK_SCALER_RGA: return "RGA";
+        case RK_SCALER_SURFACEFLINGER: return "SF";
+        default: return "none";
+    }
+}
+
+static bool has_crop(const RkScreenshotConfig* cfg) {
+    return cfg->crop_width > 0 && cfg->crop_height > 0;
+}
+
+// 旋转/镜像只有 RGA 能做
+static bool needs_transform(const RkScreenshotConfig* cfg) {
+    return cfg->rotation != 0 || cfg->flip_horizontal || cfg->flip_vertical;
+}
+
+static bool is_video_format(int format) {
+    return format == RK_FORMAT_H264 || format == RK_FORMAT_H265;
+}
+
+// 管线输出 buffer 格式：JPEG 按 encode_input 选择编码器输入，视频编码输入 NV12，
+// Raw 格式由 RGA 直接产出
+static int pipeline_format(const RkScreenshotConfig* cfg) {
+    if (is_video_format(cfg->format)) return RK_FORMAT_YUV420SP;
+    if (cfg->format == RK_FORMAT_JPEG) {
+        return cfg->encode_input == RK_FORMAT_YUV420SP ? RK_FORMAT_YUV420SP : RK_FORMAT_RGBA8888;
+    }
+    if (cfg->format == RK_FORMAT_RGBX8888) return RK_FORMAT_RGBA8888;
+    return cfg->format;
+}
+
+// RGBA/RGBX 内存布局相同，无需转换
+static bool same_layout(int a, int b) {
+    bool rgba_a = (a == RK_FORMAT_RGBA8888 || a == RK_FORMAT_RGBX8888);
+    bool rgba_b = (b == RK_FORMAT_RGBA8888 || b == RK_FORMAT_RGBX8888);
+    return a == b || (rgba_a && rgba_b);
+}
+
+// 最终输出尺寸：未指定缩放时为源区域尺寸（90/270 度旋转后宽高互换）
+static void output_size(const RkScreenshotConfig* cfg, int src_width, int src_height,
+                        int* width, int* height) {
+    if (cfg->scale_width > 0 && cfg->scale_height > 0) {
+        *width = cfg->scale_width;
+        *height = cfg->scale_height;
+    } else if (cfg->rotation == 90 || cfg->rotation == 270) {
+        *width = src_height;
+        *height = src_width;
+    } else {
+        *width = src_width;
+        *height = src_height;
+    }
+}
+
+// 与捕获方式无关的参数校验；视频格式只由录制接口使用，截图接口自行拒绝
+static RkScreenshotError check_config(const RkScreenshotConfig* cfg) {
+    if (cfg->rotation != 0 && cfg->rotation != 90 &&
+        cfg->rotation != 180 && cfg->rotation != 270) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+    if (cfg->format != RK_FORMAT_JPEG && !is_video_format(cfg->format) &&
+        !rk_rga_output_format_supported(cfg->format)) {
+        return RKSS_ERROR_UNSUPPORTED;
+    }
+    if (cfg->encode_input != RK_FORMAT_RGBA8888 && cfg->encode_input != RK_FORMAT_YUV420SP) {
+        return RKSS_ERROR_UNSUPPORTED;
+    }
+    if (cfg->jpeg_strips != RK_JPEG_STRIPS_AUTO &&
+        (cfg->jpeg_strips < 0 || cfg->jpeg_strips > RK_JPEG_STRIPS_MAX)) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+    return RKSS_SUCCESS;
+}
+
+// 决定裁剪/缩放由谁完成，填充捕获请求：
+// SF 路径由合成器直接输出裁剪缩放后的图像；RGA 路径捕获全屏，
+// 裁剪 + 缩放 + 旋转 + 镜像在 process_frame 中一次 RGA 作业完成
+static RkScreenshotError plan_capture(const RkScreenshotConfig* cfg,
+                                      RkCaptureRequest* req, RkScaler* scaler) {
+    memset(req, 0, sizeof(*req));
+    req->display_id = rk_screenshot_config_display(cfg);
+    *scaler = RK_SCALER_AUTO;
+
+    RkScreenshotError err = check_config(cfg);
+    if (err != RKSS_SUCCESS) return err;
+
+    bool crop = has_crop(cfg);
+    bool scale = cfg->scale_width > 0 && cfg->scale_height > 0;
+    if (!crop && !scale && !needs_transform(cfg)) {
+        return RKSS_SUCCESS;
+    }
+
+    int display_width = 0, display_height = 0;
+    err = g_ctx.source->get_display_size(g_ctx.source, rk_screenshot_config_display(cfg),
+                                         &display_width, &display_height);
+    if (err != RKSS_SUCCESS) return err;
+
+    int src_width = crop ? cfg->crop_width : display_width;
+    int src_height = crop ? cfg->crop_height : display_height;
+    int out_width, out_height;
+    output_size(cfg, src_width, src_height, &out_width, &out_height);
+
+    if (needs_transform(cfg) || cfg->scaler == RK_SCALER_RGA) {
+        *scaler = RK_SCALER_RGA;
+        return RKSS_SUCCESS;
+    }
+    if (!crop && out_width == display_width && out_height == display_height) {
+        return RKSS_SUCCESS;
+    }
+
+    if (cfg->scaler == RK_SCALER_SURFACEFLINGER) {
+        *scaler = RK_SCALER_SURFACEFLINGER;
+    } else {
+        // SF 输出按 buffer 实际高度分配，JPEG 需要 16 对齐时还要一次 RGA 拷贝
+        // 颜色转换（NV12 编码输入 / Raw YUV、RGB888）同样需要 RGA
+        bool post_rga = !same_layout(pipeline_format(cfg), RK_FORMAT_RGBA8888) ||
+                        (cfg->format == RK_FORMAT_JPEG &&
+                         (out_width % RK_MPP_ALIGN != 0 || out_height % RK_MPP_ALIGN != 0));
+        *scaler = rk_scaler_model_choose(&g_ctx.scaler_model, display_width, display_height,
+                                         out_width, out_height, post_rga);
+    }
+
+    if (*scaler == RK_SCALER_SURFACEFLINGER) {
+        if (crop) {
+            req->crop_x = cfg->crop_x;
+            req->crop_y = cfg->crop_y;
+            req->crop_width = cfg->crop_width;
+            req->crop_height = cfg->crop_height;
+        }
+        req->width = out_width;
+        req->height = out_height;
+    }
+    return RKSS_SUCCESS;
+}
+
+// 阶段 1：屏幕捕获（SF 可能已完成缩放/裁剪）
+static RkScreenshotError capture_frame(
+    const RkScreenshotConfig* cfg,
+    RkDmaBuffer** out,
+    int64_t* capture_time_us,
+    RkScaler* scaler)
+{
+    RkCaptureRequest req;
+    RkScreenshotError err = plan_capture(cfg, &req, scaler);
+    if (err != RKSS_SUCCESS) {
+        return err;
+    }
 
-    // ========== 阶段 1: 屏幕捕获 ==========
     uint64_t t_capture = rk_get_time_us();
     RkDmaBuffer* capture_buf = nullptr;
     
-    err = rk_sf_capture(g_ctx.sf_ctx, &capture_buf);
+    err = g_ctx.source->capture(g_ctx.source, &req, &capture_buf);
     if (err != RKSS_SUCCESS) {
-        free(res);
         return err;
     }
     
-    res->capture_time_us = rk_get_time_us() - t_capture;
-    ALOGD("📸 Capture: %.2f ms (%dx%d)", 
-          res->capture_time_us / 1000.0, capture_buf->width, capture_buf->height);
-
-    // ========== 阶段 2: RGA 缩放（可选）==========
-    RkDmaBuffer* process_buf = capture_buf;
-    bool need_scale = (cfg->scale_width > 0 && cfg->scale_height > 0) &&
-                      (cfg->scale_width != capture_buf->width || 
-                       cfg->scale_height != capture_buf->height);
-
-    if (need_scale) {
-        uint64_t t_rga = rk_get_time_us();
-        
-        RkDmaBuffer* scaled_buf = rk_dmabuf_alloc(cfg->scale_width, cfg->scale_height);
-        if (!scaled_buf) {
-            rk_dmabuf_free(capture_buf);
-            free(res);
-            return RKSS_ERROR_NO_MEMORY;
-        }
+    *capture_time_us = rk_get_time_us() - t_capture;
+    rk_scaler_model_update_sf(&g_ctx.scaler_model, capture_buf->width, capture_buf->height,
+                              req.width > 0 || req.crop_width > 0, *capture_time_us);
+    ALOGD("📸 Capture: %.2f ms (%dx%d, scaler %s)", 
+          *capture_time_us / 1000.0, capture_buf->width, capture_buf->height,
+          scaler_name(*scaler));
 
-        err = rk_rga_process(&g_ctx.rga, capture_buf, scaled_buf, cfg->rotation);
-        if (err != RKSS_SUCCESS) {
-            rk_dmabuf_free(scaled_buf);
-            rk_dmabuf_free(capture_buf);
-            free(res);
-            return err;
+    *out = capture_buf;
+    return RKSS_SUCCESS;
+}
+
+// 阶段 2 进行中：RGA 作业已提交，fence 触发后 out 可用
+typedef struct {
+    RkDmaBuffer* capture_buf;   // 作业完成前保持，finish_process 释放（批量时为 NULL，源共享）
+    RkDmaBuffer* out;           // 无作业时即捕获 buffer
+    bool has_job;
+    int fence;                  // -1 表示已完成（无需 RGA 或 CPU 回退）
+    uint64_t t_submit;
+    int src_width;              // 作业源区域，更新成本模型用
+    int src_height;
+    RkRgaJob job;
+    RkOverlay* overlay;         // 完成后叠加的水印（持有引用），NULL 表示无
+} RkPendingFrame;
+
+// 阶段 2a 规划：确定 RGA 作业并取输出 buffer（pf->has_job），不提交、不接管 capture_buf
+// 有水印时总要拷到私有 buffer：捕获 buffer 属于导入缓存 / SurfaceFlinger，可能被其它捕获共用
+static RkScreenshotError prepare_process(
+    const RkScreenshotConfig* cfg,
+    RkDmaBuffer* capture_buf,
+    RkPendingFrame* pf,
+    RkScaler* scaler,
+    bool overlay)
+{
+    memset(pf, 0, sizeof(*pf));
+    pf->fence = -1;
+    pf->out = capture_buf;
+
+    // RGA 路径捕获的是全屏，裁剪在作业内完成；SF 路径已裁剪
+    RkRgaJob* job = &pf->job;
+    int src_width = capture_buf->width;
+    int src_height = capture_buf->height;
+    if (*scaler == RK_SCALER_RGA) {
+        if (has_crop(cfg)) {
+            job->crop_x = cfg->crop_x;
+            job->crop_y = cfg->crop_y;
+            job->crop_width = cfg->crop_width;
+            job->crop_height = cfg->crop_height;
+            src_width = cfg->crop_width;
+            src_height = cfg->crop_height;
         }
+        job->rotation = cfg->rotation;
+        job->flip_horizontal = cfg->flip_horizontal;
+        job->flip_vertical = cfg->flip_vertical;
+    }
+
+    int out_width, out_height;
+    output_size(cfg, src_width, src_height, &out_width, &out_height);
 
-        res->process_time_us = rk_get_time_us() - t_rga;
-        ALOGD("🔄 RGA: %.2f ms (%dx%d -> %dx%d)",
-              res->process_time_us / 1000.0,
-              capture_buf->width, capture_buf->height,
-              scaled_buf->width, scaled_buf->height);
+    // SF 未按请求尺寸输出时同样由 RGA 补做
+    bool need_job = job->crop_width > 0 || job->rotation != 0 ||
+                    job->flip_horizontal || job->flip_vertical ||
+                    out_width != capture_buf->width || out_height != capture_buf->height;
+    if (need_job) {
+        *scaler = RK_SCALER_RGA;
+    }
+
+    // JPEG / 视频输出写入 16 对齐的 buffer，保证 MPP 零拷贝导入；
+    // 未对齐的原图也由 RGA 拷贝到对齐 buffer，代替编码器内的 CPU memcpy。
+    // 需要颜色转换（NV12 编码输入、Raw YUV/RGB888）时总要经过 RGA，与缩放在同一次作业中完成
+    bool encoded = cfg->format == RK_FORMAT_JPEG || is_video_format(cfg->format);
+    int out_format = pipeline_format(cfg);
+    int bpp = rk_format_bits_per_pixel(out_format);
+    // 24 位格式按 4 像素对齐，行字节数保持 4 字节对齐
+    int align = encoded ? RK_MPP_ALIGN : (bpp == 24 ? 4 : 1);
+    bool need_convert = !same_layout(out_format, capture_buf->format);
+    bool need_realign = !need_job &&
+                        (need_convert || overlay || (encoded && !rk_mpp_can_import(capture_buf)));
+    if (!need_job && !need_realign) {
+        return RKSS_SUCCESS;
+    }
 
+    RkDmaBuffer* scaled_buf = rk_dmabuf_pool_acquire_aligned(g_ctx.pool, out_width, out_height,
+                                                             out_format, align, align);
+    if (!scaled_buf) {
+        return RKSS_ERROR_NO_MEMORY;
+    }
+
+    pf->out = scaled_buf;
+    pf->has_job = true;
+    pf->src_width = src_width;
+    pf->src_height = src_height;
+    return RKSS_SUCCESS;
+}
+
+// 阶段 2a：提交 RGA 裁剪/缩放/旋转/镜像/重新对齐（可选），接管 capture_buf
+static RkScreenshotError submit_process(
+    const RkScreenshotConfig* cfg,
+    RkDmaBuffer* capture_buf,
+    RkPendingFrame* pf,
+    RkScaler* scaler)
+{
+    RkOverlay* overlay = current_overlay();
+    RkScreenshotError err = prepare_process(cfg, capture_buf, pf, scaler, overlay != nullptr);
+    if (err != RKSS_SUCCESS) {
+        rk_overlay_unref(overlay);
         rk_dmabuf_free(capture_buf);
-        process_buf = scaled_buf;
+        return err;
+    }
+    pf->overlay = overlay;
+    if (!pf->has_job) {
+        return RKSS_SUCCESS;
     }
 
-    // ========== 阶段 3: 输出 ==========
+    pf->t_submit = rk_get_time_us();
+    err = g_ctx.rga_exec->submit(g_ctx.rga_exec, capture_buf, pf->out, &pf->job,
+                                 -1, &pf->fence);
+    if (err == RKSS_ERROR_RGA_FAILED) {
+        // RGA 作业失败（驱动/对齐限制），退回 CPU 实现（同步完成）
+        ALOGW("⚠️ RGA job failed, falling back to CPU");
+        err = rk_cpu_process_job(capture_buf, pf->out, &pf->job);
+    }
+    if (err != RKSS_SUCCESS) {
+        rk_overlay_unref(pf->overlay);
+        pf->overlay = nullptr;
+        rk_dmabuf_free(pf->out);
+        pf->out = nullptr;
+        rk_dmabuf_free(capture_buf);
+        return err;
+    }
+
+    pf->capture_buf = capture_buf;
+    return RKSS_SUCCESS;
+}
+
+// 阶段 2b：等待 RGA 完成并释放捕获 buffer；update_model 仅在提交后立即等待时有意义
+static RkScreenshotError finish_process(
+    RkPendingFrame* pf,
+    RkDmaBuffer** out,
+    int64_t* process_time_us,
+    bool update_model)
+{
+    RkScreenshotError err = rk_fence_wait(pf->fence, -1);
+    rk_fence_close(pf->fence);
+    pf->fence = -1;
+
+    if (pf->has_job) {
+        *process_time_us = rk_get_time_us() - pf->t_submit;
+        if (err == RKSS_SUCCESS && update_model) {
+            rk_scaler_model_update_rga(&g_ctx.scaler_model, pf->src_width, pf->src_height,
+                                       pf->out->width, pf->out->height, *process_time_us);
+        }
+        ALOGD("🔄 RGA: %.2f ms (%dx%d -> %dx%d %s, rot %d)",
+              *process_time_us / 1000.0,
+              pf->src_width, pf->src_height,
+              pf->out->width, pf->out->height,
+              rk_format_name(pf->out->format), pf->job.rotation);
+    }
+    if (err == RKSS_ERROR_RGA_FAILED && pf->has_job) {
+        // 异步作业以错误结束（fence 报告）：与提交失败相同，退回 CPU 重做
+        ALOGW("⚠️ RGA job completed with error, redoing on CPU");
+        err = rk_cpu_process_job(pf->capture_buf, pf->out, &pf->job);
+    }
+    rk_dmabuf_free(pf->capture_buf);
+    pf->capture_buf = nullptr;
+
+    // 水印在编码前叠加到输出 DMA-BUF（有水印时 prepare_process 保证是私有 pool buffer）
+    if (err == RKSS_SUCCESS && pf->overlay) {
+        err = rk_overlay_apply(pf->overlay, &g_ctx.rga, pf->out);
+    }
+    rk_overlay_unref(pf->overlay);
+    pf->overlay = nullptr;
+
+    if (err != RKSS_SUCCESS) {
+        rk_dmabuf_free(pf->out);
+        pf->out = nullptr;
+        return err;
+    }
+    *out = pf->out;
+    pf->out = nullptr;
+    return RKSS_SUCCESS;
+}
+
+// 阶段 2：提交并等待，消耗 capture_buf
+static RkScreenshotError process_frame(
+    const RkScreenshotConfig* cfg,
+    RkDmaBuffer* capture_buf,
+    RkDmaBuffer** out,
+    int64_t* process_time_us,
+    RkScaler* scaler)
+{
+    RkPendingFrame pf;
+    RkScreenshotError err = submit_process(cfg, capture_buf, &pf, scaler);
+    if (err != RKSS_SUCCESS) return err;
+    return finish_process(&pf, out, process_time_us, true);
+}
+
+// 阶段 1 + 2：屏幕捕获 + 缩放（SF 或 RGA），输出 DMA-BUF（调用者 rk_dmabuf_free）
+static RkScreenshotError acquire_frame(
+    const RkScreenshotConfig* cfg,
+    RkDmaBuffer** out,
+    int64_t* capture_time_us,
+    int64_t* process_time_us,
+    RkScaler* scaler)
+{
+    RkDmaBuffer* capture_buf = nullptr;
+    RkScreenshotError err = capture_frame(cfg, &capture_buf, capture_time_us, scaler);
+    if (err != RKSS_SUCCESS) {
+        return err;
+    }
+    return process_frame(cfg, capture_buf, out, process_time_us, scaler);
+}
+
+// 按平面逐行拷贝，去掉行/垂直步进填充
+static void copy_plane(const uint8_t* src, size_t src_pitch, uint8_t* dst, size_t row_bytes,
+                       int rows) {
+    if (src_pitch == row_bytes) {
+        memcpy(dst, src, row_bytes * rows);
+        return;
+    }
+    for (int y = 0; y < rows; y++) {
+        memcpy(dst + y * row_bytes, src + y * src_pitch, row_bytes);
+    }
+}
+
+static void copy_packed(const RkDmaBuffer* buf, const uint8_t* vir, uint8_t* out) {
+    int w = buf->width, h = buf->height;
+    size_t luma_size = (size_t)buf->stride * buf->height_stride;
+    switch (buf->format) {
+        case RK_FORMAT_YUV420SP:
+            copy_plane(vir, buf->stride, out, w, h);
+            copy_plane(vir + luma_size, buf->stride, out + (size_t)w * h,
+                       (size_t)(w + 1) / 2 * 2, (h + 1) / 2);
+            break;
+        case RK_FORMAT_YUV420P: {
+            size_t cw = (w + 1) / 2, ch = (h + 1) / 2;
+            size_t c_pitch = buf->stride / 2;
+            size_t c_size = c_pitch * (buf->height_stride / 2);
+            copy_plane(vir, buf->stride, out, w, h);
+            copy_plane(vir + luma_size, c_pitch, out + (size_t)w * h, cw, ch);
+            copy_plane(vir + luma_size + c_size, c_pitch, out + (size_t)w * h + cw * ch, cw, ch);
+            break;
+        }
+        default: {
+            size_t bytes = rk_format_bits_per_pixel(buf->format) / 8;
+            copy_plane(vir, buf->stride * bytes, out, w * bytes, h);
+            break;
+        }
+    }
+}
+
+// 结果的实际分配：JPEG 数据借用 MPP 的输出 buffer，释放时归还而不是 free
+typedef struct {
+    RkScreenshotResult pub;
+    void (*release)(void* lease);
+    void* lease;
+} RkResultHolder;
+
+static RkScreenshotResult* alloc_result() {
+    RkResultHolder* holder = (RkResultHolder*)calloc(1, sizeof(RkResultHolder));
+    return holder ? &holder->pub : nullptr;
+}
+
+// 释放 res->data，res 本身保留
+static void release_result_data(RkScreenshotResult* res) {
+    RkResultHolder* holder = (RkResultHolder*)res;
+    if (holder->release) {
+        holder->release(holder->lease);
+    } else {
+        free(res->data);
+    }
+    holder->release = nullptr;
+    holder->lease = nullptr;
+    res->data = nullptr;
+    res->size = 0;
+}
+
+// 一次 JPEG 编码：strips > 1 时条带并行
+typedef struct {
+    RkDmaBuffer* src;
+    int strips;
+} RkJpegJob;
+
+static RkScreenshotError encode_jpeg(void* user, int quality, RkMppPacket* out) {
+    RkJpegJob* job = (RkJpegJob*)user;
+    return job->strips > 1
+        ? rk_jpeg_pool_encode_strips(g_ctx.jpeg, g_ctx.encode_threads, job->src, quality,
+                                     job->strips, out)
+        : rk_jpeg_pool_encode(g_ctx.jpeg, job->src, quality, out);
+}
+
+// 阶段 3：JPEG 编码或拷贝原始数据到 res，不释放 process_buf
+// allow_strips：可用 encode_threads 做条带编码（调用者自己不在 encode_threads 上运行）
+static RkScreenshotError output_frame(
+    const RkScreenshotConfig* cfg,
+    RkDmaBuffer* process_buf,
+    RkScreenshotResult* res,
+    bool allow_strips)
+{
     if (cfg->format == RK_FORMAT_JPEG) {
         // JPEG 编码
         uint64_t t_enc = rk_get_time_us();
         
-        err = rk_mpp_encode_jpeg(&g_ctx.mpp, process_buf, 
-                                 &res->data, &res->size, cfg->quality);
+        int strips = allow_strips && g_ctx.encode_threads
+                         ? rk_jpeg_strip_count(process_buf->width, process_buf->height,
+                                               cfg->jpeg_strips, rk_jpeg_pool_size(g_ctx.jpeg))
+                         : 1;
+        RkJpegJob job = {process_buf, strips};
+        RkMppPacket packet;
+        int quality = cfg->quality;
+        RkScreenshotError err = cfg->jpeg_max_bytes > 0
+            ? rk_jpeg_encode_target(&g_ctx.jpeg_rate, process_buf->width, process_buf->height,
+                                    cfg->jpeg_max_bytes, cfg->quality, encode_jpeg, &job,
+                                    &packet, &quality)
+            : encode_jpeg(&job, quality, &packet);
         if (err != RKSS_SUCCESS) {
-            rk_dmabuf_free(process_buf);
-            free(res);
             return err;
         }
+        // 零拷贝：结果直接指向编码器输出 buffer
+        RkResultHolder* holder = (RkResultHolder*)res;
+        res->data = packet.data;
+        res->size = packet.size;
+        holder->release = packet.release;
+        holder->lease = packet.buffer;
+        res->quality = quality;
 
         res->encode_time_us = rk_get_time_us() - t_enc;
-        ALOGD("🖼️  JPEG: %.2f ms (%zu bytes, Q%d)",
-              res->encode_time_us / 1000.0, res->size, cfg->quality);
+        ALOGD("🖼️  JPEG: %.2f ms (%zu bytes, Q%d, %d strip%s)",
+              res->encode_time_us / 1000.0, res->size, quality, strips,
+              strips > 1 ? "s" : "");
     } else {
-        // 原始 RGBA
-        void* vir = rk_dmabuf_map(process_buf);
-        if (!vir) {
-            rk_dmabuf_free(process_buf);
-            free(res);
-            return RKSS_ERROR_CAPTURE_FAILED;
-        }
-
-        res->size = process_buf->size;
+        // 原始数据：去掉步进填充，紧凑排列
+        res->size = rk_format_packed_size(process_buf->format, process_buf->width,
+                                          process_buf->height);
         res->data = (uint8_t*)malloc(res->size);
         if (!res->data) {
-            rk_dmabuf_free(process_buf);
-            free(res);
             return RKSS_ERROR_NO_MEMORY;
         }
-        memcpy(res->data, vir, res->size);
+
+        void* vir = rk_dmabuf_begin_cpu_access(process_buf, RK_DMABUF_CPU_READ, 0,
+                                               process_buf->size);
+        if (!vir) {
+            release_result_data(res);
+            return RKSS_ERROR_CAPTURE_FAILED;
+        }
+        copy_packed(process_buf, (const uint8_t*)vir, res->data);
+        rk_dmabuf_end_cpu_access(process_buf, RK_DMABUF_CPU_READ, 0, process_buf->size);
     }
 
     // 填充结果
     res->width = process_buf->width;
     res->height = process_buf->height;
     res->format = cfg->format;
-    res->timestamp_us = t_start;
+    res->display_id = rk_screenshot_config_display(cfg);
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_screenshot_capture(
+    const RkScreenshotConfig* cfg,
+    RkScreenshotResult** result)
+{
+    if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!cfg || !result) return RKSS_ERROR_INVALID_PARAM;
+    if (is_video_format(cfg->format)) return RKSS_ERROR_UNSUPPORTED;
+
+    uint64_t t_start = rk_get_time_us();
+    RkScreenshotError err;
+
+    RkDmaBufStats dma_before;
+    rk_dmabuf_get_stats(&dma_before);
+
+    // 分配结果
+    RkScreenshotResult* res = alloc_result();
+    if (!res) return RKSS_ERROR_NO_MEMORY;
+
+    // ========== 阶段 1-2: 捕获 + 处理 ==========
+    RkDmaBuffer* process_buf = nullptr;
+    err = acquire_frame(cfg, &process_buf, &res->capture_time_us, &res->process_time_us,
+                        &res->scaler);
+    if (err != RKSS_SUCCESS) {
+        free(res);
+        return err;
+    }
 
+    // ========== 阶段 3: 输出 ==========
+    err = output_frame(cfg, process_buf, res, true);
     rk_dmabuf_free(process_buf);
+    if (err != RKSS_SUCCESS) {
+        free(res);
+        return err;
+    }
+    res->timestamp_us = t_start;
 
     // 总结
     uint64_t total = rk_get_time_us() - t_start;
-    ALOGI("📊 Total: %.2f ms | Capture %.2f + RGA %.2f + Encode %.2f | %.1f FPS",
+    res->total_time_us = total;
+    ALOGI("📊 Total: %.2f ms | Capture %.2f + RGA %.2f + Encode %.2f | scaler %s | %.1f FPS",
           total / 1000.0,
           res->capture_time_us / 1000.0,
           res->process_time_us / 1000.0,
           res->encode_time_us / 1000.0,
+          scaler_name(res->scaler),
           1000000.0 / total);
 
+    RkDmaBufStats dma_after;
+    rk_dmabuf_get_stats(&dma_after);
+    ALOGD("🗺️  DMA-BUF: %lu maps, %lu syncs this frame",
+          dma_after.maps - dma_before.maps, dma_after.syncs - dma_before.syncs);
+
     *result = res;
     return RKSS_SUCCESS;
 }
 
+// ============================================
+// 异步截图
+// ============================================
+
+// 异步任务：捕获 + RGA 提交在调用线程，等待 RGA + 编码 + 回调在任务线程
+#define RK_MAX_ASYNC_TASKS 8
+
+typedef enum {
+    RK_TASK_FREE = 0,
+    RK_TASK_SUBMITTING,     // 调用线程正在捕获/提交
+    RK_TASK_QUEUED,         // RGA 已提交，等待任务线程
+    RK_TASK_RUNNING,        // 任务线程编码/回调中
+    RK_TASK_DONE,           // 结束（成功/失败/取消），保留到槽位复用
+} RkAsyncTaskState;
+
+typedef struct {
+    int id;
+    RkAsyncTaskState state;
+    bool cancelled;
+    RkScreenshotConfig cfg;
+    RkPendingFrame pending;
+    RkScreenshotResult* res;
+    void (*callback)(RkScreenshotResult* result, void* user_data);
+    void* user_data;
+    RkScreenshotError err;
+} RkAsyncTask;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;        // 有任务入队 / 停止
+    pthread_cond_t done;        // 任务结束
+    RkAsyncTask tasks[RK_MAX_ASYNC_TASKS];
+    int next_id;
+    bool thread_started;
+    bool stop;
+    pthread_t thread;
+} RkAsyncQueue;
+
+static RkAsyncQueue g_async = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                               PTHREAD_COND_INITIALIZER};
+
+// 调用者持有 g_async.lock
+static RkAsyncTask* async_find_locked(int task_id) {
+    for (int i = 0; i < RK_MAX_ASYNC_TASKS; i++) {
+        RkAsyncTask* t = &g_async.tasks[i];
+        if (t->state != RK_TASK_FREE && t->id == task_id) return t;
+    }
+    return nullptr;
+}
+
+// 按提交顺序取下一个已入队任务；调用者持有 g_async.lock
+static RkAsyncTask* async_next_queued_locked() {
+    RkAsyncTask* next = nullptr;
+    for (int i = 0; i < RK_MAX_ASYNC_TASKS; i++) {
+        RkAsyncTask* t = &g_async.tasks[i];
+        if (t->state == RK_TASK_QUEUED && (!next || t->id < next->id)) next = t;
+    }
+    return next;
+}
+
+// 空闲槽位优先，否则复用最早结束的任务；调用者持有 g_async.lock
+static RkAsyncTask* async_alloc_locked() {
+    RkAsyncTask* slot = nullptr;
+    for (int i = 0; i < RK_MAX_ASYNC_TASKS; i++) {
+        RkAsyncTask* t = &g_async.tasks[i];
+        if (t->state == RK_TASK_FREE) return t;
+        if (t->state == RK_TASK_DONE && (!slot || t->id < slot->id)) slot = t;
+    }
+    return slot;
+}
+
+// 任务线程：等待 RGA fence -> 编码 -> 回调，严格按提交顺序
+static void* async_thread(void* arg) {
+    pthread_mutex_lock(&g_async.lock);
+    for (;;) {
+        RkAsyncTask* t = async_next_queued_locked();
+        if (!t) {
+            if (g_async.stop) break;
+            pthread_cond_wait(&g_async.work, &g_async.lock);
+            continue;
+        }
+        t->state = RK_TASK_RUNNING;
+        bool cancelled = t->cancelled;
+        pthread_mutex_unlock(&g_async.lock);
+
+        RkScreenshotResult* res = t->res;
+        RkDmaBuffer* process_buf = nullptr;
+        // 取消的任务同样要等 RGA 写完才能归还 buffer
+        RkScreenshotError err = finish_process(&t->pending, &process_buf,
+                                               &res->process_time_us, false);
+        if (err == RKSS_SUCCESS && !cancelled) {
+            err = output_frame(&t->cfg, process_buf, res, true);
+        }
+        rk_dmabuf_free(process_buf);
+
+        if (cancelled) {
+            err = RKSS_ERROR_CANCELLED;
+        } else {
+            res->total_time_us = rk_get_time_us() - res->timestamp_us;
+            ALOGD("📊 Async task %d: %.2f ms (%s)", t->id, res->total_time_us / 1000.0,
+                  rk_screenshot_error_string(err));
+        }
+        if (err != RKSS_SUCCESS) {
+            rk_screenshot_free_result(res);
+            res = nullptr;
+        }
+        if (!cancelled && t->callback) {
+            t->callback(res, t->user_data);
+        } else {
+            rk_screenshot_free_result(res);
+        }
+
+        pthread_mutex_lock(&g_async.lock);
+        t->res = nullptr;
+        t->err = err;
+        t->state = RK_TASK_DONE;
+        pthread_cond_broadcast(&g_async.done);
+    }
+    pthread_mutex_unlock(&g_async.lock);
+    return nullptr;
+}
+
+// 完成所有已入队任务后停止任务线程
+static void async_stop() {
+    pthread_mutex_lock(&g_async.lock);
+    bool started = g_async.thread_started;
+    g_async.stop = true;
+    pthread_cond_broadcast(&g_async.work);
+    pthread_mutex_unlock(&g_async.lock);
+
+    if (started) pthread_join(g_async.thread, nullptr);
+
+    pthread_mutex_lock(&g_async.lock);
+    memset(g_async.tasks, 0, sizeof(g_async.tasks));
+    g_async.thread_started = false;
+    g_async.stop = false;
+    pthread_mutex_unlock(&g_async.lock);
+}
+
+int rk_screenshot_capture_async(
+    const RkScreenshotConfig* cfg,
+    void (*callback)(RkScreenshotResult* result, void* user_data),
+    void* user_data)
+{
+    if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!cfg) return RKSS_ERROR_INVALID_PARAM;
+    if (is_video_format(cfg->format)) return RKSS_ERROR_UNSUPPORTED;
+
+    pthread_mutex_lock(&g_async.lock);
+    if (!g_async.thread_started) {
+        if (pthread_create(&g_async.thread, NULL, async_thread, NULL) != 0) {
+            pthread_mutex_unlock(&g_async.lock);
+            return RKSS_ERROR_NO_MEMORY;
+        }
+        g_async.thread_started = true;
+    }
+    RkAsyncTask* t = async_alloc_locked();
+    if (!t) {
+        pthread_mutex_unlock(&g_async.lock);
+        return RKSS_ERROR_DEVICE_BUSY;
+    }
+    memset(t, 0, sizeof(*t));
+    if (g_async.next_id == INT32_MAX) g_async.next_id = 0;
+    t->id = ++g_async.next_id;
+    t->state = RK_TASK_SUBMITTING;
+    t->cfg = *cfg;
+    t->callback = callback;
+    t->user_data = user_data;
+    pthread_mutex_unlock(&g_async.lock);
+
+    // 阶段 1 + 2a 在调用线程：捕获后只提交 RGA，不等待
+    RkScreenshotError err = RKSS_ERROR_NO_MEMORY;
+    RkScreenshotResult* res = alloc_result();
+    if (res) {
+        res->timestamp_us = rk_get_time_us();
+        RkDmaBuffer* capture_buf = nullptr;
+        err = capture_frame(&t->cfg, &capture_buf, &res->capture_time_us, &res->scaler);
+        if (err == RKSS_SUCCESS) {
+            err = submit_process(&t->cfg, capture_buf, &t->pending, &res->scaler);
+        }
+    }
+
+    pthread_mutex_lock(&g_async.lock);
+    int id = t->id;
+    if (err != RKSS_SUCCESS) {
+        free(res);
+        t->state = RK_TASK_FREE;
+        pthread_mutex_unlock(&g_async.lock);
+        return err;
+    }
+    t->res = res;
+    t->state = RK_TASK_QUEUED;
+    pthread_cond_signal(&g_async.work);
+    pthread_mutex_unlock(&g_async.lock);
+    return id;
+}
+
+RkScreenshotError rk_screenshot_cancel(int task_id) {
+    pthread_mutex_lock(&g_async.lock);
+    RkAsyncTask* t = async_find_locked(task_id);
+    RkScreenshotError err = RKSS_SUCCESS;
+    if (!t || t->state == RK_TASK_DONE) {
+        err = RKSS_ERROR_INVALID_PARAM;
+    } else if (t->state == RK_TASK_RUNNING) {
+        err = RKSS_ERROR_DEVICE_BUSY;
+    } else {
+        t->cancelled = true;
+    }
+    pthread_mutex_unlock(&g_async.lock);
+    return err;
+}
+
+RkScreenshotError rk_screenshot_wait(int task_id, int timeout_ms) {
+    struct timespec deadline;
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&g_async.lock);
+    RkScreenshotError err = RKSS_SUCCESS;
+    for (;;) {
+        RkAsyncTask* t = async_find_locked(task_id);
+        if (!t) {
+            err = RKSS_ERROR_INVALID_PARAM;
+            break;
+        }
+        if (t->state == RK_TASK_DONE) {
+            err = t->err;
+            break;
+        }
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&g_async.done, &g_async.lock);
+        } else if (pthread_cond_timedwait(&g_async.done, &g_async.lock, &deadline) == ETIMEDOUT) {
+            err = RKSS_ERROR_TIMEOUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_async.lock);
+    return err;
+}
+
+// ============================================
+// 多屏截图
+// ============================================
+
+RkScreenshotError rk_screenshot_get_displays(RkDisplayInfo* displays, int max_count, int* count) {
+    if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    return g_ctx.source->get_displays(g_ctx.source, displays, max_count, count);
+}
+
+typedef struct {
+    RkScreenshotConfig cfg;
+    RkDmaBuffer* buf;
+    RkScaler scaler;
+    int64_t capture_time_us;
+    uint64_t done_us;
+    RkScreenshotError err;
+} RkDisplayCapture;
+
+static void* display_capture_thread(void* arg) {
+    RkDisplayCapture* job = (RkDisplayCapture*)arg;
+    job->err = capture_frame(&job->cfg, &job->buf, &job->capture_time_us, &job->scaler);
+    job->done_us = rk_get_time_us();
+    return NULL;
+}
+
+RkScreenshotError rk_screenshot_capture_multi(
+    const RkScreenshotConfig* cfg,
+    const uint64_t* display_ids,
+    int count,
+    RkScreenshotResult** results)
+{
+    if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!cfg || !display_ids || !results || count <= 0 || count > RK_MAX_DISPLAYS) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+    if (is_video_format(cfg->format)) return RKSS_ERROR_UNSUPPORTED;
+
+    RkDisplayCapture jobs[RK_MAX_DISPLAYS];
+    pthread_t threads[RK_MAX_DISPLAYS];
+    bool started[RK_MAX_DISPLAYS] = {};
+    memset(jobs, 0, sizeof(jobs));
+
+    // ========== 阶段 1: 所有显示器同时发起捕获 ==========
+    // SF 捕获是 Binder 往返 + 合成，线程并发后各屏落在同一帧窗口内
+    uint64_t t_start = rk_get_time_us();
+    for (int i = 0; i < count; i++) {
+        jobs[i].cfg = *cfg;
+        rk_screenshot_config_set_display(&jobs[i].cfg, display_ids[i]);
+        started[i] = (i > 0) &&
+                     pthread_create(&threads[i], NULL, display_capture_thread, &jobs[i]) == 0;
+    }
+    // 第一个显示器在当前线程捕获；线程创建失败的显示器同样回退到当前线程
+    for (int i = 0; i < count; i++) {
+        if (!started[i]) display_capture_thread(&jobs[i]);
+    }
+    for (int i = 0; i < count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    RkScreenshotError err = RKSS_SUCCESS;
+    uint64_t first_done = UINT64_MAX, last_done = 0;
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].err != RKSS_SUCCESS) {
+            ALOGE("❌ Display %llu capture failed: %s", (unsigned long long)display_ids[i],
+                  rk_screenshot_error_string(jobs[i].err));
+            if (err == RKSS_SUCCESS) err = jobs[i].err;
+            continue;
+        }
+        if (jobs[i].done_us < first_done) first_done = jobs[i].done_us;
+        if (jobs[i].done_us > last_done) last_done = jobs[i].done_us;
+    }
+
+    // ========== 阶段 2-3: 按显示器依次处理/编码 ==========
+    RkScreenshotResult* out[RK_MAX_DISPLAYS] = {};
+    for (int i = 0; i < count && err == RKSS_SUCCESS; i++) {
+        RkDisplayCapture* job = &jobs[i];
+        out[i] = alloc_result();
+        if (!out[i]) {
+            err = RKSS_ERROR_NO_MEMORY;
+            break;
+        }
+
+        RkScreenshotResult* res = out[i];
+        res->capture_time_us = job->capture_time_us;
+        res->scaler = job->scaler;
+        RkDmaBuffer* process_buf = nullptr;
+        err = process_frame(&job->cfg, job->buf, &process_buf, &res->process_time_us,
+                            &res->scaler);
+        job->buf = nullptr;     // 已由 process_frame 接管
+        if (err != RKSS_SUCCESS) break;
+
+        err = output_frame(&job->cfg, process_buf, res, true);
+        rk_dmabuf_free(process_buf);
+        // 同一批次共用发起时刻作为时间戳
+        res->timestamp_us = t_start;
+        res->total_time_us = rk_get_time_us() - t_start;
+    }
+
+    if (err != RKSS_SUCCESS) {
+        for (int i = 0; i < count; i++) {
+            rk_dmabuf_free(jobs[i].buf);
+            rk_screenshot_free_result(out[i]);
+        }
+        return err;
+    }
+
+    ALOGI("📊 Multi-display: %d displays in %.2f ms | capture skew %.2f ms",
+          count, (rk_get_time_us() - t_start) / 1000.0, (last_done - first_done) / 1000.0);
+
+    for (int i = 0; i < count; i++) {
+        results[i] = out[i];
+    }
+    return RKSS_SUCCESS;
+}
+
+// ============================================
+// 单次捕获多输出
+// ============================================
+
+typedef struct {
+    const RkScreenshotConfig* configs;
+    RkPendingFrame* pfs;
+    RkScreenshotResult** out;
+    RkScreenshotError errs[RK_MAX_BATCH_OUTPUTS];
+} RkBatchOutput;
+
+static void batch_output_task(void* arg, int index) {
+    RkBatchOutput* batch = (RkBatchOutput*)arg;
+    // 已在 encode_threads 上并行，不再切条带
+    batch->errs[index] = output_frame(&batch->configs[index], batch->pfs[index].out,
+                                      batch->out[index], false);
+}
+
+// 提交批量作业；整批无法在一个核心/一次 job 内完成时逐个提交，仍失败的作业退回 CPU
+static RkScreenshotError submit_batch_jobs(RkDmaBuffer* capture_buf, RkPendingFrame* pfs,
+                                           int count, int* fences, int* fence_count) {
+    RkDmaBuffer* dsts[RK_RGA_BATCH_MAX];
+    RkRgaJob jobs[RK_RGA_BATCH_MAX];
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (!pfs[i].has_job) continue;
+        dsts[n] = pfs[i].out;
+        jobs[n] = pfs[i].job;
+        n++;
+    }
+    *fence_count = 0;
+    if (n == 0) return RKSS_SUCCESS;
+
+    RkScreenshotError err = g_ctx.rga_exec->submit_batch(g_ctx.rga_exec, capture_buf, dsts, jobs,
+                                                         n, -1, &fences[0]);
+    if (err == RKSS_SUCCESS) {
+        *fence_count = 1;
+        return RKSS_SUCCESS;
+    }
+    if (err != RKSS_ERROR_RGA_FAILED) return err;
+
+    ALOGW("⚠️ RGA batch failed, submitting %d jobs separately", n);
+    for (int i = 0; i < n; i++) {
+        int fence = -1;
+        err = g_ctx.rga_exec->submit(g_ctx.rga_exec, capture_buf, dsts[i], &jobs[i], -1, &fence);
+        if (err == RKSS_ERROR_RGA_FAILED) {
+            ALOGW("⚠️ RGA job failed, falling back to CPU");
+            err = rk_cpu_process_job(capture_buf, dsts[i], &jobs[i]);
+        }
+        if (err != RKSS_SUCCESS) return err;    // 已提交的 fence 由调用者等待
+        if (fence >= 0) fences[(*fence_count)++] = fence;
+    }
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_screenshot_capture_batch(
+    const RkScreenshotConfig* configs,
+    int count,
+    RkScreenshotResult*** results)
+{
+    if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!configs || !results || count <= 0 || count > RK_MAX_BATCH_OUTPUTS) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+    for (int i = 0; i < count; i++) {
+        if (rk_screenshot_config_display(&configs[i]) != rk_screenshot_config_display(&configs[0])) {
+            return RKSS_ERROR_INVALID_PARAM;
+        }
+        if (is_video_format(configs[i].format)) return RKSS_ERROR_UNSUPPORTED;
+        RkScreenshotError err = check_config(&configs[i]);
+        if (err != RKSS_SUCCESS) return err;
+    }
+
+    // ========== 阶段 1: 全分辨率捕获一次 ==========
+    uint64_t t_start = rk_get_time_us();
+    RkCaptureRequest req;
+    memset(&req, 0, sizeof(req));
+    req.display_id = rk_screenshot_config_display(&configs[0]);
+
+    RkDmaBuffer* capture_buf = nullptr;
+    RkScreenshotError err = g_ctx.source->capture(g_ctx.source, &req, &capture_buf);
+    if (err != RKSS_SUCCESS) return err;
+    int64_t capture_time_us = rk_get_time_us() - t_start;
+    rk_scaler_model_update_sf(&g_ctx.scaler_model, capture_buf->width, capture_buf->height,
+                              false, capture_time_us);
+
+    // ========== 阶段 2: 所有输出的裁剪/缩放/转换合并为一次 RGA 提交 ==========
+    // 有水印时每个输出都写入私有 buffer（见 prepare_process）
+    RkOverlay* overlay = current_overlay();
+    RkPendingFrame pfs[RK_MAX_BATCH_OUTPUTS];
+    RkScaler scalers[RK_MAX_BATCH_OUTPUTS];
+    memset(pfs, 0, sizeof(pfs));
+    int planned = 0;
+    for (; planned < count && err == RKSS_SUCCESS; planned++) {
+        scalers[planned] = RK_SCALER_RGA;
+        err = prepare_process(&configs[planned], capture_buf, &pfs[planned], &scalers[planned],
+                              overlay != nullptr);
+        if (!pfs[planned].has_job) scalers[planned] = RK_SCALER_AUTO;
+    }
+
+    int fences[RK_MAX_BATCH_OUTPUTS];
+    int fence_count = 0;
+    uint64_t t_submit = rk_get_time_us();
+    if (err == RKSS_SUCCESS) {
+        err = submit_batch_jobs(capture_buf, pfs, count, fences, &fence_count);
+    }
+    RkScreenshotError wait_err = RKSS_SUCCESS;
+    for (int i = 0; i < fence_count; i++) {
+        RkScreenshotError e = rk_fence_wait(fences[i], -1);
+        if (wait_err == RKSS_SUCCESS) wait_err = e;
+        rk_fence_close(fences[i]);
+    }
+    if (err == RKSS_SUCCESS && wait_err == RKSS_ERROR_RGA_FAILED) {
+        // 异步作业以错误结束：全部作业已停止读写，在 CPU 上重做
+        ALOGW("⚠️ RGA batch completed with error, redoing on CPU");
+        for (int i = 0; i < count && err == RKSS_SUCCESS; i++) {
+            if (pfs[i].has_job) err = rk_cpu_process_job(capture_buf, pfs[i].out, &pfs[i].job);
+        }
+    } else if (err == RKSS_SUCCESS) {
+        err = wait_err;
+    }
+
+    for (int i = 0; i < count && overlay && err == RKSS_SUCCESS; i++) {
+        err = rk_overlay_apply(overlay, &g_ctx.rga, pfs[i].out);
+    }
+    rk_overlay_unref(overlay);
+    int64_t process_time_us = rk_get_time_us() - t_submit;
+
+    // ========== 阶段 3: 编码（多个编码上下文时并行）==========
+    RkScreenshotResult** out = nullptr;
+    if (err == RKSS_SUCCESS) {
+        out = (RkScreenshotResult**)calloc(count, sizeof(RkScreenshotResult*));
+        if (!out) err = RKSS_ERROR_NO_MEMORY;
+    }
+    for (int i = 0; i < count && err == RKSS_SUCCESS; i++) {
+        out[i] = alloc_result();
+        if (!out[i]) err = RKSS_ERROR_NO_MEMORY;
+    }
+    if (err == RKSS_SUCCESS) {
+        RkBatchOutput batch = {configs, pfs, out, {}};
+        int shared = 0;
+        for (int i = 0; i < count; i++) {
+            if (!pfs[i].has_job) shared++;
+        }
+        // 共用捕获 buffer 的输出并发读取前先映射，避免各线程重复 mmap
+        if (shared > 1 && !rk_dmabuf_map(capture_buf)) err = RKSS_ERROR_CAPTURE_FAILED;
+        if (err == RKSS_SUCCESS && g_ctx.encode_threads && count > 1) {
+            rk_thread_pool_run(g_ctx.encode_threads, count, batch_output_task, &batch);
+        } else {
+            for (int i = 0; i < count && err == RKSS_SUCCESS; i++) {
+                batch_output_task(&batch, i);
+            }
+        }
+        for (int i = 0; i < count && err == RKSS_SUCCESS; i++) {
+            err = batch.errs[i];
+            RkScreenshotResult* res = out[i];
+            res->scaler = scalers[i];
+            res->capture_time_us = capture_time_us;
+            res->process_time_us = pfs[i].has_job ? process_time_us : 0;
+            res->timestamp_us = t_start;
+            res->total_time_us = rk_get_time_us() - t_start;
+        }
+    }
+
+    for (int i = 0; i < planned; i++) {
+        if (pfs[i].has_job) rk_dmabuf_free(pfs[i].out);
+    }
+    rk_dmabuf_free(capture_buf);
+
+    if (err != RKSS_SUCCESS) {
+        rk_screenshot_free_batch(out, count);
+        return err;
+    }
+
+    ALOGI("📊 Batch: %d outputs in %.2f ms | Capture %.2f + RGA %.2f (%s) | one capture",
+          count, (rk_get_time_us() - t_start) / 1000.0, capture_time_us / 1000.0,
+          process_time_us / 1000.0, fence_count > 1 ? "split" : "batched");
+    *results = out;
+    return RKSS_SUCCESS;
+}
+
+void rk_screenshot_free_batch(RkScreenshotResult** results, int count) {
+    if (!results) return;
+    for (int i = 0; i < count; i++) {
+        rk_screenshot_free_result(results[i]);
+    }
+    free(results);
+}
+
+// ============================================
+// DMA-BUF 零拷贝结果
+// ============================================
+
+// 公共结构在前，释放时取回租借的 buffer
+typedef struct {
+    RkScreenshotDmaBuf pub;
+    RkDmaBuffer* buf;
+    bool cpu_access;
+} RkDmaBufLease;
+
+RkScreenshotError rk_screenshot_capture_dmabuf(
+    const RkScreenshotConfig* cfg,
+    uint32_t flags,
+    RkScreenshotDmaBuf** result)
+{
+    if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!cfg || !result) return RKSS_ERROR_INVALID_PARAM;
+    if (!rk_rga_output_format_supported(cfg->format)) return RKSS_ERROR_UNSUPPORTED;
+
+    uint64_t t_start = rk_get_time_us();
+
+    RkDmaBufLease* lease = (RkDmaBufLease*)calloc(1, sizeof(RkDmaBufLease));
+    if (!lease) return RKSS_ERROR_NO_MEMORY;
+
+    RkScreenshotDmaBuf* res = &lease->pub;
+    RkScreenshotError err = acquire_frame(cfg, &lease->buf, &res->capture_time_us,
+                                          &res->process_time_us, &res->scaler);
+    if (err != RKSS_SUCCESS) {
+        free(lease);
+        return err;
+    }
+
+    RkDmaBuffer* buf = lease->buf;
+    if (flags & RK_CAPTURE_FLAG_MAP) {
+        // 读区间保持到 release，期间 CPU 读取 cache 一致
+        res->data = rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_READ, 0, buf->size);
+        if (!res->data) {
+            rk_dmabuf_free(buf);
+            free(lease);
+            return RKSS_ERROR_CAPTURE_FAILED;
+        }
+        lease->cpu_access = true;
+    }
+
+    res->fd = buf->fd;
+    res->size = buf->size;
+    res->width = buf->width;
+    res->height = buf->height;
+    res->stride = buf->stride;
+    res->height_stride = buf->height_stride;
+    res->format = cfg->format;
+    res->timestamp_us = t_start;
+    res->total_time_us = rk_get_time_us() - t_start;
+
+    ALOGI("📊 Total: %.2f ms | Capture %.2f + RGA %.2f | scaler %s | DMA-BUF fd=%d (zero-copy)",
+          res->total_time_us / 1000.0,
+          res->capture_time_us / 1000.0,
+          res->process_time_us / 1000.0,
+          scaler_name(res->scaler),
+          res->fd);
+
+    *result = res;
+    return RKSS_SUCCESS;
+}
+
+void rk_screenshot_release_dmabuf(RkScreenshotDmaBuf* result) {
+    if (!result) return;
+
+    RkDmaBufLease* lease = (RkDmaBufLease*)result;
+    if (lease->cpu_access) {
+        rk_dmabuf_end_cpu_access(lease->buf, RK_DMABUF_CPU_READ, 0, lease->buf->size);
+    }
+    rk_dmabuf_free(lease->buf);
+    free(lease);
+}
+
+// ============================================
+// 视频录制
+// ============================================
+
+#define RK_MAX_RECORDINGS 4
+
+// 录制线程取帧时使用，停止前保持有效
+typedef struct {
+    int id;
+    RkScreenshotConfig cfg;     // 已固定输出尺寸（偶数）
+    RkRecorder* rec;
+} RkRecording;
+
+static pthread_mutex_t g_rec_lock = PTHREAD_MUTEX_INITIALIZER;
+static RkRecording* g_recordings[RK_MAX_RECORDINGS];
+static int g_next_rec_id;
+
+static RkScreenshotError recording_acquire(void* user, RkDmaBuffer** out) {
+    RkRecording* r = (RkRecording*)user;
+    int64_t capture_us = 0, process_us = 0;
+    RkScaler scaler = RK_SCALER_AUTO;
+    return acquire_frame(&r->cfg, out, &capture_us, &process_us, &scaler);
+}
+
+int rk_screenshot_start_recording(const RkScreenshotConfig* cfg, const char* filepath) {
+    return rk_screenshot_start_recording_ex(cfg, nullptr, filepath);
+}
+
+int rk_screenshot_start_recording_ex(const RkScreenshotConfig* cfg, const RkRecordingParams* rp,
+                                     const char* filepath) {
+    if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!cfg || !filepath) return RKSS_ERROR_INVALID_PARAM;
+    if (!is_video_format(cfg->format)) return RKSS_ERROR_UNSUPPORTED;
+    RkScreenshotError err = check_config(cfg);
+    if (err != RKSS_SUCCESS) return err;
+
+    // 编码尺寸在录制期间固定：按当前显示尺寸算出并写成显式缩放
+    int display_width = 0, display_height = 0;
+    err = g_ctx.source->get_display_size(g_ctx.source, rk_screenshot_config_display(cfg),
+                                         &display_width, &display_height);
+    if (err != RKSS_SUCCESS) return err;
+    int width, height;
+    output_size(cfg, has_crop(cfg) ? cfg->crop_width : display_width,
+                has_crop(cfg) ? cfg->crop_height : display_height, &width, &height);
+    width &= ~1;
+    height &= ~1;
+    if (width <= 0 || height <= 0) return RKSS_ERROR_INVALID_PARAM;
+
+    RkVideoEncParams params;
+    params.codec = cfg->format;
+    params.width = width;
+    params.height = height;
+    params.fps = rp && rp->fps ? rp->fps : 30;
+    params.gop = rp && rp->gop ? rp->gop : params.fps * 2;
+    params.bitrate = rp && rp->bitrate
+                         ? (int)rp->bitrate
+                         : rk_video_default_bitrate(params.codec, width, height, params.fps);
+
+    RkRecording* r = (RkRecording*)calloc(1, sizeof(RkRecording));
+    if (!r) return RKSS_ERROR_NO_MEMORY;
+    r->cfg = *cfg;
+    r->cfg.scale_width = width;
+    r->cfg.scale_height = height;
+
+    pthread_mutex_lock(&g_rec_lock);
+    int slot = -1;
+    for (int i = 0; i < RK_MAX_RECORDINGS && slot < 0; i++) {
+        if (!g_recordings[i]) slot = i;
+    }
+    if (slot < 0) {
+        pthread_mutex_unlock(&g_rec_lock);
+        free(r);
+        return RKSS_ERROR_DEVICE_BUSY;
+    }
+    if (g_next_rec_id == INT32_MAX) g_next_rec_id = 0;
+    r->id = g_next_rec_id++;
+    g_recordings[slot] = r;   // 占位，启动失败时撤销
+    pthread_mutex_unlock(&g_rec_lock);
+
+    RkVideoEncoder* enc = rk_video_encoder_create_mpp(&params);
+    RkVideoMuxer* mux = enc ? rk_video_muxer_open(filepath, params.codec, width, height)
+                            : nullptr;
+    RkRecorderSource source = {r, recording_acquire};
+    RkRecorder* rec = nullptr;
+    if (enc && mux) {
+        rec = rk_recorder_start(&params, &source, enc, mux);   // 失败时已释放 enc / mux
+    } else {
+        rk_video_encoder_destroy(enc);
+    }
+
+    // 设置 rec 后即可被停止并释放，id 须在锁内取出
+    pthread_mutex_lock(&g_rec_lock);
+    r->rec = rec;
+    int id = r->id;
+    if (!rec) g_recordings[slot] = nullptr;
+    pthread_mutex_unlock(&g_rec_lock);
+    if (!rec) {
+        free(r);
+        return !enc ? RKSS_ERROR_ENCODE_FAILED : !mux ? RKSS_ERROR_INVALID_PARAM
+                                                      : RKSS_ERROR_NO_MEMORY;
+    }
+    return id;
+}
+
+static RkScreenshotError stop_recording(RkRecording* r) {
+    RkRecorderStats stats;
+    RkScreenshotError err = rk_recorder_stop(r->rec, &stats);
+    if (stats.failures > 0) {
+        ALOGW("⚠️ Recording %d: %lu of %lu ticks failed", r->id, stats.failures, stats.ticks);
+    }
+    free(r);
+    return err;
+}
+
+RkScreenshotError rk_screenshot_stop_recording(int recording_id) {
+    RkRecording* r = nullptr;
+    pthread_mutex_lock(&g_rec_lock);
+    for (int i = 0; i < RK_MAX_RECORDINGS; i++) {
+        // 启动中的录制（rec 尚未设置）不可停止
+        if (g_recordings[i] && g_recordings[i]->rec && g_recordings[i]->id == recording_id) {
+            r = g_recordings[i];
+            g_recordings[i] = nullptr;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_rec_lock);
+    if (!r) return RKSS_ERROR_INVALID_PARAM;
+    return stop_recording(r);
+}
+
+static void recordings_stop() {
+    RkRecording* active[RK_MAX_RECORDINGS] = {};
+    pthread_mutex_lock(&g_rec_lock);
+    for (int i = 0; i < RK_MAX_RECORDINGS; i++) {
+        if (g_recordings[i] && g_recordings[i]->rec) {
+            active[i] = g_recordings[i];
+            g_recordings[i] = nullptr;
+        }
+    }
+    pthread_mutex_unlock(&g_rec_lock);
+    for (int i = 0; i < RK_MAX_RECORDINGS; i++) {
+        if (active[i]) stop_recording(active[i]);
+    }
+}
+
+// ============================================
+// 水印
+// ============================================
+
+RkScreenshotError rk_screenshot_set_watermark(
+    const uint8_t* watermark_data,
+    int32_t wm_width,
+    int32_t wm_height,
+    int32_t x,
+    int32_t y,
+    uint8_t alpha)
+{
+    RkOverlay* ov = nullptr;
+    if (watermark_data) {
+        if (!g_ctx.initialized) return RKSS_ERROR_NOT_INITIALIZED;
+        if (wm_width <= 0 || wm_height <= 0 || x < 0 || y < 0) return RKSS_ERROR_INVALID_PARAM;
+        ov = rk_overlay_create(watermark_data, wm_width, wm_height, x, y, alpha, &g_ctx.rga);
+        if (!ov) return RKSS_ERROR_NO_MEMORY;
+    }
+
+    pthread_mutex_lock(&g_overlay_lock);
+    RkOverlay* old = g_overlay;
+    g_overlay = ov;
+    pthread_mutex_unlock(&g_overlay_lock);
+    rk_overlay_unref(old);
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_screenshot_add_watermark(
+    RkScreenshotResult* result,
+    const uint8_t* watermark_data,
+    int32_t wm_width,
+    int32_t wm_height,
+    int32_t x,
+    int32_t y,
+    uint8_t alpha)
+{
+    if (!result || !result->data || !watermark_data || wm_width <= 0 || wm_height <= 0 ||
+        x < 0 || y < 0) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+    // 已编码的结果无法在像素域叠加（需解码重编码），改用 rk_screenshot_set_watermark
+    if (!rk_rga_output_format_supported(result->format)) return RKSS_ERROR_UNSUPPORTED;
+    if (result->size < rk_format_packed_size(result->format, result->width, result->height)) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+
+    // 一次性水印不导入 RGA，直接 CPU 混合
+    RkOverlay* ov = rk_overlay_create(watermark_data, wm_width, wm_height, x, y, alpha, nullptr);
+    if (!ov) return RKSS_ERROR_NO_MEMORY;
+    RkScreenshotError err = rk_overlay_blend_packed(ov, result->data, result->format,
+                                                    result->width, result->height);
+    rk_overlay_unref(ov);
+    return err;
+}
+
 void rk_screenshot_free_result(RkScreenshotResult* res) {
     if (!res) return;
-    free(res->data);
-    free(res);
+    release_result_data(res);
+    free((RkResultHolder*)res);
 }
 
 const char* rk_screenshot_error_string(RkScreenshotError err) {
@@ -217,6 +1727,10 @@ const char* rk_screenshot_error_string(RkScreenshotError err) {
         case RKSS_ERROR_CAPTURE_FAILED: return "Capture failed";
         case RKSS_ERROR_RGA_FAILED: return "RGA failed";
         case RKSS_ERROR_ENCODE_FAILED: return "Encode failed";
+        case RKSS_ERROR_UNSUPPORTED: return "Unsupported";
+        case RKSS_ERROR_TIMEOUT: return "Timeout";
+        case RKSS_ERROR_DEVICE_BUSY: return "Device busy";
+        case RKSS_ERROR_CANCELLED: return "Cancelled";
         default: return "Unknown error";
     }
 }
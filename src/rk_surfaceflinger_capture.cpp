@@ -10,13 +10,18 @@
 #include <gui/SurfaceComposerClient.h>
 #include <gui/ISurfaceComposer.h>
 #include <gui/DisplayCaptureArgs.h>
+#include <gui/DisplayEventReceiver.h>
 #include <gui/SyncScreenCaptureListener.h>
 #include <ui/GraphicBuffer.h>
 #include <ui/DisplayState.h>
+#include <ui/PixelFormat.h>
 #include <binder/ProcessState.h>
 
 #include <cstring>
 #include <cstdlib>
+#include <new>
+#include <optional>
+#include <vector>
 #include <unistd.h>
 #include <errno.h>
 
@@ -25,8 +30,259 @@ using namespace android;
 #undef LOG_TAG
 #define LOG_TAG "RK_SF"
 
+// SurfaceFlinger 截图 buffer 轮转数量有限，缓存少量导入即可
+#define RK_SF_IMPORT_CACHE_SIZE 4
+
 static RkSurfaceFlingerContext g_sf_ctx = {};
 
+// ============================================
+// GraphicBuffer 导入缓存回调
+// ============================================
+static int sf_import_rga(void* user, const RkDmaBuffer* buf, uint64_t* handle) {
+    *handle = rk_rga_import(buf);
+    return *handle ? 0 : -1;
+}
+
+static void sf_release_rga(void* user, uint64_t handle) {
+    rk_rga_release_import(handle);
+}
+
+static int sf_import_mpp(void* user, const RkDmaBuffer* buf, void** mpp_buf) {
+    // 未满足 16 对齐的 buffer 不导入，编码前会由 RGA 重新对齐
+    *mpp_buf = rk_mpp_import(buf);
+    return 0;
+}
+
+static void sf_release_mpp(void* user, void* mpp_buf) {
+    rk_mpp_release_import(mpp_buf);
+}
+
+static void sf_release_owner(void* user, void* owner) {
+    static_cast<GraphicBuffer*>(owner)->decStrong(user);
+}
+
+static const RkImportOps g_sf_import_ops = {
+    &g_sf_ctx,
+    sf_import_rga,
+    sf_release_rga,
+    sf_import_mpp,
+    sf_release_mpp,
+    sf_release_owner,
+};
+
+// GraphicBuffer 像素格式 -> RkImageFormat
+static int to_rk_format(PixelFormat format) {
+    switch (format) {
+        case PIXEL_FORMAT_RGBA_8888: return RK_FORMAT_RGBA8888;
+        case PIXEL_FORMAT_RGBX_8888: return RK_FORMAT_RGBX8888;
+        case PIXEL_FORMAT_RGB_888:   return RK_FORMAT_RGB888;
+        default:
+            ALOGW("⚠️ Unexpected capture format %d, treating as RGBA", format);
+            return RK_FORMAT_RGBA8888;
+    }
+}
+
+// ============================================
+// 显示器状态缓存（每个显示器独立）
+// ============================================
+
+static void display_destroy(RkSfDisplay* d) {
+    rk_import_cache_destroy(d->import_cache);
+    delete d;
+}
+
+// 从表中移除；仍有捕获进行中的条目延后到 display_put 释放。调用者持有 ctx->lock
+static void display_remove_locked(RkSurfaceFlingerContext* ctx, int index) {
+    RkSfDisplay* d = ctx->displays[index];
+    for (int i = index; i < ctx->display_count - 1; i++) {
+        ctx->displays[i] = ctx->displays[i + 1];
+    }
+    ctx->display_count--;
+
+    if (d->busy > 0) {
+        d->removed = true;
+        d->valid = false;
+    } else {
+        display_destroy(d);
+    }
+}
+
+// 非阻塞读取显示事件：热插拔使列表失效，模式变化只使对应显示器失效。调用者持有 ctx->lock
+static void poll_display_events_locked(RkSurfaceFlingerContext* ctx) {
+    if (!ctx->display_events) return;
+
+    DisplayEventReceiver::Event events[8];
+    ssize_t n;
+    while ((n = ctx->display_events->getEvents(events, 8)) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            uint32_t type = events[i].header.type;
+            if (type == DisplayEventReceiver::DISPLAY_EVENT_HOTPLUG) {
+                if (ctx->displays_valid) {
+                    ALOGI("Display hotplug (%llu), re-enumerating",
+                          (unsigned long long)events[i].header.displayId.value);
+                }
+                ctx->displays_valid = false;
+            } else if (type == DisplayEventReceiver::DISPLAY_EVENT_MODE_CHANGE) {
+                for (int j = 0; j < ctx->display_count; j++) {
+                    RkSfDisplay* d = ctx->displays[j];
+                    if (d->id.value == events[i].header.displayId.value && d->valid) {
+                        ALOGI("Display %llu mode changed, refreshing",
+                              (unsigned long long)d->id.value);
+                        d->valid = false;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// 同步显示器列表：保留仍在的显示器（及其导入缓存），移除已拔出的。调用者持有 ctx->lock
+static RkScreenshotError enumerate_displays_locked(RkSurfaceFlingerContext* ctx) {
+    std::vector<PhysicalDisplayId> ids = SurfaceComposerClient::getPhysicalDisplayIds();
+    if (ids.empty()) {
+        ALOGE("❌ No display");
+        return RKSS_ERROR_CAPTURE_FAILED;
+    }
+    if (ids.size() > RK_MAX_DISPLAYS) {
+        ALOGW("⚠️ %zu displays connected, only the first %d are captured",
+              ids.size(), RK_MAX_DISPLAYS);
+        ids.erase(ids.begin() + RK_MAX_DISPLAYS, ids.end());
+    }
+    std::optional<PhysicalDisplayId> internal = SurfaceComposerClient::getInternalDisplayId();
+
+    for (int i = ctx->display_count - 1; i >= 0; i--) {
+        bool present = false;
+        for (const PhysicalDisplayId& id : ids) {
+            present |= (id.value == ctx->displays[i]->id.value);
+        }
+        if (!present) {
+            ALOGI("Display %llu removed", (unsigned long long)ctx->displays[i]->id.value);
+            display_remove_locked(ctx, i);
+        }
+    }
+
+    for (const PhysicalDisplayId& id : ids) {
+        RkSfDisplay* d = nullptr;
+        for (int i = 0; i < ctx->display_count; i++) {
+            if (ctx->displays[i]->id.value == id.value) d = ctx->displays[i];
+        }
+        if (!d) {
+            d = new (std::nothrow) RkSfDisplay();
+            if (!d) return RKSS_ERROR_NO_MEMORY;
+            d->import_cache = rk_import_cache_create(&g_sf_import_ops, RK_SF_IMPORT_CACHE_SIZE);
+            if (!d->import_cache) {
+                delete d;
+                return RKSS_ERROR_NO_MEMORY;
+            }
+            d->id = id;
+            ctx->displays[ctx->display_count++] = d;
+            ALOGI("Display %llu added", (unsigned long long)id.value);
+        }
+        d->internal = internal && internal->value == id.value;
+        d->valid = false;   // 热插拔后 token 可能已变化
+    }
+
+    ctx->displays_valid = true;
+    return RKSS_SUCCESS;
+}
+
+static void invalidate_display(RkSfDisplay* d) {
+    d->valid = false;
+    d->token.clear();
+    // 旧 buffer 的尺寸可能已失效
+    rk_import_cache_clear(d->import_cache);
+}
+
+static RkScreenshotError refresh_display(RkSurfaceFlingerContext* ctx, RkSfDisplay* d) {
+    if (d->valid) return RKSS_SUCCESS;
+
+    invalidate_display(d);
+
+    sp<IBinder> token = SurfaceComposerClient::getPhysicalDisplayToken(d->id);
+    if (!token) {
+        ALOGE("❌ No token for display %llu", (unsigned long long)d->id.value);
+        ctx->displays_valid = false;
+        return RKSS_ERROR_CAPTURE_FAILED;
+    }
+
+    // 获取显示器尺寸（用于校验和调试日志）
+    ui::DisplayState state;
+    if (SurfaceComposerClient::getDisplayState(token, &state) != NO_ERROR) {
+        ALOGE("❌ Failed to get display state");
+        return RKSS_ERROR_CAPTURE_FAILED;
+    }
+
+    ui::DisplayMode mode;
+    d->refresh_rate = 0;
+    if (SurfaceComposerClient::getActiveDisplayMode(token, &mode) == NO_ERROR) {
+        d->refresh_rate = mode.refreshRate;
+    }
+
+    d->token = token;
+    d->state = state;
+    d->valid = true;
+    ctx->display_refreshes++;
+
+    ALOGD("Display %llu cached: %dx%d, rotation %d%s", (unsigned long long)d->id.value,
+          state.layerStackSpaceRect.getWidth(), state.layerStackSpaceRect.getHeight(),
+          (int)state.orientation, d->internal ? " (internal)" : "");
+    return RKSS_SUCCESS;
+}
+
+// 查找并刷新显示器，display_id 为 0 时取主屏。成功时增加 busy，调用者用 display_put 归还
+// token / state 在锁内拷贝给调用者：解锁后热插拔或模式变化可能清空 d->token
+static RkScreenshotError display_get(RkSurfaceFlingerContext* ctx, uint64_t display_id,
+                                     RkSfDisplay** out, sp<IBinder>* token,
+                                     ui::DisplayState* state) {
+    pthread_mutex_lock(&ctx->lock);
+    poll_display_events_locked(ctx);
+
+    RkScreenshotError err = RKSS_SUCCESS;
+    if (!ctx->displays_valid) {
+        err = enumerate_displays_locked(ctx);
+    }
+
+    RkSfDisplay* d = nullptr;
+    for (int i = 0; err == RKSS_SUCCESS && i < ctx->display_count; i++) {
+        RkSfDisplay* c = ctx->displays[i];
+        if (display_id == 0 ? c->internal : c->id.value == display_id) d = c;
+    }
+    if (err == RKSS_SUCCESS && !d) {
+        // 无内置屏（纯外接设备）时主屏取第一个
+        if (display_id == 0 && ctx->display_count > 0) {
+            d = ctx->displays[0];
+        } else {
+            ALOGE("❌ Display %llu not found", (unsigned long long)display_id);
+            err = RKSS_ERROR_INVALID_PARAM;
+        }
+    }
+    if (err == RKSS_SUCCESS) {
+        // 显示器 token/状态走缓存，无需每帧 Binder 调用
+        err = refresh_display(ctx, d);
+    }
+    if (err == RKSS_SUCCESS) {
+        d->busy++;
+        *out = d;
+        if (token) *token = d->token;
+        if (state) *state = d->state;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return err;
+}
+
+static void display_put(RkSurfaceFlingerContext* ctx, RkSfDisplay* d, bool failed) {
+    pthread_mutex_lock(&ctx->lock);
+    if (failed && !d->removed) {
+        invalidate_display(d);      // token 可能已失效（显示器移除），下次重新获取
+        ctx->displays_valid = false;
+    }
+    d->busy--;
+    bool destroy = d->removed && d->busy == 0;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (destroy) display_destroy(d);
+}
+
 RkScreenshotError rk_sf_init(RkSurfaceFlingerContext** out_ctx) {
     if (!out_ctx) return RKSS_ERROR_INVALID_PARAM;
     
@@ -40,9 +296,23 @@ RkScreenshotError rk_sf_init(RkSurfaceFlingerContext** out_ctx) {
     ProcessState::self()->setThreadPoolMaxThreadCount(1);
     ProcessState::self()->startThreadPool();
 
+    pthread_mutex_init(&g_sf_ctx.lock, NULL);
+
+    // 热插拔事件始终投递，另外订阅模式变化；VSYNC 未请求时不会投递
+    g_sf_ctx.display_events = new DisplayEventReceiver(
+            ISurfaceComposer::eVsyncSourceApp, ISurfaceComposer::EventRegistration::modeChanged);
+    if (g_sf_ctx.display_events->initCheck() != NO_ERROR) {
+        ALOGW("⚠️ DisplayEventReceiver unavailable, display cache refreshes on failure only");
+        delete g_sf_ctx.display_events;
+        g_sf_ctx.display_events = nullptr;
+    }
+
     g_sf_ctx.initialized = true;
     g_sf_ctx.total_captures = 0;
     g_sf_ctx.total_time_us = 0;
+    g_sf_ctx.display_count = 0;
+    g_sf_ctx.displays_valid = false;
+    g_sf_ctx.display_refreshes = 0;
     *out_ctx = &g_sf_ctx;
 
     ALOGI("✅ SurfaceFlinger capture ready");
@@ -55,48 +325,117 @@ void rk_sf_deinit(RkSurfaceFlingerContext* ctx) {
     if (ctx->total_captures > 0) {
         ALOGI("SF stats: %lu captures, avg %.2f ms",
               ctx->total_captures, ctx->total_time_us / ctx->total_captures / 1000.0);
+        ALOGI("SF display state refreshed %lu times", ctx->display_refreshes);
     }
+    delete ctx->display_events;
+    ctx->display_events = nullptr;
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->display_count > 0) {
+        display_remove_locked(ctx, ctx->display_count - 1);
+    }
+    ctx->displays_valid = false;
+    pthread_mutex_unlock(&ctx->lock);
+    pthread_mutex_destroy(&ctx->lock);
     ctx->initialized = false;
 }
 
-RkScreenshotError rk_sf_capture(RkSurfaceFlingerContext* ctx, RkDmaBuffer** out_buf) {
+RkScreenshotError rk_sf_get_displays(RkSurfaceFlingerContext* ctx,
+                                     RkDisplayInfo* displays, int max_count, int* count) {
     if (!ctx || !ctx->initialized) return RKSS_ERROR_NOT_INITIALIZED;
-    if (!out_buf) return RKSS_ERROR_INVALID_PARAM;
+    if (!count || max_count < 0 || (max_count > 0 && !displays)) return RKSS_ERROR_INVALID_PARAM;
 
-    uint64_t t0 = rk_get_time_us();
+    pthread_mutex_lock(&ctx->lock);
+    poll_display_events_locked(ctx);
+    RkScreenshotError err = RKSS_SUCCESS;
+    if (!ctx->displays_valid) {
+        err = enumerate_displays_locked(ctx);
+    }
 
-    // 获取显示器
-    sp<IBinder> display = SurfaceComposerClient::getInternalDisplayToken();
-    if (!display) {
-        ALOGE("❌ No display");
-        return RKSS_ERROR_CAPTURE_FAILED;
+    int n = 0;
+    for (int i = 0; err == RKSS_SUCCESS && i < ctx->display_count; i++) {
+        RkSfDisplay* d = ctx->displays[i];
+        if (refresh_display(ctx, d) != RKSS_SUCCESS) continue;
+        if (n < max_count) {
+            RkDisplayInfo* info = &displays[n];
+            memset(info, 0, sizeof(*info));
+            info->id = d->id.value;
+            info->width = d->state.layerStackSpaceRect.getWidth();
+            info->height = d->state.layerStackSpaceRect.getHeight();
+            info->rotation = (int)d->state.orientation * 90;
+            info->refresh_rate = d->refresh_rate;
+            info->internal = d->internal;
+        }
+        n++;
     }
+    pthread_mutex_unlock(&ctx->lock);
+
+    *count = n;
+    return err;
+}
 
-    // 获取显示器尺寸（用于调试日志）
+RkScreenshotError rk_sf_get_display_size(RkSurfaceFlingerContext* ctx, uint64_t display_id,
+                                         int* width, int* height) {
+    if (!ctx || !ctx->initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!width || !height) return RKSS_ERROR_INVALID_PARAM;
+
+    RkSfDisplay* d = nullptr;
     ui::DisplayState state;
-    if (SurfaceComposerClient::getDisplayState(display, &state) != NO_ERROR) {
-        ALOGE("❌ Failed to get display state");
-        return RKSS_ERROR_CAPTURE_FAILED;
+    RkScreenshotError err = display_get(ctx, display_id, &d, nullptr, &state);
+    if (err != RKSS_SUCCESS) return err;
+
+    *width = state.layerStackSpaceRect.getWidth();
+    *height = state.layerStackSpaceRect.getHeight();
+    display_put(ctx, d, false);
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_sf_capture(RkSurfaceFlingerContext* ctx, const RkCaptureRequest* req,
+                                RkDmaBuffer** out_buf) {
+    if (!ctx || !ctx->initialized) return RKSS_ERROR_NOT_INITIALIZED;
+    if (!out_buf) return RKSS_ERROR_INVALID_PARAM;
+    if (req && (req->width < 0 || req->height < 0 || req->crop_width < 0 || req->crop_height < 0)) {
+        return RKSS_ERROR_INVALID_PARAM;
+    }
+
+    uint64_t t0 = rk_get_time_us();
+
+    RkSfDisplay* display = nullptr;
+    sp<IBinder> token;
+    RkScreenshotError display_err = display_get(ctx, req ? req->display_id : 0, &display, &token,
+                                                nullptr);
+    if (display_err != RKSS_SUCCESS) {
+        return display_err;
     }
 
-    // 截图
+    // 截图（不持锁，多个显示器可并发捕获）
     gui::DisplayCaptureArgs args;
-    args.displayToken = display;
+    args.displayToken = token;
     args.width = 0;
     args.height = 0;
     args.useIdentityTransform = false;
+    if (req) {
+        // 合成器直接渲染缩放/裁剪后的图像，省去全分辨率 buffer 与 RGA 缩放
+        args.width = req->width;
+        args.height = req->height;
+        if (req->crop_width > 0 && req->crop_height > 0) {
+            args.sourceCrop = Rect(req->crop_x, req->crop_y,
+                                   req->crop_x + req->crop_width, req->crop_y + req->crop_height);
+        }
+    }
 
     sp<SyncScreenCaptureListener> listener = sp<SyncScreenCaptureListener>::make();
     
     status_t err = ScreenshotClient::captureDisplay(args, listener);
     if (err != NO_ERROR) {
         ALOGE("❌ captureDisplay failed: %d", err);
+        display_put(ctx, display, true);
         return RKSS_ERROR_CAPTURE_FAILED;
     }
 
     ScreenCaptureResults results = listener->waitForResults();
     if (results.result != NO_ERROR || !results.buffer) {
         ALOGE("❌ Capture failed: %d", results.result);
+        display_put(ctx, display, true);
         return RKSS_ERROR_CAPTURE_FAILED;
     }
 
@@ -106,35 +445,87 @@ RkScreenshotError rk_sf_capture(RkSurfaceFlingerContext* ctx, RkDmaBuffer** out_
     const native_handle_t* handle = buffer->getNativeBuffer()->handle;
     if (!handle || handle->numFds < 1) {
         ALOGE("❌ No DMA-BUF fd in GraphicBuffer");
+        display_put(ctx, display, false);
         return RKSS_ERROR_CAPTURE_FAILED;
     }
 
-    int fd = dup(handle->data[0]);
-    if (fd < 0) {
-        ALOGE("❌ dup failed: %s", strerror(errno));
-        return RKSS_ERROR_CAPTURE_FAILED;
-    }
+    // 按 GraphicBuffer 唯一 ID 查找导入缓存，未命中时 dup fd 并导入 RGA/MPP
+    RkImportDesc desc = {};
+    desc.id = buffer->getId();
+    desc.fd = handle->data[0];
+    desc.width = buffer->getWidth();
+    desc.height = buffer->getHeight();
+    desc.stride = buffer->getStride();
+    desc.height_stride = desc.height;
+    desc.format = to_rk_format(buffer->getPixelFormat());
+    desc.size = rk_format_frame_size(desc.format, desc.stride, desc.height_stride);
+    desc.owner = buffer.get();
+    buffer->incStrong(&g_sf_ctx);   // 由缓存条目持有，淘汰时释放
 
-    // 创建输出结构
-    RkDmaBuffer* buf = (RkDmaBuffer*)calloc(1, sizeof(RkDmaBuffer));
-    if (!buf) {
-        close(fd);
-        return RKSS_ERROR_NO_MEMORY;
+    RkDmaBuffer* buf = nullptr;
+    RkScreenshotError import_err = rk_import_cache_acquire(display->import_cache, &desc, &buf);
+    uint64_t display_id = display->id.value;
+    // 借出的 buffer 持有导入缓存的引用，显示器拔出后缓存延迟释放
+    display_put(ctx, display, false);
+    if (import_err != RKSS_SUCCESS) {
+        ALOGE("❌ Import GraphicBuffer failed: %d", import_err);
+        return import_err;
     }
 
-    buf->fd = fd;
-    buf->width = buffer->getWidth();
-    buf->height = buffer->getHeight();
-    buf->stride = buffer->getStride();
-    buf->format = buffer->getPixelFormat();
-    buf->size = buf->stride * buf->height * 4;
-
     uint64_t elapsed = rk_get_time_us() - t0;
+    pthread_mutex_lock(&ctx->lock);
     ctx->total_captures++;
     ctx->total_time_us += elapsed;
+    pthread_mutex_unlock(&ctx->lock);
 
-    ALOGD("📸 Captured %dx%d in %.2f ms (fd=%d)", buf->width, buf->height, elapsed / 1000.0, fd);
+    ALOGD("📸 Display %llu: captured %dx%d in %.2f ms (fd=%d, id=%llu)",
+          (unsigned long long)display_id, buf->width, buf->height,
+          elapsed / 1000.0, buf->fd, (unsigned long long)desc.id);
 
     *out_buf = buf;
     return RKSS_SUCCESS;
 }
+
+// ============================================
+// 帧来源适配
+// ============================================
+
+static RkScreenshotError sf_source_get_displays(RkFrameSource* src, RkDisplayInfo* displays,
+                                                int max_count, int* count) {
+    return rk_sf_get_displays((RkSurfaceFlingerContext*)src->priv, displays, max_count, count);
+}
+
+static RkScreenshotError sf_source_get_display_size(RkFrameSource* src, uint64_t display_id,
+                                                    int* width, int* height) {
+    return rk_sf_get_display_size((RkSurfaceFlingerContext*)src->priv, display_id, width, height);
+}
+
+static RkScreenshotError sf_source_capture(RkFrameSource* src, const RkCaptureRequest* req,
+                                           RkDmaBuffer** out) {
+    return rk_sf_capture((RkSurfaceFlingerContext*)src->priv, req, out);
+}
+
+static void sf_source_destroy(RkFrameSource* src) {
+    rk_sf_deinit((RkSurfaceFlingerContext*)src->priv);
+    delete src;
+}
+
+RkFrameSource* rk_frame_source_create_sf() {
+    RkSurfaceFlingerContext* ctx = nullptr;
+    if (rk_sf_init(&ctx) != RKSS_SUCCESS) {
+        return nullptr;
+    }
+
+    RkFrameSource* src = new (std::nothrow) RkFrameSource();
+    if (!src) {
+        rk_sf_deinit(ctx);
+        return nullptr;
+    }
+    src->name = "surfaceflinger";
+    src->priv = ctx;
+    src->get_displays = sf_source_get_displays;
+    src->get_display_size = sf_source_get_display_size;
+    src->capture = sf_source_capture;
+    src->destroy = sf_source_destroy;
+    return src;
+}
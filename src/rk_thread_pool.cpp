@@ -0,0 +1,143 @@
+/**
+ * RK3588 Thread Pool - CPU 处理后端的行条带并行
+ *
+ * 常驻工作线程 + 调用线程共同领取任务序号（原子计数），全部完成后 run 返回。
+ * 同一时刻只执行一批任务，多个调用者按 run_lock 串行。
+ */
+
+#include "rk_internal.h"
+#include <cstdlib>
+#include <unistd.h>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_Pool"
+
+#define RK_THREAD_POOL_MAX 16
+
+struct RkThreadPool {
+    pthread_mutex_t run_lock;       // 串行化 rk_thread_pool_run
+    pthread_mutex_t lock;
+    pthread_cond_t work;            // 新一批任务 / 停止
+    pthread_cond_t done;            // 工作线程退出本批
+    pthread_t threads[RK_THREAD_POOL_MAX];
+    int thread_count;               // 工作线程数（不含调用线程）
+
+    // 当前批次
+    void (*fn)(void* arg, int index);
+    void* arg;
+    int count;
+    int next;                       // 下一个任务序号（原子领取）
+    uint64_t generation;
+    int active;                     // 仍在本批中的工作线程
+    bool stop;
+};
+
+// 领取任务直到取完
+static void run_tasks(RkThreadPool* pool) {
+    for (;;) {
+        int index = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (index >= pool->count) break;
+        pool->fn(pool->arg, index);
+    }
+}
+
+static void* worker_thread(void* arg) {
+    RkThreadPool* pool = (RkThreadPool*)arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->stop) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->stop) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_tasks(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return nullptr;
+}
+
+RkThreadPool* rk_thread_pool_create(int threads) {
+    if (threads <= 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (int)n : 1;
+    }
+    if (threads > RK_THREAD_POOL_MAX + 1) threads = RK_THREAD_POOL_MAX + 1;
+
+    RkThreadPool* pool = (RkThreadPool*)calloc(1, sizeof(RkThreadPool));
+    if (!pool) return nullptr;
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // 调用线程也执行任务，工作线程少一个
+    for (int i = 0; i < threads - 1; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_thread, pool) != 0) {
+            ALOGW("⚠️ Thread pool: only %d of %d workers started", i, threads - 1);
+            break;
+        }
+        pool->thread_count++;
+    }
+    return pool;
+}
+
+void rk_thread_pool_destroy(RkThreadPool* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], nullptr);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->run_lock);
+    free(pool);
+}
+
+int rk_thread_pool_size(const RkThreadPool* pool) {
+    return pool ? pool->thread_count + 1 : 1;
+}
+
+void rk_thread_pool_run(RkThreadPool* pool, int count, void (*fn)(void* arg, int index),
+                        void* arg) {
+    if (count <= 0) return;
+    if (!pool || pool->thread_count == 0 || count == 1) {
+        for (int i = 0; i < count; i++) fn(arg, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->count = count;
+    pool->next = 0;
+    pool->active = pool->thread_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_tasks(pool);
+
+    // 等所有工作线程离开本批，之后才能改写 fn/arg
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_unlock(&pool->run_lock);
+}
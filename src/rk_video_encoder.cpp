@@ -0,0 +1,343 @@
+/**
+ * RK3588 Video Encoder - MPP H.264 / H.265 编码上下文
+ *
+ * 输入为 RGA 产出的 16 对齐 NV12 DMA-BUF，零拷贝导入 MPP；CBR 码控，每个 IDR 之前带参数集，
+ * 输出即 Annex-B 访问单元，封装层按需转换
+ * CPU 替身输出结构合法的 Annex-B（参数集 + 按码率填充的 slice），主机上测试录制管线与封装
+ */
+
+#include "rk_internal.h"
+#include <mpp_frame.h>
+#include <mpp_packet.h>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_Video"
+
+static inline int align16(int v) {
+    return (v + RK_MPP_ALIGN - 1) / RK_MPP_ALIGN * RK_MPP_ALIGN;
+}
+
+static const char* codec_name(int codec) {
+    return codec == RK_FORMAT_H265 ? "H.265" : "H.264";
+}
+
+int rk_video_default_bitrate(int codec, int width, int height, int fps) {
+    // 桌面内容 H.264 约 0.1 bit/像素/帧（1080p30 约 6 Mbps），H.265 同画质约省 40%
+    double bits = (double)width * height * (fps > 0 ? fps : 30) * 0.1;
+    if (codec == RK_FORMAT_H265) bits *= 0.6;
+    if (bits < 200000) bits = 200000;
+    return (int)bits;
+}
+
+static bool check_params(const RkVideoEncParams* params) {
+    if (!params) return false;
+    if (params->codec != RK_FORMAT_H264 && params->codec != RK_FORMAT_H265) return false;
+    if (params->width <= 0 || params->height <= 0 || (params->width & 1) || (params->height & 1)) {
+        return false;
+    }
+    return params->fps > 0 && params->gop > 0 && params->bitrate > 0;
+}
+
+// 输入须与配置的步进一致（prep:hor_stride / ver_stride 决定 UV 平面位置）
+static bool check_input(const RkVideoEncParams* params, const RkDmaBuffer* src) {
+    return src && src->format == RK_FORMAT_YUV420SP && src->width == params->width &&
+           src->height == params->height && src->stride == align16(params->width) &&
+           src->height_stride == align16(params->height);
+}
+
+// ============================================
+// MPP 上下文
+// ============================================
+
+typedef struct {
+    MppCtx ctx;
+    MppApi* api;
+    MppEncCfg cfg;
+    RkVideoEncParams params;
+    uint64_t frames;
+    uint64_t idr_requests;
+} MppVideo;
+
+static void mpp_video_packet_release(void* buffer) {
+    MppPacket packet = (MppPacket)buffer;
+    if (packet) mpp_packet_deinit(&packet);
+}
+
+static RkScreenshotError mpp_video_encode(RkVideoEncoder* enc, RkDmaBuffer* src, bool force_idr,
+                                          RkMppPacket* out) {
+    MppVideo* v = (MppVideo*)enc->priv;
+    if (!check_input(&v->params, src)) return RKSS_ERROR_INVALID_PARAM;
+    memset(out, 0, sizeof(*out));
+
+    // 导入缓存中已有 MppBuffer 时直接借用
+    MppBuffer frame_buf = (MppBuffer)src->mpp_buf;
+    bool borrowed = frame_buf != nullptr;
+    if (!borrowed) frame_buf = (MppBuffer)rk_mpp_import(src);
+    if (!frame_buf) return RKSS_ERROR_ENCODE_FAILED;
+
+    if (force_idr) {
+        v->api->control(v->ctx, MPP_ENC_SET_IDR_FRAME, nullptr);
+        v->idr_requests++;
+    }
+
+    MppFrame frame = nullptr;
+    mpp_frame_init(&frame);
+    mpp_frame_set_width(frame, v->params.width);
+    mpp_frame_set_height(frame, v->params.height);
+    mpp_frame_set_hor_stride(frame, src->stride);
+    mpp_frame_set_ver_stride(frame, src->height_stride);
+    mpp_frame_set_fmt(frame, MPP_FMT_YUV420SP);
+    mpp_frame_set_buffer(frame, frame_buf);
+
+    RkScreenshotError err = RKSS_SUCCESS;
+    MppPacket packet = nullptr;
+    MPP_RET ret = v->api->encode_put_frame(v->ctx, frame);
+    if (ret == MPP_OK) ret = v->api->encode_get_packet(v->ctx, &packet);
+    if (ret != MPP_OK || !packet) {
+        ALOGE("❌ %s encode failed: %d", codec_name(v->params.codec), ret);
+        err = RKSS_ERROR_ENCODE_FAILED;
+    } else {
+        out->data = (uint8_t*)mpp_packet_get_pos(packet);
+        out->size = mpp_packet_get_length(packet);
+        out->buffer = packet;
+        out->release = mpp_video_packet_release;
+        v->frames++;
+    }
+
+    mpp_frame_set_buffer(frame, nullptr);
+    mpp_frame_deinit(&frame);
+    if (!borrowed) rk_mpp_release_import(frame_buf);
+    return err;
+}
+
+static void mpp_video_destroy(RkVideoEncoder* enc) {
+    MppVideo* v = (MppVideo*)enc->priv;
+    if (v->frames > 0) {
+        ALOGI("%s encoder: %lu frames, %lu forced IDR", codec_name(v->params.codec), v->frames,
+              v->idr_requests);
+    }
+    if (v->cfg) mpp_enc_cfg_deinit(v->cfg);
+    if (v->ctx) mpp_destroy(v->ctx);
+    free(v);
+    free(enc);
+}
+
+static RkScreenshotError mpp_video_configure(MppVideo* v) {
+    const RkVideoEncParams* p = &v->params;
+    MppEncCfg cfg = v->cfg;
+
+    mpp_enc_cfg_set_s32(cfg, "prep:width", p->width);
+    mpp_enc_cfg_set_s32(cfg, "prep:height", p->height);
+    mpp_enc_cfg_set_s32(cfg, "prep:hor_stride", align16(p->width));
+    mpp_enc_cfg_set_s32(cfg, "prep:ver_stride", align16(p->height));
+    mpp_enc_cfg_set_s32(cfg, "prep:format", MPP_FMT_YUV420SP);
+
+    // CBR：码率上下浮动 1/16，帧率输入输出一致
+    mpp_enc_cfg_set_s32(cfg, "rc:mode", MPP_ENC_RC_MODE_CBR);
+    mpp_enc_cfg_set_s32(cfg, "rc:bps_target", p->bitrate);
+    mpp_enc_cfg_set_s32(cfg, "rc:bps_max", p->bitrate / 16 * 17);
+    mpp_enc_cfg_set_s32(cfg, "rc:bps_min", p->bitrate / 16 * 15);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_flex", 0);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_num", p->fps);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_denorm", 1);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_flex", 0);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_num", p->fps);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_denorm", 1);
+    mpp_enc_cfg_set_s32(cfg, "rc:gop", p->gop);
+
+    if (p->codec == RK_FORMAT_H264) {
+        mpp_enc_cfg_set_s32(cfg, "codec:type", MPP_VIDEO_CodingAVC);
+        // High@4.0 + CABAC + 8x8 变换
+        mpp_enc_cfg_set_s32(cfg, "h264:profile", 100);
+        mpp_enc_cfg_set_s32(cfg, "h264:level", 40);
+        mpp_enc_cfg_set_s32(cfg, "h264:cabac_en", 1);
+        mpp_enc_cfg_set_s32(cfg, "h264:cabac_idc", 0);
+        mpp_enc_cfg_set_s32(cfg, "h264:trans8x8", 1);
+    } else {
+        mpp_enc_cfg_set_s32(cfg, "codec:type", MPP_VIDEO_CodingHEVC);
+    }
+
+    MPP_RET ret = v->api->control(v->ctx, MPP_ENC_SET_CFG, cfg);
+    if (ret != MPP_OK) {
+        ALOGE("❌ %s config failed: %d", codec_name(p->codec), ret);
+        return RKSS_ERROR_ENCODE_FAILED;
+    }
+
+    // 每个 IDR 前都输出参数集：Annex-B 从任意关键帧起可解码，MP4 封装从首帧取参数集
+    MppEncHeaderMode header_mode = MPP_ENC_HEADER_MODE_EACH_IDR;
+    ret = v->api->control(v->ctx, MPP_ENC_SET_HEADER_MODE, &header_mode);
+    if (ret != MPP_OK) {
+        ALOGE("❌ %s header mode failed: %d", codec_name(p->codec), ret);
+        return RKSS_ERROR_ENCODE_FAILED;
+    }
+    return RKSS_SUCCESS;
+}
+
+RkVideoEncoder* rk_video_encoder_create_mpp(const RkVideoEncParams* params) {
+    if (!check_params(params)) return nullptr;
+
+    RkVideoEncoder* enc = (RkVideoEncoder*)calloc(1, sizeof(RkVideoEncoder));
+    MppVideo* v = (MppVideo*)calloc(1, sizeof(MppVideo));
+    if (!enc || !v) {
+        free(enc);
+        free(v);
+        return nullptr;
+    }
+    v->params = *params;
+    enc->name = "mpp";
+    enc->priv = v;
+    enc->encode = mpp_video_encode;
+    enc->destroy = mpp_video_destroy;
+
+    MppCodingType coding = params->codec == RK_FORMAT_H265 ? MPP_VIDEO_CodingHEVC
+                                                           : MPP_VIDEO_CodingAVC;
+    MPP_RET ret = mpp_create(&v->ctx, &v->api);
+    if (ret == MPP_OK) {
+        ret = mpp_init(v->ctx, MPP_CTX_ENC, coding);
+    } else {
+        v->ctx = nullptr;
+    }
+    if (ret == MPP_OK) ret = mpp_enc_cfg_init(&v->cfg);
+    if (ret != MPP_OK) {
+        ALOGE("❌ MPP %s init failed: %d", codec_name(params->codec), ret);
+        mpp_video_destroy(enc);
+        return nullptr;
+    }
+    if (mpp_video_configure(v) != RKSS_SUCCESS) {
+        mpp_video_destroy(enc);
+        return nullptr;
+    }
+
+    ALOGI("✅ MPP %s encoder ready: %dx%d@%d, %d kbps, GOP %d", codec_name(params->codec),
+          params->width, params->height, params->fps, params->bitrate / 1000, params->gop);
+    return enc;
+}
+
+// ============================================
+// CPU 替身
+// ============================================
+
+typedef struct {
+    RkVideoEncParams params;
+    int latency_us;
+    int since_idr;              // 距上一个 IDR 的帧数，-1 表示还没有输出过
+} StubVideo;
+
+// 典型的 High@4.0 SPS/PPS 与 Main@3.1 VPS/SPS/PPS（含防竞争字节），只用于检验封装
+static const uint8_t k_h264_sps[] = {0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02,
+                                     0x27, 0xe5, 0x84, 0x00, 0x00, 0x03, 0x00, 0x04, 0x00,
+                                     0x00, 0x03, 0x00, 0xf0, 0x3c, 0x60, 0xc6, 0x58};
+static const uint8_t k_h264_pps[] = {0x68, 0xeb, 0xe3, 0xcb, 0x22, 0xc0};
+static const uint8_t k_h265_vps[] = {0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60,
+                                     0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03,
+                                     0x00, 0x00, 0x03, 0x00, 0x5d, 0x95, 0x98, 0x09};
+static const uint8_t k_h265_sps[] = {0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00,
+                                     0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5d,
+                                     0xa0, 0x02, 0x80, 0x80, 0x2d, 0x16, 0x59, 0x59, 0xa4,
+                                     0x93, 0x2b, 0xc0, 0x5a, 0x70, 0x80, 0x00, 0x01, 0xf4,
+                                     0x80, 0x00, 0x3a, 0x98, 0x04};
+static const uint8_t k_h265_pps[] = {0x44, 0x01, 0xc1, 0x72, 0xb4, 0x62, 0x40};
+
+static size_t put_nal(uint8_t* dst, const uint8_t* nal, size_t size) {
+    static const uint8_t start[4] = {0, 0, 0, 1};
+    memcpy(dst, start, 4);
+    memcpy(dst + 4, nal, size);
+    return 4 + size;
+}
+
+static void stub_packet_release(void* buffer) {
+    free(buffer);
+}
+
+static RkScreenshotError stub_encode(RkVideoEncoder* enc, RkDmaBuffer* src, bool force_idr,
+                                     RkMppPacket* out) {
+    StubVideo* s = (StubVideo*)enc->priv;
+    if (!check_input(&s->params, src)) return RKSS_ERROR_INVALID_PARAM;
+    memset(out, 0, sizeof(*out));
+    uint64_t t0 = rk_get_time_us();
+
+    // 读一遍 Y 平面，slice 内容取其校验和（同一画面产出相同码流）
+    size_t luma = (size_t)src->stride * src->height;
+    const uint8_t* y = (const uint8_t*)rk_dmabuf_begin_cpu_access(src, RK_DMABUF_CPU_READ, 0,
+                                                                 luma);
+    if (!y) return RKSS_ERROR_ENCODE_FAILED;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < luma; i += 64) sum = sum * 31 + y[i];
+    rk_dmabuf_end_cpu_access(src, RK_DMABUF_CPU_READ, 0, luma);
+
+    bool idr = force_idr || s->since_idr < 0 || s->since_idr + 1 >= s->params.gop;
+    s->since_idr = idr ? 0 : s->since_idr + 1;
+    size_t payload = (size_t)s->params.bitrate / 8 / s->params.fps;
+    if (idr) payload *= 4;
+    if (payload < 16) payload = 16;
+
+    bool hevc = s->params.codec == RK_FORMAT_H265;
+    uint8_t* buf = (uint8_t*)malloc(payload + 256);
+    if (!buf) return RKSS_ERROR_NO_MEMORY;
+    size_t pos = 0;
+    if (idr && hevc) {
+        pos += put_nal(buf + pos, k_h265_vps, sizeof(k_h265_vps));
+        pos += put_nal(buf + pos, k_h265_sps, sizeof(k_h265_sps));
+        pos += put_nal(buf + pos, k_h265_pps, sizeof(k_h265_pps));
+    } else if (idr) {
+        pos += put_nal(buf + pos, k_h264_sps, sizeof(k_h264_sps));
+        pos += put_nal(buf + pos, k_h264_pps, sizeof(k_h264_pps));
+    }
+
+    // slice：H.264 IDR 5 / 非 IDR 1，HEVC IDR_W_RADL 19 / TRAIL_R 1；负载字节最高位置 1，不会出现起始码
+    uint8_t header[2];
+    size_t header_len = hevc ? 2 : 1;
+    if (hevc) {
+        header[0] = (uint8_t)((idr ? 19 : 1) << 1);
+        header[1] = 0x01;
+    } else {
+        header[0] = idr ? 0x65 : 0x41;
+    }
+    pos += put_nal(buf + pos, header, header_len);
+    for (size_t i = 0; i < payload; i++) {
+        buf[pos++] = (uint8_t)(0x80 | ((sum >> (i & 15)) + i * 31) % 0x80);
+    }
+
+    out->data = buf;
+    out->size = pos;
+    out->buffer = buf;
+    out->release = stub_packet_release;
+
+    uint64_t elapsed = rk_get_time_us() - t0;
+    if (s->latency_us > 0 && elapsed < (uint64_t)s->latency_us) {
+        usleep(s->latency_us - elapsed);
+    }
+    return RKSS_SUCCESS;
+}
+
+static void stub_destroy(RkVideoEncoder* enc) {
+    free(enc->priv);
+    free(enc);
+}
+
+RkVideoEncoder* rk_video_encoder_create_stub(const RkVideoEncParams* params, int latency_us) {
+    if (!check_params(params)) return nullptr;
+
+    RkVideoEncoder* enc = (RkVideoEncoder*)calloc(1, sizeof(RkVideoEncoder));
+    StubVideo* s = (StubVideo*)calloc(1, sizeof(StubVideo));
+    if (!enc || !s) {
+        free(enc);
+        free(s);
+        return nullptr;
+    }
+    s->params = *params;
+    s->latency_us = latency_us;
+    s->since_idr = -1;
+    enc->name = "stub";
+    enc->priv = s;
+    enc->encode = stub_encode;
+    enc->destroy = stub_destroy;
+    return enc;
+}
+
+void rk_video_encoder_destroy(RkVideoEncoder* enc) {
+    if (enc) enc->destroy(enc);
+}
@@ -0,0 +1,524 @@
+/**
+ * RK3588 Video Muxer - Annex-B 裸流 / 最小 MP4
+ *
+ * Annex-B：访问单元原样写入，无时间戳（播放器按帧率播放，跳过的静止帧使时长变短）
+ * MP4：ftyp + mdat（边录边写）+ moov（关闭时写入）。样本为 4 字节长度前缀的 NAL，
+ * 参数集从首个关键帧取出放入 avcC / hvcC；每帧的时长来自 pts，静止期延长上一帧
+ */
+
+#include "rk_internal.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#undef LOG_TAG
+#define LOG_TAG "RK_Mux"
+
+// 媒体时间刻度（与 MPEG-TS 一致），影片时间刻度为毫秒
+#define RK_MP4_MEDIA_TIMESCALE 90000
+#define RK_MP4_MOVIE_TIMESCALE 1000
+
+typedef std::vector<uint8_t> Bytes;
+
+struct RkVideoMuxer {
+    FILE* file;
+    int codec;
+    int width;
+    int height;
+    bool mp4;
+    bool failed;
+    uint64_t frames;
+    uint64_t bytes;
+    // MP4
+    long long mdat_start;
+    long long offset;
+    Bytes vps, sps, pps;
+    Bytes sample;
+    std::vector<uint32_t> sizes;
+    std::vector<uint64_t> offsets;
+    std::vector<int64_t> pts;
+    std::vector<uint32_t> syncs;   // 关键帧样本号（从 1 开始）
+};
+
+// ============================================
+// Annex-B 解析
+// ============================================
+
+// 从 *pos 起找下一个 NAL（不含起始码与尾随零字节）；*pos 移到其后
+static bool next_nal(const uint8_t* p, size_t size, size_t* pos, const uint8_t** nal,
+                     size_t* len) {
+    size_t i = *pos;
+    while (i + 3 <= size && !(p[i] == 0 && p[i + 1] == 0 && p[i + 2] == 1)) i++;
+    if (i + 3 > size) return false;
+    size_t begin = i + 3;
+    size_t end = begin;
+    while (end + 3 <= size && !(p[end] == 0 && p[end + 1] == 0 && p[end + 2] == 1)) end++;
+    if (end + 3 > size) end = size;
+    *pos = end;
+    while (end > begin && p[end - 1] == 0) end--;
+    *nal = p + begin;
+    *len = end - begin;
+    return *len > 0;
+}
+
+static int nal_type(int codec, const uint8_t* nal) {
+    return codec == RK_FORMAT_H265 ? (nal[0] >> 1) & 0x3f : nal[0] & 0x1f;
+}
+
+static bool nal_is_keyframe(int codec, int type) {
+    // H.264 IDR；HEVC IRAP（BLA / IDR / CRA）
+    return codec == RK_FORMAT_H265 ? (type >= 16 && type <= 21) : type == 5;
+}
+
+bool rk_video_au_is_keyframe(int codec, const uint8_t* au, size_t size) {
+    size_t pos = 0;
+    const uint8_t* nal;
+    size_t len;
+    while (next_nal(au, size, &pos, &nal, &len)) {
+        if (nal_is_keyframe(codec, nal_type(codec, nal))) return true;
+    }
+    return false;
+}
+
+// 去掉防竞争字节（00 00 03 -> 00 00）
+static Bytes unescape(const uint8_t* nal, size_t len) {
+    Bytes rbsp;
+    rbsp.reserve(len);
+    int zeros = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (zeros >= 2 && nal[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] == 0 ? zeros + 1 : 0;
+        rbsp.push_back(nal[i]);
+    }
+    return rbsp;
+}
+
+// ============================================
+// MP4 box 写入
+// ============================================
+
+static void put8(Bytes& b, uint32_t v) {
+    b.push_back((uint8_t)v);
+}
+
+static void put16(Bytes& b, uint32_t v) {
+    put8(b, v >> 8);
+    put8(b, v);
+}
+
+static void put32(Bytes& b, uint32_t v) {
+    put16(b, v >> 16);
+    put16(b, v);
+}
+
+static void put64(Bytes& b, uint64_t v) {
+    put32(b, (uint32_t)(v >> 32));
+    put32(b, (uint32_t)v);
+}
+
+static void put_bytes(Bytes& b, const uint8_t* p, size_t n) {
+    b.insert(b.end(), p, p + n);
+}
+
+static size_t box_begin(Bytes& b, const char* type) {
+    size_t at = b.size();
+    put32(b, 0);
+    put_bytes(b, (const uint8_t*)type, 4);
+    return at;
+}
+
+static size_t full_box_begin(Bytes& b, const char* type, int version, uint32_t flags) {
+    size_t at = box_begin(b, type);
+    put32(b, (uint32_t)version << 24 | flags);
+    return at;
+}
+
+static void box_end(Bytes& b, size_t at) {
+    uint32_t size = (uint32_t)(b.size() - at);
+    b[at] = (uint8_t)(size >> 24);
+    b[at + 1] = (uint8_t)(size >> 16);
+    b[at + 2] = (uint8_t)(size >> 8);
+    b[at + 3] = (uint8_t)size;
+}
+
+static void put_matrix(Bytes& b) {
+    static const uint32_t unity[9] = {0x10000, 0, 0, 0, 0x10000, 0, 0, 0, 0x40000000};
+    for (int i = 0; i < 9; i++) put32(b, unity[i]);
+}
+
+// AVCDecoderConfigurationRecord：profile/兼容性/level 取自 SPS，4 字节长度前缀
+static void put_avcc(Bytes& b, const Bytes& sps, const Bytes& pps) {
+    Bytes rbsp = unescape(sps.data(), sps.size());
+    size_t at = box_begin(b, "avcC");
+    put8(b, 1);
+    put8(b, rbsp[1]);
+    put8(b, rbsp[2]);
+    put8(b, rbsp[3]);
+    put8(b, 0xff);
+    put8(b, 0xe1);
+    put16(b, sps.size());
+    put_bytes(b, sps.data(), sps.size());
+    put8(b, 1);
+    put16(b, pps.size());
+    put_bytes(b, pps.data(), pps.size());
+    // High 系列须带色度格式与位深：NV12 8 位
+    int profile = rbsp[1];
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 144) {
+        put8(b, 0xfc | 1);
+        put8(b, 0xf8);
+        put8(b, 0xf8);
+        put8(b, 0);
+    }
+    box_end(b, at);
+}
+
+// HEVCDecoderConfigurationRecord：general_profile_tier_level 取自 SPS（跳过 2 字节头与 1 字节 ID）
+static void put_hvcc(Bytes& b, const Bytes& vps, const Bytes& sps, const Bytes& pps) {
+    Bytes rbsp = unescape(sps.data(), sps.size());
+    size_t at = box_begin(b, "hvcC");
+    put8(b, 1);
+    put_bytes(b, rbsp.data() + 3, 12);     // profile_space/tier/profile_idc + 兼容 + 约束 + level
+    put16(b, 0xf000);                       // min_spatial_segmentation_idc
+    put8(b, 0xfc);                          // parallelismType
+    put8(b, 0xfc | 1);                      // 4:2:0
+    put8(b, 0xf8);                          // 8 位
+    put8(b, 0xf8);
+    put16(b, 0);                            // avgFrameRate 未指定
+    put8(b, 1 << 3 | 1 << 2 | 3);           // 1 个时域层，嵌套，4 字节长度前缀
+    put8(b, 3);
+    const Bytes* sets[3] = {&vps, &sps, &pps};
+    for (int i = 0; i < 3; i++) {
+        put8(b, 0x80 | nal_type(RK_FORMAT_H265, sets[i]->data()));
+        put16(b, 1);
+        put16(b, sets[i]->size());
+        put_bytes(b, sets[i]->data(), sets[i]->size());
+    }
+    box_end(b, at);
+}
+
+static void put_sample_entry(Bytes& b, const RkVideoMuxer* mux) {
+    bool hevc = mux->codec == RK_FORMAT_H265;
+    size_t at = box_begin(b, hevc ? "hvc1" : "avc1");
+    for (int i = 0; i < 6; i++) put8(b, 0);
+    put16(b, 1);                            // data_reference_index
+    for (int i = 0; i < 4; i++) put32(b, 0);
+    put16(b, mux->width);
+    put16(b, mux->height);
+    put32(b, 0x00480000);                   // 72 dpi
+    put32(b, 0x00480000);
+    put32(b, 0);
+    put16(b, 1);                            // frame_count
+    char name[32] = {};
+    name[0] = (char)snprintf(name + 1, sizeof(name) - 1, "rk_screenshot");
+    put_bytes(b, (const uint8_t*)name, sizeof(name));
+    put16(b, 0x18);
+    put16(b, 0xffff);
+    if (hevc) {
+        put_hvcc(b, mux->vps, mux->sps, mux->pps);
+    } else {
+        put_avcc(b, mux->sps, mux->pps);
+    }
+    box_end(b, at);
+}
+
+static inline int64_t to_media(int64_t us) {
+    return us * RK_MP4_MEDIA_TIMESCALE / 1000000;
+}
+
+static void build_moov(Bytes& b, const RkVideoMuxer* mux, int64_t end_us) {
+    size_t n = mux->sizes.size();
+    int64_t t0 = to_media(mux->pts[0]);
+    int64_t t_end = to_media(end_us);
+    // 最后一帧至少 1 个刻度
+    if (t_end <= to_media(mux->pts[n - 1])) t_end = to_media(mux->pts[n - 1]) + 1;
+    uint64_t media_duration = t_end - t0;
+    uint64_t movie_duration = media_duration * RK_MP4_MOVIE_TIMESCALE / RK_MP4_MEDIA_TIMESCALE;
+
+    size_t moov = box_begin(b, "moov");
+
+    size_t mvhd = full_box_begin(b, "mvhd", 0, 0);
+    put32(b, 0);
+    put32(b, 0);
+    put32(b, RK_MP4_MOVIE_TIMESCALE);
+    put32(b, (uint32_t)movie_duration);
+    put32(b, 0x00010000);                   // rate 1.0
+    put16(b, 0x0100);                       // volume 1.0
+    put16(b, 0);
+    put64(b, 0);
+    put_matrix(b);
+    for (int i = 0; i < 6; i++) put32(b, 0);
+    put32(b, 2);                            // next_track_ID
+    box_end(b, mvhd);
+
+    size_t trak = box_begin(b, "trak");
+    size_t tkhd = full_box_begin(b, "tkhd", 0, 3);     // enabled | in_movie
+    put32(b, 0);
+    put32(b, 0);
+    put32(b, 1);                            // track_ID
+    put32(b, 0);
+    put32(b, (uint32_t)movie_duration);
+    put64(b, 0);
+    put16(b, 0);                            // layer
+    put16(b, 0);                            // alternate_group
+    put16(b, 0);                            // volume（视频为 0）
+    put16(b, 0);
+    put_matrix(b);
+    put32(b, (uint32_t)mux->width << 16);
+    put32(b, (uint32_t)mux->height << 16);
+    box_end(b, tkhd);
+
+    size_t mdia = box_begin(b, "mdia");
+    size_t mdhd = full_box_begin(b, "mdhd", 0, 0);
+    put32(b, 0);
+    put32(b, 0);
+    put32(b, RK_MP4_MEDIA_TIMESCALE);
+    put32(b, (uint32_t)media_duration);
+    put16(b, 0x55c4);                       // "und"
+    put16(b, 0);
+    box_end(b, mdhd);
+
+    size_t hdlr = full_box_begin(b, "hdlr", 0, 0);
+    put32(b, 0);
+    put_bytes(b, (const uint8_t*)"vide", 4);
+    for (int i = 0; i < 3; i++) put32(b, 0);
+    put_bytes(b, (const uint8_t*)"VideoHandler", 13);
+    box_end(b, hdlr);
+
+    size_t minf = box_begin(b, "minf");
+    size_t vmhd = full_box_begin(b, "vmhd", 0, 1);
+    put64(b, 0);
+    box_end(b, vmhd);
+    size_t dinf = box_begin(b, "dinf");
+    size_t dref = full_box_begin(b, "dref", 0, 0);
+    put32(b, 1);
+    box_end(b, full_box_begin(b, "url ", 0, 1));   // 数据在本文件内
+    box_end(b, dref);
+    box_end(b, dinf);
+
+    size_t stbl = box_begin(b, "stbl");
+    size_t stsd = full_box_begin(b, "stsd", 0, 0);
+    put32(b, 1);
+    put_sample_entry(b, mux);
+    box_end(b, stsd);
+
+    // stts：相邻 pts 之差，相同时长合并
+    size_t stts = full_box_begin(b, "stts", 0, 0);
+    size_t count_at = b.size();
+    put32(b, 0);
+    uint32_t runs = 0, run_count = 0;
+    int64_t run_delta = -1;
+    for (size_t i = 0; i < n; i++) {
+        int64_t next = i + 1 < n ? to_media(mux->pts[i + 1]) : t_end;
+        int64_t delta = next - to_media(mux->pts[i]);
+        if (delta == run_delta) {
+            run_count++;
+            continue;
+        }
+        if (run_count > 0) {
+            put32(b, run_count);
+            put32(b, (uint32_t)run_delta);
+            runs++;
+        }
+        run_delta = delta;
+        run_count = 1;
+    }
+    put32(b, run_count);
+    put32(b, (uint32_t)run_delta);
+    runs++;
+    b[count_at] = (uint8_t)(runs >> 24);
+    b[count_at + 1] = (uint8_t)(runs >> 16);
+    b[count_at + 2] = (uint8_t)(runs >> 8);
+    b[count_at + 3] = (uint8_t)runs;
+    box_end(b, stts);
+
+    size_t stss = full_box_begin(b, "stss", 0, 0);
+    put32(b, mux->syncs.size());
+    for (uint32_t s : mux->syncs) put32(b, s);
+    box_end(b, stss);
+
+    size_t stsz = full_box_begin(b, "stsz", 0, 0);
+    put32(b, 0);
+    put32(b, n);
+    for (uint32_t s : mux->sizes) put32(b, s);
+    box_end(b, stsz);
+
+    // 每个样本一个 chunk，偏移用 64 位
+    size_t stsc = full_box_begin(b, "stsc", 0, 0);
+    put32(b, 1);
+    put32(b, 1);
+    put32(b, 1);
+    put32(b, 1);
+    box_end(b, stsc);
+
+    size_t co64 = full_box_begin(b, "co64", 0, 0);
+    put32(b, n);
+    for (uint64_t off : mux->offsets) put64(b, off);
+    box_end(b, co64);
+
+    box_end(b, stbl);
+    box_end(b, minf);
+    box_end(b, mdia);
+    box_end(b, trak);
+    box_end(b, moov);
+}
+
+// ============================================
+// 公共接口
+// ============================================
+
+static bool ends_with(const char* str, const char* suffix) {
+    size_t n = strlen(str), m = strlen(suffix);
+    return n >= m && strcasecmp(str + n - m, suffix) == 0;
+}
+
+static bool write_all(RkVideoMuxer* mux, const void* data, size_t size) {
+    if (mux->failed) return false;
+    if (fwrite(data, 1, size, mux->file) != size) {
+        ALOGE("❌ Video write failed (%zu bytes)", size);
+        mux->failed = true;
+        return false;
+    }
+    mux->offset += size;
+    return true;
+}
+
+RkVideoMuxer* rk_video_muxer_open(const char* path, int codec, int width, int height) {
+    if (!path || (codec != RK_FORMAT_H264 && codec != RK_FORMAT_H265) || width <= 0 ||
+        height <= 0) {
+        return nullptr;
+    }
+    RkVideoMuxer* mux = new (std::nothrow) RkVideoMuxer();
+    if (!mux) return nullptr;
+    mux->codec = codec;
+    mux->width = width;
+    mux->height = height;
+    mux->mp4 = ends_with(path, ".mp4");
+    mux->file = fopen(path, "wb");
+    if (!mux->file) {
+        ALOGE("❌ Cannot open %s", path);
+        delete mux;
+        return nullptr;
+    }
+
+    if (mux->mp4) {
+        Bytes head;
+        size_t ftyp = box_begin(head, "ftyp");
+        put_bytes(head, (const uint8_t*)"isom", 4);
+        put32(head, 0x200);
+        put_bytes(head, (const uint8_t*)"isomiso2mp41", 12);
+        box_end(head, ftyp);
+        // mdat 用 64 位长度，关闭时回填
+        mux->mdat_start = head.size();
+        put32(head, 1);
+        put_bytes(head, (const uint8_t*)"mdat", 4);
+        put64(head, 0);
+        if (!write_all(mux, head.data(), head.size())) {
+            fclose(mux->file);
+            delete mux;
+            return nullptr;
+        }
+    }
+    ALOGI("🎬 Recording to %s (%s, %s)", path, mux->mp4 ? "MP4" : "Annex-B",
+          codec == RK_FORMAT_H265 ? "H.265" : "H.264");
+    return mux;
+}
+
+RkScreenshotError rk_video_muxer_write(RkVideoMuxer* mux, const uint8_t* au, size_t size,
+                                       int64_t pts_us) {
+    if (!mux || !au || size == 0) return RKSS_ERROR_INVALID_PARAM;
+    if (mux->failed) return RKSS_ERROR_ENCODE_FAILED;
+    if (!mux->pts.empty() && pts_us <= mux->pts.back()) return RKSS_ERROR_INVALID_PARAM;
+
+    if (!mux->mp4) {
+        if (!write_all(mux, au, size)) return RKSS_ERROR_ENCODE_FAILED;
+        mux->frames++;
+        mux->bytes += size;
+        mux->pts.push_back(pts_us);
+        return RKSS_SUCCESS;
+    }
+
+    // 转成长度前缀样本：参数集留给 avcC / hvcC，AUD 丢弃
+    bool hevc = mux->codec == RK_FORMAT_H265;
+    bool key = false;
+    mux->sample.clear();
+    size_t pos = 0;
+    const uint8_t* nal;
+    size_t len;
+    while (next_nal(au, size, &pos, &nal, &len)) {
+        int type = nal_type(mux->codec, nal);
+        Bytes* param = nullptr;
+        if (hevc) {
+            param = type == 32 ? &mux->vps : type == 33 ? &mux->sps : type == 34 ? &mux->pps
+                                                                                : nullptr;
+            if (type == 35) continue;
+        } else {
+            param = type == 7 ? &mux->sps : type == 8 ? &mux->pps : nullptr;
+            if (type == 9) continue;
+        }
+        if (param) {
+            if (param->empty()) param->assign(nal, nal + len);
+            continue;
+        }
+        key = key || nal_is_keyframe(mux->codec, type);
+        put32(mux->sample, len);
+        put_bytes(mux->sample, nal, len);
+    }
+    if (mux->sample.empty()) return RKSS_ERROR_INVALID_PARAM;
+
+    uint64_t offset = mux->offset;
+    if (!write_all(mux, mux->sample.data(), mux->sample.size())) return RKSS_ERROR_ENCODE_FAILED;
+    mux->sizes.push_back(mux->sample.size());
+    mux->offsets.push_back(offset);
+    mux->pts.push_back(pts_us);
+    if (key) mux->syncs.push_back(mux->sizes.size());
+    mux->frames++;
+    mux->bytes += mux->sample.size();
+    return RKSS_SUCCESS;
+}
+
+static RkScreenshotError finish_mp4(RkVideoMuxer* mux, int64_t end_us) {
+    if (mux->sizes.empty()) {
+        ALOGW("⚠️ No frames recorded, MP4 left without index");
+        return RKSS_ERROR_ENCODE_FAILED;
+    }
+    bool hevc = mux->codec == RK_FORMAT_H265;
+    if (mux->sps.empty() || mux->pps.empty() || (hevc && mux->vps.empty()) ||
+        mux->sps.size() < (hevc ? 15u : 4u)) {
+        ALOGE("❌ Stream has no parameter sets, cannot write MP4 index");
+        return RKSS_ERROR_ENCODE_FAILED;
+    }
+
+    Bytes moov;
+    build_moov(moov, mux, end_us);
+    long long mdat_size = mux->offset - mux->mdat_start;
+    if (!write_all(mux, moov.data(), moov.size())) return RKSS_ERROR_ENCODE_FAILED;
+
+    Bytes size;
+    put64(size, mdat_size);
+    if (fseeko(mux->file, mux->mdat_start + 8, SEEK_SET) != 0 ||
+        fwrite(size.data(), 1, size.size(), mux->file) != size.size()) {
+        ALOGE("❌ Failed to patch mdat size");
+        return RKSS_ERROR_ENCODE_FAILED;
+    }
+    return RKSS_SUCCESS;
+}
+
+RkScreenshotError rk_video_muxer_close(RkVideoMuxer* mux, int64_t end_us) {
+    if (!mux) return RKSS_ERROR_INVALID_PARAM;
+
+    RkScreenshotError err = mux->failed ? RKSS_ERROR_ENCODE_FAILED : RKSS_SUCCESS;
+    if (err == RKSS_SUCCESS && mux->mp4) err = finish_mp4(mux, end_us);
+    if (fclose(mux->file) != 0 && err == RKSS_SUCCESS) err = RKSS_ERROR_ENCODE_FAILED;
+
+    int64_t duration = mux->pts.empty() ? 0 : end_us - mux->pts[0];
+    ALOGI("🎬 %s closed: %lu frames, %zu keyframes, %.2f s, %.1f KB", mux->mp4 ? "MP4" : "Annex-B",
+          mux->frames, mux->syncs.size(), duration / 1000000.0, mux->bytes / 1024.0);
+    if (err != RKSS_SUCCESS) ALOGE("❌ Video file incomplete: %d", err);
+    delete mux;
+    return err;
+}
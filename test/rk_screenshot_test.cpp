@@ -8,14 +8,17 @@
  *   test_screenshot -f           # 仅功能测试
  *   test_screenshot -p [count]   # 性能测试 (默认100次)
  *   test_screenshot -b [count]   # 纯性能基准测试 (无文件IO)
+ *   test_screenshot -u           # 内部模块单元测试 (无需 SurfaceFlinger)
  */
 
 #include "../include/rk_screenshot.h"
+#include "../include/rk_internal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 //==============================================================================
 // Utilities
@@ -57,15 +60,40 @@ typedef struct {
     int scale_height;
 } TestCase;
 
-#define NUM_TEST_CASES 5
+#define NUM_TEST_CASES 7
 static TestCase g_test_cases[NUM_TEST_CASES] = {
     {"Raw RGBA (1920x1080)",      "test_raw.rgba",    RK_FORMAT_RGBA8888, 0,  0, 0},
+    {"Raw NV12 (1280x720)",       "test_720p.nv12",   RK_FORMAT_YUV420SP, 0,  1280, 720},
+    {"Raw BGR888 (640x360)",      "test_360p.bgr",    RK_FORMAT_BGR888,   0,  640, 360},
     {"JPEG Full (1920x1080 Q90)", "test_full.jpg",    RK_FORMAT_JPEG,     90, 0, 0},
     {"JPEG Scaled (1280x720 Q85)","test_scaled.jpg",  RK_FORMAT_JPEG,     85, 1280, 720},
     {"Thumbnail (320x180 Q75)",   "test_thumb.jpg",   RK_FORMAT_JPEG,     75, 320, 180},
     {"HD Ready (1280x720 Q90)",   "test_720p.jpg",    RK_FORMAT_JPEG,     90, 1280, 720},
 };
 
+// 异步回调：计数成功结果（任务线程按提交顺序调用）
+static void count_async_result(RkScreenshotResult* result, void* user_data) {
+    if (result) {
+        (*(int*)user_data)++;
+        rk_screenshot_free_result(result);
+    }
+}
+
+// 单次捕获扇出：原图 JPEG + 720p 预览 + 320x180 NV12 缩略图
+#define NUM_BATCH_OUTPUTS 3
+static void batch_configs(RkScreenshotConfig cfgs[NUM_BATCH_OUTPUTS]) {
+    for (int i = 0; i < NUM_BATCH_OUTPUTS; i++) rk_screenshot_get_default_config(&cfgs[i]);
+    cfgs[0].format = RK_FORMAT_JPEG;
+    cfgs[0].quality = 90;
+    cfgs[1].format = RK_FORMAT_JPEG;
+    cfgs[1].quality = 80;
+    cfgs[1].scale_width = 1280;
+    cfgs[1].scale_height = 720;
+    cfgs[2].format = RK_FORMAT_YUV420SP;
+    cfgs[2].scale_width = 320;
+    cfgs[2].scale_height = 180;
+}
+
 static int run_functional_tests(bool save_files) {
     print_separator("🧪 FUNCTIONAL TESTS");
     
@@ -88,9 +116,18 @@ static int run_functional_tests(bool save_files) {
         RkScreenshotError err = rk_screenshot_capture(&cfg, &res);
         uint64_t elapsed = get_time_us() - t0;
         
+        // Raw 格式结果按紧凑排列报告实际格式与大小
+        if (err == RKSS_SUCCESS && res && tc->format != RK_FORMAT_JPEG &&
+            (res->format != tc->format ||
+             res->size != rk_format_packed_size(tc->format, res->width, res->height))) {
+            printf("   ❌ Raw result mismatch: format %d, %zu bytes\n", res->format, res->size);
+            rk_screenshot_free_result(res);
+            continue;
+        }
+
         if (err == RKSS_SUCCESS && res) {
-            printf("   ✅ Success: %dx%d, %zu bytes, %.2f ms\n", 
-                   res->width, res->height, res->size, elapsed / 1000.0);
+            printf("   ✅ Success: %dx%d, %zu bytes, %.2f ms (scaler %d)\n", 
+                   res->width, res->height, res->size, elapsed / 1000.0, res->scaler);
             
             if (save_files) {
                 save_file(tc->filename, res->data, res->size);
@@ -103,6 +140,142 @@ static int run_functional_tests(bool save_files) {
         }
     }
     
+    // 裁剪 + 旋转 + 镜像：一次 RGA 作业完成
+    total++;
+    printf("\n📷 Test %d/%d: Crop + rotate 90 + flip\n", total, total);
+    {
+        RkScreenshotConfig cfg;
+        rk_screenshot_get_default_config(&cfg);
+        cfg.format = RK_FORMAT_JPEG;
+        cfg.quality = 85;
+        cfg.crop_x = 240;
+        cfg.crop_y = 0;
+        cfg.crop_width = 1440;
+        cfg.crop_height = 1080;
+        cfg.scale_width = 720;
+        cfg.scale_height = 960;
+        cfg.rotation = 90;
+        cfg.flip_horizontal = true;
+
+        RkScreenshotResult* res = NULL;
+        RkScreenshotError err = rk_screenshot_capture(&cfg, &res);
+        if (err == RKSS_SUCCESS && res && res->width == 720 && res->height == 960 &&
+            res->scaler == RK_SCALER_RGA) {
+            printf("   ✅ Success: %dx%d, %zu bytes, RGA %.2f ms\n",
+                   res->width, res->height, res->size, res->process_time_us / 1000.0);
+            if (save_files) {
+                save_file("test_transform.jpg", res->data, res->size);
+            }
+            passed++;
+        } else {
+            printf("   ❌ Failed: %s\n", rk_screenshot_error_string(err));
+        }
+        rk_screenshot_free_result(res);
+    }
+
+    // 异步：连续提交 3 帧，回调按提交顺序执行
+    total++;
+    printf("\n📷 Test %d/%d: Async x3\n", total, total);
+    {
+        RkScreenshotConfig cfg;
+        rk_screenshot_get_default_config(&cfg);
+        cfg.format = RK_FORMAT_JPEG;
+        cfg.quality = 80;
+        cfg.scale_width = 1280;
+        cfg.scale_height = 720;
+
+        int done = 0;
+        int ids[3];
+        bool ok = true;
+        for (int i = 0; i < 3; i++) {
+            ids[i] = rk_screenshot_capture_async(&cfg, count_async_result, &done);
+            ok = ok && ids[i] > 0;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (ids[i] > 0 && rk_screenshot_wait(ids[i], 5000) != RKSS_SUCCESS) ok = false;
+        }
+        if (ok && done == 3) {
+            printf("   ✅ Success: %d callbacks\n", done);
+            passed++;
+        } else {
+            printf("   ❌ Failed: %d/3 callbacks\n", done);
+        }
+    }
+
+    // 批量：一次捕获三个输出，时间戳一致
+    total++;
+    printf("\n📷 Test %d/%d: Batch (full + 720p + NV12 thumbnail)\n", total, total);
+    {
+        RkScreenshotConfig cfgs[NUM_BATCH_OUTPUTS];
+        batch_configs(cfgs);
+        static const char* const names[NUM_BATCH_OUTPUTS] = {
+            "test_batch_full.jpg", "test_batch_720p.jpg", "test_batch_thumb.nv12"};
+
+        RkScreenshotResult** results = NULL;
+        RkScreenshotError err = rk_screenshot_capture_batch(cfgs, NUM_BATCH_OUTPUTS, &results);
+        bool ok = err == RKSS_SUCCESS;
+        for (int i = 0; ok && i < NUM_BATCH_OUTPUTS; i++) {
+            RkScreenshotResult* r = results[i];
+            ok = r->timestamp_us == results[0]->timestamp_us && r->format == cfgs[i].format &&
+                 (cfgs[i].scale_width == 0 || (r->width == cfgs[i].scale_width &&
+                                               r->height == cfgs[i].scale_height));
+            printf("   %s %dx%d, %zu bytes, ts %lld\n", ok ? "✅" : "❌",
+                   r->width, r->height, r->size, (long long)r->timestamp_us);
+            if (ok && save_files) save_file(names[i], r->data, r->size);
+        }
+        if (ok) {
+            printf("   ✅ Success: capture %.2f ms, RGA %.2f ms\n",
+                   results[0]->capture_time_us / 1000.0, results[1]->process_time_us / 1000.0);
+            passed++;
+        } else {
+            printf("   ❌ Failed: %s\n", rk_screenshot_error_string(err));
+        }
+        rk_screenshot_free_batch(results, NUM_BATCH_OUTPUTS);
+    }
+
+    // 多屏：枚举后同时捕获所有显示器
+    total++;
+    printf("\n📷 Test %d/%d: Multi-display\n", total, total);
+    RkDisplayInfo displays[RK_MAX_DISPLAYS];
+    uint64_t ids[RK_MAX_DISPLAYS];
+    int count = 0;
+    RkScreenshotError err = rk_screenshot_get_displays(displays, RK_MAX_DISPLAYS, &count);
+    if (err == RKSS_SUCCESS && count > 0) {
+        if (count > RK_MAX_DISPLAYS) count = RK_MAX_DISPLAYS;
+        for (int i = 0; i < count; i++) {
+            printf("   🖥️  Display %llu: %dx%d @ %.1f Hz%s\n",
+                   (unsigned long long)displays[i].id, displays[i].width, displays[i].height,
+                   displays[i].refresh_rate, displays[i].internal ? " (internal)" : "");
+            ids[i] = displays[i].id;
+        }
+
+        RkScreenshotConfig cfg;
+        rk_screenshot_get_default_config(&cfg);
+        cfg.format = RK_FORMAT_JPEG;
+        cfg.quality = 80;
+
+        RkScreenshotResult* results[RK_MAX_DISPLAYS] = {};
+        err = rk_screenshot_capture_multi(&cfg, ids, count, results);
+        if (err == RKSS_SUCCESS) {
+            for (int i = 0; i < count; i++) {
+                printf("   ✅ Display %llu: %dx%d, %zu bytes, ts %lld\n",
+                       (unsigned long long)results[i]->display_id,
+                       results[i]->width, results[i]->height, results[i]->size,
+                       (long long)results[i]->timestamp_us);
+                if (save_files) {
+                    char filename[64];
+                    snprintf(filename, sizeof(filename), "test_display%d.jpg", i);
+                    save_file(filename, results[i]->data, results[i]->size);
+                }
+                rk_screenshot_free_result(results[i]);
+            }
+            passed++;
+        }
+    }
+    if (err != RKSS_SUCCESS || count == 0) {
+        printf("   ❌ Failed: %s\n", rk_screenshot_error_string(err));
+    }
+
     printf("\n────────────────────────────────────────────────────────────\n");
     printf("📊 Result: %d/%d tests passed\n", passed, total);
     
@@ -119,16 +292,208 @@ typedef struct {
     int quality;
     int scale_width;
     int scale_height;
+    RkImageFormat encode_input;
 } PerfTestCase;
 
-#define NUM_PERF_TESTS 4
+// NV12 用例与对应的 RGBA 用例对比：RGA 多做颜色转换，编码器少读 5/8 数据
+#define NUM_PERF_TESTS 6
 static PerfTestCase g_perf_tests[NUM_PERF_TESTS] = {
-    {"Raw RGBA",    RK_FORMAT_RGBA8888, 0,  0, 0},
-    {"JPEG 1080p",  RK_FORMAT_JPEG,     90, 0, 0},
-    {"JPEG 720p",   RK_FORMAT_JPEG,     85, 1280, 720},
-    {"Thumbnail",   RK_FORMAT_JPEG,     75, 320, 180},
+    {"Raw RGBA",         RK_FORMAT_RGBA8888, 0,  0, 0,       RK_FORMAT_RGBA8888},
+    {"JPEG 1080p",       RK_FORMAT_JPEG,     90, 0, 0,       RK_FORMAT_RGBA8888},
+    {"JPEG 1080p NV12",  RK_FORMAT_JPEG,     90, 0, 0,       RK_FORMAT_YUV420SP},
+    {"JPEG 720p",        RK_FORMAT_JPEG,     85, 1280, 720,  RK_FORMAT_RGBA8888},
+    {"JPEG 720p NV12",   RK_FORMAT_JPEG,     85, 1280, 720,  RK_FORMAT_YUV420SP},
+    {"Thumbnail",        RK_FORMAT_JPEG,     75, 320, 180,   RK_FORMAT_RGBA8888},
 };
 
+// Raw DMA-BUF 零拷贝：与 "Raw RGBA" 对比 memcpy 开销
+static void run_dmabuf_performance(int iterations) {
+    printf("\n🔥 Raw DMA-BUF (zero-copy):\n");
+
+    RkScreenshotConfig cfg;
+    rk_screenshot_get_default_config(&cfg);
+    cfg.format = RK_FORMAT_RGBA8888;
+
+    uint64_t total_time = 0;
+    size_t total_bytes = 0;
+    int success_count = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        RkScreenshotDmaBuf* res = NULL;
+        uint64_t t0 = get_time_us();
+        RkScreenshotError err = rk_screenshot_capture_dmabuf(&cfg, 0, &res);
+        uint64_t elapsed = get_time_us() - t0;
+
+        if (err == RKSS_SUCCESS && res) {
+            total_time += elapsed;
+            total_bytes += res->size;
+            success_count++;
+            rk_screenshot_release_dmabuf(res);
+        }
+    }
+
+    if (success_count > 0) {
+        double avg_ms = (total_time / success_count) / 1000.0;
+        printf("   ✅ %d/%d successful\n", success_count, iterations);
+        printf("   ⏱️  Time: avg=%.2f ms, FPS: %.1f\n", avg_ms, 1000.0 / avg_ms);
+        printf("   📊 Throughput: %.1f MB/s (no CPU copy)\n",
+               (total_bytes / success_count) / avg_ms / 1000.0);
+    } else {
+        printf("   ❌ All iterations failed!\n");
+    }
+}
+
+// 异步流水线：最多 3 帧在途，下一帧的捕获与上一帧的 RGA/编码重叠
+static void run_async_performance(int iterations) {
+    printf("\n🔥 JPEG 720p async (pipelined):\n");
+
+    RkScreenshotConfig cfg;
+    rk_screenshot_get_default_config(&cfg);
+    cfg.format = RK_FORMAT_JPEG;
+    cfg.quality = 85;
+    cfg.scale_width = 1280;
+    cfg.scale_height = 720;
+
+    const int depth = 3;
+    int ids[depth] = {};
+    int success_count = 0;
+    uint64_t t0 = get_time_us();
+    for (int i = 0; i < iterations; i++) {
+        int slot = i % depth;
+        if (ids[slot] > 0) rk_screenshot_wait(ids[slot], -1);
+        ids[slot] = rk_screenshot_capture_async(&cfg, count_async_result, &success_count);
+    }
+    for (int i = 0; i < depth; i++) {
+        if (ids[i] > 0) rk_screenshot_wait(ids[i], -1);
+    }
+    uint64_t total = get_time_us() - t0;
+
+    if (success_count > 0) {
+        double avg_ms = (total / iterations) / 1000.0;
+        printf("   ✅ %d/%d successful\n", success_count, iterations);
+        printf("   ⏱️  Time: avg=%.2f ms/frame, FPS: %.1f\n", avg_ms, 1000.0 / avg_ms);
+    } else {
+        printf("   ❌ All iterations failed!\n");
+    }
+}
+
+// 批量 vs 逐个：同样三个输出，一次捕获 + 一次 RGA 提交 对比 三次完整截图
+static void run_batch_performance(int iterations) {
+    printf("\n🔥 Batch full + 720p + thumbnail:\n");
+
+    RkScreenshotConfig cfgs[NUM_BATCH_OUTPUTS];
+    batch_configs(cfgs);
+
+    uint64_t batch_time = 0, single_time = 0;
+    int batch_ok = 0, single_ok = 0;
+    for (int i = 0; i < iterations; i++) {
+        RkScreenshotResult** results = NULL;
+        uint64_t t0 = get_time_us();
+        if (rk_screenshot_capture_batch(cfgs, NUM_BATCH_OUTPUTS, &results) == RKSS_SUCCESS) {
+            batch_time += get_time_us() - t0;
+            batch_ok++;
+            rk_screenshot_free_batch(results, NUM_BATCH_OUTPUTS);
+        }
+
+        t0 = get_time_us();
+        bool ok = true;
+        for (int k = 0; k < NUM_BATCH_OUTPUTS; k++) {
+            RkScreenshotResult* res = NULL;
+            ok = rk_screenshot_capture(&cfgs[k], &res) == RKSS_SUCCESS && ok;
+            rk_screenshot_free_result(res);
+        }
+        if (ok) {
+            single_time += get_time_us() - t0;
+            single_ok++;
+        }
+    }
+
+    if (batch_ok > 0 && single_ok > 0) {
+        printf("   ✅ %d/%d batches, %d/%d triples\n", batch_ok, iterations, single_ok, iterations);
+        printf("   ⏱️  Batch avg=%.2f ms vs separate avg=%.2f ms\n",
+               (batch_time / batch_ok) / 1000.0, (single_time / single_ok) / 1000.0);
+    } else {
+        printf("   ❌ All iterations failed!\n");
+    }
+}
+
+// 条带并行 vs 单次编码：同一尺寸 JPEG，只改 jpeg_strips
+static void run_strip_performance(int iterations) {
+    static const int sizes[3][2] = {{1920, 1080}, {2560, 1440}, {3840, 2160}};
+
+    for (int s = 0; s < 3; s++) {
+        printf("\n🔥 JPEG %dx%d single vs strips:\n", sizes[s][0], sizes[s][1]);
+        RkScreenshotConfig cfg;
+        rk_screenshot_get_default_config(&cfg);
+        cfg.format = RK_FORMAT_JPEG;
+        cfg.quality = 85;
+        cfg.scale_width = sizes[s][0];
+        cfg.scale_height = sizes[s][1];
+
+        uint64_t encode_us[2] = {0, 0};
+        size_t bytes[2] = {0, 0};
+        int ok[2] = {0, 0};
+        for (int mode = 0; mode < 2; mode++) {
+            cfg.jpeg_strips = mode == 0 ? 1 : 4;
+            for (int i = 0; i < iterations; i++) {
+                RkScreenshotResult* res = NULL;
+                if (rk_screenshot_capture(&cfg, &res) == RKSS_SUCCESS) {
+                    encode_us[mode] += res->encode_time_us;
+                    bytes[mode] += res->size;
+                    ok[mode]++;
+                }
+                rk_screenshot_free_result(res);
+            }
+        }
+
+        if (ok[0] > 0 && ok[1] > 0) {
+            printf("   ⏱️  Encode: single avg=%.2f ms (%.1f KB) vs %d strips avg=%.2f ms (%.1f KB)\n",
+                   encode_us[0] / ok[0] / 1000.0, bytes[0] / ok[0] / 1024.0,
+                   4, encode_us[1] / ok[1] / 1000.0,
+                   bytes[1] / ok[1] / 1024.0);
+        } else {
+            printf("   ❌ All iterations failed!\n");
+        }
+    }
+}
+
+static void run_target_size_performance(int iterations) {
+    static const size_t budgets[3] = {100 * 1024, 200 * 1024, 400 * 1024};
+
+    for (int b = 0; b < 3; b++) {
+        printf("\n🔥 JPEG 1080p target %zu KB:\n", budgets[b] / 1024);
+        RkScreenshotConfig cfg;
+        rk_screenshot_get_default_config(&cfg);
+        cfg.format = RK_FORMAT_JPEG;
+        cfg.quality = 100;
+        cfg.jpeg_max_bytes = budgets[b];
+
+        uint64_t encode_us = 0;
+        size_t bytes = 0;
+        int ok = 0, within = 0, quality = 0;
+        for (int i = 0; i < iterations; i++) {
+            RkScreenshotResult* res = NULL;
+            if (rk_screenshot_capture(&cfg, &res) == RKSS_SUCCESS) {
+                encode_us += res->encode_time_us;
+                bytes += res->size;
+                quality += res->quality;
+                within += res->size <= budgets[b];
+                ok++;
+            }
+            rk_screenshot_free_result(res);
+        }
+
+        if (ok > 0) {
+            // 重编码次数与首次命中率见 deinit 时的 logcat（RK_JPEG_Rate）
+            printf("   📦 Within budget: %d/%d, avg %.1f KB, avg Q%d\n", within, ok,
+                   bytes / ok / 1024.0, quality / ok);
+            printf("   ⏱️  Encode: avg=%.2f ms (incl. re-encodes)\n", encode_us / ok / 1000.0);
+        } else {
+            printf("   ❌ All iterations failed!\n");
+        }
+    }
+}
+
 static void run_performance_tests(int iterations, bool benchmark_mode) {
     print_separator(benchmark_mode ? "⚡ BENCHMARK MODE" : "📈 PERFORMANCE TESTS");
     printf("  Iterations: %d\n", iterations);
@@ -145,8 +510,11 @@ static void run_performance_tests(int iterations, bool benchmark_mode) {
         cfg.quality = tc->quality;
         cfg.scale_width = tc->scale_width;
         cfg.scale_height = tc->scale_height;
+        cfg.encode_input = tc->encode_input;
         
         uint64_t total_time = 0;
+        uint64_t process_time = 0;
+        uint64_t encode_time = 0;
         uint64_t min_time = UINT64_MAX;
         uint64_t max_time = 0;
         size_t total_bytes = 0;
@@ -172,6 +540,8 @@ static void run_performance_tests(int iterations, bool benchmark_mode) {
                 if (elapsed < min_time) min_time = elapsed;
                 if (elapsed > max_time) max_time = elapsed;
                 total_bytes += res->size;
+                process_time += res->process_time_us;
+                encode_time += res->encode_time_us;
                 success_count++;
                 rk_screenshot_free_result(res);
             }
@@ -190,6 +560,8 @@ static void run_performance_tests(int iterations, bool benchmark_mode) {
             printf("   ✅ %d/%d successful\n", success_count, iterations);
             printf("   ⏱️  Time: avg=%.2f ms, min=%.2f ms, max=%.2f ms\n",
                    avg_ms, min_time / 1000.0, max_time / 1000.0);
+            printf("   🔄 Stages: RGA avg=%.2f ms, encode avg=%.2f ms\n",
+                   (process_time / success_count) / 1000.0, (encode_time / success_count) / 1000.0);
             printf("   🚀 FPS: %.1f\n", fps);
             printf("   📊 Avg size: %.1f KB, Throughput: %.1f MB/s\n",
                    (total_bytes / success_count) / 1024.0, throughput_mbps);
@@ -197,6 +569,2116 @@ static void run_performance_tests(int iterations, bool benchmark_mode) {
             printf("   ❌ All iterations failed!\n");
         }
     }
+
+    run_dmabuf_performance(iterations);
+    run_async_performance(iterations);
+    run_batch_performance(iterations);
+    run_strip_performance(iterations);
+    run_target_size_performance(iterations);
+}
+
+//==============================================================================
+// Unit Tests (内部模块，memfd 后端，可在普通 Linux 主机运行)
+//==============================================================================
+
+static int g_unit_failures = 0;
+
+#define UNIT_CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("   ❌ %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        g_unit_failures++; \
+    } \
+} while (0)
+
+static void test_dmabuf_pool() {
+    printf("\n🧩 DMA-BUF pool\n");
+
+    const size_t frame = 64 * 32 * 4;
+    RkDmaBufPool* pool = rk_dmabuf_pool_create(rk_dmabuf_memfd_allocator(), frame * 2);
+    UNIT_CHECK(pool != NULL);
+    if (!pool) return;
+
+    // 首次分配 miss，归还后同规格命中
+    RkDmaBuffer* a = rk_dmabuf_pool_acquire(pool, 64, 32, RK_FORMAT_RGBA8888);
+    UNIT_CHECK(a != NULL && a->fd >= 0 && a->size == frame);
+    int fd = a ? a->fd : -1;
+    rk_dmabuf_free(a);
+
+    RkDmaBuffer* b = rk_dmabuf_pool_acquire(pool, 64, 32, RK_FORMAT_RGBA8888);
+    UNIT_CHECK(b != NULL && b->fd == fd);
+
+    // 不同规格不能复用
+    RkDmaBuffer* c = rk_dmabuf_pool_acquire(pool, 32, 64, RK_FORMAT_RGBA8888);
+    UNIT_CHECK(c != NULL && c->fd != fd);
+
+    RkDmaBufPoolStats st;
+    rk_dmabuf_pool_get_stats(pool, &st);
+    UNIT_CHECK(st.hits == 1 && st.misses == 2);
+    UNIT_CHECK(st.leased_count == 2 && st.idle_count == 0);
+
+    // 上限 2 帧：第 3 个空闲 buffer 淘汰最旧的
+    RkDmaBuffer* d = rk_dmabuf_pool_acquire(pool, 16, 16, RK_FORMAT_RGBA8888);
+    rk_dmabuf_free(b);
+    rk_dmabuf_free(c);
+    rk_dmabuf_free(d);
+    rk_dmabuf_pool_get_stats(pool, &st);
+    UNIT_CHECK(st.idle_bytes <= frame * 2);
+    UNIT_CHECK(st.evictions == 1);
+    UNIT_CHECK(st.high_water_bytes == frame * 2 + 16 * 16 * 4);
+
+    rk_dmabuf_pool_trim(pool, 0);
+    rk_dmabuf_pool_get_stats(pool, &st);
+    UNIT_CHECK(st.idle_count == 0 && st.idle_bytes == 0);
+
+    // 租出期间销毁：归还时释放
+    RkDmaBuffer* e = rk_dmabuf_pool_acquire(pool, 64, 32, RK_FORMAT_RGBA8888);
+    rk_dmabuf_pool_destroy(pool);
+    rk_dmabuf_free(e);
+
+    // 简单 benchmark：直接分配 vs pool 复用
+    const int iters = 200;
+    const RkDmaAllocator* memfd = rk_dmabuf_memfd_allocator();
+    uint64_t t0 = get_time_us();
+    for (int i = 0; i < iters; i++) {
+        RkDmaBuffer* buf = rk_dmabuf_alloc_with(memfd, 1920, 1080, RK_FORMAT_RGBA8888);
+        if (buf) memset(rk_dmabuf_map(buf), 0, buf->size);
+        rk_dmabuf_free(buf);
+    }
+    uint64_t t_alloc = get_time_us() - t0;
+
+    pool = rk_dmabuf_pool_create(memfd, 1920 * 1080 * 4);
+    t0 = get_time_us();
+    for (int i = 0; i < iters; i++) {
+        RkDmaBuffer* buf = rk_dmabuf_pool_acquire(pool, 1920, 1080, RK_FORMAT_RGBA8888);
+        if (buf) memset(rk_dmabuf_map(buf), 0, buf->size);
+        rk_dmabuf_free(buf);
+    }
+    uint64_t t_pool = get_time_us() - t0;
+    rk_dmabuf_pool_destroy(pool);
+
+    printf("   ⏱️  1080p alloc+touch: %.1f us/frame, pooled: %.1f us/frame\n",
+           (double)t_alloc / iters, (double)t_pool / iters);
+}
+
+static void test_dmabuf_mapping() {
+    printf("\n🧩 DMA-BUF persistent mapping\n");
+
+    RkDmaBufPool* pool = rk_dmabuf_pool_create(rk_dmabuf_memfd_allocator(), 1 << 20);
+    UNIT_CHECK(pool != NULL);
+    if (!pool) return;
+
+    RkDmaBufStats before, after;
+    rk_dmabuf_get_stats(&before);
+
+    // 多次 CPU 访问 + 跨租借只映射一次
+    RkDmaBuffer* buf = rk_dmabuf_pool_acquire(pool, 32, 32, RK_FORMAT_RGBA8888);
+    uint8_t* p = (uint8_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, 0);
+    UNIT_CHECK(p != NULL);
+    if (p) memset(p, 0x5a, buf->size);
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, 0);
+    rk_dmabuf_free(buf);
+
+    buf = rk_dmabuf_pool_acquire(pool, 32, 32, RK_FORMAT_RGBA8888);
+    uint8_t* q = (uint8_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_READ, 128, 256);
+    UNIT_CHECK(q == p);
+    UNIT_CHECK(q && q[128] == 0x5a);
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_READ, 128, 256);
+
+    rk_dmabuf_get_stats(&after);
+    UNIT_CHECK(after.maps - before.maps == 1);
+    UNIT_CHECK(after.unmaps == before.unmaps);
+    // memfd 不支持 DMA_BUF_IOCTL_SYNC，不计数
+    UNIT_CHECK(buf->sync_unsupported);
+    UNIT_CHECK(after.syncs == before.syncs);
+
+    rk_dmabuf_free(buf);
+    rk_dmabuf_pool_destroy(pool);
+
+    rk_dmabuf_get_stats(&after);
+    UNIT_CHECK(after.unmaps - before.unmaps == 1);
+}
+
+static void test_dmabuf_aligned_alloc() {
+    printf("\n🧩 DMA-BUF aligned allocation\n");
+
+    const RkDmaAllocator* memfd = rk_dmabuf_memfd_allocator();
+
+    // 320x180 缩略图：紧凑分配无法零拷贝，16 对齐后可以
+    RkDmaBuffer* tight = rk_dmabuf_alloc_with(memfd, 320, 180, RK_FORMAT_RGBA8888);
+    UNIT_CHECK(tight && tight->stride == 320 && tight->height_stride == 180);
+    UNIT_CHECK(!rk_mpp_can_import(tight));
+    rk_dmabuf_free(tight);
+
+    RkDmaBuffer* aligned = rk_dmabuf_alloc_aligned(memfd, 320, 180, RK_FORMAT_RGBA8888,
+                                                   RK_MPP_ALIGN, RK_MPP_ALIGN);
+    UNIT_CHECK(aligned && aligned->stride == 320 && aligned->height_stride == 192);
+    UNIT_CHECK(aligned && aligned->size == 320 * 192 * 4);
+    UNIT_CHECK(rk_mpp_can_import(aligned));
+    rk_dmabuf_free(aligned);
+
+    RkDmaBuffer* odd = rk_dmabuf_alloc_aligned(memfd, 333, 77, RK_FORMAT_RGBA8888,
+                                               RK_MPP_ALIGN, RK_MPP_ALIGN);
+    UNIT_CHECK(odd && odd->stride == 336 && odd->height_stride == 80);
+    UNIT_CHECK(rk_mpp_can_import(odd));
+    rk_dmabuf_free(odd);
+
+    // YUV420 步进至少偶数，大小为 1.5 字节/像素
+    RkDmaBuffer* nv12 = rk_dmabuf_alloc_with(memfd, 321, 181, RK_FORMAT_YUV420SP);
+    UNIT_CHECK(nv12 && nv12->stride == 322 && nv12->height_stride == 182);
+    UNIT_CHECK(nv12 && nv12->size == 322 * 182 * 3 / 2);
+    rk_dmabuf_free(nv12);
+
+    // 对齐规格参与 pool key
+    RkDmaBufPool* pool = rk_dmabuf_pool_create(memfd, 1 << 20);
+    RkDmaBuffer* a = rk_dmabuf_pool_acquire(pool, 320, 180, RK_FORMAT_RGBA8888);
+    rk_dmabuf_free(a);
+    RkDmaBuffer* b = rk_dmabuf_pool_acquire_aligned(pool, 320, 180, RK_FORMAT_RGBA8888,
+                                                    RK_MPP_ALIGN, RK_MPP_ALIGN);
+    UNIT_CHECK(b && b->height_stride == 192);
+    rk_dmabuf_free(b);
+    RkDmaBufPoolStats st;
+    rk_dmabuf_pool_get_stats(pool, &st);
+    UNIT_CHECK(st.hits == 0 && st.misses == 2);
+    rk_dmabuf_pool_destroy(pool);
+}
+
+// 模拟 SurfaceFlinger：在固定几块 buffer 间轮转，导入操作只计数
+typedef struct {
+    RkDmaBuffer* buffers[3];
+    int next;
+    int rga_imports;
+    int rga_releases;
+    int mpp_imports;
+    int mpp_releases;
+    int owner_refs;     // 尚未释放的所有者引用
+} FakeBufferSource;
+
+static int fake_import_rga(void* user, const RkDmaBuffer* buf, uint64_t* handle) {
+    FakeBufferSource* src = (FakeBufferSource*)user;
+    *handle = 1000 + (++src->rga_imports);
+    return 0;
+}
+
+static void fake_release_rga(void* user, uint64_t handle) {
+    ((FakeBufferSource*)user)->rga_releases++;
+}
+
+static int fake_import_mpp(void* user, const RkDmaBuffer* buf, void** mpp_buf) {
+    FakeBufferSource* src = (FakeBufferSource*)user;
+    src->mpp_imports++;
+    *mpp_buf = (void*)buf;
+    return 0;
+}
+
+static void fake_release_mpp(void* user, void* mpp_buf) {
+    ((FakeBufferSource*)user)->mpp_releases++;
+}
+
+static void fake_release_owner(void* user, void* owner) {
+    ((FakeBufferSource*)user)->owner_refs--;
+}
+
+static RkImportDesc fake_next_frame(FakeBufferSource* src) {
+    int i = src->next++ % 3;
+    RkDmaBuffer* b = src->buffers[i];
+    RkImportDesc desc = {};
+    desc.id = 0x1000 + i;
+    desc.fd = b->fd;
+    desc.size = b->size;
+    desc.width = b->width;
+    desc.height = b->height;
+    desc.stride = b->stride;
+    desc.height_stride = b->height_stride;
+    desc.format = b->format;
+    desc.owner = b;
+    src->owner_refs++;
+    return desc;
+}
+
+static void test_import_cache() {
+    printf("\n🧩 GraphicBuffer import cache\n");
+
+    FakeBufferSource src;
+    memset(&src, 0, sizeof(src));
+    for (int i = 0; i < 3; i++) {
+        src.buffers[i] = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 64, 64,
+                                              RK_FORMAT_RGBA8888);
+    }
+    RkImportOps ops = { &src, fake_import_rga, fake_release_rga,
+                        fake_import_mpp, fake_release_mpp, fake_release_owner };
+
+    // 容量足够：3 块 buffer 轮转 12 帧，只导入 3 次
+    RkImportCache* cache = rk_import_cache_create(&ops, 4);
+    for (int f = 0; f < 12; f++) {
+        RkImportDesc desc = fake_next_frame(&src);
+        RkDmaBuffer* buf = NULL;
+        UNIT_CHECK(rk_import_cache_acquire(cache, &desc, &buf) == RKSS_SUCCESS);
+        UNIT_CHECK(buf && buf->rga_handle != 0 && buf->mpp_buf != NULL);
+        UNIT_CHECK(buf && buf->fd != desc.fd);     // 缓存持有自己的 dup
+        rk_dmabuf_free(buf);
+    }
+    RkImportCacheStats st;
+    rk_import_cache_get_stats(cache, &st);
+    UNIT_CHECK(st.misses == 3 && st.hits == 9 && st.evictions == 0);
+    UNIT_CHECK(src.rga_imports == 3 && src.mpp_imports == 3);
+    UNIT_CHECK(src.owner_refs == 3);   // 每个条目持有一个引用
+
+    rk_import_cache_destroy(cache);
+    UNIT_CHECK(src.rga_releases == 3 && src.mpp_releases == 3);
+    UNIT_CHECK(src.owner_refs == 0);
+
+    // 容量 2：LRU 轮转每帧都淘汰
+    src.next = 0;
+    src.rga_imports = src.rga_releases = 0;
+    cache = rk_import_cache_create(&ops, 2);
+    RkDmaBuffer* held = NULL;
+    for (int f = 0; f < 6; f++) {
+        RkImportDesc desc = fake_next_frame(&src);
+        RkDmaBuffer* buf = NULL;
+        rk_import_cache_acquire(cache, &desc, &buf);
+        if (f == 0) {
+            held = buf;     // 借出中的条目不能被淘汰
+        } else {
+            rk_dmabuf_free(buf);
+        }
+    }
+    rk_import_cache_get_stats(cache, &st);
+    UNIT_CHECK(st.entries <= 2);
+    UNIT_CHECK(st.hits == 1);           // 只有被持有的 buffer 0 在第 3 帧命中
+    UNIT_CHECK(held && held->rga_handle == 1001);
+    rk_import_cache_destroy(cache);
+    UNIT_CHECK(src.owner_refs == 1);    // held 仍在借出
+    rk_dmabuf_free(held);
+    UNIT_CHECK(src.owner_refs == 0);
+    UNIT_CHECK(src.rga_imports == src.rga_releases);
+
+    for (int i = 0; i < 3; i++) rk_dmabuf_free(src.buffers[i]);
+}
+
+// 编码配置只由尺寸/步进/格式/质量档决定：连续同尺寸截图复用，不重新 SET_CFG
+static void test_mpp_params() {
+    printf("\n🧩 MPP encoder config reuse\n");
+
+    const RkDmaAllocator* memfd = rk_dmabuf_memfd_allocator();
+    RkDmaBuffer* a = rk_dmabuf_alloc_aligned(memfd, 1920, 1080, RK_FORMAT_RGBA8888,
+                                             RK_MPP_ALIGN, RK_MPP_ALIGN);
+    RkDmaBuffer* b = rk_dmabuf_alloc_aligned(memfd, 1920, 1080, RK_FORMAT_RGBA8888,
+                                             RK_MPP_ALIGN, RK_MPP_ALIGN);
+    RkDmaBuffer* tight = rk_dmabuf_alloc_with(memfd, 1920, 1080, RK_FORMAT_RGBA8888);
+    RkDmaBuffer* nv12 = rk_dmabuf_alloc_aligned(memfd, 1920, 1080, RK_FORMAT_YUV420SP,
+                                                RK_MPP_ALIGN, RK_MPP_ALIGN);
+    UNIT_CHECK(a && b && tight && nv12);
+    if (a && b && tight && nv12) {
+        RkMppEncParams pa, pb;
+        UNIT_CHECK(rk_mpp_enc_params(a, 90, &pa) == RKSS_SUCCESS);
+        UNIT_CHECK(pa.width == 1920 && pa.height == 1080 && pa.hor_stride == 1920 * 4 &&
+                   pa.ver_stride == 1088 && pa.quant == 9);
+
+        // 另一块同规格 buffer、同一质量档（85~94 -> 9）：配置相同
+        UNIT_CHECK(rk_mpp_enc_params(b, 85, &pb) == RKSS_SUCCESS);
+        UNIT_CHECK(memcmp(&pa, &pb, sizeof(pa)) == 0);
+        UNIT_CHECK(rk_mpp_enc_params(b, 95, &pb) == RKSS_SUCCESS && pb.quant == 10);
+        UNIT_CHECK(memcmp(&pa, &pb, sizeof(pa)) != 0);
+
+        // 紧凑 buffer 走拷贝，步进同样 16 对齐；NV12 步进按 Y 平面字节
+        UNIT_CHECK(rk_mpp_enc_params(tight, 90, &pb) == RKSS_SUCCESS);
+        UNIT_CHECK(memcmp(&pa, &pb, sizeof(pa)) == 0);
+        UNIT_CHECK(rk_mpp_enc_params(nv12, 90, &pb) == RKSS_SUCCESS);
+        UNIT_CHECK(pb.hor_stride == 1920 && pb.ver_stride == 1088 && pb.format != pa.format);
+
+        tight->format = RK_FORMAT_RGB888;
+        UNIT_CHECK(rk_mpp_enc_params(tight, 90, &pb) == RKSS_ERROR_UNSUPPORTED);
+        tight->format = RK_FORMAT_RGBA8888;
+    }
+    RkMppEncoder idle = {};
+    RkMppEncStats stats;
+    rk_mpp_get_stats(&idle, &stats);
+    UNIT_CHECK(stats.frames == 0 && stats.reconfigs == 0);
+    rk_dmabuf_free(nv12);
+    rk_dmabuf_free(tight);
+    rk_dmabuf_free(b);
+    rk_dmabuf_free(a);
+}
+
+static void test_mpp_packet_sizer() {
+    printf("\n🧩 MPP packet sizing\n");
+
+    RkMppPacketSizer sizer;
+    rk_mpp_packet_sizer_init(&sizer);
+    size_t raw = (size_t)1920 * 1080 * 4;
+    size_t first = rk_mpp_packet_capacity(&sizer, 1920, 1080);
+    // 首帧容量远小于原始 RGBA 帧，且 64KB 对齐
+    UNIT_CHECK(first < raw / 4 && first % (64 * 1024) == 0);
+    UNIT_CHECK(rk_mpp_packet_capacity_max(1920, 1080) >= raw);
+
+    // 桌面 ~0.2 字节/像素：估计逐帧回落，容量仍留有余量
+    for (int i = 0; i < 50; i++) {
+        rk_mpp_packet_sizer_update(&sizer, 400 * 1024, 1920, 1080);
+    }
+    size_t steady = rk_mpp_packet_capacity(&sizer, 1920, 1080);
+    UNIT_CHECK(steady < first && steady > 400 * 1024 + 1024);
+
+    // 复杂画面一帧就跟上
+    rk_mpp_packet_sizer_update(&sizer, 2 * 1024 * 1024, 1920, 1080);
+    UNIT_CHECK(rk_mpp_packet_capacity(&sizer, 1920, 1080) > 2 * 1024 * 1024 + 1024);
+
+    // 噪声图估计超过原始大小时按最大容量封顶
+    rk_mpp_packet_sizer_update(&sizer, raw * 2, 1920, 1080);
+    UNIT_CHECK(rk_mpp_packet_capacity(&sizer, 1920, 1080) ==
+               rk_mpp_packet_capacity_max(1920, 1080));
+    printf("    1080p packet: first %zu KB, steady %zu KB (was %zu KB per frame)\n",
+           first / 1024, steady / 1024, raw / 1024);
+}
+
+static void test_scaler_model() {
+    printf("\n🧩 Scaler cost model\n");
+
+    RkScalerModel model;
+    rk_scaler_model_init(&model);
+
+    // 缩略图：SF 直接合成小图远小于全分辨率捕获 + RGA
+    UNIT_CHECK(rk_scaler_model_choose(&model, 1920, 1080, 320, 180, true) ==
+               RK_SCALER_SURFACEFLINGER);
+    // 轻微缩小且 SF 输出仍需重新对齐：RGA 单次处理更省
+    UNIT_CHECK(rk_scaler_model_choose(&model, 1920, 1080, 1900, 1070, true) ==
+               RK_SCALER_RGA);
+
+    // 实测 SF 缩放很慢时切换到 RGA
+    for (int i = 0; i < 30; i++) {
+        rk_scaler_model_update_sf(&model, 1280, 720, true, 40000);
+    }
+    UNIT_CHECK(model.sf_samples == 30);
+    UNIT_CHECK(model.sf_scaled_per_mpx_us > 30000);
+    UNIT_CHECK(model.sf_per_mpx_us < 3000);     // 原尺寸合成不受影响
+    for (int i = 0; i < 30; i++) {
+        rk_scaler_model_update_rga(&model, 1920, 1080, 1280, 720, 1500);
+    }
+    UNIT_CHECK(model.rga_per_mpx_us < 1000);
+    UNIT_CHECK(rk_scaler_model_choose(&model, 3840, 2160, 1280, 720, false) == RK_SCALER_RGA);
+
+    rk_scaler_model_deinit(&model);
+}
+
+// 读回 RGBA 像素 (x, y)
+static uint32_t read_pixel(RkDmaBuffer* buf, int x, int y) {
+    uint32_t* p = (uint32_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_READ, 0, buf->size);
+    uint32_t v = p ? p[(size_t)y * buf->stride + x] : 0;
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_READ, 0, buf->size);
+    return v;
+}
+
+static void test_frame_sources() {
+    printf("\n🧩 Frame sources\n");
+
+    // 64 位物理显示器 ID 拆成两半存放在配置里
+    RkScreenshotConfig dcfg = {};
+    UNIT_CHECK(rk_screenshot_config_display(&dcfg) == 0);
+    rk_screenshot_config_set_display(&dcfg, 0x1234567800000042ULL);
+    UNIT_CHECK(rk_screenshot_config_display(&dcfg) == 0x1234567800000042ULL);
+
+    // 合成图案：每 2 帧变化一次
+    RkSyntheticSourceConfig scfg = {};
+    scfg.width = 640;
+    scfg.height = 360;
+    scfg.change_interval = 2;
+    scfg.allocator = rk_dmabuf_memfd_allocator();
+    RkFrameSource* src = rk_frame_source_create_synthetic(&scfg);
+    UNIT_CHECK(src != NULL);
+    if (src) {
+        int w = 0, h = 0;
+        UNIT_CHECK(src->get_display_size(src, 0, &w, &h) == RKSS_SUCCESS && w == 640 && h == 360);
+
+        RkDmaBuffer* f[3] = {};
+        for (int i = 0; i < 3; i++) {
+            UNIT_CHECK(src->capture(src, NULL, &f[i]) == RKSS_SUCCESS);
+        }
+        UNIT_CHECK(f[0] && f[0]->width == 640 && f[0]->stride % 16 == 0);
+        // 画面每 2 帧变化：帧 0/1 相同，帧 2 不同
+        UNIT_CHECK(read_pixel(f[0], 0, 100) == read_pixel(f[1], 0, 100));
+        UNIT_CHECK(read_pixel(f[0], 0, 100) != read_pixel(f[2], 0, 100));
+        for (int i = 0; i < 3; i++) rk_dmabuf_free(f[i]);
+
+        // 裁剪 + 缩放：输出尺寸按请求，右下角取自裁剪区域
+        RkCaptureRequest req = {};
+        req.width = 80;
+        req.height = 45;
+        req.crop_x = 320;
+        req.crop_y = 180;
+        req.crop_width = 320;
+        req.crop_height = 180;
+        RkDmaBuffer* thumb = NULL;
+        UNIT_CHECK(src->capture(src, &req, &thumb) == RKSS_SUCCESS);
+        UNIT_CHECK(thumb && thumb->width == 80 && thumb->height == 45);
+        rk_dmabuf_free(thumb);
+
+        req.crop_x = 400;   // 超出显示范围
+        UNIT_CHECK(src->capture(src, &req, &thumb) == RKSS_ERROR_INVALID_PARAM);
+        rk_frame_source_destroy(src);
+    }
+
+    // 回放：两帧纯色，播放到末尾后循环
+    char path[] = "/tmp/rk_replay_XXXXXX";
+    int fd = mkstemp(path);
+    UNIT_CHECK(fd >= 0);
+    if (fd < 0) return;
+    const int rw = 64, rh = 32;
+    uint32_t colors[2] = {0xff0000ffu, 0xff00ff00u};
+    for (int i = 0; i < 2; i++) {
+        for (int p = 0; p < rw * rh; p++) {
+            UNIT_CHECK(write(fd, &colors[i], 4) == 4);
+        }
+    }
+    close(fd);
+
+    src = rk_frame_source_create_replay(path, rw, rh, rk_dmabuf_memfd_allocator());
+    UNIT_CHECK(src != NULL);
+    if (src) {
+        for (int i = 0; i < 3; i++) {
+            RkDmaBuffer* buf = NULL;
+            UNIT_CHECK(src->capture(src, NULL, &buf) == RKSS_SUCCESS);
+            UNIT_CHECK(buf && read_pixel(buf, rw - 1, rh - 1) == colors[i % 2]);
+            rk_dmabuf_free(buf);
+        }
+        rk_frame_source_destroy(src);
+    }
+    UNIT_CHECK(rk_frame_source_create_replay(path, 4096, 4096, NULL) == NULL);
+    unlink(path);
+
+    UNIT_CHECK(rk_frame_source_create_from_spec("synthetic:0x0") == NULL);
+    UNIT_CHECK(rk_frame_source_create_from_spec("replay:/nonexistent") == NULL);
+    src = rk_frame_source_create_from_spec("synthetic:320x240:0");
+    UNIT_CHECK(src != NULL && strcmp(src->name, "synthetic") == 0);
+    rk_frame_source_destroy(src);
+}
+
+// 源像素编码为 (x, y)，便于校验几何变换
+static RkDmaBuffer* make_coord_buffer(int w, int h) {
+    RkDmaBuffer* buf = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), w, h, RK_FORMAT_RGBA8888);
+    if (!buf) return NULL;
+    uint32_t* p = (uint32_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    for (int y = 0; p && y < h; y++) {
+        for (int x = 0; x < w; x++) p[(size_t)y * buf->stride + x] = (uint32_t)(y << 16 | x);
+    }
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    return buf;
+}
+
+#define COORD(x, y) ((uint32_t)((y) << 16 | (x)))
+
+// 执行作业并检查输出 (0,0) 与 (1,0) 像素
+static bool cpu_job_matches(RkDmaBuffer* src, int dw, int dh, const RkRgaJob* job,
+                            uint32_t p00, uint32_t p10) {
+    RkDmaBuffer* dst = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), dw, dh,
+                                            RK_FORMAT_RGBA8888);
+    if (!dst) return false;
+    bool ok = rk_cpu_process_job(src, dst, job) == RKSS_SUCCESS &&
+              read_pixel(dst, 0, 0) == p00 && read_pixel(dst, 1, 0) == p10;
+    rk_dmabuf_free(dst);
+    return ok;
+}
+
+static void test_cpu_job() {
+    printf("\n🧩 CPU crop/scale/rotate/flip reference\n");
+
+    RkDmaBuffer* src = make_coord_buffer(4, 2);
+    UNIT_CHECK(src != NULL);
+    if (!src) return;
+
+    RkRgaJob job = {};
+    UNIT_CHECK(cpu_job_matches(src, 4, 2, &job, COORD(0, 0), COORD(1, 0)));
+    job.rotation = 90;      // 顺时针：输出首行取自源图最后一行向上
+    UNIT_CHECK(cpu_job_matches(src, 2, 4, &job, COORD(0, 1), COORD(0, 0)));
+    job.rotation = 180;
+    UNIT_CHECK(cpu_job_matches(src, 4, 2, &job, COORD(3, 1), COORD(2, 1)));
+    job.rotation = 270;
+    UNIT_CHECK(cpu_job_matches(src, 2, 4, &job, COORD(3, 0), COORD(3, 1)));
+
+    job = RkRgaJob{};
+    job.flip_horizontal = true;
+    UNIT_CHECK(cpu_job_matches(src, 4, 2, &job, COORD(3, 0), COORD(2, 0)));
+    job.flip_vertical = true;   // 双向镜像 == 旋转 180
+    UNIT_CHECK(cpu_job_matches(src, 4, 2, &job, COORD(3, 1), COORD(2, 1)));
+    job.flip_horizontal = false;
+    job.rotation = 90;      // 镜像作用于旋转后的图像
+    UNIT_CHECK(cpu_job_matches(src, 2, 4, &job, COORD(3, 1), COORD(3, 0)));
+
+    // 裁剪 + 旋转
+    job = RkRgaJob{};
+    job.crop_x = 1;
+    job.crop_width = 2;
+    job.crop_height = 2;
+    job.rotation = 90;
+    UNIT_CHECK(cpu_job_matches(src, 2, 2, &job, COORD(1, 1), COORD(1, 0)));
+
+    // 缩小一半：最近邻取像素中心
+    job = RkRgaJob{};
+    UNIT_CHECK(cpu_job_matches(src, 2, 1, &job, COORD(1, 1), COORD(3, 1)));
+
+    job.rotation = 45;
+    UNIT_CHECK(!cpu_job_matches(src, 4, 2, &job, 0, 0));
+    job.rotation = 0;
+    job.crop_x = 3;
+    job.crop_width = 2;
+    job.crop_height = 2;
+    UNIT_CHECK(!cpu_job_matches(src, 2, 2, &job, 0, 0));
+    rk_dmabuf_free(src);
+
+    // RGBA -> NV12：纯红 (JFIF 全范围 Y=77, Cb=85, Cr=255)，奇数宽度
+    src = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 3, 3, RK_FORMAT_RGBA8888);
+    RkDmaBuffer* nv12 = rk_dmabuf_alloc_aligned(rk_dmabuf_memfd_allocator(), 3, 3,
+                                                RK_FORMAT_YUV420SP, 16, 16);
+    UNIT_CHECK(src && nv12);
+    if (src && nv12) {
+        uint32_t* p = (uint32_t*)rk_dmabuf_begin_cpu_access(src, RK_DMABUF_CPU_WRITE, 0, src->size);
+        for (int i = 0; p && i < src->stride * 3; i++) p[i] = 0xff0000ffu;
+        rk_dmabuf_end_cpu_access(src, RK_DMABUF_CPU_WRITE, 0, src->size);
+
+        job = RkRgaJob{};
+        UNIT_CHECK(rk_cpu_process_job(src, nv12, &job) == RKSS_SUCCESS);
+        uint8_t* y = (uint8_t*)rk_dmabuf_begin_cpu_access(nv12, RK_DMABUF_CPU_READ, 0, nv12->size);
+        if (y) {
+            uint8_t* uv = y + (size_t)nv12->stride * nv12->height_stride;
+            UNIT_CHECK(y[0] == 77 && y[2 * nv12->stride + 2] == 77);
+            UNIT_CHECK(uv[0] == 85 && uv[1] == 255);
+            UNIT_CHECK(uv[nv12->stride + 2] == 85 && uv[nv12->stride + 3] == 255);
+        }
+        rk_dmabuf_end_cpu_access(nv12, RK_DMABUF_CPU_READ, 0, nv12->size);
+    }
+    rk_dmabuf_free(nv12);
+
+    // I420 / 24 位 RGB 打包：奇数尺寸，检查平面位置与字节序
+    UNIT_CHECK(rk_format_packed_size(RK_FORMAT_YUV420P, 3, 3) == 9 + 2 * 2 * 2);
+    UNIT_CHECK(rk_format_packed_size(RK_FORMAT_BGR888, 3, 3) == 27);
+    RkDmaBuffer* i420 = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 3, 3,
+                                             RK_FORMAT_YUV420P);
+    RkDmaBuffer* bgr = rk_dmabuf_alloc_aligned(rk_dmabuf_memfd_allocator(), 37, 3,
+                                               RK_FORMAT_BGR888, 4, 1);
+    UNIT_CHECK(i420 && bgr);
+    if (src && i420 && bgr) {
+        job = RkRgaJob{};
+        UNIT_CHECK(rk_cpu_process_job(src, i420, &job) == RKSS_SUCCESS);
+        uint8_t* y = (uint8_t*)rk_dmabuf_begin_cpu_access(i420, RK_DMABUF_CPU_READ, 0, i420->size);
+        if (y) {
+            uint8_t* u = y + (size_t)i420->stride * i420->height_stride;
+            uint8_t* v = u + (size_t)(i420->stride / 2) * (i420->height_stride / 2);
+            UNIT_CHECK(y[0] == 77 && u[0] == 85 && v[0] == 255);
+            UNIT_CHECK(u[i420->stride / 2 + 1] == 85 && v[i420->stride / 2 + 1] == 255);
+        }
+        rk_dmabuf_end_cpu_access(i420, RK_DMABUF_CPU_READ, 0, i420->size);
+
+        // 放大到 37 像素宽，覆盖向量化主循环与尾部
+        UNIT_CHECK(rk_cpu_process_job(src, bgr, &job) == RKSS_SUCCESS);
+        UNIT_CHECK(bgr->stride == 40);
+        uint8_t* p = (uint8_t*)rk_dmabuf_begin_cpu_access(bgr, RK_DMABUF_CPU_READ, 0, bgr->size);
+        if (p) {
+            uint8_t* last = p + (size_t)2 * bgr->stride * 3 + 36 * 3;
+            UNIT_CHECK(p[0] == 0 && p[1] == 0 && p[2] == 255);
+            UNIT_CHECK(last[0] == 0 && last[1] == 0 && last[2] == 255);
+        }
+        rk_dmabuf_end_cpu_access(bgr, RK_DMABUF_CPU_READ, 0, bgr->size);
+    }
+    rk_dmabuf_free(bgr);
+    rk_dmabuf_free(i420);
+    rk_dmabuf_free(src);
+
+    // 参考耗时：1080p 裁剪 + 旋转 90 + 缩放到 720x1280
+    src = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 1920, 1080, RK_FORMAT_RGBA8888);
+    RkDmaBuffer* dst = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 720, 1280,
+                                            RK_FORMAT_RGBA8888);
+    if (src && dst) {
+        job = RkRgaJob{};
+        job.crop_x = 240;
+        job.crop_width = 1440;
+        job.crop_height = 1080;
+        job.rotation = 90;
+        uint64_t t0 = get_time_us();
+        UNIT_CHECK(rk_cpu_process_job(src, dst, &job) == RKSS_SUCCESS);
+        printf("   ⏱️  CPU 1440x1080 -> 720x1280 (rot 90): %.2f ms\n",
+               (get_time_us() - t0) / 1000.0);
+    }
+    rk_dmabuf_free(dst);
+    rk_dmabuf_free(src);
+}
+
+static void count_task(void* arg, int index) {
+    __atomic_add_fetch((int*)arg, index + 1, __ATOMIC_RELAXED);
+}
+
+static bool same_rgba(RkDmaBuffer* a, RkDmaBuffer* b) {
+    for (int y = 0; y < a->height; y++) {
+        for (int x = 0; x < a->width; x++) {
+            if (read_pixel(a, x, y) != read_pixel(b, x, y)) return false;
+        }
+    }
+    return true;
+}
+
+// 每像素 R = x * step, G = y * step
+static RkDmaBuffer* make_ramp_buffer(int w, int h, int step) {
+    RkDmaBuffer* buf = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), w, h, RK_FORMAT_RGBA8888);
+    if (!buf) return NULL;
+    uint32_t* p = (uint32_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    for (int y = 0; p && y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            p[(size_t)y * buf->stride + x] = 0xff000000u | (uint32_t)(y * step) << 8 | x * step;
+        }
+    }
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    return buf;
+}
+
+#define RAMP(r, g) (0xff000000u | (uint32_t)(g) << 8 | (r))
+
+static RkScreenshotError fail_submit_batch(RkRgaExecutor* exec, RkDmaBuffer* src,
+                                           RkDmaBuffer* const* dsts, const RkRgaJob* jobs,
+                                           int count, int acquire_fence, int* release_fence) {
+    *release_fence = -1;
+    return RKSS_ERROR_RGA_FAILED;
+}
+
+static RkScreenshotError fail_submit(RkRgaExecutor* exec, RkDmaBuffer* src, RkDmaBuffer* dst,
+                                     const RkRgaJob* job, int acquire_fence, int* release_fence) {
+    return fail_submit_batch(exec, src, &dst, job, 1, acquire_fence, release_fence);
+}
+
+static void fail_destroy(RkRgaExecutor* exec) {
+    free(exec);
+}
+
+static void test_cpu_backend() {
+    printf("\n🧩 CPU backend (SIMD scaler + thread pool)\n");
+
+    RkThreadPool* pool = rk_thread_pool_create(4);
+    UNIT_CHECK(pool != NULL && rk_thread_pool_size(pool) == 4);
+    int sum = 0;
+    rk_thread_pool_run(pool, 100, count_task, &sum);
+    UNIT_CHECK(sum == 5050);
+    sum = 0;
+    rk_thread_pool_run(NULL, 10, count_task, &sum);
+    UNIT_CHECK(sum == 55 && rk_thread_pool_size(NULL) == 1);
+
+    // 1:1 旋转/镜像（RGBA 整行搬运 / 4x4 转置）与最近邻参考逐像素一致；奇数尺寸覆盖尾部
+    RkDmaBuffer* src = make_coord_buffer(37, 23);
+    RkDmaBuffer* ref = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 37, 37,
+                                            RK_FORMAT_RGBA8888);
+    RkDmaBuffer* out = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 37, 37,
+                                            RK_FORMAT_RGBA8888);
+    UNIT_CHECK(src && ref && out);
+    if (src && ref && out) {
+        static const int rotations[4] = {0, 90, 180, 270};
+        for (int i = 0; i < 16; i++) {
+            RkRgaJob job = {};
+            job.rotation = rotations[i % 4];
+            job.flip_horizontal = (i / 4) & 1;
+            job.flip_vertical = (i / 8) & 1;
+            bool transpose = job.rotation == 90 || job.rotation == 270;
+            // 同尺寸的 dst 视图：宽高取旋转后尺寸
+            ref->width = out->width = transpose ? 23 : 37;
+            ref->height = out->height = transpose ? 37 : 23;
+            UNIT_CHECK(rk_cpu_process_job(src, ref, &job) == RKSS_SUCCESS);
+            UNIT_CHECK(rk_cpu_process_job_ex(src, out, &job, RK_CPU_FILTER_BILINEAR, pool) ==
+                       RKSS_SUCCESS);
+            UNIT_CHECK(same_rgba(ref, out));
+        }
+
+        // 最近邻缩放 + 旋转：线程池分条带后与单线程参考一致
+        RkRgaJob job = {};
+        job.crop_x = 3;
+        job.crop_width = 30;
+        job.crop_height = 20;
+        job.rotation = 270;
+        ref->width = out->width = 17;
+        ref->height = out->height = 29;
+        UNIT_CHECK(rk_cpu_process_job(src, ref, &job) == RKSS_SUCCESS);
+        UNIT_CHECK(rk_cpu_process_job_ex(src, out, &job, RK_CPU_FILTER_NEAREST, pool) ==
+                   RKSS_SUCCESS);
+        UNIT_CHECK(same_rgba(ref, out));
+        ref->width = out->width = 37;
+        ref->height = out->height = 37;
+    }
+    rk_dmabuf_free(out);
+    rk_dmabuf_free(ref);
+    rk_dmabuf_free(src);
+
+    // 双线性放大：像素中心对齐，两端钳位
+    src = make_ramp_buffer(2, 1, 128);
+    out = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 4, 1, RK_FORMAT_RGBA8888);
+    UNIT_CHECK(src && out);
+    if (src && out) {
+        RkRgaJob job = {};
+        UNIT_CHECK(rk_cpu_process_job_ex(src, out, &job, RK_CPU_FILTER_BILINEAR, NULL) ==
+                   RKSS_SUCCESS);
+        UNIT_CHECK(read_pixel(out, 0, 0) == RAMP(0, 0) && read_pixel(out, 1, 0) == RAMP(32, 0));
+        UNIT_CHECK(read_pixel(out, 2, 0) == RAMP(96, 0) && read_pixel(out, 3, 0) == RAMP(128, 0));
+    }
+    rk_dmabuf_free(out);
+    rk_dmabuf_free(src);
+
+    // 4x4 -> 2x2：双线性与盒式都等于 2x2 平均；旋转在缩放之后
+    src = make_ramp_buffer(4, 4, 64);
+    out = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 2, 2, RK_FORMAT_RGBA8888);
+    UNIT_CHECK(src && out);
+    if (src && out) {
+        RkRgaJob job = {};
+        UNIT_CHECK(rk_cpu_process_job_ex(src, out, &job, RK_CPU_FILTER_BILINEAR, pool) ==
+                   RKSS_SUCCESS);
+        UNIT_CHECK(read_pixel(out, 0, 0) == RAMP(32, 32) && read_pixel(out, 1, 1) == RAMP(160, 160));
+        UNIT_CHECK(rk_cpu_process_job_ex(src, out, &job, RK_CPU_FILTER_BOX, pool) ==
+                   RKSS_SUCCESS);
+        UNIT_CHECK(read_pixel(out, 1, 0) == RAMP(160, 32) && read_pixel(out, 0, 1) == RAMP(32, 160));
+        job.rotation = 90;
+        UNIT_CHECK(rk_cpu_process_job_ex(src, out, &job, RK_CPU_FILTER_AUTO, pool) ==
+                   RKSS_SUCCESS);
+        UNIT_CHECK(read_pixel(out, 0, 0) == RAMP(32, 160) && read_pixel(out, 1, 0) == RAMP(32, 32));
+    }
+    rk_dmabuf_free(out);
+    rk_dmabuf_free(src);
+
+    // 盒式缩小到 NV12：纯红保持 Y=77, Cb=85, Cr=255
+    src = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 64, 64, RK_FORMAT_RGBA8888);
+    RkDmaBuffer* nv12 = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 30, 30,
+                                             RK_FORMAT_YUV420SP);
+    UNIT_CHECK(src && nv12);
+    if (src && nv12) {
+        uint32_t* p = (uint32_t*)rk_dmabuf_begin_cpu_access(src, RK_DMABUF_CPU_WRITE, 0, src->size);
+        for (int i = 0; p && i < src->stride * 64; i++) p[i] = 0xff0000ffu;
+        rk_dmabuf_end_cpu_access(src, RK_DMABUF_CPU_WRITE, 0, src->size);
+
+        RkRgaJob job = {};
+        job.rotation = 180;
+        UNIT_CHECK(rk_cpu_process_job_ex(src, nv12, &job, RK_CPU_FILTER_BOX, pool) ==
+                   RKSS_SUCCESS);
+        uint8_t* y = (uint8_t*)rk_dmabuf_begin_cpu_access(nv12, RK_DMABUF_CPU_READ, 0, nv12->size);
+        if (y) {
+            uint8_t* uv = y + (size_t)nv12->stride * nv12->height_stride;
+            UNIT_CHECK(y[0] == 77 && y[29 * nv12->stride + 29] == 77);
+            UNIT_CHECK(uv[0] == 85 && uv[1] == 255);
+        }
+        rk_dmabuf_end_cpu_access(nv12, RK_DMABUF_CPU_READ, 0, nv12->size);
+    }
+    rk_dmabuf_free(nv12);
+    rk_dmabuf_free(src);
+
+    // CPU 执行器同步完成（无 fence）；混合执行器：小作业走 CPU，大作业走 RGA，RGA 失败退回 CPU
+    RkRgaExecutor* cpu = rk_rga_executor_create_cpu(2, RK_CPU_FILTER_AUTO);
+    UNIT_CHECK(cpu != NULL);
+    src = make_coord_buffer(640, 480);
+    RkDmaBuffer* big = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 640, 480,
+                                            RK_FORMAT_RGBA8888);
+    RkDmaBuffer* tiny = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 64, 48,
+                                             RK_FORMAT_RGBA8888);
+    UNIT_CHECK(src && big && tiny);
+    if (cpu && src && big && tiny) {
+        RkRgaJob job = {};
+        job.rotation = 180;
+        int fence = 0;
+        UNIT_CHECK(cpu->submit(cpu, src, big, &job, -1, &fence) == RKSS_SUCCESS);
+        UNIT_CHECK(fence == -1 && read_pixel(big, 0, 0) == COORD(639, 479));
+
+        RkRgaJobDesc desc;
+        rk_rga_job_describe(src, tiny, &job, &desc);
+        UNIT_CHECK(!rk_cpu_job_is_tiny(&desc));     // 源区域 640x480 不算小作业
+        job.crop_width = 320;
+        job.crop_height = 240;
+        rk_rga_job_describe(src, tiny, &job, &desc);
+        UNIT_CHECK(rk_cpu_job_is_tiny(&desc));
+
+        RkRgaExecutor* hybrid = rk_rga_executor_create_hybrid(
+            rk_rga_executor_create_emulated(1000, 2), cpu);
+        cpu = NULL;     // 由混合执行器接管
+        UNIT_CHECK(hybrid != NULL);
+        if (hybrid) {
+            UNIT_CHECK(hybrid->submit(hybrid, src, tiny, &job, -1, &fence) == RKSS_SUCCESS);
+            UNIT_CHECK(fence == -1 && read_pixel(tiny, 0, 0) == COORD(317, 237));
+            job = RkRgaJob{};
+            UNIT_CHECK(hybrid->submit(hybrid, src, big, &job, -1, &fence) == RKSS_SUCCESS);
+            UNIT_CHECK(fence >= 0 && rk_fence_wait(fence, 1000) == RKSS_SUCCESS);
+            UNIT_CHECK(read_pixel(big, 0, 0) == COORD(0, 0));
+            rk_fence_close(fence);
+            rk_rga_executor_destroy(hybrid);
+        }
+
+        RkRgaExecutor* failing = (RkRgaExecutor*)calloc(1, sizeof(RkRgaExecutor));
+        failing->name = "failing";
+        failing->submit = fail_submit;
+        failing->submit_batch = fail_submit_batch;
+        failing->destroy = fail_destroy;
+        hybrid = rk_rga_executor_create_hybrid(failing, rk_rga_executor_create_cpu(1,
+                                                                  RK_CPU_FILTER_AUTO));
+        UNIT_CHECK(hybrid != NULL);
+        if (hybrid) {
+            RkDmaBuffer* outs[2] = {big, tiny};
+            RkRgaJob jobs[2] = {};
+            jobs[0].flip_vertical = true;
+            UNIT_CHECK(hybrid->submit_batch(hybrid, src, outs, jobs, 2, -1, &fence) ==
+                       RKSS_SUCCESS);
+            UNIT_CHECK(fence == -1 && read_pixel(big, 0, 0) == COORD(0, 479));
+            rk_rga_executor_destroy(hybrid);
+        }
+    }
+    rk_rga_executor_destroy(cpu);
+    rk_dmabuf_free(tiny);
+    rk_dmabuf_free(big);
+    rk_dmabuf_free(src);
+
+    // 参考耗时：1080p 裁剪 + 旋转 90 + 缩放到 720x1280，各滤波器单线程 / 线程池
+    src = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 1920, 1080, RK_FORMAT_RGBA8888);
+    RkDmaBuffer* dst = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 720, 1280,
+                                            RK_FORMAT_RGBA8888);
+    if (src && dst && pool) {
+        RkRgaJob job = {};
+        job.crop_x = 240;
+        job.crop_width = 1440;
+        job.crop_height = 1080;
+        job.rotation = 90;
+        static const struct { RkCpuFilter filter; const char* name; } filters[] = {
+            {RK_CPU_FILTER_NEAREST, "nearest"},
+            {RK_CPU_FILTER_BILINEAR, "bilinear"},
+            {RK_CPU_FILTER_BOX, "box"},
+        };
+        for (const auto& f : filters) {
+            uint64_t t0 = get_time_us();
+            UNIT_CHECK(rk_cpu_process_job_ex(src, dst, &job, f.filter, NULL) == RKSS_SUCCESS);
+            uint64_t t1 = get_time_us();
+            UNIT_CHECK(rk_cpu_process_job_ex(src, dst, &job, f.filter, pool) == RKSS_SUCCESS);
+            printf("   ⏱️  CPU %-8s 1440x1080 -> 720x1280 (rot 90): %.2f ms, %d threads %.2f ms\n",
+                   f.name, (t1 - t0) / 1000.0, rk_thread_pool_size(pool),
+                   (get_time_us() - t1) / 1000.0);
+        }
+        job = RkRgaJob{};
+        ref = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 1080, 1920, RK_FORMAT_RGBA8888);
+        job.rotation = 270;
+        if (ref) {
+            uint64_t t0 = get_time_us();
+            UNIT_CHECK(rk_cpu_process_job_ex(src, ref, &job, RK_CPU_FILTER_AUTO, pool) ==
+                       RKSS_SUCCESS);
+            printf("   ⏱️  CPU 1920x1080 rotate 270 (4x4 transpose): %.2f ms\n",
+                   (get_time_us() - t0) / 1000.0);
+        }
+        rk_dmabuf_free(ref);
+    }
+    rk_dmabuf_free(dst);
+    rk_dmabuf_free(src);
+    rk_thread_pool_destroy(pool);
+}
+
+static void test_rga_executor() {
+    printf("\n🧩 Async RGA executor (CPU emulated)\n");
+
+    UNIT_CHECK(rk_fence_wait(-1, 0) == RKSS_SUCCESS);
+
+    // 20 ms/作业，队列深度 2：提交不等待执行，作业按 FIFO 串行
+    const int latency_us = 20000;
+    RkRgaExecutor* exec = rk_rga_executor_create_emulated(latency_us, 2);
+    UNIT_CHECK(exec != NULL);
+    if (!exec) return;
+
+    RkDmaBuffer* src = make_coord_buffer(64, 64);
+    RkDmaBuffer* dst[4] = {};
+    int fence[4] = {-1, -1, -1, -1};
+    RkRgaJob job = {};
+    uint64_t t0 = get_time_us();
+    for (int i = 0; i < 4; i++) {
+        dst[i] = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 32, 32, RK_FORMAT_RGBA8888);
+        UNIT_CHECK(src && dst[i]);
+        if (!src || !dst[i]) break;
+        UNIT_CHECK(exec->submit(exec, src, dst[i], &job, -1, &fence[i]) == RKSS_SUCCESS);
+    }
+    uint64_t submit_us = get_time_us() - t0;
+    // 深度 2：第 3、4 个提交各等一个作业完成（不看墙钟，看 fence 状态）；
+    // 最后一个作业还排在两个 latency_us 之后，40 ms 的余量足以在其完成前检查
+    UNIT_CHECK(rk_fence_wait(fence[0], 0) == RKSS_SUCCESS);
+    UNIT_CHECK(rk_fence_wait(fence[1], 0) == RKSS_SUCCESS);
+    UNIT_CHECK(rk_fence_wait(fence[3], 0) == RKSS_ERROR_TIMEOUT);
+    UNIT_CHECK(rk_fence_wait(fence[3], -1) == RKSS_SUCCESS);
+    for (int i = 0; i < 3; i++) {
+        UNIT_CHECK(rk_fence_wait(fence[i], 0) == RKSS_SUCCESS);   // FIFO：前面的已完成
+    }
+    printf("   ⏱️  4 jobs: submit %.2f ms, complete %.2f ms\n",
+           submit_us / 1000.0, (get_time_us() - t0) / 1000.0);
+    for (int i = 0; i < 4; i++) {
+        UNIT_CHECK(dst[i] && read_pixel(dst[i], 31, 31) == COORD(63, 63));
+        rk_fence_close(fence[i]);
+    }
+
+    // 级联：第二个作业以第一个的 fence 为 acquire，先缩放再旋转
+    if (dst[0] && dst[1]) {
+        int f1 = -1, f2 = -1;
+        job.rotation = 0;
+        UNIT_CHECK(exec->submit(exec, src, dst[0], &job, -1, &f1) == RKSS_SUCCESS);
+        job.rotation = 180;
+        UNIT_CHECK(exec->submit(exec, dst[0], dst[1], &job, f1, &f2) == RKSS_SUCCESS);
+        rk_fence_close(f1);     // acquire fence 所有权不转移
+        UNIT_CHECK(rk_fence_wait(f2, 1000) == RKSS_SUCCESS);
+        UNIT_CHECK(read_pixel(dst[1], 0, 0) == COORD(63, 63));
+        rk_fence_close(f2);
+    }
+
+    // 批量：同一源三个输出，一个 fence
+    if (dst[0] && dst[1] && dst[2]) {
+        RkDmaBuffer* outs[3] = {dst[0], dst[1], dst[2]};
+        RkRgaJob jobs[3] = {};
+        jobs[1].rotation = 180;
+        jobs[2].flip_horizontal = true;
+        int f = -1;
+        UNIT_CHECK(exec->submit_batch(exec, src, outs, jobs, 3, -1, &f) == RKSS_SUCCESS);
+        UNIT_CHECK(rk_fence_wait(f, 1000) == RKSS_SUCCESS);
+        UNIT_CHECK(read_pixel(dst[0], 0, 0) == COORD(1, 1));
+        UNIT_CHECK(read_pixel(dst[1], 0, 0) == COORD(63, 63));
+        UNIT_CHECK(read_pixel(dst[2], 0, 0) == COORD(63, 1));
+        rk_fence_close(f);
+    }
+
+    // 异步失败经 fence 报告：上一阶段以错误结束（pipe 无数据挂断），本作业及其级联都失败
+    int upstream[2] = {-1, -1};
+    if (dst[0] && dst[1] && pipe(upstream) == 0) {
+        int f1 = -1, f2 = -1;
+        job.rotation = 0;
+        UNIT_CHECK(exec->submit(exec, src, dst[0], &job, upstream[0], &f1) == RKSS_SUCCESS);
+        UNIT_CHECK(exec->submit(exec, dst[0], dst[1], &job, f1, &f2) == RKSS_SUCCESS);
+        close(upstream[0]);
+        close(upstream[1]);
+        UNIT_CHECK(rk_fence_wait(f1, 1000) == RKSS_ERROR_RGA_FAILED);
+        UNIT_CHECK(rk_fence_wait(f2, 1000) == RKSS_ERROR_RGA_FAILED);
+        UNIT_CHECK(rk_fence_wait(f1, 0) == RKSS_ERROR_RGA_FAILED);   // 状态不被 wait 消耗
+        rk_fence_close(f1);
+        rk_fence_close(f2);
+    }
+
+    // 参数错误同步返回，不产生 fence
+    int bad = -1;
+    job.rotation = 45;
+    UNIT_CHECK(exec->submit(exec, src, dst[0], &job, -1, &bad) == RKSS_ERROR_INVALID_PARAM);
+    UNIT_CHECK(bad == -1);
+
+    rk_rga_executor_destroy(exec);
+    for (int i = 0; i < 4; i++) rk_dmabuf_free(dst[i]);
+    rk_dmabuf_free(src);
+}
+
+static void test_rga_scheduler() {
+    printf("\n🧩 Multi-core RGA scheduler\n");
+
+    const uint32_t all = (1u << RK_RGA_CORE_COUNT) - 1;
+    uint64_t idle[RK_RGA_CORE_COUNT] = {};
+
+    // 大图缩放走 RGA3，两核轮流
+    RkRgaJobDesc big = {1920, 1080, 1280, 720, RK_FORMAT_RGBA8888, 0};
+    UNIT_CHECK(rk_rga_sched_pick(&big, idle, all) == RK_RGA_CORE_RGA3_0);
+    uint64_t busy0[RK_RGA_CORE_COUNT] = {rk_rga_core_cost_us(RK_RGA_CORE_RGA3_0, &big), 0, 0};
+    UNIT_CHECK(rk_rga_sched_pick(&big, busy0, all) == RK_RGA_CORE_RGA3_1);
+
+    // 小作业启动开销占主导，走 RGA2
+    RkRgaJobDesc small = {160, 120, 80, 60, RK_FORMAT_RGBA8888, 0};
+    UNIT_CHECK(rk_rga_sched_pick(&small, idle, all) == RK_RGA_CORE_RGA2);
+
+    // 能力限制：I420 与超 8 倍缩小只有 RGA2，输出超 4096 只有 RGA3
+    RkRgaJobDesc i420 = big;
+    i420.dst_format = RK_FORMAT_YUV420P;
+    UNIT_CHECK(rk_rga_sched_pick(&i420, idle, all) == RK_RGA_CORE_RGA2);
+    UNIT_CHECK(rk_rga_sched_pick(&i420, idle, all & ~(1u << RK_RGA_CORE_RGA2)) == -1);
+    RkRgaJobDesc thumb = {3840, 2160, 320, 180, RK_FORMAT_RGBA8888, 0};
+    UNIT_CHECK(rk_rga_sched_pick(&thumb, idle, all) == RK_RGA_CORE_RGA2);
+    RkRgaJobDesc wide = {3840, 1080, 7680, 2160, RK_FORMAT_RGBA8888, 0};
+    UNIT_CHECK(!rk_rga_core_supports(RK_RGA_CORE_RGA2, &wide));
+    UNIT_CHECK(rk_rga_sched_pick(&wide, idle, all) == RK_RGA_CORE_RGA3_0);
+
+    // 批量整体放在同时支持全部作业的核心上
+    RkRgaJobDesc preview = {1920, 1080, 320, 180, RK_FORMAT_YUV420SP, 0};
+    RkRgaJobDesc fanout[3] = {big, preview, i420};
+    UNIT_CHECK(rk_rga_sched_pick_batch(fanout, 2, idle, all) == RK_RGA_CORE_RGA3_0);
+    UNIT_CHECK(rk_rga_sched_pick_batch(fanout, 3, idle, all) == RK_RGA_CORE_RGA2);
+    RkRgaJobDesc no_core[2] = {i420, wide};
+    UNIT_CHECK(rk_rga_sched_pick_batch(no_core, 2, idle, all) == -1);
+
+    // RGA2 只能访问 4G 以下：地址未知的 buffer 不选它
+    RkRgaJobDesc icon = {320, 240, 160, 120, RK_FORMAT_RGBA8888, 0};
+    UNIT_CHECK(rk_rga_sched_pick(&icon, idle, all) == RK_RGA_CORE_RGA2);
+    icon.high_mem = true;
+    UNIT_CHECK(rk_rga_sched_pick(&icon, idle, all) == RK_RGA_CORE_RGA3_0);
+    RkRgaJobDesc i420_high = i420;
+    i420_high.high_mem = true;
+    UNIT_CHECK(rk_rga_sched_pick(&i420_high, idle, all) == -1);
+    RkDmaBuffer low = {};
+    low.width = low.height = low.stride = low.height_stride = 1920;
+    low.format = RK_FORMAT_RGBA8888;
+    low.dma32 = true;
+    RkDmaBuffer gralloc = low;
+    gralloc.dma32 = false;
+    RkRgaJob plain = {};
+    RkRgaJobDesc d;
+    rk_rga_job_describe(&low, &low, &plain, &d);
+    UNIT_CHECK(!d.high_mem);
+    rk_rga_job_describe(&gralloc, &low, &plain, &d);
+    UNIT_CHECK(d.high_mem);
+    UNIT_CHECK(rk_dmabuf_memfd_allocator()->dma32 && rk_dmabuf_dma32_allocator()->dma32 &&
+               !rk_dmabuf_heap_allocator()->dma32);
+
+    // 旋转：缩放比按旋转后的方向计算
+    RkRgaJobDesc rot = {1920, 1080, 1080, 1920, RK_FORMAT_RGBA8888, 90};
+    UNIT_CHECK(rk_rga_core_supports(RK_RGA_CORE_RGA3_0, &rot));
+    UNIT_CHECK(rk_rga_core_cost_us(RK_RGA_CORE_RGA3_0, &rot) >
+               rk_rga_core_cost_us(RK_RGA_CORE_RGA3_0, &big));
+
+    // 模拟三核（每作业 4 ms）：负载分到所有核心
+    const int latency_us = 4000;
+    const int jobs = 9;
+    RkRgaExecutor* cores[RK_RGA_CORE_COUNT];
+    for (int i = 0; i < RK_RGA_CORE_COUNT; i++) {
+        cores[i] = rk_rga_executor_create_emulated(latency_us, 4);
+    }
+    RkRgaExecutor* sched = rk_rga_executor_create_scheduler(cores);
+    UNIT_CHECK(sched != NULL);
+    if (!sched) {
+        for (int i = 0; i < RK_RGA_CORE_COUNT; i++) rk_rga_executor_destroy(cores[i]);
+        return;
+    }
+
+    RkDmaBuffer* src = make_coord_buffer(640, 480);
+    RkDmaBuffer* dst[jobs] = {};
+    int fence[jobs];
+    RkRgaJob job = {};
+    uint64_t t0 = get_time_us();
+    for (int i = 0; i < jobs; i++) {
+        fence[i] = -1;
+        dst[i] = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 320, 240, RK_FORMAT_RGBA8888);
+        UNIT_CHECK(src && dst[i]);
+        if (!src || !dst[i]) break;
+        UNIT_CHECK(sched->submit(sched, src, dst[i], &job, -1, &fence[i]) == RKSS_SUCCESS);
+    }
+    for (int i = 0; i < jobs; i++) {
+        UNIT_CHECK(rk_fence_wait(fence[i], 1000) == RKSS_SUCCESS);
+        rk_fence_close(fence[i]);
+    }
+    uint64_t total_us = get_time_us() - t0;
+    // 墙钟只在多核主机上校验（ASan / 单核时 CPU 模拟本身就超过 latency_us）
+    if (sysconf(_SC_NPROCESSORS_ONLN) >= 3) UNIT_CHECK(total_us < (uint64_t)jobs * latency_us);
+    UNIT_CHECK(dst[jobs - 1] && read_pixel(dst[jobs - 1], 319, 239) == COORD(639, 479));
+
+    // 回收线程异步统计，稍等其收完 fence
+    RkRgaCoreStats stats[RK_RGA_CORE_COUNT];
+    uint64_t elapsed_us = 0;
+    for (int tries = 0; tries < 100; tries++) {
+        rk_rga_scheduler_get_stats(sched, stats, &elapsed_us);
+        int queued = 0;
+        for (int i = 0; i < RK_RGA_CORE_COUNT; i++) queued += stats[i].queued;
+        if (queued == 0) break;
+        usleep(1000);
+    }
+    // 空闲时调度器总选同一个最便宜的核心：每个核心都分到作业、且有核心同时在途多个作业，
+    // 说明提交没有等待执行，作业在各核心的队列里并发
+    uint64_t dispatched = 0;
+    int max_queued = 0;
+    for (int i = 0; i < RK_RGA_CORE_COUNT; i++) {
+        UNIT_CHECK(stats[i].jobs > 0 && stats[i].queued == 0 && stats[i].pending_us == 0);
+        UNIT_CHECK(stats[i].busy_us >= (uint64_t)latency_us);
+        dispatched += stats[i].jobs;
+        if (stats[i].max_queued > max_queued) max_queued = stats[i].max_queued;
+        printf("   core %d: %lu jobs, busy %.0f%%, max queue %d\n", i, stats[i].jobs,
+               elapsed_us ? stats[i].busy_us * 100.0 / elapsed_us : 0.0, stats[i].max_queued);
+    }
+    UNIT_CHECK(dispatched == (uint64_t)jobs && max_queued >= 2);
+    printf("   ⏱️  %d jobs on 3 cores: %.2f ms (serial %.2f ms)\n",
+           jobs, total_us / 1000.0, jobs * latency_us / 1000.0);
+
+    UNIT_CHECK(rk_rga_scheduler_get_stats(NULL, stats, NULL) == RKSS_ERROR_INVALID_PARAM);
+    rk_rga_executor_destroy(sched);
+    for (int i = 0; i < jobs; i++) rk_dmabuf_free(dst[i]);
+    rk_dmabuf_free(src);
+}
+
+// 平滑渐变（相邻像素差 < 1），用于比较不同滤波路径的接缝误差
+static RkDmaBuffer* make_gradient_buffer(int w, int h) {
+    RkDmaBuffer* buf = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), w, h, RK_FORMAT_RGBA8888);
+    if (!buf) return NULL;
+    uint32_t* p = (uint32_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    for (int y = 0; p && y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint32_t r = (uint32_t)x * 255 / (w - 1), g = (uint32_t)y * 255 / (h - 1);
+            p[(size_t)y * buf->stride + x] = 0xff000000u | g << 8 | r;
+        }
+    }
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    return buf;
+}
+
+// 两个同布局 buffer 的最大字节差
+static int max_byte_diff(RkDmaBuffer* a, RkDmaBuffer* b) {
+    uint8_t* pa = (uint8_t*)rk_dmabuf_begin_cpu_access(a, RK_DMABUF_CPU_READ, 0, a->size);
+    uint8_t* pb = (uint8_t*)rk_dmabuf_begin_cpu_access(b, RK_DMABUF_CPU_READ, 0, b->size);
+    int diff = pa && pb && a->size == b->size ? 0 : 256;
+    for (size_t i = 0; diff < 256 && i < a->size; i++) {
+        int d = pa[i] > pb[i] ? pa[i] - pb[i] : pb[i] - pa[i];
+        if (d > diff) diff = d;
+    }
+    rk_dmabuf_end_cpu_access(b, RK_DMABUF_CPU_READ, 0, b->size);
+    rk_dmabuf_end_cpu_access(a, RK_DMABUF_CPU_READ, 0, a->size);
+    return diff;
+}
+
+static void clear_buffer(RkDmaBuffer* buf) {
+    void* p = rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    if (p) memset(p, 0, buf->size);
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+}
+
+// 按块逐个执行，返回是否全部成功
+static bool run_tiles(RkDmaBuffer* src, RkDmaBuffer* dst, const RkRgaJob* tiles, int count,
+                      RkCpuFilter filter) {
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        ok = ok && rk_cpu_process_job_ex(src, dst, &tiles[i], filter, NULL) == RKSS_SUCCESS;
+    }
+    return ok;
+}
+
+static void test_rga_tiling() {
+    printf("\n🧩 RGA tiling (beyond single-pass limits)\n");
+
+    const uint32_t rga2 = 1u << RK_RGA_CORE_RGA2;
+    const uint32_t rga3 = (1u << RK_RGA_CORE_RGA3_0) | (1u << RK_RGA_CORE_RGA3_1);
+    RkRgaJob tiles[RK_RGA_TILE_MAX];
+
+    // 4200 宽输出：RGA3 单次完成，RGA2（输出 <= 4096）切两块
+    RkDmaBuffer* src = make_coord_buffer(4200, 72);
+    RkDmaBuffer* ref = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 4200, 72,
+                                            RK_FORMAT_RGBA8888);
+    RkDmaBuffer* out = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 4200, 72,
+                                            RK_FORMAT_RGBA8888);
+    UNIT_CHECK(src && ref && out);
+    if (src && ref && out) {
+        RkRgaJob job = {};
+        UNIT_CHECK(rk_rga_job_split(src, out, &job, rga3, tiles) == 1);
+        int n = rk_rga_job_split(src, out, &job, rga2, tiles);
+        UNIT_CHECK(n == 2);
+        UNIT_CHECK(n == 2 && tiles[0].dst_width + tiles[1].dst_width == 4200 &&
+                   tiles[1].dst_x == tiles[0].dst_width && tiles[1].crop_x == tiles[1].dst_x);
+        UNIT_CHECK(rk_rga_job_split(src, out, &job, 0, tiles) == 2);    // 未知核心按 RGA2
+
+        // 所有旋转/镜像：逐块最近邻结果与单次参考逐像素一致
+        for (int i = 0; i < 8; i++) {
+            job = RkRgaJob{};
+            job.rotation = (i % 4) * 90;
+            job.flip_horizontal = i >= 4;
+            job.flip_vertical = i == 5;
+            bool transpose = job.rotation == 90 || job.rotation == 270;
+            ref->width = out->width = transpose ? 72 : 4200;
+            ref->height = out->height = transpose ? 4200 : 72;
+            ref->stride = out->stride = ref->width;
+            n = rk_rga_job_split(src, out, &job, rga2, tiles);
+            UNIT_CHECK(n >= 2);
+            clear_buffer(out);
+            UNIT_CHECK(rk_cpu_process_job(src, ref, &job) == RKSS_SUCCESS);
+            UNIT_CHECK(run_tiles(src, out, tiles, n, RK_CPU_FILTER_NEAREST));
+            UNIT_CHECK(same_rgba(ref, out));
+        }
+        ref->width = out->width = ref->stride = out->stride = 4200;
+        ref->height = out->height = 72;
+    }
+    rk_dmabuf_free(out);
+    rk_dmabuf_free(ref);
+    rk_dmabuf_free(src);
+
+    // 8400x144 -> 4200x72：源与输出都超限；块边界在缩放格点上，最近邻一致，双线性只差接缝
+    src = make_gradient_buffer(8400, 144);
+    ref = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 4200, 72, RK_FORMAT_RGBA8888);
+    out = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 4200, 72, RK_FORMAT_RGBA8888);
+    UNIT_CHECK(src && ref && out);
+    if (src && ref && out) {
+        RkRgaJob job = {};
+        int n = rk_rga_job_split(src, out, &job, rga3 | rga2, tiles);
+        UNIT_CHECK(n == 2);
+        for (int i = 0; i < n; i++) {
+            RkRgaJobDesc desc;
+            rk_rga_job_describe(src, out, &tiles[i], &desc);
+            UNIT_CHECK(rk_rga_core_supports(RK_RGA_CORE_RGA3_0, &desc));
+        }
+        UNIT_CHECK(rk_cpu_process_job(src, ref, &job) == RKSS_SUCCESS);
+        UNIT_CHECK(run_tiles(src, out, tiles, n, RK_CPU_FILTER_NEAREST));
+        UNIT_CHECK(max_byte_diff(ref, out) == 0);
+
+        UNIT_CHECK(rk_cpu_process_job_ex(src, ref, &job, RK_CPU_FILTER_BILINEAR, NULL) ==
+                   RKSS_SUCCESS);
+        UNIT_CHECK(run_tiles(src, out, tiles, n, RK_CPU_FILTER_BILINEAR));
+        int diff = max_byte_diff(ref, out);
+        UNIT_CHECK(diff <= 2);
+        printf("   bilinear 8400x144 -> 4200x72 in %d tiles: max diff %d\n", n, diff);
+
+        // 3 倍放大到超限输出：格点步长 3，块边界仍对齐
+        job.crop_width = 1400;
+        job.crop_height = 24;
+        n = rk_rga_job_split(src, out, &job, rga2, tiles);
+        UNIT_CHECK(n == 2 && tiles[1].dst_x % 3 == 0);
+        UNIT_CHECK(rk_cpu_process_job(src, ref, &job) == RKSS_SUCCESS);
+        UNIT_CHECK(run_tiles(src, out, tiles, n, RK_CPU_FILTER_NEAREST));
+        UNIT_CHECK(max_byte_diff(ref, out) == 0);
+    }
+    rk_dmabuf_free(out);
+    rk_dmabuf_free(ref);
+    rk_dmabuf_free(src);
+
+    // NV12：块起点为偶数，色度 2x2 平均不跨块，与单次输出逐字节一致
+    src = make_gradient_buffer(4200, 72);
+    ref = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 4200, 72, RK_FORMAT_YUV420SP);
+    out = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 4200, 72, RK_FORMAT_YUV420SP);
+    UNIT_CHECK(src && ref && out);
+    if (src && ref && out) {
+        RkRgaJob job = {};
+        job.rotation = 180;
+        int n = rk_rga_job_split(src, out, &job, rga2, tiles);
+        UNIT_CHECK(n == 2 && (tiles[1].dst_x & 1) == 0);
+        UNIT_CHECK(rk_cpu_process_job(src, ref, &job) == RKSS_SUCCESS);
+        UNIT_CHECK(run_tiles(src, out, tiles, n, RK_CPU_FILTER_NEAREST));
+        UNIT_CHECK(max_byte_diff(ref, out) == 0);
+
+        job.dst_x = 1;      // YUV 输出区域起点须为偶数
+        job.dst_width = 64;
+        job.dst_height = 64;
+        UNIT_CHECK(rk_cpu_process_job(src, out, &job) == RKSS_ERROR_INVALID_PARAM);
+    }
+    rk_dmabuf_free(out);
+    rk_dmabuf_free(ref);
+    rk_dmabuf_free(src);
+
+    // 分块执行器：超限作业逐块提交给模拟核心（pipe fence 不能合并，同步完成），小作业原样透传
+    RkRgaExecutor* exec = rk_rga_executor_create_tiled(rk_rga_executor_create_emulated(2000, 4),
+                                                       rga2);
+    src = make_coord_buffer(4200, 72);
+    out = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 4200, 72, RK_FORMAT_RGBA8888);
+    RkDmaBuffer* small = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 420, 72,
+                                              RK_FORMAT_RGBA8888);
+    UNIT_CHECK(exec && src && out && small);
+    if (exec && src && out && small) {
+        RkRgaJob job = {};
+        job.flip_horizontal = true;
+        int fence = 0;
+        uint64_t t0 = get_time_us();
+        UNIT_CHECK(exec->submit(exec, src, out, &job, -1, &fence) == RKSS_SUCCESS);
+        UNIT_CHECK(fence == -1);
+        UNIT_CHECK(read_pixel(out, 0, 0) == COORD(4199, 0) &&
+                   read_pixel(out, 4199, 71) == COORD(0, 71));
+        uint64_t tiled_us = get_time_us() - t0;
+
+        UNIT_CHECK(exec->submit(exec, src, small, &job, -1, &fence) == RKSS_SUCCESS);
+        UNIT_CHECK(fence >= 0 && rk_fence_wait(fence, 1000) == RKSS_SUCCESS);
+        rk_fence_close(fence);
+
+        RkRgaTileStats stats;
+        UNIT_CHECK(rk_rga_tiled_get_stats(exec, &stats) == RKSS_SUCCESS);
+        UNIT_CHECK(stats.jobs == 2 && stats.tiled_jobs == 1 && stats.tiles == 2);
+        printf("   4200x72 flip H: %lu tiles in %.2f ms (per tile avg %.2f ms, max %.2f ms)\n",
+               (unsigned long)stats.tiles, tiled_us / 1000.0,
+               stats.tile_us_total / stats.tiles / 1000.0, stats.tile_us_max / 1000.0);
+    }
+    RkRgaTileStats stats;
+    UNIT_CHECK(rk_rga_tiled_get_stats(NULL, &stats) == RKSS_ERROR_INVALID_PARAM);
+    rk_rga_executor_destroy(exec);
+    rk_dmabuf_free(small);
+    rk_dmabuf_free(out);
+    rk_dmabuf_free(src);
+}
+
+// 纯色 RGBA buffer（R, G, B, A 字节序）
+static RkDmaBuffer* make_solid_buffer(int w, int h, uint32_t color) {
+    RkDmaBuffer* buf = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), w, h, RK_FORMAT_RGBA8888);
+    if (!buf) return NULL;
+    uint32_t* p = (uint32_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    for (size_t i = 0; p && i < (size_t)buf->stride * h; i++) p[i] = color;
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    return buf;
+}
+
+static void test_overlay() {
+    printf("\n💧 Watermark overlay (CPU blend)\n");
+
+    uint8_t wm[8 * 4 * 4];
+    for (int i = 0; i < 8 * 4; i++) {
+        wm[i * 4 + 0] = 200;
+        wm[i * 4 + 1] = 100;
+        wm[i * 4 + 2] = 0;
+        wm[i * 4 + 3] = 255;
+    }
+
+    // 半透明 + 右下角裁剪：(60,30) 起只剩 4x2
+    // 128/255 混合：R 200*128/255 + 100*127/255 = 150，G 50 + 25，B 0 + 100，A 128 + 127
+    RkDmaBuffer* dst = make_solid_buffer(64, 32, 0xffc83264);
+    RkOverlay* ov = rk_overlay_create(wm, 8, 4, 60, 30, 128, NULL);
+    UNIT_CHECK(dst && ov);
+    if (dst && ov) {
+        UNIT_CHECK(rk_overlay_apply(ov, NULL, dst) == RKSS_SUCCESS);
+        UNIT_CHECK(read_pixel(dst, 60, 30) == 0xff644b96u);
+        UNIT_CHECK(read_pixel(dst, 63, 31) == 0xff644b96u);
+        UNIT_CHECK(read_pixel(dst, 59, 31) == 0xffc83264u);
+        UNIT_CHECK(read_pixel(dst, 63, 29) == 0xffc83264u);
+    }
+    rk_overlay_unref(ov);
+    ov = rk_overlay_create(wm, 8, 4, 64, 0, 255, NULL);     // 完全在图外
+    UNIT_CHECK(ov && rk_overlay_apply(ov, NULL, dst) == RKSS_SUCCESS);
+    UNIT_CHECK(!dst || read_pixel(dst, 63, 0) == 0xffc83264u);
+    rk_overlay_unref(ov);
+    UNIT_CHECK(rk_overlay_create(wm, 8, 4, -1, 0, 255, NULL) == NULL);
+    rk_dmabuf_free(dst);
+
+    // YUV：先在 RGBA 上混合再转换 vs 直接在 NV12/I420 上混合
+    // 不透明且落在偶数坐标时逐字节一致；半透明时只差舍入
+    RkDmaBuffer* rgba = make_gradient_buffer(64, 32);
+    RkDmaBuffer* blended = make_gradient_buffer(64, 32);
+    int formats[2] = {RK_FORMAT_YUV420SP, RK_FORMAT_YUV420P};
+    for (int f = 0; f < 2; f++) {
+        RkDmaBuffer* ref = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 64, 32, formats[f]);
+        RkDmaBuffer* out = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 64, 32, formats[f]);
+        UNIT_CHECK(rgba && blended && ref && out);
+        if (!rgba || !blended || !ref || !out) {
+            rk_dmabuf_free(out);
+            rk_dmabuf_free(ref);
+            continue;
+        }
+        RkRgaJob job = {};
+        uint8_t alphas[2] = {255, 100};
+        for (int a = 0; a < 2; a++) {
+            ov = rk_overlay_create(wm, 8, 4, 4, 2, alphas[a], NULL);
+            UNIT_CHECK(ov != NULL);
+            if (!ov) continue;
+            UNIT_CHECK(rk_cpu_process_job(rgba, blended, &job) == RKSS_SUCCESS);
+            UNIT_CHECK(rk_overlay_apply(ov, NULL, blended) == RKSS_SUCCESS);
+            UNIT_CHECK(rk_cpu_process_job(blended, ref, &job) == RKSS_SUCCESS);
+            UNIT_CHECK(rk_cpu_process_job(rgba, out, &job) == RKSS_SUCCESS);
+            UNIT_CHECK(rk_overlay_apply(ov, NULL, out) == RKSS_SUCCESS);
+            int diff = max_byte_diff(ref, out);
+            UNIT_CHECK(alphas[a] == 255 ? diff == 0 : diff <= 2);
+            rk_overlay_unref(ov);
+        }
+        rk_dmabuf_free(out);
+        rk_dmabuf_free(ref);
+    }
+    rk_dmabuf_free(blended);
+    rk_dmabuf_free(rgba);
+
+    // 紧凑布局（Raw 结果）与带步进的 DMA-BUF 结果一致：RGB888 30 宽，步进 32
+    rgba = make_gradient_buffer(30, 20);
+    RkDmaBuffer* rgb = rk_dmabuf_alloc_aligned(rk_dmabuf_memfd_allocator(), 30, 20,
+                                               RK_FORMAT_RGB888, 32, 1);
+    uint8_t* packed = (uint8_t*)malloc(30 * 20 * 3);
+    ov = rk_overlay_create(wm, 8, 4, 25, 3, 180, NULL);
+    UNIT_CHECK(rgba && rgb && packed && ov && rgb->stride == 32);
+    if (rgba && rgb && packed && ov) {
+        RkRgaJob job = {};
+        UNIT_CHECK(rk_cpu_process_job(rgba, rgb, &job) == RKSS_SUCCESS);
+        uint8_t* p = (uint8_t*)rk_dmabuf_begin_cpu_access(rgb, RK_DMABUF_CPU_READ, 0, rgb->size);
+        for (int y = 0; p && y < 20; y++) memcpy(packed + y * 90, p + y * 96, 90);
+        rk_dmabuf_end_cpu_access(rgb, RK_DMABUF_CPU_READ, 0, rgb->size);
+        uint8_t before = packed[3 * 90 + 25 * 3 + 1];
+
+        UNIT_CHECK(rk_overlay_blend_cpu(ov, rgb) == RKSS_SUCCESS);
+        UNIT_CHECK(rk_overlay_blend_packed(ov, packed, RK_FORMAT_RGB888, 30, 20) == RKSS_SUCCESS);
+        p = (uint8_t*)rk_dmabuf_begin_cpu_access(rgb, RK_DMABUF_CPU_READ, 0, rgb->size);
+        bool same = p != NULL;
+        for (int y = 0; same && y < 20; y++) same = memcmp(packed + y * 90, p + y * 96, 90) == 0;
+        rk_dmabuf_end_cpu_access(rgb, RK_DMABUF_CPU_READ, 0, rgb->size);
+        UNIT_CHECK(same);
+        UNIT_CHECK(packed[3 * 90 + 25 * 3 + 1] != before);    // G 40 -> 约 80
+        UNIT_CHECK(rk_overlay_blend_packed(ov, packed, RK_FORMAT_JPEG, 30, 20) ==
+                   RKSS_ERROR_UNSUPPORTED);
+    }
+    rk_overlay_unref(ov);
+    free(packed);
+    rk_dmabuf_free(rgb);
+    rk_dmabuf_free(rgba);
+
+    // 1080p 上 400x100 水印：每帧 CPU 混合耗时（首次含预乘平面生成）
+    uint8_t* logo = (uint8_t*)malloc(400 * 100 * 4);
+    for (int i = 0; logo && i < 400 * 100; i++) {
+        logo[i * 4 + 0] = 255;
+        logo[i * 4 + 1] = 255;
+        logo[i * 4 + 2] = 255;
+        logo[i * 4 + 3] = (uint8_t)(i % 400 * 255 / 399);
+    }
+    ov = logo ? rk_overlay_create(logo, 400, 100, 1500, 960, 200, NULL) : NULL;
+    for (int f = 0; f < 2 && ov; f++) {
+        int format = f == 0 ? RK_FORMAT_RGBA8888 : RK_FORMAT_YUV420SP;
+        RkDmaBuffer* frame = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 1920, 1080, format);
+        UNIT_CHECK(frame != NULL);
+        if (!frame) continue;
+        UNIT_CHECK(rk_overlay_apply(ov, NULL, frame) == RKSS_SUCCESS);
+        const int rounds = 20;
+        uint64_t t0 = get_time_us();
+        for (int i = 0; i < rounds; i++) rk_overlay_apply(ov, NULL, frame);
+        printf("   400x100 on 1080p %s: %.3f ms/frame\n", rk_format_name(format),
+               (get_time_us() - t0) / 1000.0 / rounds);
+        rk_dmabuf_free(frame);
+    }
+    rk_overlay_unref(ov);
+    free(logo);
+}
+
+// 扫描标记段：检查 SOI/EOI，取 SOF0 尺寸；*restarts 为熵编码数据中的 RST 标记数
+static bool parse_jpeg(const uint8_t* data, size_t size, int* width, int* height, int* restarts) {
+    if (size < 4 || data[0] != 0xff || data[1] != 0xd8) return false;
+    if (data[size - 2] != 0xff || data[size - 1] != 0xd9) return false;
+    *width = *height = *restarts = 0;
+    size_t pos = 2;
+    while (pos + 4 <= size && data[pos] == 0xff) {
+        uint8_t marker = data[pos + 1];
+        size_t len = (size_t)data[pos + 2] << 8 | data[pos + 3];
+        if (marker == 0xc0 && pos + 9 <= size) {
+            *height = data[pos + 5] << 8 | data[pos + 6];
+            *width = data[pos + 7] << 8 | data[pos + 8];
+        }
+        pos += 2 + len;
+        if (marker == 0xda) break;
+    }
+    for (; pos + 1 < size - 2; pos++) {
+        if (data[pos] == 0xff && data[pos + 1] >= 0xd0 && data[pos + 1] <= 0xd7) (*restarts)++;
+    }
+    return *width > 0 && *height > 0;
+}
+
+static void test_jpeg_sw() {
+    printf("\n🧩 Software JPEG encoder\n");
+
+    RkDmaBuffer* img = make_gradient_buffer(1917, 1073);
+    RkDmaBuffer* flat = make_solid_buffer(640, 480, 0xff808080);
+    RkDmaBuffer* nv12 = rk_dmabuf_alloc_with(rk_dmabuf_memfd_allocator(), 641, 361,
+                                             RK_FORMAT_YUV420SP);
+    UNIT_CHECK(img && flat && nv12);
+    if (img && flat && nv12) {
+        uint8_t* hi = NULL;
+        uint8_t* lo = NULL;
+        size_t hi_size = 0, lo_size = 0;
+        int w, h, rst;
+        uint64_t t0 = get_time_us();
+        UNIT_CHECK(rk_jpeg_sw_encode(img, 90, &hi, &hi_size) == RKSS_SUCCESS);
+        uint64_t elapsed = get_time_us() - t0;
+        UNIT_CHECK(hi && parse_jpeg(hi, hi_size, &w, &h, &rst) && w == 1917 && h == 1073);
+        UNIT_CHECK(rk_jpeg_sw_encode(img, 30, &lo, &lo_size) == RKSS_SUCCESS);
+        UNIT_CHECK(lo_size < hi_size);
+        free(hi);
+        free(lo);
+
+        // 纯色画面几乎只剩头部
+        UNIT_CHECK(rk_jpeg_sw_encode(flat, 90, &lo, &lo_size) == RKSS_SUCCESS);
+        UNIT_CHECK(lo_size < 8 * 1024);
+        free(lo);
+
+        UNIT_CHECK(rk_jpeg_sw_encode(nv12, 90, &lo, &lo_size) == RKSS_SUCCESS);
+        UNIT_CHECK(parse_jpeg(lo, lo_size, &w, &h, &rst) && w == 641 && h == 361 && rst == 0);
+        free(lo);
+
+        flat->format = RK_FORMAT_RGB888;
+        UNIT_CHECK(rk_jpeg_sw_encode(flat, 90, &lo, &lo_size) == RKSS_ERROR_UNSUPPORTED);
+        flat->format = RK_FORMAT_RGBA8888;
+        printf("    1917x1073 Q90: %zu bytes in %.2f ms\n", hi_size, elapsed / 1000.0);
+    }
+    rk_dmabuf_free(nv12);
+    rk_dmabuf_free(flat);
+    rk_dmabuf_free(img);
+}
+
+typedef struct {
+    RkJpegPool* pool;
+    RkDmaBuffer* src;
+    int failures;
+} PoolEncodeArgs;
+
+static void pool_encode_task(void* arg, int index) {
+    PoolEncodeArgs* a = (PoolEncodeArgs*)arg;
+    RkMppPacket pkt;
+    if (rk_jpeg_pool_encode(a->pool, a->src, 80, &pkt) != RKSS_SUCCESS) {
+        __atomic_add_fetch(&a->failures, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    int w, h, rst;
+    if (!parse_jpeg(pkt.data, pkt.size, &w, &h, &rst) || w != a->src->width) {
+        __atomic_add_fetch(&a->failures, 1, __ATOMIC_RELAXED);
+    }
+    pkt.release(pkt.buffer);
+}
+
+// 12 次并发编码，每个上下文至少 latency_us；返回耗时
+static uint64_t run_pool(int contexts, int latency_us, RkDmaBuffer* src, RkThreadPool* threads,
+                         RkJpegEncoderStats* enc_stats, RkJpegPoolStats* stats, int* failures) {
+    RkJpegEncoder* encoders[RK_JPEG_POOL_MAX];
+    for (int i = 0; i < contexts; i++) encoders[i] = rk_jpeg_encoder_create_sw(latency_us);
+    RkJpegPool* pool = rk_jpeg_pool_create(encoders, contexts);
+    if (!pool) {
+        *failures = 1;
+        return 0;
+    }
+    PoolEncodeArgs args = {pool, src, 0};
+    uint64_t t0 = get_time_us();
+    rk_thread_pool_run(threads, 12, pool_encode_task, &args);
+    uint64_t elapsed = get_time_us() - t0;
+    rk_jpeg_pool_get_stats(pool, enc_stats, stats);
+    rk_jpeg_pool_destroy(pool);
+    *failures = args.failures;
+    return elapsed;
+}
+
+static void test_jpeg_pool() {
+    printf("\n🧩 JPEG encoder pool\n");
+
+    RkDmaBuffer* src = make_gradient_buffer(320, 240);
+    RkThreadPool* threads = rk_thread_pool_create(6);
+    UNIT_CHECK(src && threads);
+    if (src && threads) {
+        // 模拟每帧 10ms 的硬件核心：吞吐随上下文数增长
+        RkJpegEncoderStats enc[RK_JPEG_POOL_MAX];
+        RkJpegPoolStats one, three;
+        int failures = 0;
+        uint64_t t1 = run_pool(1, 10000, src, threads, enc, &one, &failures);
+        UNIT_CHECK(failures == 0 && one.encodes == 12 && enc[0].frames == 12);
+        UNIT_CHECK(one.waits > 0);
+        // 同一上下文连续编码同规格：除第一帧外都沿用配置
+        UNIT_CHECK(enc[0].affinity_hits == 11);
+
+        uint64_t t3 = run_pool(3, 10000, src, threads, enc, &three, &failures);
+        UNIT_CHECK(failures == 0 && three.encodes == 12);
+        for (int i = 0; i < 3; i++) {
+            UNIT_CHECK(enc[i].frames > 0 && enc[i].busy_us >= enc[i].frames * 10000);
+        }
+        // 墙钟加速依赖空闲 CPU（ASan / 单核主机上真实编码比模拟延迟更慢），只在多核时校验；
+        // 否则看池统计：各上下文忙碌时间之和超过池的存活时间，即上下文确实并发使用
+        uint64_t busy = enc[0].busy_us + enc[1].busy_us + enc[2].busy_us;
+        UNIT_CHECK(busy > three.elapsed_us);
+        if (sysconf(_SC_NPROCESSORS_ONLN) >= 3) UNIT_CHECK(t1 >= 12 * 10000 && t3 * 2 < t1);
+        printf("    12 encodes: 1 context %.1f ms (%lu waits), 3 contexts %.1f ms (%lu waits)\n",
+               t1 / 1000.0, one.waits, t3 / 1000.0, three.waits);
+        for (int i = 0; i < 3; i++) {
+            printf("      %s#%d: %lu frames, %.0f%% busy\n", enc[i].name, i, enc[i].frames,
+                   enc[i].busy_us * 100.0 / three.elapsed_us);
+        }
+
+        // 不支持的格式：上下文报错后归还，仍可继续使用
+        RkJpegEncoder* e = rk_jpeg_encoder_create_sw(0);
+        RkJpegPool* pool = rk_jpeg_pool_create(&e, 1);
+        RkMppPacket pkt;
+        src->format = RK_FORMAT_BGR888;
+        UNIT_CHECK(rk_jpeg_pool_encode(pool, src, 80, &pkt) == RKSS_ERROR_UNSUPPORTED);
+        src->format = RK_FORMAT_RGBA8888;
+        UNIT_CHECK(rk_jpeg_pool_encode(pool, src, 80, &pkt) == RKSS_SUCCESS);
+        pkt.release(pkt.buffer);
+        rk_jpeg_pool_get_stats(pool, enc, NULL);
+        UNIT_CHECK(enc[0].failures == 1 && enc[0].frames == 1);
+        rk_jpeg_pool_destroy(pool);
+        UNIT_CHECK(rk_jpeg_pool_create(&e, 0) == NULL);
+    }
+    rk_thread_pool_destroy(threads);
+    rk_dmabuf_free(src);
+}
+
+static void test_jpeg_strips() {
+    printf("\n🧩 JPEG strip encoding\n");
+
+    UNIT_CHECK(rk_jpeg_strip_rows(1080, 4) == 272 && rk_jpeg_strip_rows(2160, 4) == 544);
+    UNIT_CHECK(rk_jpeg_strip_count(1920, 1080, 4, 1) == 4);
+    UNIT_CHECK(rk_jpeg_strip_count(1920, 1080, RK_JPEG_STRIPS_AUTO, 4) == 1);
+    UNIT_CHECK(rk_jpeg_strip_count(2560, 1440, RK_JPEG_STRIPS_AUTO, 4) == 4);
+    UNIT_CHECK(rk_jpeg_strip_count(64, 40, 8, 4) == 3);     // 16 行对齐后只能切 3 条
+    UNIT_CHECK(rk_jpeg_strip_count(1920, 1080, 0, 4) == 1);
+
+    const int contexts = 4;
+    RkJpegEncoder* encoders[contexts];
+    for (int i = 0; i < contexts; i++) encoders[i] = rk_jpeg_encoder_create_sw(0);
+    RkJpegPool* pool = rk_jpeg_pool_create(encoders, contexts);
+    RkThreadPool* threads = rk_thread_pool_create(contexts);
+    UNIT_CHECK(pool && threads);
+
+    static const int sizes[3][2] = {{1920, 1080}, {2560, 1440}, {3840, 2160}};
+    for (int s = 0; pool && threads && s < 3; s++) {
+        int w = sizes[s][0], h = sizes[s][1];
+        RkDmaBuffer* src = make_gradient_buffer(w, h);
+        UNIT_CHECK(src);
+        if (!src) continue;
+
+        RkMppPacket single, strips;
+        uint64_t t0 = get_time_us();
+        UNIT_CHECK(rk_jpeg_pool_encode(pool, src, 85, &single) == RKSS_SUCCESS);
+        uint64_t t_single = get_time_us() - t0;
+        t0 = get_time_us();
+        UNIT_CHECK(rk_jpeg_pool_encode_strips(pool, threads, src, 85, contexts, &strips) ==
+                   RKSS_SUCCESS);
+        uint64_t t_strips = get_time_us() - t0;
+
+        // 一个基线 JPEG，条带之间各一个 RST；体积只多出 RST、补齐字节与 DC 重置
+        int sw, sh, rst;
+        UNIT_CHECK(parse_jpeg(strips.data, strips.size, &sw, &sh, &rst));
+        UNIT_CHECK(sw == w && sh == h && rst == contexts - 1);
+        UNIT_CHECK(strips.size < single.size + single.size / 100);
+        printf("    %dx%d: single %.1f ms (%zu KB), %d strips %.1f ms (%+ld bytes)\n", w, h,
+               t_single / 1000.0, single.size / 1024, contexts, t_strips / 1000.0,
+               (long)strips.size - (long)single.size);
+        single.release(single.buffer);
+        strips.release(strips.buffer);
+        rk_dmabuf_free(src);
+    }
+    printf("    (CPU stand-in, %ld host CPU(s); run -p on device for MPP numbers)\n",
+           sysconf(_SC_NPROCESSORS_ONLN));
+
+    // 拼接校验：表不同、条带不等高时拒绝
+    RkDmaBuffer* src = make_gradient_buffer(320, 96);
+    if (pool && src) {
+        RkMppPacket parts[3];
+        UNIT_CHECK(rk_jpeg_pool_encode_rows(pool, src, 0, 32, 80, &parts[0]) == RKSS_SUCCESS);
+        UNIT_CHECK(rk_jpeg_pool_encode_rows(pool, src, 32, 32, 80, &parts[1]) == RKSS_SUCCESS);
+        UNIT_CHECK(rk_jpeg_pool_encode_rows(pool, src, 64, 32, 50, &parts[2]) == RKSS_SUCCESS);
+        uint8_t* out = NULL;
+        size_t size = 0;
+        int w, h, rst;
+        UNIT_CHECK(rk_jpeg_stitch_strips(parts, 2, 320, 64, &out, &size) == RKSS_SUCCESS);
+        UNIT_CHECK(parse_jpeg(out, size, &w, &h, &rst) && h == 64 && rst == 1);
+        free(out);
+        UNIT_CHECK(rk_jpeg_stitch_strips(parts, 3, 320, 96, &out, &size) ==
+                   RKSS_ERROR_ENCODE_FAILED);
+        UNIT_CHECK(rk_jpeg_stitch_strips(parts, 2, 320, 80, &out, &size) ==
+                   RKSS_ERROR_INVALID_PARAM);
+        for (int i = 0; i < 3; i++) parts[i].release(parts[i].buffer);
+        UNIT_CHECK(rk_jpeg_pool_encode_rows(pool, src, 1, 32, 80, &parts[0]) ==
+                   RKSS_ERROR_INVALID_PARAM);
+    }
+    rk_dmabuf_free(src);
+    rk_thread_pool_destroy(threads);
+    rk_jpeg_pool_destroy(pool);
+}
+
+// 大小只随质量变化的假编码器：bytes = per_quality * quality
+typedef struct {
+    size_t per_quality;
+    int calls;
+    int last_quality;
+} FakeJpegSizer;
+
+static RkScreenshotError fake_jpeg_encode(void* user, int quality, RkMppPacket* out) {
+    FakeJpegSizer* f = (FakeJpegSizer*)user;
+    f->calls++;
+    f->last_quality = quality;
+    out->data = (uint8_t*)malloc(1);
+    out->buffer = out->data;
+    out->release = free;
+    out->size = f->per_quality * quality;
+    return out->data ? RKSS_SUCCESS : RKSS_ERROR_NO_MEMORY;
+}
+
+typedef struct {
+    RkJpegPool* pool;
+    RkDmaBuffer* src;
+} SwJpegJob;
+
+static RkScreenshotError sw_jpeg_encode(void* user, int quality, RkMppPacket* out) {
+    SwJpegJob* job = (SwJpegJob*)user;
+    return rk_jpeg_pool_encode(job->pool, job->src, quality, out);
+}
+
+static void test_jpeg_rate() {
+    printf("\n🧩 JPEG target size\n");
+
+    RkJpegRateModel model;
+    rk_jpeg_rate_init(&model);
+
+    // 无数据时按先验：预算越大质量越高，不超过调用者的 quality
+    UNIT_CHECK(rk_jpeg_rate_pick(&model, 1920, 1080, 1 << 30, 85) == 85);
+    UNIT_CHECK(rk_jpeg_rate_pick(&model, 1920, 1080, 1 << 30, 70) == 70);
+    UNIT_CHECK(rk_jpeg_rate_pick(&model, 1920, 1080, 1, 100) == 10);
+    UNIT_CHECK(rk_jpeg_rate_pick(&model, 1920, 1080, 200 * 1024, 100) <
+               rk_jpeg_rate_pick(&model, 1920, 1080, 600 * 1024, 100));
+
+    // 模型低估一半时：超预算后按修正的模型降档，只重编码一次
+    rk_jpeg_rate_update(&model, 640, 480, 90, 45000);
+    FakeJpegSizer fake = {1000, 0, 0};
+    RkMppPacket pkt;
+    int quality = 0;
+    UNIT_CHECK(rk_jpeg_encode_target(&model, 640, 480, 45000, 100, fake_jpeg_encode, &fake, &pkt,
+                                     &quality) == RKSS_SUCCESS);
+    UNIT_CHECK(fake.calls == 2 && quality < 100 && pkt.size == fake.per_quality * quality);
+    pkt.release(pkt.buffer);
+    // 学到后首次即命中
+    fake.calls = 0;
+    UNIT_CHECK(rk_jpeg_encode_target(&model, 640, 480, 45000, 100, fake_jpeg_encode, &fake, &pkt,
+                                     &quality) == RKSS_SUCCESS);
+    UNIT_CHECK(fake.calls == 1 && pkt.size <= 45000);
+    pkt.release(pkt.buffer);
+
+    // 放不下时：重编码一次后返回较小的结果；已是最低档则不重编码
+    fake.per_quality = 100000;
+    fake.calls = 0;
+    UNIT_CHECK(rk_jpeg_encode_target(&model, 640, 480, 45000, 100, fake_jpeg_encode, &fake, &pkt,
+                                     &quality) == RKSS_SUCCESS);
+    UNIT_CHECK(fake.calls == 2 && pkt.size > 45000 && quality == fake.last_quality);
+    pkt.release(pkt.buffer);
+    fake.calls = 0;
+    UNIT_CHECK(rk_jpeg_encode_target(&model, 640, 480, 45000, 10, fake_jpeg_encode, &fake, &pkt,
+                                     &quality) == RKSS_SUCCESS);
+    UNIT_CHECK(fake.calls == 1 && quality == 10);
+    pkt.release(pkt.buffer);
+    // quality 11-14 与 Q10 同一 quant 档，同样不重编码；25 的重编码必须落到更低的档
+    fake.calls = 0;
+    UNIT_CHECK(rk_jpeg_encode_target(&model, 640, 480, 45000, 14, fake_jpeg_encode, &fake, &pkt,
+                                     &quality) == RKSS_SUCCESS);
+    UNIT_CHECK(fake.calls == 1 && quality == 14);
+    pkt.release(pkt.buffer);
+    fake.per_quality = 1000;
+    fake.calls = 0;
+    UNIT_CHECK(rk_jpeg_encode_target(&model, 320, 240, 6000, 25, fake_jpeg_encode, &fake, &pkt,
+                                     &quality) == RKSS_SUCCESS);
+    UNIT_CHECK(fake.calls == 2 && fake.last_quality <= 20);
+    pkt.release(pkt.buffer);
+
+    RkJpegRateStats stats;
+    rk_jpeg_rate_get_stats(&model, &stats);
+    UNIT_CHECK(stats.frames == 6 && stats.first_hits == 1 && stats.reencodes == 3 &&
+               stats.misses == 5);
+    UNIT_CHECK(rk_jpeg_encode_target(&model, 640, 480, 0, 100, fake_jpeg_encode, &fake, &pkt,
+                                     &quality) == RKSS_ERROR_INVALID_PARAM);
+    rk_jpeg_rate_deinit(&model);
+
+    // 软件编码的真实曲线：选中的质量与逐档枚举的最优解相差不超过一档
+    RkJpegEncoder* sw = rk_jpeg_encoder_create_sw(0);
+    RkJpegPool* pool = rk_jpeg_pool_create(&sw, 1);
+    RkDmaBuffer* src = make_gradient_buffer(640, 480);
+    UNIT_CHECK(pool && src);
+    if (pool && src) {
+        SwJpegJob job = {pool, src};
+        size_t sizes[10];
+        for (int i = 0; i < 10; i++) {
+            UNIT_CHECK(sw_jpeg_encode(&job, (i + 1) * 10, &pkt) == RKSS_SUCCESS);
+            sizes[i] = pkt.size;
+            pkt.release(pkt.buffer);
+        }
+        size_t budget = (sizes[5] + sizes[6]) / 2;    // Q60 放得下，Q70 放不下
+        rk_jpeg_rate_init(&model);
+        int frames = 10, within = 0, last_quality = 0;
+        for (int i = 0; i < frames; i++) {
+            UNIT_CHECK(rk_jpeg_encode_target(&model, 640, 480, budget, 100, sw_jpeg_encode, &job,
+                                             &pkt, &last_quality) == RKSS_SUCCESS);
+            within += pkt.size <= budget;
+            pkt.release(pkt.buffer);
+        }
+        rk_jpeg_rate_get_stats(&model, &stats);
+        UNIT_CHECK(within == frames && stats.misses == 0);
+        UNIT_CHECK(last_quality == 60 || last_quality == 50);
+        UNIT_CHECK(stats.reencodes <= 2);
+        printf("    640x480 budget %zu B: Q%d, %lu/%lu first-pass hits, %lu re-encodes, "
+               "%.0f%% budget used\n", budget, last_quality, stats.first_hits, stats.frames,
+               stats.reencodes, 100.0 * stats.fill_sum / stats.frames);
+        rk_jpeg_rate_deinit(&model);
+    }
+    rk_dmabuf_free(src);
+    rk_jpeg_pool_destroy(pool);
+}
+
+// 在 [p, p + n) 中找一层 box，返回其内容
+static const uint8_t* find_box(const uint8_t* p, size_t n, const char* type, size_t* len) {
+    size_t pos = 0;
+    while (pos + 8 <= n) {
+        uint64_t size = (uint32_t)(p[pos] << 24 | p[pos + 1] << 16 | p[pos + 2] << 8 | p[pos + 3]);
+        size_t head = 8;
+        if (size == 1 && pos + 16 <= n) {
+            size = 0;
+            for (int i = 0; i < 8; i++) size = size << 8 | p[pos + 8 + i];
+            head = 16;
+        }
+        if (size < head || pos + size > n) return NULL;
+        if (memcmp(p + pos + 4, type, 4) == 0) {
+            *len = size - head;
+            return p + pos + head;
+        }
+        pos += size;
+    }
+    return NULL;
+}
+
+static uint32_t be32(const uint8_t* p) {
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+typedef struct {
+    uint32_t samples;       // stsz
+    uint32_t syncs;         // stss
+    uint32_t media_duration;
+    const uint8_t* config;  // avcC / hvcC 内容
+    bool ok;
+} Mp4Info;
+
+static uint8_t* read_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = (uint8_t*)malloc(*size ? *size : 1);
+    if (data && fread(data, 1, *size, f) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+// data 需保持到 info->config 用完
+static Mp4Info parse_mp4(const uint8_t* data, size_t size, bool hevc) {
+    Mp4Info info = {};
+    size_t len;
+    const uint8_t* mdat = find_box(data, size, "mdat", &len);
+    const uint8_t* moov = find_box(data, size, "moov", &len);
+    if (!mdat || !moov) return info;
+    const uint8_t* b = moov;
+    const char* path[] = {"trak", "mdia", "minf", "stbl"};
+    for (int i = 0; b && i < 4; i++) {
+        b = find_box(b, len, path[i], &len);
+        if (b && i == 1) {
+            size_t mlen;
+            const uint8_t* mdhd = find_box(b, len, "mdhd", &mlen);
+            if (mdhd) info.media_duration = be32(mdhd + 16);
+        }
+    }
+    if (!b) return info;
+    size_t l;
+    const uint8_t* stsz = find_box(b, len, "stsz", &l);
+    const uint8_t* stss = find_box(b, len, "stss", &l);
+    const uint8_t* co64 = find_box(b, len, "co64", &l);
+    const uint8_t* stsd = find_box(b, len, "stsd", &l);
+    if (!stsz || !stss || !co64 || !stsd) return info;
+    info.samples = be32(stsz + 8);
+    info.syncs = be32(stss + 4);
+    // 样本条目头 8 + 78 字节后是解码配置
+    const uint8_t* entry = find_box(stsd + 8, l - 8, hevc ? "hvc1" : "avc1", &l);
+    if (!entry || l < 78) return info;
+    info.config = find_box(entry + 78, l - 78, hevc ? "hvcC" : "avcC", &l);
+    // 首个样本偏移落在 mdat 内，长度前缀不超过样本大小
+    uint64_t off = 0;
+    for (int i = 0; i < 8; i++) off = off << 8 | co64[8 + i];
+    info.ok = info.config && off >= (uint64_t)(mdat - data) && off + 4 <= size &&
+              be32(data + off) + 4 <= be32(stsz + 12);
+    return info;
+}
+
+static void fill_luma(RkDmaBuffer* buf, uint8_t value) {
+    uint8_t* p = (uint8_t*)rk_dmabuf_begin_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+    if (!p) return;
+    memset(p, value, buf->size);
+    rk_dmabuf_end_cpu_access(buf, RK_DMABUF_CPU_WRITE, 0, buf->size);
+}
+
+static void test_video_muxer() {
+    printf("\n🧩 Video encoder / muxer\n");
+
+    RkVideoEncParams params = {RK_FORMAT_H264, 320, 240, 30, 5, 0};
+    params.bitrate = rk_video_default_bitrate(RK_FORMAT_H264, 320, 240, 30);
+    UNIT_CHECK(params.bitrate >= 200000);
+    UNIT_CHECK(rk_video_default_bitrate(RK_FORMAT_H265, 1920, 1080, 30) <
+               rk_video_default_bitrate(RK_FORMAT_H264, 1920, 1080, 30));
+    RkVideoEncParams odd = params;
+    odd.width = 321;
+    UNIT_CHECK(rk_video_encoder_create_stub(&odd, 0) == NULL);
+    odd = params;
+    odd.codec = RK_FORMAT_JPEG;
+    UNIT_CHECK(rk_video_encoder_create_stub(&odd, 0) == NULL);
+
+    const RkDmaAllocator* memfd = rk_dmabuf_memfd_allocator();
+    RkDmaBuffer* frame = rk_dmabuf_alloc_aligned(memfd, 320, 240, RK_FORMAT_YUV420SP, 16, 16);
+    RkDmaBuffer* wrong = rk_dmabuf_alloc_aligned(memfd, 160, 120, RK_FORMAT_YUV420SP, 16, 16);
+    UNIT_CHECK(frame && wrong);
+    if (!frame || !wrong) {
+        rk_dmabuf_free(frame);
+        rk_dmabuf_free(wrong);
+        return;
+    }
+
+    static const int codecs[2] = {RK_FORMAT_H264, RK_FORMAT_H265};
+    for (int c = 0; c < 2; c++) {
+        bool hevc = codecs[c] == RK_FORMAT_H265;
+        params.codec = codecs[c];
+        RkVideoEncoder* enc = rk_video_encoder_create_stub(&params, 0);
+        UNIT_CHECK(enc != NULL);
+        if (!enc) continue;
+        RkMppPacket pkt;
+        UNIT_CHECK(enc->encode(enc, wrong, false, &pkt) == RKSS_ERROR_INVALID_PARAM);
+
+        char es_path[64], mp4_path[64];
+        snprintf(es_path, sizeof(es_path), "/tmp/rk_video_test_%d.%s", getpid(),
+                 hevc ? "h265" : "h264");
+        snprintf(mp4_path, sizeof(mp4_path), "/tmp/rk_video_test_%d.mp4", getpid());
+        RkVideoMuxer* es = rk_video_muxer_open(es_path, params.codec, 320, 240);
+        RkVideoMuxer* mp4 = rk_video_muxer_open(mp4_path, params.codec, 320, 240);
+        UNIT_CHECK(es && mp4);
+
+        // 12 帧，GOP 5：帧 0/5 为关键帧，帧 7 强制 IDR 后重新计数（帧 12 之前不再有）
+        int keys = 0;
+        for (int i = 0; es && mp4 && i < 12; i++) {
+            fill_luma(frame, (uint8_t)(i * 16));
+            UNIT_CHECK(enc->encode(enc, frame, i == 7, &pkt) == RKSS_SUCCESS);
+            bool key = rk_video_au_is_keyframe(params.codec, pkt.data, pkt.size);
+            keys += key;
+            UNIT_CHECK(key == (i == 0 || i == 5 || i == 7));
+            // 帧 3 之后空出一个节拍，模拟静止跳过（MP4 中帧 3 时长加倍）
+            int64_t pts = i * 33333 + (i >= 4 ? 33333 : 0);
+            UNIT_CHECK(rk_video_muxer_write(es, pkt.data, pkt.size, pts) == RKSS_SUCCESS);
+            UNIT_CHECK(rk_video_muxer_write(mp4, pkt.data, pkt.size, pts) == RKSS_SUCCESS);
+            if (i == 11) {
+                UNIT_CHECK(rk_video_muxer_write(mp4, pkt.data, pkt.size, pts) ==
+                           RKSS_ERROR_INVALID_PARAM);
+            }
+            pkt.release(pkt.buffer);
+        }
+        enc->destroy(enc);
+        int64_t end_us = 13 * 33333;
+        UNIT_CHECK(rk_video_muxer_close(es, end_us) == RKSS_SUCCESS);
+        UNIT_CHECK(rk_video_muxer_close(mp4, end_us) == RKSS_SUCCESS);
+
+        // Annex-B：每个关键帧前一组参数集
+        size_t size = 0;
+        uint8_t* data = read_file(es_path, &size);
+        int params_sets = 0, idr = 0, slices = 0;
+        for (size_t i = 0; data && i + 3 < size; i++) {
+            if (data[i] || data[i + 1] || data[i + 2] != 1) continue;
+            uint8_t h = data[i + 3];
+            int type = hevc ? (h >> 1) & 0x3f : h & 0x1f;
+            if (hevc ? (type >= 32 && type <= 34) : (type == 7 || type == 8)) params_sets++;
+            if (hevc ? type == 19 : type == 5) idr++;
+            if (hevc ? (type == 1 || type == 19) : (type == 1 || type == 5)) slices++;
+        }
+        UNIT_CHECK(slices == 12 && idr == keys && params_sets == keys * (hevc ? 3 : 2));
+        free(data);
+
+        data = read_file(mp4_path, &size);
+        Mp4Info info = data ? parse_mp4(data, size, hevc) : Mp4Info();
+        UNIT_CHECK(info.ok && info.samples == 12 && (int)info.syncs == keys);
+        UNIT_CHECK(info.media_duration == (uint32_t)(end_us * 90000 / 1000000));
+        if (info.ok) {
+            // avcC: High profile；hvcC: Main profile、level 3.1
+            UNIT_CHECK(hevc ? ((info.config[1] & 0x1f) == 1 && info.config[12] == 93)
+                            : info.config[1] == 100);
+        }
+        printf("    %s: %d keyframes, Annex-B + MP4 (%zu bytes)\n", hevc ? "H.265" : "H.264",
+               keys, size);
+        free(data);
+        unlink(es_path);
+        unlink(mp4_path);
+    }
+    rk_dmabuf_free(frame);
+    rk_dmabuf_free(wrong);
+
+    UNIT_CHECK(rk_video_muxer_open("/nonexistent/x.mp4", RK_FORMAT_H264, 320, 240) == NULL);
+    UNIT_CHECK(rk_video_muxer_open("/tmp/x.mp4", RK_FORMAT_JPEG, 320, 240) == NULL);
+}
+
+// 录制测试的帧来源：合成画面经 CPU 转成 16 对齐的 NV12
+typedef struct {
+    RkFrameSource* src;
+    int width;
+    int height;
+} RecordSource;
+
+static RkScreenshotError record_acquire(void* user, RkDmaBuffer** out) {
+    RecordSource* rs = (RecordSource*)user;
+    RkDmaBuffer* rgba = NULL;
+    RkScreenshotError err = rs->src->capture(rs->src, NULL, &rgba);
+    if (err != RKSS_SUCCESS) return err;
+    RkDmaBuffer* nv12 = rk_dmabuf_alloc_aligned(rk_dmabuf_memfd_allocator(), rs->width,
+                                                rs->height, RK_FORMAT_YUV420SP, 16, 16);
+    RkRgaJob job = {};
+    err = nv12 ? rk_cpu_process_job(rgba, nv12, &job) : RKSS_ERROR_NO_MEMORY;
+    rk_dmabuf_free(rgba);
+    if (err != RKSS_SUCCESS) {
+        rk_dmabuf_free(nv12);
+        return err;
+    }
+    *out = nv12;
+    return RKSS_SUCCESS;
+}
+
+static void test_recorder() {
+    printf("\n🧩 Recorder\n");
+
+    // 动态画面（每 3 帧变化）与静止画面各录 0.6 秒，30 fps，GOP 6
+    static const int intervals[2] = {3, 0};
+    for (int s = 0; s < 2; s++) {
+        RkSyntheticSourceConfig scfg = {};
+        scfg.width = 320;
+        scfg.height = 240;
+        scfg.change_interval = intervals[s];
+        scfg.allocator = rk_dmabuf_memfd_allocator();
+        RecordSource rs = {rk_frame_source_create_synthetic(&scfg), 320, 240};
+        UNIT_CHECK(rs.src != NULL);
+        if (!rs.src) continue;
+
+        RkVideoEncParams params = {RK_FORMAT_H264, 320, 240, 30, 6, 400000};
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/rk_record_test_%d.mp4", getpid());
+        RkRecorderSource source = {&rs, record_acquire};
+        RkRecorder* rec = rk_recorder_start(&params, &source,
+                                            rk_video_encoder_create_stub(&params, 2000),
+                                            rk_video_muxer_open(path, params.codec, 320, 240));
+        UNIT_CHECK(rec != NULL);
+        if (!rec) {
+            rk_frame_source_destroy(rs.src);
+            continue;
+        }
+        usleep(600000);
+        RkRecorderStats live;
+        rk_recorder_get_stats(rec, &live);
+        RkRecorderStats stats;
+        UNIT_CHECK(rk_recorder_stop(rec, &stats) == RKSS_SUCCESS);
+        UNIT_CHECK(live.elapsed_us >= 600000 && stats.ticks >= live.ticks);
+        rk_frame_source_destroy(rs.src);
+
+        // 每个节拍要么编码、要么静止跳过、要么失败；每 GOP 个节拍至少一个关键帧
+        UNIT_CHECK(stats.failures == 0);
+        UNIT_CHECK(stats.frames + stats.static_skips + stats.late_ticks == stats.ticks);
+        UNIT_CHECK(stats.ticks >= 10 && stats.keyframes >= stats.ticks / 6);
+        if (intervals[s] == 0) {
+            UNIT_CHECK(stats.static_skips > 0 && stats.frames == stats.keyframes);
+        } else {
+            UNIT_CHECK(stats.frames > stats.keyframes);
+        }
+
+        size_t size = 0;
+        uint8_t* data = read_file(path, &size);
+        Mp4Info info = data ? parse_mp4(data, size, false) : Mp4Info();
+        UNIT_CHECK(info.ok && info.samples == stats.frames && info.syncs == stats.keyframes);
+        // 时长覆盖全部节拍，含末尾的静止期
+        UNIT_CHECK(info.media_duration == stats.ticks * (1000000 / 30) * 90000 / 1000000);
+        printf("    %s: %lu ticks, %lu frames (%lu key), %lu static, %lu late\n",
+               intervals[s] ? "changing" : "static", stats.ticks, stats.frames,
+               stats.keyframes, stats.static_skips, stats.late_ticks);
+        free(data);
+        unlink(path);
+    }
+
+    // 启动参数非法时接管的编码器/封装一并释放
+    RkVideoEncParams bad = {RK_FORMAT_H264, 320, 240, 0, 6, 400000};
+    RkRecorderSource none = {NULL, record_acquire};
+    UNIT_CHECK(rk_recorder_start(&bad, &none, NULL, NULL) == NULL);
+}
+
+static int run_unit_tests() {
+    print_separator("🧩 UNIT TESTS");
+
+    g_unit_failures = 0;
+    test_dmabuf_pool();
+    test_dmabuf_mapping();
+    test_dmabuf_aligned_alloc();
+    test_import_cache();
+    test_mpp_params();
+    test_mpp_packet_sizer();
+    test_scaler_model();
+    test_frame_sources();
+    test_cpu_job();
+    test_cpu_backend();
+    test_rga_executor();
+    test_rga_scheduler();
+    test_rga_tiling();
+    test_overlay();
+    test_jpeg_sw();
+    test_jpeg_pool();
+    test_jpeg_strips();
+    test_jpeg_rate();
+    test_video_muxer();
+    test_recorder();
+
+    printf("\n────────────────────────────────────────────────────────────\n");
+    printf("📊 Unit tests: %s (%d failures)\n",
+           g_unit_failures == 0 ? "PASSED" : "FAILED", g_unit_failures);
+    return g_unit_failures == 0 ? 0 : 1;
 }
 
 //==============================================================================
@@ -209,6 +2691,8 @@ static void print_usage(const char* prog) {
     printf("  -f           Functional tests only (with file output)\n");
     printf("  -p [count]   Performance tests (default: 100 iterations)\n");
     printf("  -b [count]   Benchmark mode (no progress output)\n");
+    printf("  -u           Unit tests for internal modules (no engine init)\n");
+    printf("  -S SPEC      Frame source: sf | synthetic[:WxH[:N]] | replay:FILE:WxH\n");
     printf("  -h           Show this help\n");
     printf("\nNo options: Run both functional and performance tests\n");
 }
@@ -234,6 +2718,10 @@ int main(int argc, char** argv) {
             if (i + 1 < argc && argv[i + 1][0] != '-') {
                 iterations = atoi(argv[++i]);
             }
+        } else if (strcmp(argv[i], "-u") == 0) {
+            return run_unit_tests();
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            rk_screenshot_set_frame_source(argv[++i]);
         } else if (strcmp(argv[i], "-h") == 0) {
             print_usage(argv[0]);
             return 0;
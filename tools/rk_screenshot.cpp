@@ -8,8 +8,15 @@
  *   rk_screencap output.jpg         # 保存 JPEG
  *   rk_screencap output.png         # 保存 PNG (if supported)
  *   rk_screencap -r output.rgba     # 保存原始 RGBA
+ *   rk_screencap out.nv12           # 保存原始 NV12（.i420/.yuv/.rgb/.bgr 同理）
  *   rk_screencap -s 1280x720 out.jpg  # 缩放到指定尺寸
  *   rk_screencap -q 85 out.jpg      # 指定 JPEG 质量 (1-100)
+ *   rk_screencap -m 200000 out.jpg  # 限制 JPEG 大小（自动选质量）
+ *   rk_screencap -c 0,0,960x540 -R 90 -F h out.jpg  # 裁剪 + 旋转 + 镜像
+ *   rk_screencap -j auto out.jpg    # 大帧按条带并行编码
+ *   rk_screencap -S 8080            # MJPEG 推流：http://127.0.0.1:8080/
+ *   rk_screencap -l                 # 列出显示器
+ *   rk_screencap -d ID out.jpg      # 截取指定显示器
  */
 
 #include "rk_screenshot.h"
@@ -17,8 +24,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <signal.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 //==============================================================================
 // Configuration
@@ -28,8 +45,25 @@ typedef struct {
     const char* output_file;
     RkImageFormat format;
     int quality;
+    int max_bytes;
     int scale_width;
     int scale_height;
+    int crop_x;
+    int crop_y;
+    int crop_width;
+    int crop_height;
+    int rotation;
+    bool flip_horizontal;
+    bool flip_vertical;
+    bool nv12_input;
+    int jpeg_strips;
+    int record_seconds;
+    int record_fps;
+    int record_kbps;
+    bool hevc;
+    const char* stream_spec;
+    uint64_t display_id;
+    bool list_displays;
     bool verbose;
     bool to_stdout;
     bool show_timing;
@@ -39,8 +73,25 @@ static void init_config(AppConfig* cfg) {
     cfg->output_file = NULL;
     cfg->format = RK_FORMAT_JPEG;
     cfg->quality = 90;
+    cfg->max_bytes = 0;
     cfg->scale_width = 0;
     cfg->scale_height = 0;
+    cfg->crop_x = 0;
+    cfg->crop_y = 0;
+    cfg->crop_width = 0;
+    cfg->crop_height = 0;
+    cfg->rotation = 0;
+    cfg->flip_horizontal = false;
+    cfg->flip_vertical = false;
+    cfg->nv12_input = false;
+    cfg->jpeg_strips = 0;
+    cfg->record_seconds = 10;
+    cfg->record_fps = 0;
+    cfg->record_kbps = 0;
+    cfg->hevc = false;
+    cfg->stream_spec = NULL;
+    cfg->display_id = 0;
+    cfg->list_displays = false;
     cfg->verbose = false;
     cfg->to_stdout = false;
     cfg->show_timing = false;
@@ -63,13 +114,36 @@ static bool ends_with(const char* str, const char* suffix) {
     return strcasecmp(str + str_len - suffix_len, suffix) == 0;
 }
 
-static RkImageFormat detect_format(const char* filename) {
+static RkImageFormat detect_format(const char* filename, bool hevc) {
     if (ends_with(filename, ".rgba") || ends_with(filename, ".raw")) {
         return RK_FORMAT_RGBA8888;
     }
+    if (ends_with(filename, ".nv12")) return RK_FORMAT_YUV420SP;
+    if (ends_with(filename, ".i420") || ends_with(filename, ".yuv")) return RK_FORMAT_YUV420P;
+    if (ends_with(filename, ".rgb")) return RK_FORMAT_RGB888;
+    if (ends_with(filename, ".bgr")) return RK_FORMAT_BGR888;
+    if (ends_with(filename, ".h264") || ends_with(filename, ".264")) return RK_FORMAT_H264;
+    if (ends_with(filename, ".h265") || ends_with(filename, ".265") ||
+        ends_with(filename, ".hevc")) {
+        return RK_FORMAT_H265;
+    }
+    if (ends_with(filename, ".mp4")) return hevc ? RK_FORMAT_H265 : RK_FORMAT_H264;
     return RK_FORMAT_JPEG;  // Default
 }
 
+static const char* format_name(RkImageFormat format) {
+    switch (format) {
+        case RK_FORMAT_JPEG: return "JPEG";
+        case RK_FORMAT_YUV420SP: return "NV12";
+        case RK_FORMAT_YUV420P: return "I420";
+        case RK_FORMAT_RGB888: return "RGB888";
+        case RK_FORMAT_BGR888: return "BGR888";
+        case RK_FORMAT_H264: return "H.264";
+        case RK_FORMAT_H265: return "H.265";
+        default: return "RGBA";
+    }
+}
+
 //==============================================================================
 // Main
 //==============================================================================
@@ -80,19 +154,501 @@ static void print_usage(const char* prog) {
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -s WxH       Scale to specified size (e.g., -s 1280x720)\n");
     fprintf(stderr, "  -q QUALITY   JPEG quality 1-100 (default: 90)\n");
+    fprintf(stderr, "  -m BYTES     JPEG size budget; picks the highest quality that fits\n");
     fprintf(stderr, "  -r           Output raw RGBA8888 format\n");
+    fprintf(stderr, "  -c X,Y,WxH   Crop source region (e.g., -c 0,0,960x540)\n");
+    fprintf(stderr, "  -R DEGREES   Rotate clockwise 0/90/180/270\n");
+    fprintf(stderr, "  -F h|v|hv    Flip horizontally and/or vertically\n");
+    fprintf(stderr, "  -n           Feed NV12 to the JPEG encoder (RGA converts)\n");
+    fprintf(stderr, "  -j N|auto    Encode JPEG as N parallel strips (auto: 1440p and up)\n");
+    fprintf(stderr, "  -V SECONDS   Recording length for video outputs (default: 10, Ctrl-C stops)\n");
+    fprintf(stderr, "  -f FPS       Recording / streaming frame rate (default: 30 / 15)\n");
+    fprintf(stderr, "  -B KBPS      Recording bitrate (default: estimated from resolution)\n");
+    fprintf(stderr, "  -H           Record .mp4 as H.265 instead of H.264\n");
+    fprintf(stderr, "  -S PORT|PATH Serve an MJPEG stream on 127.0.0.1:PORT or a Unix socket\n");
+    fprintf(stderr, "  -d ID        Capture display ID (default: internal display)\n");
+    fprintf(stderr, "  -l           List connected displays\n");
     fprintf(stderr, "  -v           Verbose output (to stderr)\n");
     fprintf(stderr, "  -t           Show timing information\n");
     fprintf(stderr, "  -h           Show this help\n");
     fprintf(stderr, "\nOutput:\n");
     fprintf(stderr, "  If output_file is specified, write to file\n");
+    fprintf(stderr, "  Raw format follows the extension: .rgba .nv12 .i420/.yuv .rgb .bgr\n");
+    fprintf(stderr, "  Video outputs record the screen: .h264/.264 .h265/.265/.hevc .mp4\n");
     fprintf(stderr, "  Otherwise, write JPEG to stdout (for piping)\n");
     fprintf(stderr, "\nExamples:\n");
     fprintf(stderr, "  %s screenshot.jpg              # Save JPEG\n", prog);
     fprintf(stderr, "  %s -s 1280x720 thumb.jpg       # Scaled JPEG\n", prog);
     fprintf(stderr, "  %s -q 95 -v hq.jpg             # High quality with verbose\n", prog);
+    fprintf(stderr, "  %s -m 150000 -t share.jpg      # Best quality under 150 KB\n", prog);
     fprintf(stderr, "  %s | base64                    # Pipe JPEG to base64\n", prog);
     fprintf(stderr, "  %s -r screen.rgba              # Raw RGBA data\n", prog);
+    fprintf(stderr, "  %s -c 240,0,1440x1080 -R 90 p.jpg  # Crop + rotate\n", prog);
+    fprintf(stderr, "  %s -d 4619827259835644672 hdmi.jpg  # Secondary display\n", prog);
+    fprintf(stderr, "  %s -V 30 -s 1280x720 demo.mp4  # Record 30 s of 720p H.264\n", prog);
+    fprintf(stderr, "  %s -S 8080 -f 10 -s 1280x720   # MJPEG on http://127.0.0.1:8080/\n", prog);
+}
+
+static int list_displays() {
+    RkDisplayInfo displays[RK_MAX_DISPLAYS];
+    int count = 0;
+    RkScreenshotError err = rk_screenshot_get_displays(displays, RK_MAX_DISPLAYS, &count);
+    if (err != RKSS_SUCCESS) {
+        fprintf(stderr, "Error: List displays failed: %s\n", rk_screenshot_error_string(err));
+        return 1;
+    }
+    if (count > RK_MAX_DISPLAYS) count = RK_MAX_DISPLAYS;
+    for (int i = 0; i < count; i++) {
+        printf("%llu\t%dx%d\t%.1f Hz\trotation %d%s\n",
+               (unsigned long long)displays[i].id, displays[i].width, displays[i].height,
+               displays[i].refresh_rate, displays[i].rotation,
+               displays[i].internal ? "\tinternal" : "");
+    }
+    return 0;
+}
+
+static volatile sig_atomic_t g_interrupted = 0;
+
+static void on_interrupt(int) {
+    g_interrupted = 1;
+}
+
+// 录制到 cfg.output_file，持续 record_seconds 秒或直到 Ctrl-C
+static int record_screen(const AppConfig* cfg, const RkScreenshotConfig* cap_cfg) {
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+
+    RkRecordingParams params;
+    memset(&params, 0, sizeof(params));
+    params.fps = cfg->record_fps;
+    params.bitrate = cfg->record_kbps * 1000;
+    int id = rk_screenshot_start_recording_ex(cap_cfg, &params, cfg->output_file);
+    if (id < 0) {
+        fprintf(stderr, "Error: Recording failed: %s\n",
+                rk_screenshot_error_string((RkScreenshotError)id));
+        return 1;
+    }
+    if (cfg->verbose) {
+        fprintf(stderr, "Recording %s to %s for %d s...\n", format_name(cap_cfg->format),
+                cfg->output_file, cfg->record_seconds);
+    }
+
+    uint64_t t_end = get_time_us() + (uint64_t)cfg->record_seconds * 1000000;
+    while (!g_interrupted && get_time_us() < t_end) {
+        usleep(100000);
+    }
+
+    RkScreenshotError err = rk_screenshot_stop_recording(id);
+    if (err != RKSS_SUCCESS) {
+        fprintf(stderr, "Error: Finishing %s failed: %s\n", cfg->output_file,
+                rk_screenshot_error_string(err));
+        return 1;
+    }
+    if (cfg->verbose) fprintf(stderr, "Saved: %s\n", cfg->output_file);
+    return 0;
+}
+
+//==============================================================================
+// MJPEG Streaming
+//==============================================================================
+
+#define STREAM_BOUNDARY      "rkframe"
+#define STREAM_MAX_CLIENTS   16
+#define STREAM_DEFAULT_FPS   15
+// 一帧在此时间内写不完即断开该客户端（管线从不等待客户端）
+#define STREAM_STALL_US      2000000
+#define STREAM_REQUEST_US    2000000
+
+// 一帧编码结果：只编码一次，按引用分发给所有客户端，最后一个引用释放时归还
+typedef struct {
+    RkScreenshotResult* result;
+    char header[128];           // multipart 分段头
+    int header_len;
+    int refs;                   // 受 StreamServer.lock 保护
+} StreamFrame;
+
+typedef struct StreamClient {
+    struct StreamServer* server;
+    int fd;
+    int id;
+    char peer[64];
+    pthread_t thread;
+    StreamFrame* pending;       // 单槽：只保留最新一帧，未发送的旧帧计入 skipped
+    bool closed;                // 线程已退出，等待回收
+    const char* reason;
+    uint64_t connected_us;
+    uint64_t frames;
+    uint64_t skipped;
+    uint64_t bytes;
+    uint64_t send_max_us;
+    struct StreamClient* next;
+} StreamClient;
+
+typedef struct StreamServer {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // 新帧或停止
+    StreamClient* clients;
+    int next_id;
+    bool stop;
+} StreamServer;
+
+// 调用者持有 server->lock
+static void stream_frame_unref(StreamFrame* frame) {
+    if (frame && --frame->refs == 0) {
+        rk_screenshot_free_result(frame->result);
+        free(frame);
+    }
+}
+
+// 在 deadline 前写完（非阻塞 fd）；返回失败原因，NULL 表示成功
+static const char* send_all(int fd, const void* data, size_t len, uint64_t deadline_us) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n > 0) {
+            p += n;
+            len -= n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return "disconnected";
+        uint64_t now = get_time_us();
+        if (now >= deadline_us) return "stalled";
+        struct pollfd pfd = {fd, POLLOUT, 0};
+        poll(&pfd, 1, (int)((deadline_us - now + 999) / 1000));
+    }
+    return NULL;
+}
+
+// 读到请求头结束；只接受 GET，路径不限
+static const char* read_request(int fd) {
+    char buf[1024];
+    size_t len = 0;
+    uint64_t deadline = get_time_us() + STREAM_REQUEST_US;
+    while (len < sizeof(buf) - 1) {
+        ssize_t n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n == 0) return "disconnected";
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return "disconnected";
+            uint64_t now = get_time_us();
+            if (now >= deadline) return "request timeout";
+            struct pollfd pfd = {fd, POLLIN, 0};
+            poll(&pfd, 1, (int)((deadline - now + 999) / 1000));
+            continue;
+        }
+        len += n;
+        buf[len] = '\0';
+        if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n")) {
+            return strncmp(buf, "GET ", 4) == 0 ? NULL : "bad request";
+        }
+    }
+    return "bad request";
+}
+
+static void* stream_client_thread(void* arg) {
+    StreamClient* c = (StreamClient*)arg;
+    StreamServer* s = c->server;
+    static const char k_ok[] =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: multipart/x-mixed-replace; boundary=" STREAM_BOUNDARY "\r\n"
+        "Cache-Control: no-cache, no-store\r\n"
+        "Pragma: no-cache\r\n"
+        "Connection: close\r\n\r\n";
+    static const char k_bad[] = "HTTP/1.0 405 Method Not Allowed\r\nConnection: close\r\n\r\n";
+
+    const char* reason = read_request(c->fd);
+    if (reason) {
+        if (strcmp(reason, "bad request") == 0) {
+            send_all(c->fd, k_bad, sizeof(k_bad) - 1, get_time_us() + STREAM_REQUEST_US);
+        }
+    } else {
+        reason = send_all(c->fd, k_ok, sizeof(k_ok) - 1, get_time_us() + STREAM_STALL_US);
+    }
+
+    while (!reason) {
+        pthread_mutex_lock(&s->lock);
+        while (!s->stop && !c->pending) pthread_cond_wait(&s->wake, &s->lock);
+        StreamFrame* frame = c->pending;
+        c->pending = NULL;
+        pthread_mutex_unlock(&s->lock);
+        if (!frame) {
+            reason = "server stopped";
+            break;
+        }
+
+        uint64_t t0 = get_time_us();
+        uint64_t deadline = t0 + STREAM_STALL_US;
+        reason = send_all(c->fd, frame->header, frame->header_len, deadline);
+        if (!reason) reason = send_all(c->fd, frame->result->data, frame->result->size, deadline);
+        if (!reason) reason = send_all(c->fd, "\r\n", 2, deadline);
+        uint64_t send_us = get_time_us() - t0;
+
+        pthread_mutex_lock(&s->lock);
+        if (!reason) {
+            c->frames++;
+            c->bytes += frame->header_len + frame->result->size + 2;
+            if (send_us > c->send_max_us) c->send_max_us = send_us;
+        }
+        stream_frame_unref(frame);
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    stream_frame_unref(c->pending);
+    c->pending = NULL;
+    c->reason = reason;
+    c->closed = true;
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+static void print_client_stats(const StreamClient* c, const char* state) {
+    double secs = (get_time_us() - c->connected_us) / 1e6;
+    fprintf(stderr, "Client #%d %s: %s after %.1f s, %llu frames (%.1f fps), %llu skipped, "
+            "%.1f KB, max send %.1f ms\n",
+            c->id, c->peer, state, secs, (unsigned long long)c->frames,
+            secs > 0 ? c->frames / secs : 0.0, (unsigned long long)c->skipped,
+            c->bytes / 1024.0, c->send_max_us / 1000.0);
+}
+
+// 回收已退出的客户端线程；all 为 true 时回收全部（调用前已 stop）
+static void reap_clients(StreamServer* s, bool all) {
+    StreamClient* done = NULL;
+    pthread_mutex_lock(&s->lock);
+    StreamClient** link = &s->clients;
+    while (*link) {
+        StreamClient* c = *link;
+        if (all || c->closed) {
+            *link = c->next;
+            c->next = done;
+            done = c;
+        } else {
+            link = &c->next;
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    while (done) {
+        StreamClient* c = done;
+        done = c->next;
+        pthread_join(c->thread, NULL);
+        close(c->fd);
+        print_client_stats(c, c->reason);
+        free(c);
+    }
+}
+
+static void accept_client(StreamServer* s, int listen_fd, bool unix_socket) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd = accept(listen_fd, (struct sockaddr*)&addr, &addr_len);
+    if (fd < 0) return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    int live = 0;
+    pthread_mutex_lock(&s->lock);
+    for (StreamClient* c = s->clients; c; c = c->next) live += !c->closed;
+    pthread_mutex_unlock(&s->lock);
+    StreamClient* c = live < STREAM_MAX_CLIENTS ? (StreamClient*)calloc(1, sizeof(*c)) : NULL;
+    if (!c) {
+        static const char k_busy[] = "HTTP/1.0 503 Service Unavailable\r\nConnection: close\r\n\r\n";
+        send(fd, k_busy, sizeof(k_busy) - 1, MSG_NOSIGNAL);
+        close(fd);
+        return;
+    }
+
+    c->server = s;
+    c->fd = fd;
+    c->id = ++s->next_id;
+    c->connected_us = get_time_us();
+    if (unix_socket) {
+        snprintf(c->peer, sizeof(c->peer), "(unix)");
+    } else {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)&addr;
+        char ip[INET_ADDRSTRLEN] = "?";
+        inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip));
+        snprintf(c->peer, sizeof(c->peer), "(%s:%d)", ip, ntohs(in->sin_port));
+    }
+    if (pthread_create(&c->thread, NULL, stream_client_thread, c) != 0) {
+        close(fd);
+        free(c);
+        return;
+    }
+
+    pthread_mutex_lock(&s->lock);
+    c->next = s->clients;
+    s->clients = c;
+    pthread_mutex_unlock(&s->lock);
+    fprintf(stderr, "Client #%d %s connected\n", c->id, c->peer);
+}
+
+// 分发一帧给所有在线客户端；返回接收者数
+static int publish_frame(StreamServer* s, RkScreenshotResult* result) {
+    StreamFrame* frame = (StreamFrame*)calloc(1, sizeof(StreamFrame));
+    if (!frame) {
+        rk_screenshot_free_result(result);
+        return 0;
+    }
+    frame->result = result;
+    frame->header_len = snprintf(frame->header, sizeof(frame->header),
+                                 "--" STREAM_BOUNDARY "\r\nContent-Type: image/jpeg\r\n"
+                                 "Content-Length: %zu\r\n\r\n", result->size);
+    frame->refs = 1;
+
+    int receivers = 0;
+    pthread_mutex_lock(&s->lock);
+    for (StreamClient* c = s->clients; c; c = c->next) {
+        if (c->closed) continue;
+        if (c->pending) {
+            c->skipped++;
+            stream_frame_unref(c->pending);
+        }
+        c->pending = frame;
+        frame->refs++;
+        receivers++;
+    }
+    stream_frame_unref(frame);
+    pthread_cond_broadcast(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    return receivers;
+}
+
+// spec：纯数字为 127.0.0.1 上的 TCP 端口，否则为 Unix socket 路径
+static int open_listener(const char* spec, bool* unix_socket) {
+    char* end = NULL;
+    long port = strtol(spec, &end, 10);
+    *unix_socket = !(end && *end == '\0' && port > 0 && port < 65536);
+
+    int fd;
+    if (*unix_socket) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(spec) >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Error: Socket path too long: %s\n", spec);
+            return -1;
+        }
+        strcpy(addr.sun_path, spec);
+        // 只清理上次遗留的 socket，不覆盖普通文件
+        struct stat st;
+        if (lstat(spec, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(spec);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)port);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0 || listen(fd, 8) != 0) {
+        fprintf(stderr, "Error: Cannot listen on %s: %s\n", spec, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 常驻服务：按帧率节拍截图编码一次，multipart MJPEG 分发给所有客户端，直到 Ctrl-C
+// 没有客户端时不截图；慢客户端只拿到最新帧，写不动的断开
+static int stream_screen(const AppConfig* cfg, const RkScreenshotConfig* cap_cfg) {
+    bool unix_socket = false;
+    int listen_fd = open_listener(cfg->stream_spec, &unix_socket);
+    if (listen_fd < 0) return 1;
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+    signal(SIGPIPE, SIG_IGN);
+
+    StreamServer server;
+    memset(&server, 0, sizeof(server));
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.wake, NULL);
+
+    const int fps = cfg->record_fps > 0 ? cfg->record_fps : STREAM_DEFAULT_FPS;
+    const uint64_t interval = 1000000 / fps;
+    fprintf(stderr, "Streaming MJPEG at %d fps on %s%s\n", fps,
+            unix_socket ? "unix:" : "http://127.0.0.1:", cfg->stream_spec);
+
+    uint64_t frames = 0, failures = 0, late_ticks = 0, encode_us = 0, bytes = 0;
+    uint64_t start = get_time_us();
+    uint64_t tick = 0;
+    uint64_t next_report = start + 5000000;
+    while (!g_interrupted) {
+        uint64_t due = start + tick * interval;
+        uint64_t now = get_time_us();
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, due > now ? (int)((due - now + 999) / 1000) : 0) > 0) {
+            accept_client(&server, listen_fd, unix_socket);
+        }
+        reap_clients(&server, false);
+        if (get_time_us() < due) continue;
+
+        bool have_clients = false;
+        pthread_mutex_lock(&server.lock);
+        for (StreamClient* c = server.clients; c; c = c->next) have_clients |= !c->closed;
+        pthread_mutex_unlock(&server.lock);
+
+        if (have_clients) {
+            RkScreenshotResult* result = NULL;
+            RkScreenshotError err = rk_screenshot_capture(cap_cfg, &result);
+            if (err == RKSS_SUCCESS && result) {
+                frames++;
+                encode_us += result->encode_time_us;
+                bytes += result->size;
+                publish_frame(&server, result);
+            } else if (failures++ == 0) {
+                fprintf(stderr, "Error: Capture failed: %s\n", rk_screenshot_error_string(err));
+            }
+        }
+
+        // 下一个节拍：处理超时则跳过已错过的节拍
+        uint64_t next = tick + 1;
+        uint64_t now_tick = (get_time_us() - start) / interval;
+        if (now_tick > next) {
+            late_ticks += now_tick - next;
+            next = now_tick;
+        }
+        tick = next;
+
+        if (cfg->verbose && get_time_us() >= next_report) {
+            next_report += 5000000;
+            pthread_mutex_lock(&server.lock);
+            for (StreamClient* c = server.clients; c; c = c->next) {
+                if (!c->closed) print_client_stats(c, "streaming");
+            }
+            pthread_mutex_unlock(&server.lock);
+        }
+    }
+
+    pthread_mutex_lock(&server.lock);
+    server.stop = true;
+    pthread_cond_broadcast(&server.wake);
+    pthread_mutex_unlock(&server.lock);
+    reap_clients(&server, true);
+
+    close(listen_fd);
+    if (unix_socket) unlink(cfg->stream_spec);
+    pthread_cond_destroy(&server.wake);
+    pthread_mutex_destroy(&server.lock);
+
+    fprintf(stderr, "Stream stopped: %llu frames, %llu failed, %llu late ticks, "
+            "avg %.1f KB, encode %.2f ms/frame\n",
+            (unsigned long long)frames, (unsigned long long)failures,
+            (unsigned long long)late_ticks, frames ? bytes / 1024.0 / frames : 0.0,
+            frames ? encode_us / 1000.0 / frames : 0.0);
+    return 0;
 }
 
 static bool parse_size(const char* str, int* width, int* height) {
@@ -105,13 +661,23 @@ static bool parse_size(const char* str, int* width, int* height) {
     return (*width > 0 && *height > 0);
 }
 
+static bool parse_crop(const char* str, int* x, int* y, int* width, int* height) {
+    const char* c1 = strchr(str, ',');
+    const char* c2 = c1 ? strchr(c1 + 1, ',') : NULL;
+    if (!c2) return false;
+
+    *x = atoi(str);
+    *y = atoi(c1 + 1);
+    return *x >= 0 && *y >= 0 && parse_size(c2 + 1, width, height);
+}
+
 int main(int argc, char** argv) {
     AppConfig cfg;
     init_config(&cfg);
     
     // Parse options
     int opt;
-    while ((opt = getopt(argc, argv, "s:q:rvth")) != -1) {
+    while ((opt = getopt(argc, argv, "s:q:m:rc:R:F:nj:V:f:B:HS:d:lvth")) != -1) {
         switch (opt) {
             case 's':
                 if (!parse_size(optarg, &cfg.scale_width, &cfg.scale_height)) {
@@ -126,9 +692,83 @@ int main(int argc, char** argv) {
                     return 1;
                 }
                 break;
+            case 'm':
+                cfg.max_bytes = atoi(optarg);
+                if (cfg.max_bytes <= 0) {
+                    fprintf(stderr, "Error: Invalid size budget '%s'\n", optarg);
+                    return 1;
+                }
+                break;
             case 'r':
                 cfg.format = RK_FORMAT_RGBA8888;
                 break;
+            case 'c':
+                if (!parse_crop(optarg, &cfg.crop_x, &cfg.crop_y,
+                                &cfg.crop_width, &cfg.crop_height)) {
+                    fprintf(stderr, "Error: Invalid crop format '%s', use X,Y,WxH\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'R':
+                cfg.rotation = atoi(optarg);
+                if (cfg.rotation != 0 && cfg.rotation != 90 &&
+                    cfg.rotation != 180 && cfg.rotation != 270) {
+                    fprintf(stderr, "Error: Rotation must be 0, 90, 180 or 270\n");
+                    return 1;
+                }
+                break;
+            case 'F':
+                cfg.flip_horizontal = strchr(optarg, 'h') != NULL;
+                cfg.flip_vertical = strchr(optarg, 'v') != NULL;
+                if (!cfg.flip_horizontal && !cfg.flip_vertical) {
+                    fprintf(stderr, "Error: Flip must be h, v or hv\n");
+                    return 1;
+                }
+                break;
+            case 'n':
+                cfg.nv12_input = true;
+                break;
+            case 'j':
+                cfg.jpeg_strips = strcmp(optarg, "auto") == 0 ? RK_JPEG_STRIPS_AUTO : atoi(optarg);
+                if (cfg.jpeg_strips != RK_JPEG_STRIPS_AUTO &&
+                    (cfg.jpeg_strips < 1 || cfg.jpeg_strips > 8)) {
+                    fprintf(stderr, "Error: Strips must be 1-8 or auto\n");
+                    return 1;
+                }
+                break;
+            case 'V':
+                cfg.record_seconds = atoi(optarg);
+                if (cfg.record_seconds <= 0) {
+                    fprintf(stderr, "Error: Invalid recording length '%s'\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f':
+                cfg.record_fps = atoi(optarg);
+                if (cfg.record_fps <= 0 || cfg.record_fps > 120) {
+                    fprintf(stderr, "Error: Invalid frame rate '%s' (1-120)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'B':
+                cfg.record_kbps = atoi(optarg);
+                if (cfg.record_kbps <= 0 || cfg.record_kbps > 200000) {
+                    fprintf(stderr, "Error: Invalid bitrate '%s' kbps\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'H':
+                cfg.hevc = true;
+                break;
+            case 'S':
+                cfg.stream_spec = optarg;
+                break;
+            case 'd':
+                cfg.display_id = strtoull(optarg, NULL, 0);
+                break;
+            case 'l':
+                cfg.list_displays = true;
+                break;
             case 'v':
                 cfg.verbose = true;
                 break;
@@ -145,17 +785,30 @@ int main(int argc, char** argv) {
     }
     
     // Get output file
-    if (optind < argc) {
+    if (cfg.stream_spec) {
+        cfg.format = RK_FORMAT_JPEG;  // stream is always MJPEG
+    } else if (optind < argc) {
         cfg.output_file = argv[optind];
         // Auto-detect format from extension
         if (cfg.format != RK_FORMAT_RGBA8888) {
-            cfg.format = detect_format(cfg.output_file);
+            cfg.format = detect_format(cfg.output_file, cfg.hevc);
         }
     } else {
         cfg.to_stdout = true;
         cfg.format = RK_FORMAT_JPEG;  // stdout always JPEG
     }
     
+    if (cfg.list_displays) {
+        RkScreenshotError err = rk_screenshot_init();
+        if (err != RKSS_SUCCESS) {
+            fprintf(stderr, "Error: Init failed: %s\n", rk_screenshot_error_string(err));
+            return 1;
+        }
+        int ret = list_displays();
+        rk_screenshot_deinit();
+        return ret;
+    }
+    
     // Check if stdout is a terminal
     if (cfg.to_stdout && isatty(STDOUT_FILENO)) {
         fprintf(stderr, "Error: Will not write binary data to terminal.\n");
@@ -179,13 +832,42 @@ int main(int argc, char** argv) {
     rk_screenshot_get_default_config(&cap_cfg);
     cap_cfg.format = cfg.format;
     cap_cfg.quality = cfg.quality;
+    cap_cfg.jpeg_max_bytes = cfg.max_bytes;
     cap_cfg.scale_width = cfg.scale_width;
     cap_cfg.scale_height = cfg.scale_height;
+    cap_cfg.crop_x = cfg.crop_x;
+    cap_cfg.crop_y = cfg.crop_y;
+    cap_cfg.crop_width = cfg.crop_width;
+    cap_cfg.crop_height = cfg.crop_height;
+    cap_cfg.rotation = cfg.rotation;
+    cap_cfg.flip_horizontal = cfg.flip_horizontal;
+    cap_cfg.flip_vertical = cfg.flip_vertical;
+    cap_cfg.encode_input = cfg.nv12_input ? RK_FORMAT_YUV420SP : RK_FORMAT_RGBA8888;
+    cap_cfg.jpeg_strips = cfg.jpeg_strips;
+    rk_screenshot_config_set_display(&cap_cfg, cfg.display_id);
     
     if (cfg.verbose) {
-        fprintf(stderr, "Config: format=%s, quality=%d, scale=%dx%d\n",
-                cfg.format == RK_FORMAT_JPEG ? "JPEG" : "RGBA",
-                cfg.quality, cfg.scale_width, cfg.scale_height);
+        fprintf(stderr, "Config: format=%s, quality=%d, scale=%dx%d, crop=%d,%d,%dx%d, rotation=%d%s%s\n",
+                format_name(cfg.format),
+                cfg.quality, cfg.scale_width, cfg.scale_height,
+                cfg.crop_x, cfg.crop_y, cfg.crop_width, cfg.crop_height, cfg.rotation,
+                cfg.flip_horizontal ? ", flip H" : "", cfg.flip_vertical ? ", flip V" : "");
+    }
+    
+    if (cfg.stream_spec) {
+        if (cfg.show_timing || cfg.verbose) {
+            fprintf(stderr, "Init: %.2f ms (paid once for the whole stream)\n",
+                    (t_init - t_start) / 1000.0);
+        }
+        int ret = stream_screen(&cfg, &cap_cfg);
+        rk_screenshot_deinit();
+        return ret;
+    }
+    
+    if (cfg.format == RK_FORMAT_H264 || cfg.format == RK_FORMAT_H265) {
+        int ret = record_screen(&cfg, &cap_cfg);
+        rk_screenshot_deinit();
+        return ret;
     }
     
     // Capture
@@ -241,6 +923,10 @@ int main(int argc, char** argv) {
     if (cfg.show_timing || cfg.verbose) {
         fprintf(stderr, "Resolution: %dx%d\n", result->width, result->height);
         fprintf(stderr, "Size: %zu bytes (%.1f KB)\n", result->size, result->size / 1024.0);
+        if (result->format == RK_FORMAT_JPEG) {
+            fprintf(stderr, "Quality: %d%s\n", result->quality,
+                    cfg.max_bytes > 0 && result->size > (size_t)cfg.max_bytes ? " (over budget)" : "");
+        }
     }
     
     if (cfg.show_timing) {